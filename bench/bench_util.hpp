@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * @file bench/bench_util.hpp
+ *
+ * @brief Tiny timing helpers shared by the benchmarks.
+ *
+ * Benchmarks are standalone programs registered via meson's benchmark()
+ * (run with "meson test --benchmark" or "ninja benchmark").  Each takes an
+ * optional first argument that scales the workload size, so the default
+ * run stays quick.
+ */
+
+#pragma once
+#ifndef ELLIS_BENCH_BENCH_UTIL_HPP_
+#define ELLIS_BENCH_BENCH_UTIL_HPP_
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace ellis {
+namespace bench {
+
+
+#ifdef __GLIBC__
+/** Heap allocations so far, including those of operator new and of node
+ * payloads; see malloc() below. */
+static size_t g_mallocs = 0;
+#endif
+
+
+/** Returns the workload scale factor from the command line (default 1). */
+inline size_t scale_arg(int argc, char **argv)
+{
+  if (argc > 1) {
+    long s = atol(argv[1]);
+    if (s > 0) {
+      return (size_t)s;
+    }
+  }
+  return 1;
+}
+
+
+/** Runs fn reps times and returns the fastest run, in seconds. */
+template <typename F>
+double best_of(int reps, F &&fn)
+{
+  using clock = std::chrono::steady_clock;
+  double best = 1e300;
+  for (int i = 0; i < reps; i++) {
+    auto start = clock::now();
+    fn();
+    std::chrono::duration<double> dur = clock::now() - start;
+    if (dur.count() < best) {
+      best = dur.count();
+    }
+  }
+  return best;
+}
+
+
+/** Prints one result line: time, throughput over bytes, and time per item. */
+inline void report(
+    const char *name,
+    double secs,
+    size_t bytes,
+    size_t items)
+{
+  printf("%-36s %9.3f ms %9.1f MB/s %9.1f ns/item\n",
+      name,
+      secs * 1e3,
+      bytes / secs / 1e6,
+      secs * 1e9 / items);
+}
+
+
+}  /* namespace bench */
+}  /* namespace ellis */
+
+
+#ifdef __GLIBC__
+/* Count allocations by standing in front of glibc's malloc.  Each benchmark
+ * is a single translation unit, so this is only defined once. */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *malloc(size_t size) noexcept
+{
+  ellis::bench::g_mallocs++;
+  return __libc_malloc(size);
+}
+#endif
+
+#endif  /* ELLIS_BENCH_BENCH_UTIL_HPP_ */
@@ -0,0 +1,473 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <ellis/codec/json.hpp>
+#include <ellis/codec/json_parallel.hpp>
+#include <ellis/codec/json_view.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/binary_node.hpp>
+#include <ellis/core/emigration.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis_private/codec/util/base64.hpp>
+#include <ellis_private/using.hpp>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "../bench_util.hpp"
+
+using namespace ellis;
+
+
+/** Encodes n repeatedly and reports the best time. */
+static void bench_encode(
+    const char *name,
+    const node &n,
+    size_t items,
+    const json_encoder_opts &opts = json_encoder_opts())
+{
+  json_encoder enc(opts);
+  std::ostringstream sizing;
+  dump_stream(&n, sizing, enc);
+  vector<char> buf(sizing.str().size() + 1);
+  size_t len = 0;
+  double secs = bench::best_of(5, [&]() {
+      dump_mem(&n, buf.data(), buf.size(), enc);
+      len = strlen(buf.data());
+    });
+  bench::report(name, secs, len, items);
+}
+
+
+/** Decodes text repeatedly and reports the best time. */
+static void bench_decode(const char *name, const string &text, size_t items)
+{
+  json_decoder dec;
+  double secs = bench::best_of(5, [&]() {
+      auto n = load_mem(text.data(), text.size(), dec);
+    });
+  bench::report(name, secs, text.size(), items);
+}
+
+
+/*  _   _                 _
+ * | \ | |_   _ _ __ ___ | |__   ___ _ __ ___
+ * |  \| | | | | '_ ` _ \| '_ \ / _ \ '__/ __|
+ * | |\  | |_| | | | | | | |_) |  __/ |  \__ \
+ * |_| \_|\__,_|_| |_| |_|_.__/ \___|_|  |___/
+ *
+ */
+
+
+static void bench_numbers(size_t scale)
+{
+  const size_t count = 100000 * scale;
+  uint64_t state = 0x2545F4914F6CDD1DULL;
+  auto next = [&state]() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+  };
+
+  /* Doubles as they typically come from sensors: a handful of significant
+   * digits, plus some full-precision values. */
+  node dbls(type::ARRAY);
+  auto &da = dbls.as_mutable_array();
+  for (size_t i = 0; i < count; i++) {
+    uint64_t r = next();
+    if (i % 4 == 0) {
+      da.append((double)(r >> 11) / (double)(1ULL << 53) * 1e6);
+    }
+    else {
+      da.append((double)(int64_t)(r % 2000000 - 1000000) / 1000.0);
+    }
+  }
+  bench_encode("json_encode_doubles", dbls, count);
+
+  node ints(type::ARRAY);
+  auto &ia = ints.as_mutable_array();
+  for (size_t i = 0; i < count; i++) {
+    uint64_t r = next();
+    ia.append((int64_t)(r >> (r % 64)) * ((r & 1) ? -1 : 1));
+  }
+  bench_encode("json_encode_ints", ints, count);
+
+  /* Records mixing both, e.g. timestamped samples. */
+  node recs(type::ARRAY);
+  auto &ra = recs.as_mutable_array();
+  const size_t nrecs = count / 4;
+  for (size_t i = 0; i < nrecs; i++) {
+    node rec(type::MAP);
+    auto &m = rec.as_mutable_map();
+    m.insert("t", (int64_t)(1500000000000LL + i * 10));
+    m.insert("x", (double)(int64_t)(next() % 100000) / 100.0);
+    m.insert("y", (double)(int64_t)(next() % 100000) / 100.0);
+    m.insert("v", (double)(next() >> 11) / (double)(1ULL << 53));
+    ra.append(rec);
+  }
+  bench_encode("json_encode_numeric_records", recs, nrecs * 4);
+  json_encoder_opts compact;
+  compact.compact = true;
+  bench_encode("json_encode_numeric_records_compact", recs, nrecs * 4,
+      compact);
+  json_encoder_opts sorted;
+  sorted.sort_keys = true;
+  bench_encode("json_encode_numeric_records_sorted", recs, nrecs * 4,
+      sorted);
+
+  std::ostringstream text;
+  dump_stream(&dbls, text, json_encoder());
+  bench_decode("json_decode_doubles", text.str(), count);
+}
+
+
+/*  ____  _        _
+ * / ___|| |_ _ __(_)_ __   __ _ ___
+ * \___ \| __| '__| | '_ \ / _` / __|
+ *  ___) | |_| |  | | | | | (_| \__ \
+ * |____/ \__|_|  |_|_| |_|\__, |___/
+ *                         |___/
+ */
+
+
+static void bench_strings(size_t scale)
+{
+  const size_t count = 20000 * scale;
+  static const char *k_levels[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+  static const char *k_msgs[] = {
+    "connection established to upstream broker after 3 retries, "
+      "negotiated protocol version 4 with compression enabled",
+    "request completed in 12.4ms with status 200 for client session "
+      "7f3a9c12 (user agent Mozilla 5.0 compatible)",
+    "cache miss for key user profile 83712, falling back to primary "
+      "datastore and scheduling background refresh",
+    "failed to parse \"config.yaml\" at line 42:\n\tunexpected token",
+    "wrote checkpoint to /var/lib/service/state/checkpoint-000123.bin",
+  };
+
+  node logs(type::ARRAY);
+  auto &la = logs.as_mutable_array();
+  for (size_t i = 0; i < count; i++) {
+    node rec(type::MAP);
+    auto &m = rec.as_mutable_map();
+    const char *msg = k_msgs[i % 5];
+    m.insert("level", k_levels[i % 4]);
+    m.insert("logger", "com.example.service.ingest.pipeline.Worker");
+    m.insert("msg", msg);
+    m.insert("thread", "worker-pool-7-thread-12");
+    la.append(rec);
+  }
+  bench_encode("json_encode_log_records", logs, count);
+
+  /* One big string, e.g. an embedded document or stack trace. */
+  string big;
+  while (big.size() < 1000000 * scale) {
+    big += k_msgs[big.size() % 4];
+    big += ' ';
+  }
+  node bign(big);
+  bench_encode("json_encode_big_string", bign, big.size() / 64);
+}
+
+
+/*  ____  _
+ * | __ )(_)_ __   __ _ _ __ _   _
+ * |  _ \| | '_ \ / _` | '__| | | |
+ * | |_) | | | | | (_| | |  | |_| |
+ * |____/|_|_| |_|\__,_|_|   \__, |
+ *                          |___/
+ */
+
+
+static void bench_binary(size_t scale)
+{
+  /* A multi-MB blob, e.g. an image or a compressed payload. */
+  const size_t len = 4000000 * scale;
+  node blob(type::BINARY);
+  auto &b = blob.as_mutable_binary();
+  b.resize(len);
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  for (size_t i = 0; i < len; i++) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    b[i] = (byte)(state >> 56);
+  }
+
+  vector<char> b64(base64_encoded_len(len));
+  double secs = bench::best_of(5, [&]() {
+      base64_encode(b.data(), len, b64.data());
+    });
+  bench::report("base64_encode", secs, len, len / 64);
+  vector<byte> raw(base64_decoded_max(b64.size()));
+  size_t rawlen = 0;
+  secs = bench::best_of(5, [&]() {
+      base64_decode(b64.data(), b64.size(), raw.data(), &rawlen);
+    });
+  bench::report("base64_decode", secs, b64.size(), len / 64);
+
+  bench_encode("json_encode_binary", blob, len / 64);
+  std::ostringstream os;
+  dump_stream(&blob, os, json_encoder());
+  bench_decode("json_decode_binary", os.str(), len / 64);
+}
+
+
+/*  _
+ * | |    __ _ _____   _
+ * | |   / _` |_  / | | |
+ * | |__| (_| |/ /| |_| |
+ * |_____\__,_/___|\__, |
+ *                 |___/
+ */
+
+
+static void bench_lazy(size_t scale)
+{
+  /* A ~1 MB API response of which we only want three fields. */
+  node resp(type::MAP);
+  auto &rm = resp.as_mutable_map();
+  rm.insert("status", "ok");
+  rm.insert("request_id", "c0ffee-1234");
+  node results(type::ARRAY);
+  for (size_t i = 0; i < 4000 * scale; i++) {
+    node rec(type::MAP);
+    auto &m = rec.as_mutable_map();
+    m.insert("id", (int64_t)i);
+    m.insert("name", "item name with some length to it");
+    m.insert("score", i * 0.25);
+    node tags(type::ARRAY);
+    tags.as_mutable_array().append("alpha");
+    tags.as_mutable_array().append("beta");
+    m.insert("tags", tags);
+    m.insert("active", i % 2 == 0);
+    results.as_mutable_array().append(rec);
+  }
+  rm.insert("results", results);
+  node paging(type::MAP);
+  paging.as_mutable_map().insert("total", (int64_t)(4000 * scale));
+  rm.insert("paging", paging);
+
+  std::ostringstream os;
+  dump_stream(&resp, os, json_encoder());
+  const string text = os.str();
+
+  int64_t sink = 0;
+  json_decoder dec;
+  double eager = bench::best_of(5, [&]() {
+      auto n = load_mem(text.data(), text.size(), dec);
+      sink += n->at("{status}").as_u8str().length();
+      sink += n->at("{paging}{total}").as_int64();
+      sink += n->at("{results}[100]{id}").as_int64();
+    });
+  bench::report("json_eager_decode_3_fields", eager, text.size(), 1);
+
+  double lazy = bench::best_of(5, [&]() {
+      json_tape tape(text.data(), text.size());
+      auto root = tape.root();
+      sink += root["status"].as_u8str().length();
+      sink += root.at("{paging}{total}").as_int64();
+      sink += root.at("{results}[100]{id}").as_int64();
+    });
+  bench::report("json_tape_3_fields", lazy, text.size(), 1);
+  if (sink == 42) {
+    printf("\n");
+  }
+}
+
+
+/*  ____                 _ _      _
+ * |  _ \ __ _ _ __ __ _| | | ___| |
+ * | |_) / _` | '__/ _` | | |/ _ \ |
+ * |  __/ (_| | | | (_| | | |  __/ |
+ * |_|   \__,_|_|  \__,_|_|_|\___|_|
+ *
+ */
+
+
+static void bench_parallel(size_t scale)
+{
+  /* A big array of records, as in a data dump or export. */
+  const size_t count = 40000 * scale;
+  node recs(type::ARRAY);
+  auto &ra = recs.as_mutable_array();
+  for (size_t i = 0; i < count; i++) {
+    node rec(type::MAP);
+    auto &m = rec.as_mutable_map();
+    m.insert("id", (int64_t)i);
+    m.insert("name", "record name of moderate length");
+    m.insert("score", i * 0.125);
+    node tags(type::ARRAY);
+    tags.as_mutable_array().append("alpha");
+    tags.as_mutable_array().append((int64_t)(i % 7));
+    m.insert("tags", tags);
+    ra.append(rec);
+  }
+  std::ostringstream os;
+  dump_stream(&recs, os, json_encoder());
+  const string text = os.str();
+
+  printf("(%u hardware threads)\n", std::thread::hardware_concurrency());
+  for (unsigned threads : { 1, 2, 4, 8, 16, 32 }) {
+    json_parallel_opts opts;
+    opts.threads = threads;
+    double secs = bench::best_of(3, [&]() {
+        auto n = json_parallel_decode(text.data(), text.size(), opts);
+      });
+    string name = "json_parallel_decode_t" + std::to_string(threads);
+    bench::report(name.c_str(), secs, text.size(), count);
+  }
+}
+
+
+/*  ____            _           _   _
+ * |  _ \ _ __ ___ (_) ___  ___| |_(_) ___  _ __
+ * | |_) | '__/ _ \| |/ _ \/ __| __| |/ _ \| '_ \
+ * |  __/| | | (_) | |  __/ (__| |_| | (_) | | | |
+ * |_|   |_|  \___// |\___|\___|\__|_|\___/|_| |_|
+ *               |__/
+ */
+
+
+static void bench_projection(size_t scale)
+{
+  /* Wide documents, e.g. telemetry or feature rows, of which a consumer
+   * only wants a handful of columns. */
+  const size_t count = 2000 * scale;
+  const size_t fields = 200;
+  const vector<string> paths =
+    { "{f3}", "{f50}", "{f99}", "{f150}", "{f199}" };
+  vector<string> docs;
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    node doc(type::MAP);
+    auto &m = doc.as_mutable_map();
+    for (size_t f = 0; f < fields; f++) {
+      string key = "f" + std::to_string(f);
+      if (f % 3 == 0) {
+        m.insert(key, (int64_t)(i * f));
+      } else if (f % 3 == 1) {
+        m.insert(key, "some field value " + std::to_string(f));
+      } else {
+        m.insert(key, f * 0.5);
+      }
+    }
+    std::ostringstream os;
+    dump_stream(&doc, os, json_encoder());
+    docs.push_back(os.str());
+    total += docs.back().size();
+  }
+
+  json_decoder dec;
+  double secs = bench::best_of(3, [&]() {
+      for (const auto &text : docs) {
+        auto doc = load_mem(text.data(), text.size(), dec);
+        node slim = doc->as_map().filter(
+            [&](const string &k, const node &) {
+              for (const auto &p : paths) {
+                if (k == p.substr(1, p.size() - 2)) {
+                  return true;
+                }
+              }
+              return false;
+            });
+      }
+    });
+  bench::report("json_decode_full_then_filter", secs, total, count);
+
+  dec.set_projection(paths);
+  secs = bench::best_of(3, [&]() {
+      for (const auto &text : docs) {
+        auto slim = load_mem(text.data(), text.size(), dec);
+      }
+    });
+  bench::report("json_decode_projected", secs, total, count);
+}
+
+
+/*  ____
+ * |  _ \ ___ _   _ ___  ___
+ * | |_) / _ \ | | / __|/ _ \
+ * |  _ <  __/ |_| \__ \  __/
+ * |_| \_\___|\__,_|___/\___|
+ *
+ */
+
+
+static void bench_reuse(size_t scale)
+{
+  /* A stream of small, same-shaped messages, decoded into a fresh node or
+   * into the same one each time. */
+  const size_t count = 20000 * scale;
+  const string msg = "{ \"id\": 12345, \"name\": \"sensor seventeen, rack 4\", "
+    "\"tags\": [ \"alpha\", \"beta\", \"gamma\" ], "
+    "\"pos\": { \"x\": 1.5, \"y\": -2.25 }, \"ok\": true }";
+  json_decoder dec;
+  node out(type::NIL);
+  double secs = bench::best_of(5, [&]() {
+      for (size_t i = 0; i < count; i++) {
+        out = *load_mem(msg.data(), msg.size(), dec);
+      }
+    });
+  bench::report("json_decode_messages", secs, msg.size() * count, count);
+  secs = bench::best_of(5, [&]() {
+      for (size_t i = 0; i < count; i++) {
+        load_mem(msg.data(), msg.size(), dec, &out);
+      }
+    });
+  bench::report("json_decode_messages_reused", secs,
+      msg.size() * count, count);
+
+#ifdef __GLIBC__
+  const int reps = 1000;
+  size_t before = bench::g_mallocs;
+  for (int i = 0; i < reps; i++) {
+    out = *load_mem(msg.data(), msg.size(), dec);
+  }
+  const double per_msg = (double)(bench::g_mallocs - before) / reps;
+  load_mem(msg.data(), msg.size(), dec, &out);
+  load_mem(msg.data(), msg.size(), dec, &out);
+  before = bench::g_mallocs;
+  for (int i = 0; i < reps; i++) {
+    load_mem(msg.data(), msg.size(), dec, &out);
+  }
+  const double per_msg_into = (double)(bench::g_mallocs - before) / reps;
+  printf("%-36s %9.1f /message %9.1f /message into\n",
+      "json_decode_allocs_messages", per_msg, per_msg_into);
+#endif
+}
+
+
+int main(int argc, char **argv)
+{
+  size_t scale = bench::scale_arg(argc, argv);
+  bench_numbers(scale);
+  bench_strings(scale);
+  bench_binary(scale);
+  bench_lazy(scale);
+  bench_parallel(scale);
+  bench_projection(scale);
+  bench_reuse(scale);
+  return 0;
+}
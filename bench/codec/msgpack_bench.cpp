@@ -0,0 +1,589 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/codec/msgpack_seq.hpp>
+#include <ellis/codec/msgpack_view.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/binary_node.hpp>
+#include <ellis/core/emigration.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/node.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis/stream/mem_input_stream.hpp>
+#include <ellis/stream/file_input_stream.hpp>
+#include <ellis/stream/fd_output_stream.hpp>
+#include <ellis/stream/mem_output_stream.hpp>
+#include <ellis/stream/mmap_input_stream.hpp>
+#include <ellis_private/using.hpp>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../bench_util.hpp"
+
+using namespace ellis;
+
+
+static vector<byte> encode(const node &n)
+{
+  return dump_vector(&n, msgpack_encoder());
+}
+
+
+/** Decodes buf repeatedly, handing it over in pieces of at most chunk
+ * bytes, and reports the best time.  With slices, binaries refer to buf in
+ * place rather than being copied. */
+static void bench_decode(
+    const char *name,
+    const vector<byte> &buf,
+    size_t chunk,
+    size_t items,
+    bool slices = false)
+{
+  msgpack_decoder dec;
+  if (slices) {
+    /* buf outlives the decoded nodes, so the owner need not free it. */
+    dec.set_slice_source(
+        std::shared_ptr<const void>(&buf, [](const void *) {}),
+        buf.data(), buf.size());
+  }
+  double secs = bench::best_of(5, [&]() {
+      dec.reset();
+      for (size_t i = 0; i < buf.size(); i += chunk) {
+        size_t count = std::min(chunk, buf.size() - i);
+        auto st = dec.consume_buffer(buf.data() + i, &count);
+        if (st.state() == stream_state::SUCCESS) {
+          return;
+        }
+        if (st.state() == stream_state::ERROR) {
+          break;
+        }
+      }
+      fprintf(stderr, "%s: decode failed\n", name);
+      exit(1);
+    });
+  bench::report(name, secs, buf.size(), items);
+}
+
+
+/** A typical array of small records. */
+static node make_records(size_t count)
+{
+  node recs(type::ARRAY);
+  auto &ra = recs.as_mutable_array();
+  for (size_t i = 0; i < count; i++) {
+    node rec(type::MAP);
+    auto &m = rec.as_mutable_map();
+    m.insert("id", (int64_t)i * 1000);
+    m.insert("name", "record name of moderate length");
+    m.insert("score", i * 0.125);
+    node tags(type::ARRAY);
+    tags.as_mutable_array().append("alpha");
+    tags.as_mutable_array().append((int64_t)(i % 7));
+    m.insert("tags", tags);
+    ra.append(rec);
+  }
+  return recs;
+}
+
+
+/** Returns the peak resident set size so far, in KB. */
+static long peak_rss_kb()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+}
+
+
+static void bench_encode(size_t scale)
+{
+  /* Big enough for the encoder's footprint to stand out. */
+  const size_t count = 400000 * scale;
+  const node recs = make_records(count);
+  msgpack_encoder enc;
+  vector<byte> chunk(65536);
+
+  /* Output goes to a fixed size buffer, as it would for a socket or file. */
+  const long rss_before = peak_rss_kb();
+  size_t total = 0;
+  double secs = bench::best_of(3, [&]() {
+      enc.reset(&recs);
+      total = 0;
+      while (true) {
+        size_t n = chunk.size();
+        auto st = enc.fill_buffer(chunk.data(), &n);
+        total += n;
+        if (st.state() != stream_state::CONTINUE) {
+          break;
+        }
+      }
+    });
+  const long rss_after = peak_rss_kb();
+  bench::report("msgpack_encode_records", secs, total, count);
+
+  /* Working out the size alone, as for a length prefix. */
+  size_t size = 0;
+  secs = bench::best_of(3, [&]() {
+      enc.encoded_size(recs, &size);
+    });
+  bench::report("msgpack_encoded_size_records", secs, total, count);
+
+  secs = bench::best_of(3, [&]() {
+      enc.reset(&recs);
+      size_t n = chunk.size();
+      enc.fill_buffer(chunk.data(), &n);
+    });
+  printf("%-36s %9.3f ms\n", "msgpack_encode_time_to_first_byte",
+      secs * 1e3);
+  printf("%-36s %9.1f MB\n", "msgpack_encode_peak_rss_growth",
+      (rss_after - rss_before) / 1024.0);
+}
+
+
+static void bench_records(size_t scale)
+{
+  const size_t count = 40000 * scale;
+  const node recs = make_records(count);
+  const vector<byte> buf = encode(recs);
+  bench_decode("msgpack_decode_records", buf, buf.size(), count);
+  bench_decode("msgpack_decode_records_4k_chunks", buf, 4096, count);
+
+  /* One record at a time, as messages, into a fresh node or the same one. */
+  const vector<byte> one = encode(recs.as_array()[0]);
+  msgpack_decoder dec;
+  node out(type::NIL);
+  double secs = bench::best_of(5, [&]() {
+      for (size_t i = 0; i < count; i++) {
+        out = *load_mem(one.data(), one.size(), dec);
+      }
+    });
+  bench::report("msgpack_decode_messages", secs, one.size() * count, count);
+  secs = bench::best_of(5, [&]() {
+      for (size_t i = 0; i < count; i++) {
+        load_mem(one.data(), one.size(), dec, &out);
+      }
+    });
+  bench::report("msgpack_decode_messages_reused", secs,
+      one.size() * count, count);
+}
+
+
+static void bench_sequence(size_t scale)
+{
+  /* The same records, as a stream of separate values, e.g. bus messages. */
+  const size_t count = 40000 * scale;
+  const node recs = make_records(count);
+  const auto &ra = recs.as_array();
+  /* Back to back, the records take their encoded size less the array's
+   * header. */
+  const vector<byte> whole = encode(recs);
+  const size_t used = whole.size() - (count > 0xffff ? 5 : 3);
+  vector<byte> buf(used + 1);
+  double secs = bench::best_of(5, [&]() {
+      mem_output_stream mos(buf.data(), buf.size());
+      msgpack_seq_writer wtr(mos);
+      for (size_t i = 0; i < count; i++) {
+        wtr.write(ra[i]);
+      }
+      wtr.flush();
+    });
+  bench::report("msgpack_seq_write", secs, used, count);
+
+  secs = bench::best_of(5, [&]() {
+      mem_input_stream mis(buf.data(), used);
+      msgpack_seq_reader rdr(mis);
+      while (rdr.next()) {
+      }
+    });
+  bench::report("msgpack_seq_read", secs, used, count);
+
+  secs = bench::best_of(5, [&]() {
+      mem_input_stream mis(buf.data(), used);
+      msgpack_seq_reader rdr(mis);
+      vector<node> batch;
+      do {
+        batch.clear();
+      } while (rdr.next_batch(256, &batch) > 0);
+    });
+  bench::report("msgpack_seq_read_batches", secs, used, count);
+}
+
+
+static void bench_view(size_t scale)
+{
+  /* Routing: read two header fields, then forward the body as it is. */
+  const size_t count = 20000 * scale;
+  node hdr(type::MAP);
+  hdr.as_mutable_map().insert("dest", 17);
+  hdr.as_mutable_map().insert("topic", "camera/front");
+  node msg(type::MAP);
+  msg.as_mutable_map().insert("body", make_records(count));
+  msg.as_mutable_map().insert("hdr", hdr);
+  const vector<byte> buf = encode(msg);
+
+  int64_t sink = 0;
+  double secs = bench::best_of(5, [&]() {
+      msgpack_decoder dec;
+      auto n = load_mem(buf.data(), buf.size(), dec);
+      sink += n->at("{hdr}{dest}").as_int64();
+      sink += n->at("{hdr}{topic}").as_u8str().length();
+      sink += encode(n->at("{body}")).size();
+    });
+  bench::report("msgpack_route_decode", secs, buf.size(), count);
+
+  secs = bench::best_of(5, [&]() {
+      msgpack_view v(buf.data(), buf.size());
+      sink += v.at("{hdr}{dest}").as_int64();
+      sink += v.at("{hdr}{topic}").data_length();
+      sink += v["body"].raw_length();
+    });
+  bench::report("msgpack_route_view", secs, buf.size(), count);
+  if (sink == 0) {
+    printf("unreachable\n");
+  }
+}
+
+
+/** Returns the number of nodes in the tree under n, including n. */
+static size_t count_nodes(const node &n)
+{
+  size_t total = 1;
+  if (n.get_type() == type::ARRAY) {
+    const auto &a = n.as_array();
+    for (size_t i = 0; i < a.length(); i++) {
+      total += count_nodes(a[i]);
+    }
+  }
+  else if (n.get_type() == type::MAP) {
+    n.as_map().foreach([&total](const string &, const node &v) {
+        total += count_nodes(v);
+      });
+  }
+  return total;
+}
+
+
+#ifdef __GLIBC__
+/** Reports heap allocations per node for decoding n whole, and per message
+ * for decoding its first element over and over. */
+static void report_allocs(const char *name, const node &n)
+{
+  const vector<byte> buf = encode(n);
+  const size_t nodes = count_nodes(n);
+  msgpack_decoder dec;
+  size_t before = bench::g_mallocs;
+  node out = *load_mem(buf.data(), buf.size(), dec);
+  const double per_node = (double)(bench::g_mallocs - before) / nodes;
+
+  const vector<byte> one = encode(n.as_array()[0]);
+  const int reps = 1000;
+  before = bench::g_mallocs;
+  for (int i = 0; i < reps; i++) {
+    out = *load_mem(one.data(), one.size(), dec);
+  }
+  const double per_msg = (double)(bench::g_mallocs - before) / reps;
+
+  /* The same, into the existing node, once the decoder has the storage of
+   * earlier messages to build in. */
+  load_mem(one.data(), one.size(), dec, &out);
+  load_mem(one.data(), one.size(), dec, &out);
+  before = bench::g_mallocs;
+  for (int i = 0; i < reps; i++) {
+    load_mem(one.data(), one.size(), dec, &out);
+  }
+  const double per_msg_into = (double)(bench::g_mallocs - before) / reps;
+  printf("%-36s %9.3f /node %9.1f /message %9.1f /message into\n",
+      name, per_node, per_msg, per_msg_into);
+}
+#endif
+
+
+static void bench_allocs(size_t scale)
+{
+#ifdef __GLIBC__
+  node scalars(type::ARRAY);
+  for (size_t i = 0; i < 30000 * scale; i++) {
+    node triple(type::ARRAY);
+    triple.as_mutable_array().append((int64_t)(i % 100));
+    triple.as_mutable_array().append(i % 2 == 0);
+    triple.as_mutable_array().append(node(type::NIL));
+    scalars.as_mutable_array().append(triple);
+  }
+  report_allocs("msgpack_decode_allocs_scalars", scalars);
+  report_allocs("msgpack_decode_allocs_records", make_records(10000 * scale));
+#else
+  (void)scale;
+#endif
+}
+
+
+static void bench_strings(size_t scale)
+{
+  /* Larger payloads, e.g. log messages or documents. */
+  const size_t count = 10000 * scale;
+  node strs(type::ARRAY);
+  for (size_t i = 0; i < count; i++) {
+    strs.as_mutable_array().append(string(1000, 'a' + i % 26));
+  }
+  const vector<byte> buf = encode(strs);
+  bench_decode("msgpack_decode_strings", buf, buf.size(), count);
+  bench_decode("msgpack_decode_strings_4k_chunks", buf, 4096, count);
+}
+
+
+static void bench_binary(size_t scale)
+{
+  /* A multi-MB blob, e.g. an image. */
+  const size_t len = 4000000 * scale;
+  node blob(type::BINARY);
+  blob.as_mutable_binary().resize(len);
+  const vector<byte> buf = encode(blob);
+  bench_decode("msgpack_decode_binary", buf, buf.size(), len / 64);
+  bench_decode("msgpack_decode_binary_4k_chunks", buf, 4096, len / 64);
+}
+
+
+static void bench_frames(size_t scale)
+{
+  /* A batch of camera frames with a little metadata each. */
+  const size_t count = 16 * scale;
+  const size_t len = 1 << 20;
+  node frames(type::ARRAY);
+  for (size_t i = 0; i < count; i++) {
+    node frame(type::MAP);
+    frame.as_mutable_map().insert("seq", (int64_t)i);
+    node pixels(type::BINARY);
+    pixels.as_mutable_binary().resize(len);
+    frame.as_mutable_map().insert("pixels", pixels);
+    frames.as_mutable_array().append(frame);
+  }
+  const vector<byte> buf = encode(frames);
+  bench_decode("msgpack_decode_frames", buf, buf.size(), count);
+  bench_decode("msgpack_decode_frames_sliced", buf, buf.size(), count, true);
+}
+
+
+/** Writes buf to a file, then loads it back, through read() and through a
+ * mapping, and reports the best time for each.  The file stays in the page
+ * cache, so this measures the cost of getting it into the decoder. */
+static void bench_file(const char *name, const vector<byte> &buf, size_t items)
+{
+  char path[] = "/tmp/ellis_benchXXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0 || write(fd, buf.data(), buf.size()) != (ssize_t)buf.size()) {
+    printf("%-36s could not write %s\n", name, path);
+    return;
+  }
+  close(fd);
+
+  string read_name = string(name) + "_read";
+  double secs = bench::best_of(3, [&]() {
+      msgpack_decoder dec;
+      auto n = load(file_input_stream(path), dec);
+    });
+  bench::report(read_name.c_str(), secs, buf.size(), items);
+
+  string mmap_name = string(name) + "_mmap";
+  secs = bench::best_of(3, [&]() {
+      msgpack_decoder dec;
+      auto n = load(mmap_input_stream(path), dec);
+    });
+  bench::report(mmap_name.c_str(), secs, buf.size(), items);
+
+  unlink(path);
+}
+
+
+static void bench_files(size_t scale)
+{
+  const size_t count = 100000 * scale;
+  bench_file("msgpack_load_file_records", encode(make_records(count)), count);
+
+  const size_t len = 64000000 * scale;
+  node blob(type::BINARY);
+  blob.as_mutable_binary().resize(len);
+  bench_file("msgpack_load_file_binary", encode(blob), len / 64);
+}
+
+
+/** An fd output stream with a fixed ref_min: 0 copies everything through
+ * its buffer, as all streams did before emit_ref, and 1 writes every body
+ * in place, however short. */
+class fixed_ref_output_stream : public fd_output_stream {
+  size_t m_ref_min;
+public:
+  fixed_ref_output_stream(int fd, size_t ref_min) :
+    fd_output_stream(fd),
+    m_ref_min(ref_min)
+  {
+  }
+  size_t ref_min() const override { return m_ref_min; }
+};
+
+
+/** Dumps arrays of blobs of various sizes to fd, copying the blobs through
+ * the stream buffer, writing them all in place with writev, and as
+ * fd_output_stream chooses by its ref_min.  rewind is called before each
+ * dump. */
+static void bench_dump_to(
+    const char *dest,
+    int fd,
+    const std::function<void()> &rewind,
+    size_t scale)
+{
+  const size_t total = 64000000 * scale;
+  for (size_t len : { 1024, 4096, 8192, 16384, 32768, 65536, 1 << 20 }) {
+    const size_t count = total / len;
+    node blobs(type::ARRAY);
+    for (size_t i = 0; i < count; i++) {
+      node blob(type::BINARY);
+      blob.as_mutable_binary().resize(len);
+      memset(blob.as_mutable_binary().data(), (int)i, len);
+      blobs.as_mutable_array().append(blob);
+    }
+    msgpack_encoder enc;
+    const string name = string("msgpack_dump_") + dest + "_"
+      + std::to_string(len / 1024) + "k";
+    double secs = bench::best_of(3, [&]() {
+        rewind();
+        dump(&blobs, fixed_ref_output_stream(fd, 0), enc);
+      });
+    bench::report((name + "_copied").c_str(), secs, total, count);
+    secs = bench::best_of(3, [&]() {
+        rewind();
+        dump(&blobs, fixed_ref_output_stream(fd, 1), enc);
+      });
+    bench::report((name + "_in_place").c_str(), secs, total, count);
+    secs = bench::best_of(3, [&]() {
+        rewind();
+        dump(&blobs, fd_output_stream(fd), enc);
+      });
+    bench::report((name + "_default").c_str(), secs, total, count);
+  }
+}
+
+
+/** Dumps blobs to a file, which lands in the page cache, and to a pipe,
+ * drained by another thread; both touch every byte, unlike /dev/null. */
+static void bench_dump(size_t scale)
+{
+  char path[] = "/tmp/msgpack_benchXXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return;
+  }
+  unlink(path);
+  bench_dump_to("file", fd, [fd]() { lseek(fd, 0, SEEK_SET); }, scale);
+  close(fd);
+
+  int pfd[2];
+  if (pipe(pfd) != 0) {
+    perror("pipe");
+    return;
+  }
+  std::thread drain([&pfd]() {
+      vector<byte> buf(1 << 20);
+      while (read(pfd[0], buf.data(), buf.size()) > 0) {
+      }
+    });
+  bench_dump_to("pipe", pfd[1], []() {}, scale);
+  close(pfd[1]);
+  drain.join();
+  close(pfd[0]);
+}
+
+
+/** Dumps to memory of unknown size: through a std::ostringstream, into a
+ * fresh vector, and into the same vector each time. */
+static void bench_dump_memory(const char *name, const node &n, size_t reps,
+    size_t items)
+{
+  msgpack_encoder enc;
+  size_t total = 0;
+  double secs = bench::best_of(5, [&]() {
+      total = 0;
+      for (size_t i = 0; i < reps; i++) {
+        std::ostringstream os;
+        dump_stream(&n, os, enc);
+        total += os.str().size();
+      }
+    });
+  const string base = string("msgpack_dump_") + name;
+  bench::report((base + "_ostringstream").c_str(), secs, total, items);
+  secs = bench::best_of(5, [&]() {
+      total = 0;
+      for (size_t i = 0; i < reps; i++) {
+        total += dump_vector(&n, enc).size();
+      }
+    });
+  bench::report((base + "_vector").c_str(), secs, total, items);
+  vector<byte> out;
+  secs = bench::best_of(5, [&]() {
+      total = 0;
+      for (size_t i = 0; i < reps; i++) {
+        dump_vector(&n, &out, enc);
+        total += out.size();
+      }
+    });
+  bench::report((base + "_vector_reused").c_str(), secs, total, items);
+}
+
+
+static void bench_dump_memory(size_t scale)
+{
+  const size_t count = 200000 * scale;
+  const node recs = make_records(count);
+  bench_dump_memory("records", recs, 1, count);
+  bench_dump_memory("messages", recs.as_array()[0], count, count);
+}
+
+
+int main(int argc, char **argv)
+{
+  size_t scale = bench::scale_arg(argc, argv);
+  /* First, while the peak RSS is still low. */
+  bench_encode(scale);
+  bench_allocs(scale);
+  bench_records(scale);
+  bench_sequence(scale);
+  bench_view(scale);
+  bench_strings(scale);
+  bench_binary(scale);
+  bench_frames(scale);
+  bench_files(scale);
+  bench_dump(scale);
+  bench_dump_memory(scale);
+  return 0;
+}
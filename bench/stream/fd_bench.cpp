@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/binary_node.hpp>
+#include <ellis/core/emigration.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/stream/fd_input_stream.hpp>
+#include <ellis/stream/fd_output_stream.hpp>
+#include <ellis/stream/file_input_stream.hpp>
+#include <ellis/stream/file_output_stream.hpp>
+#include <ellis/stream/stream_buffer.hpp>
+#include <ellis/stream/uring_file_input_stream.hpp>
+#include <ellis/stream/uring_file_output_stream.hpp>
+#include <ellis_private/using.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../bench_util.hpp"
+
+using namespace ellis;
+
+
+/** A buffer configuration to try: initial and maximum size. */
+struct buf_config {
+  const char *name;
+  size_t size;
+  size_t max;
+};
+
+static const buf_config k_configs[] = {
+  { "4k", 4096, 4096 },
+  { "16k", 16384, 16384 },
+  { "64k", 65536, 65536 },
+  { "256k", 262144, 262144 },
+  { "1m", 1048576, 1048576 },
+  { "4k_to_1m", 4096, 1048576 },
+  { "default", stream_buffer::k_default_size, stream_buffer::k_default_max },
+};
+
+
+/** Writes len bytes to fd in large blocks, as a fast producer would. */
+static void write_all(int fd, size_t len)
+{
+  static vector<char> block(1 << 20, 'x');
+  while (len > 0) {
+    ssize_t n = write(fd, block.data(), std::min(len, block.size()));
+    if (n <= 0) {
+      return;
+    }
+    len -= n;
+  }
+}
+
+
+/** Reads fd to the end in large blocks, as a fast consumer would. */
+static void read_all(int fd)
+{
+  static vector<char> block(1 << 20);
+  while (read(fd, block.data(), block.size()) > 0) {
+  }
+}
+
+
+/** Reads everything from fd through an fd_input_stream; returns the number
+ * of buffers it took. */
+static size_t drain(int fd, const buf_config &cfg, size_t *total)
+{
+  fd_input_stream in(fd, cfg.size, cfg.max);
+  const byte *buf;
+  size_t avail;
+  size_t bufs = 0;
+  *total = 0;
+  while (in.next_input_buf(&buf, &avail)) {
+    *total += avail;
+    bufs++;
+  }
+  return bufs;
+}
+
+
+/** Writes len bytes to fd through an fd_output_stream; returns the number
+ * of buffers it took. */
+static size_t fill(int fd, const buf_config &cfg, size_t len)
+{
+  fd_output_stream out(fd, cfg.size, cfg.max);
+  size_t bufs = 0;
+  while (len > 0) {
+    byte *buf;
+    size_t avail;
+    out.next_output_buf(&buf, &avail);
+    size_t n = std::min(len, avail);
+    memset(buf, 'x', n);
+    out.emit(n);
+    len -= n;
+    bufs++;
+  }
+  return bufs;
+}
+
+
+/** Makes a connected pair of fds of the given kind: "pipe" or "socket". */
+static void open_pair(const string &kind, int fds[2])
+{
+  int rc = (kind == "pipe") ? pipe(fds)
+    : socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  if (rc != 0) {
+    perror("making fd pair");
+    exit(1);
+  }
+}
+
+
+static void bench_reads(size_t scale)
+{
+  const size_t len = (256 << 20) * scale;
+
+  char path[] = "/tmp/ellis_benchXXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    exit(1);
+  }
+  write_all(fd, len);
+  close(fd);
+
+  for (const auto &cfg : k_configs) {
+    size_t total = 0;
+    size_t bufs = 0;
+    double secs = bench::best_of(3, [&]() {
+        int rfd = open(path, O_RDONLY);
+        bufs = drain(rfd, cfg, &total);
+        close(rfd);
+      });
+    string name = string("fd_read_file_") + cfg.name;
+    bench::report(name.c_str(), secs, total, bufs);
+  }
+  unlink(path);
+
+  for (string kind : { "pipe", "socket" }) {
+    for (const auto &cfg : k_configs) {
+      size_t total = 0;
+      size_t bufs = 0;
+      double secs = bench::best_of(3, [&]() {
+          int fds[2];
+          open_pair(kind, fds);
+          std::thread writer([&]() {
+              write_all(fds[1], len);
+              close(fds[1]);
+            });
+          bufs = drain(fds[0], cfg, &total);
+          writer.join();
+          close(fds[0]);
+        });
+      string name = "fd_read_" + kind + "_" + cfg.name;
+      bench::report(name.c_str(), secs, total, bufs);
+    }
+  }
+}
+
+
+static void bench_writes(size_t scale)
+{
+  const size_t len = (256 << 20) * scale;
+
+  for (const auto &cfg : k_configs) {
+    size_t bufs = 0;
+    double secs = bench::best_of(3, [&]() {
+        char path[] = "/tmp/ellis_benchXXXXXX";
+        int fd = mkstemp(path);
+        bufs = fill(fd, cfg, len);
+        close(fd);
+        unlink(path);
+      });
+    string name = string("fd_write_file_") + cfg.name;
+    bench::report(name.c_str(), secs, len, bufs);
+  }
+
+  for (string kind : { "pipe", "socket" }) {
+    for (const auto &cfg : k_configs) {
+      size_t bufs = 0;
+      double secs = bench::best_of(3, [&]() {
+          int fds[2];
+          open_pair(kind, fds);
+          std::thread reader([&]() {
+              read_all(fds[0]);
+              close(fds[0]);
+            });
+          bufs = fill(fds[1], cfg, len);
+          close(fds[1]);
+          reader.join();
+        });
+      string name = "fd_write_" + kind + "_" + cfg.name;
+      bench::report(name.c_str(), secs, len, bufs);
+    }
+  }
+}
+
+
+/** An io_uring configuration to try: reads or writes in flight, and the
+ * size of each. */
+struct uring_config {
+  const char *name;
+  size_t depth;
+  size_t bufsize;
+};
+
+static const uring_config k_uring_configs[] = {
+  { "d1_256k", 1, 262144 },
+  { "d4_64k", 4, 65536 },
+  { "d4_256k", 4, 262144 },
+  { "d8_256k", 8, 262144 },
+  { "d16_1m", 16, 1048576 },
+};
+
+
+/** Reads the whole stream, returning the number of buffers it took. */
+static size_t drain(sync_input_stream &in, size_t *total)
+{
+  const byte *buf;
+  size_t avail;
+  size_t bufs = 0;
+  *total = 0;
+  while (in.next_input_buf(&buf, &avail)) {
+    *total += avail;
+    bufs++;
+  }
+  return bufs;
+}
+
+
+/** Writes len bytes to the stream, returning the number of buffers it
+ * took. */
+static size_t fill(sync_output_stream &out, size_t len)
+{
+  size_t bufs = 0;
+  while (len > 0) {
+    byte *buf;
+    size_t avail;
+    out.next_output_buf(&buf, &avail);
+    size_t n = std::min(len, avail);
+    memset(buf, 'x', n);
+    out.emit(n);
+    len -= n;
+    bufs++;
+  }
+  return bufs;
+}
+
+
+/** Compares the io_uring file streams with the synchronous ones, on one
+ * large file, and on a batch conversion: decoding a directory's worth of
+ * msgpack files and encoding each into a new file. */
+static void bench_uring(size_t scale)
+{
+  const size_t len = (256 << 20) * scale;
+
+  char path[] = "/tmp/ellis_benchXXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    exit(1);
+  }
+  write_all(fd, len);
+  close(fd);
+
+  size_t total = 0;
+  size_t bufs = 0;
+  double secs = bench::best_of(3, [&]() {
+      file_input_stream in(path);
+      bufs = drain(in, &total);
+    });
+  bench::report("file_read_sync", secs, total, bufs);
+  for (const auto &cfg : k_uring_configs) {
+    secs = bench::best_of(3, [&]() {
+        uring_file_input_stream in(path, cfg.depth, cfg.bufsize);
+        bufs = drain(in, &total);
+      });
+    string name = string("file_read_uring_") + cfg.name;
+    bench::report(name.c_str(), secs, total, bufs);
+  }
+
+  secs = bench::best_of(3, [&]() {
+      file_output_stream out(path);
+      bufs = fill(out, len);
+    });
+  bench::report("file_write_sync", secs, len, bufs);
+  for (const auto &cfg : k_uring_configs) {
+    secs = bench::best_of(3, [&]() {
+        uring_file_output_stream out(path, cfg.depth, cfg.bufsize);
+        bufs = fill(out, len);
+        out.finish();
+      });
+    string name = string("file_write_uring_") + cfg.name;
+    bench::report(name.c_str(), secs, len, bufs);
+  }
+  unlink(path);
+
+  /* A batch of documents, each some records with a blob and a label. */
+  const size_t files = 32 * scale;
+  node doc(type::ARRAY);
+  for (int i = 0; i < 256; i++) {
+    node blob(type::BINARY);
+    blob.as_mutable_binary().resize(16384);
+    memset(blob.as_mutable_binary().data(), i, 16384);
+    doc.as_mutable_array().append(std::move(blob));
+    doc.as_mutable_array().append("record " + std::to_string(i));
+  }
+  vector<string> ins;
+  vector<string> outs;
+  for (size_t i = 0; i < files; i++) {
+    ins.push_back("/tmp/ellis_bench_in" + std::to_string(i));
+    outs.push_back("/tmp/ellis_bench_out" + std::to_string(i));
+    dump_file(&doc, ins.back().c_str(), msgpack_encoder());
+  }
+  size_t doc_bytes = 0;
+  {
+    file_input_stream in(ins[0].c_str());
+    drain(in, &doc_bytes);
+  }
+
+  node got(type::NIL);
+  secs = bench::best_of(3, [&]() {
+      for (size_t i = 0; i < files; i++) {
+        load(file_input_stream(ins[i].c_str()), msgpack_decoder(), &got);
+        dump(&got, file_output_stream(outs[i].c_str()), msgpack_encoder());
+      }
+    });
+  bench::report("convert_sync", secs, doc_bytes * files, files);
+  for (const auto &cfg : k_uring_configs) {
+    secs = bench::best_of(3, [&]() {
+        for (size_t i = 0; i < files; i++) {
+          load(uring_file_input_stream(ins[i].c_str(), cfg.depth,
+                cfg.bufsize), msgpack_decoder(), &got);
+          dump(&got, uring_file_output_stream(outs[i].c_str(), cfg.depth,
+                cfg.bufsize), msgpack_encoder());
+        }
+      });
+    string name = string("convert_uring_") + cfg.name;
+    bench::report(name.c_str(), secs, doc_bytes * files, files);
+  }
+  for (size_t i = 0; i < files; i++) {
+    unlink(ins[i].c_str());
+    unlink(outs[i].c_str());
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  size_t scale = bench::scale_arg(argc, argv);
+  bench_reads(scale);
+  bench_writes(scale);
+  bench_uring(scale);
+  return 0;
+}
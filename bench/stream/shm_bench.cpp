@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/core/binary_node.hpp>
+#include <ellis/core/emigration.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/stream/fd_input_stream.hpp>
+#include <ellis/stream/fd_output_stream.hpp>
+#include <ellis/stream/shm_input_stream.hpp>
+#include <ellis/stream/shm_output_stream.hpp>
+#include <ellis_private/using.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../bench_util.hpp"
+
+using namespace ellis;
+
+
+/** What to do with one end of a two way channel between processes. */
+typedef std::function<void(sync_input_stream &, sync_output_stream &)>
+  endpoint_fn;
+
+static const char *const k_kinds[] = {
+  "pipe", "socket", "shm_spin", "shm_futex"
+};
+
+
+static void die(const char *what)
+{
+  perror(what);
+  exit(1);
+}
+
+
+/** Opens the named ring once the other process has created it. */
+static unique_ptr<shm_input_stream> open_ring(const string &name,
+    shm_wait wait)
+{
+  for (int tries = 0; tries < 10000; tries++) {
+    try {
+      return unique_ptr<shm_input_stream>(
+          new shm_input_stream(name.c_str(), wait));
+    } catch (const err &) {
+      usleep(100);
+    }
+  }
+  fprintf(stderr, "ring %s never appeared\n", name.c_str());
+  exit(1);
+}
+
+
+/** Runs child in a child process and parent here, connected both ways by
+ * the given kind of channel; returns how long parent took, in seconds. */
+static double run(const string &kind, endpoint_fn child, endpoint_fn parent)
+{
+  using clock = std::chrono::steady_clock;
+  std::chrono::duration<double> dur;
+  pid_t pid;
+
+  if (kind == "pipe" || kind == "socket") {
+    /* Index 0 is the parent's end, 1 the child's. */
+    int rd[2];
+    int wr[2];
+    if (kind == "pipe") {
+      int down[2];
+      int up[2];
+      if (pipe(down) != 0 || pipe(up) != 0) {
+        die("pipe");
+      }
+      rd[0] = up[0];
+      wr[0] = down[1];
+      rd[1] = down[0];
+      wr[1] = up[1];
+    } else {
+      int s[2];
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, s) != 0) {
+        die("socketpair");
+      }
+      rd[0] = wr[0] = s[0];
+      rd[1] = wr[1] = s[1];
+    }
+    pid = fork();
+    if (pid < 0) {
+      die("fork");
+    }
+    const int me = (pid == 0) ? 1 : 0;
+    close(rd[1 - me]);
+    if (wr[1 - me] != rd[1 - me]) {
+      close(wr[1 - me]);
+    }
+    {
+      fd_input_stream in(rd[me]);
+      fd_output_stream out(wr[me]);
+      if (pid == 0) {
+        child(in, out);
+        _exit(0);
+      }
+      auto start = clock::now();
+      parent(in, out);
+      dur = clock::now() - start;
+    }
+    close(rd[me]);
+    if (wr[me] != rd[me]) {
+      close(wr[me]);
+    }
+  } else {
+    const shm_wait wait = (kind == "shm_spin") ? shm_wait::SPIN
+      : shm_wait::FUTEX;
+    const string down = "/ellis_bench_down_" + std::to_string(getpid());
+    const string up = "/ellis_bench_up_" + std::to_string(getpid());
+    unique_ptr<shm_output_stream> out(new shm_output_stream(
+          down.c_str(), shm_output_stream::k_default_capacity, wait));
+    pid = fork();
+    if (pid < 0) {
+      die("fork");
+    }
+    if (pid == 0) {
+      /* The parent's end was copied along; leave it be. */
+      {
+        shm_output_stream child_out(up.c_str(),
+            shm_output_stream::k_default_capacity, wait);
+        shm_input_stream child_in(down.c_str(), wait);
+        child(child_in, child_out);
+      }
+      _exit(0);
+    }
+    auto in = open_ring(up, wait);
+    auto start = clock::now();
+    parent(*in, *out);
+    dur = clock::now() - start;
+    out.reset();
+  }
+
+  int status = 0;
+  if (waitpid(pid, &status, 0) != pid || ! WIFEXITED(status)
+      || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s child failed\n", kind.c_str());
+    exit(1);
+  }
+  return dur.count();
+}
+
+
+/** As run(), taking the best of reps. */
+static double best_run(int reps, const string &kind, endpoint_fn child,
+    endpoint_fn parent)
+{
+  double best = 1e300;
+  for (int i = 0; i < reps; i++) {
+    best = std::min(best, run(kind, child, parent));
+  }
+  return best;
+}
+
+
+/** A message with a payload of len bytes, such as a sensor sample; with
+ * none, a small request or reply. */
+static node make_doc(size_t len)
+{
+  node doc(type::MAP);
+  doc.as_mutable_map().insert("seq", 12345);
+  doc.as_mutable_map().insert("sensor", "front_left");
+  doc.as_mutable_map().insert("value", 3.14159);
+  if (len > 0) {
+    node blob(type::BINARY);
+    blob.as_mutable_binary().resize(len);
+    memset(blob.as_mutable_binary().data(), 0x5a, len);
+    doc.as_mutable_map().insert("payload", std::move(blob));
+  }
+  return doc;
+}
+
+
+static size_t msgpack_size(const node &doc)
+{
+  std::ostringstream os;
+  dump_stream(&doc, os, msgpack_encoder());
+  return os.str().size();
+}
+
+
+/** A message to the child and its reply, count times over: the time per
+ * item is the latency of one round trip. */
+static void bench_pingpong(size_t scale)
+{
+  const size_t count = 20000 * scale;
+  const node doc = make_doc(0);
+  const size_t bytes = 2 * msgpack_size(doc) * count;
+  for (string kind : k_kinds) {
+    double secs = best_run(3, kind,
+        [&](sync_input_stream &in, sync_output_stream &out) {
+          msgpack_decoder deco;
+          msgpack_encoder enco;
+          node got(type::NIL);
+          for (size_t i = 0; i < count; i++) {
+            load(in, deco, &got);
+            dump(&got, out, enco);
+          }
+        },
+        [&](sync_input_stream &in, sync_output_stream &out) {
+          msgpack_decoder deco;
+          msgpack_encoder enco;
+          node reply(type::NIL);
+          for (size_t i = 0; i < count; i++) {
+            dump(&doc, out, enco);
+            load(in, deco, &reply);
+          }
+        });
+    string name = "pingpong_" + kind;
+    bench::report(name.c_str(), secs, bytes, count);
+  }
+}
+
+
+/** A stream of messages of each size from the child, decoded as they
+ * come. */
+static void bench_messages(size_t scale)
+{
+  for (size_t len : { 0, 1024, 65536 }) {
+    const size_t count = (len < 65536 ? 200000 : 10000) * scale;
+    const node doc = make_doc(len);
+    const size_t bytes = msgpack_size(doc) * count;
+    for (string kind : k_kinds) {
+      double secs = best_run(3, kind,
+          [&](sync_input_stream &, sync_output_stream &out) {
+            msgpack_encoder enco;
+            for (size_t i = 0; i < count; i++) {
+              dump(&doc, out, enco);
+            }
+          },
+          [&](sync_input_stream &in, sync_output_stream &) {
+            msgpack_decoder deco;
+            node got(type::NIL);
+            for (size_t i = 0; i < count; i++) {
+              load(in, deco, &got);
+            }
+          });
+      string name = "messages_" + std::to_string(len) + "_" + kind;
+      bench::report(name.c_str(), secs, bytes, count);
+    }
+  }
+}
+
+
+/** Raw bytes from the child, as fast as they can go. */
+static void bench_bytes(size_t scale)
+{
+  const size_t len = (512 << 20) * scale;
+  for (string kind : k_kinds) {
+    size_t bufs = 0;
+    double secs = best_run(3, kind,
+        [&](sync_input_stream &, sync_output_stream &out) {
+          for (size_t left = len; left > 0; ) {
+            byte *buf;
+            size_t avail;
+            out.next_output_buf(&buf, &avail);
+            size_t n = std::min(left, avail);
+            memset(buf, 'x', n);
+            out.emit(n);
+            left -= n;
+          }
+        },
+        [&](sync_input_stream &in, sync_output_stream &) {
+          const byte *buf;
+          size_t avail;
+          bufs = 0;
+          for (size_t got = 0; got < len; got += avail) {
+            in.next_input_buf(&buf, &avail);
+            bufs++;
+          }
+        });
+    string name = "bytes_" + kind;
+    bench::report(name.c_str(), secs, len, bufs);
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  size_t scale = bench::scale_arg(argc, argv);
+  bench_pingpong(scale);
+  bench_messages(scale);
+  bench_bytes(scale);
+  return 0;
+}
@@ -38,43 +38,127 @@
 #include <ellis/core/decoder.hpp>
 #include <ellis/core/encoder.hpp>
 #include <sstream>
+#include <string>
+#include <vector>
 
 namespace ellis {
 
 
+class element_stream;
 class json_parser;
 class json_tokenizer;
+class projection;
 
 class json_decoder : public decoder {
 
   std::unique_ptr<json_tokenizer> m_toker;
   std::unique_ptr<json_parser> m_parser;
+  std::unique_ptr<projection> m_proj;
+  std::unique_ptr<element_stream> m_stream;
 
 public:
   json_decoder();
   ~json_decoder();
+
+  /** Only build the parts of the document at the given paths (in the
+   * syntax of node::at), and whatever maps and arrays lead to them.
+   *
+   * Everything else is passed over by the tokenizer, without building nodes
+   * or strings, and is only checked for matching brackets and terminated
+   * strings.  Skipped map entries are left out; skipped array elements are
+   * left as nulls, so that the selected elements keep their indices, or left
+   * out if no later element is selected.
+   *
+   * Resets the decoder.  Throws PATH_FAIL if a path is malformed.
+   */
+  void set_projection(const std::vector<std::string> &paths);
+
+  /** Go back to building the whole document.  Resets the decoder. */
+  void clear_projection();
+
+  /** Hand each element of the array at the given path (in the syntax of
+   * node::at; "" for the document itself) to fn as soon as it is complete,
+   * rather than adding it to the array.
+   *
+   * This bounds memory use by the largest element, rather than the whole
+   * array, for documents like [ {...}, {...}, ... ].  The array is left
+   * empty in the decoded document, which is otherwise built as usual.  If
+   * there is no array at the path, nothing is streamed.  fn may throw to
+   * abandon the decode, after which the decoder must be reset.
+   *
+   * Resets the decoder.  Throws PATH_FAIL if the path is malformed.
+   */
+  void set_element_callback(const std::string &path, element_fn fn);
+
+  /** Go back to building arrays whole.  Resets the decoder. */
+  void clear_element_callback();
+
   node_progress consume_buffer(
       const byte *buf,
       size_t *bytecount) override;
   node_progress chop() override;
+
+  /** As the base class, but keeping what *out held before, and building the
+   * next document in it, reusing its strings, arrays and map entries
+   * wherever the shape matches.  This is not done while a projection or
+   * element callback is set. */
+  progress consume_buffer_into(
+      const byte *buf,
+      size_t *bytecount,
+      node *out) override;
+  progress chop_into(node *out) override;
   void reset() override;
 };
 
 
+/** Output options for json_encoder.
+ *
+ * The defaults give the traditional ellis layout, e.g. { "a": [ 1, 2 ] }.
+ */
+struct json_encoder_opts {
+  /** Omit all insignificant whitespace, e.g. {"a":[1,2]}. */
+  bool compact = false;
+  /** Emit map entries in byte-wise key order rather than hash order. */
+  bool sort_keys = false;
+};
+
+
+/** A JSON encoder.
+ *
+ * JSON has no binary type, so binary nodes are written as strings holding a
+ * literal "/ELLIS_BINARY/" followed by the padded base64 of their contents.
+ * json_decoder turns such strings back into binary nodes; ordinary strings
+ * never match, since the encoder always escapes their slashes.  Strings from
+ * other producers that carry the prefix but not valid base64 stay strings.
+ */
 class json_encoder : public encoder {
   std::stringstream m_obuf;
   size_t m_obufpos = 0;
   size_t m_obufend = 0;
+  json_encoder_opts m_opts;
 
   void _clear_obuf();
+  void _stream_out_str(const char *s, size_t len, std::ostream &os);
   void _stream_out(const node &n, std::ostream &os);
+  size_t _size(const node &n) const;
 
 public:
   json_encoder();
+  explicit json_encoder(const json_encoder_opts &opts);
+
+  /** Change the output options; takes effect on the next reset(). */
+  void set_opts(const json_encoder_opts &opts);
+  const json_encoder_opts & opts() const;
+
   progress fill_buffer(
       byte *buf,
       size_t *bytecount) override;
   void reset(const node *new_node) override;
+
+  /** As the base class, for the current options.  Strings are scanned for
+   * characters that need escaping, and numbers are formatted on the stack,
+   * but nothing else is written. */
+  bool encoded_size(const node &n, size_t *bytecount) const override;
 };
 
 
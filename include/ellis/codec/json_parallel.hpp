@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/codec/json_parallel.hpp
+ *
+ * @brief Ellis multi-threaded JSON decoding C++ header.
+ *
+ * Large JSON documents are very often one huge array (of records, samples,
+ * log entries, ...), possibly nested a level or two down inside some small
+ * envelope.  json_parallel_decode finds the elements of such an array with a
+ * quick structural scan, decodes contiguous runs of them on worker threads
+ * using ordinary json_decoder instances, and splices the results back in
+ * order.  The result is the same node that json_decoder would produce.
+ *
+ * Example:
+ *
+ *   json_parallel_opts opts;
+ *   opts.path = "{data}{records}";
+ *   unique_ptr<node> doc = json_parallel_decode(text, len, opts);
+ */
+
+#pragma once
+#ifndef ELLIS_CODEC_JSON_PARALLEL_HPP_
+#define ELLIS_CODEC_JSON_PARALLEL_HPP_
+
+#include <ellis/core/node.hpp>
+#include <memory>
+#include <string>
+
+namespace ellis {
+
+
+/** Options for json_parallel_decode. */
+struct json_parallel_opts {
+  /** Number of threads to use; 0 means one per hardware thread. */
+  unsigned threads = 0;
+  /** Path (in the syntax of node::at) of the array to split up; empty means
+   * the top-level value. */
+  std::string path;
+  /** Don't bother with threads for arrays with less text than this. */
+  size_t min_parallel_bytes = 1 << 20;
+};
+
+
+/** Decode len bytes of JSON text, splitting the array at opts.path across
+ * threads.
+ *
+ * If the path does not lead to an array, or the array is small, the whole
+ * document is decoded on the calling thread instead.  As with load_mem and
+ * json_decoder, anything following the top-level value is ignored.
+ *
+ * Throws PARSE_FAIL (or the error json_decoder would throw) if the text is
+ * malformed, and PATH_FAIL if opts.path is not a valid path.
+ */
+std::unique_ptr<node> json_parallel_decode(
+    const char *text,
+    size_t len,
+    const json_parallel_opts &opts = json_parallel_opts());
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CODEC_JSON_PARALLEL_HPP_ */
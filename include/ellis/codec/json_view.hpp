@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * @file ellis/codec/json_view.hpp
+ *
+ * @brief Ellis on-demand JSON access C++ header.
+ *
+ * Decoding a large JSON document into nodes is wasteful when only a few
+ * values are needed.  A json_tape instead makes a single pass over the
+ * text, checking its structure and recording where each value starts and
+ * ends, without allocating any nodes or strings.  Values are then reached
+ * through json_view handles, and only turned into nodes (or strings, or
+ * numbers) when asked for.
+ *
+ * Example:
+ *
+ *   json_tape tape(text, len);
+ *   json_view root = tape.root();
+ *   int64_t id = root["id"].as_int64();
+ *   string name = root.at("{user}{name}").as_u8str();
+ *   unique_ptr<node> tags = root["tags"].to_node();
+ */
+
+#pragma once
+#ifndef ELLIS_CODEC_JSON_VIEW_HPP_
+#define ELLIS_CODEC_JSON_VIEW_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/node.hpp>
+#include <ellis/core/type.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ellis {
+
+
+class json_view;
+
+
+/** A structural index over JSON text.
+ *
+ * The text is not copied, and must remain valid and unchanged for as long
+ * as the tape, or any view into it, is in use.
+ *
+ * The structure (brackets, commas, colons, literals, number syntax and
+ * string boundaries) is checked up front; escape sequences inside strings
+ * are only checked when a string is actually read.
+ */
+class json_tape {
+  friend class json_view;
+
+  /* One entry per value, and per map key, in document order. */
+  struct entry {
+    /** Offset of the value in the text. */
+    size_t offset;
+    /** Length of the value's text, including quotes or brackets. */
+    size_t len;
+    /** Tape index just past this value's children. */
+    uint32_t next;
+    /** Number of array elements or map entries; otherwise unused. */
+    uint32_t count;
+    /** Type of the value. */
+    type kind;
+    /** True for strings containing escape sequences. */
+    bool escaped;
+  };
+
+  const char *m_text;
+  size_t m_len;
+  std::vector<entry> m_tape;
+
+  void _build();
+
+public:
+  /** Index len bytes of JSON text.  Throws PARSE_FAIL if malformed. */
+  json_tape(const char *text, size_t len);
+
+  json_tape(const json_tape &) = delete;
+  json_tape & operator=(const json_tape &) = delete;
+
+  /** Return a view of the top-level value. */
+  json_view root() const;
+
+  /** Return the number of tape entries (values plus map keys). */
+  size_t size() const;
+};
+
+
+/** A lightweight read-only handle to a value within a json_tape.
+ *
+ * Views are cheap to copy, and remain valid as long as the tape does.
+ * Accessors mirror those of node.  They throw TYPE_MISMATCH when applied to
+ * the wrong type of value, INVALID_ARGS for an array index out of range,
+ * NO_SUCH for a missing map key, and PATH_FAIL from at().
+ */
+class json_view {
+  const json_tape *m_tape;
+  uint32_t m_idx;
+
+  json_view(const json_tape *tape, uint32_t idx);
+  const json_tape::entry & _ent() const;
+  void _check_type(type t) const;
+  std::string _key(uint32_t key_idx) const;
+  bool _key_equals(uint32_t key_idx, const char *key, size_t keylen) const;
+  bool _find(const char *key, size_t keylen, json_view *found) const;
+
+  friend class json_tape;
+
+public:
+  /** Return the type the value would have once decoded into a node. */
+  type get_type() const;
+  bool is_type(type t) const;
+
+  /** Return the number of elements of an array, or entries of a map. */
+  size_t length() const;
+
+  /** Return the given element of an array.  Takes time linear in idx. */
+  json_view operator[](size_t idx) const;
+  json_view operator[](int idx) const;
+
+  /** Return the value for the given key of a map. */
+  json_view operator[](const std::string &key) const;
+  json_view operator[](const char *key) const;
+
+  /** Return true iff this is a map containing the given key. */
+  bool has_key(const std::string &key) const;
+
+  /** Return the keys of a map, in document order. */
+  std::vector<std::string> keys() const;
+
+  /** Follow a path in the syntax of node::at, e.g. "{a}[2]{b}". */
+  json_view at(const std::string &path) const;
+
+  bool as_bool() const;
+  int64_t as_int64() const;
+  double as_double() const;
+  std::string as_u8str() const;
+
+  /** Decode this value (and everything under it) into a new node. */
+  std::unique_ptr<node> to_node() const;
+
+  /** Return the raw JSON text of this value. */
+  const char * raw_text() const;
+  size_t raw_length() const;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CODEC_JSON_VIEW_HPP_ */
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * @file ellis/codec/jsonl.hpp
+ *
+ * @brief Ellis JSON Lines (newline delimited JSON) codec C++ header.
+ *
+ * A JSON Lines stream is a sequence of JSON values ("records"), one per
+ * line.  As a data format (extension "jsonl") it maps to an array node with
+ * one element per record.  For streams too large to hold in memory, use
+ * jsonl_reader and jsonl_writer, which handle one record at a time.
+ */
+
+#pragma once
+#ifndef ELLIS_CODEC_JSONL_HPP_
+#define ELLIS_CODEC_JSONL_HPP_
+
+#include <ellis/codec/json.hpp>
+#include <ellis/core/decoder.hpp>
+#include <ellis/core/defs.hpp>
+#include <ellis/core/encoder.hpp>
+#include <ellis/core/node.hpp>
+#include <ellis/core/sync_input_stream.hpp>
+#include <ellis/core/sync_output_stream.hpp>
+#include <functional>
+#include <memory>
+
+namespace ellis {
+
+
+/** Decodes a whole JSON Lines stream into an array of its records. */
+class jsonl_decoder : public decoder {
+  json_decoder m_dec;
+  std::unique_ptr<node> m_records;
+  bool m_in_record = false;
+
+public:
+  jsonl_decoder();
+  node_progress consume_buffer(
+      const byte *buf,
+      size_t *bytecount) override;
+  node_progress chop() override;
+  void reset() override;
+};
+
+
+/** Encodes an array node as JSON Lines, one compact record per element. */
+class jsonl_encoder : public encoder {
+  json_encoder m_enc;
+  const node *m_records = nullptr;
+  size_t m_idx = 0;
+  bool m_need_newline = false;
+
+public:
+  jsonl_encoder();
+  progress fill_buffer(
+      byte *buf,
+      size_t *bytecount) override;
+  void reset(const node *new_node) override;
+};
+
+
+/** Reads JSON Lines records from a stream one at a time.
+ *
+ * The same json_decoder is reused for each record, and bytes past the end
+ * of a record are handed back to the stream, so memory use is bounded by
+ * the largest record rather than the size of the stream.
+ *
+ * Blank lines are skipped.  The stream must outlive the reader.
+ */
+class jsonl_reader {
+  sync_input_stream &m_in;
+  json_decoder m_dec;
+  size_t m_count = 0;
+
+public:
+  explicit jsonl_reader(sync_input_stream &in);
+
+  /** Read the next record.
+   *
+   * Returns nullptr at the end of the stream, provided the stream ended on
+   * a record boundary.  Throws an ellis::err on malformed or truncated
+   * input.
+   */
+  std::unique_ptr<node> next();
+
+  /** Call fn on each remaining record, in order, until fn returns false or
+   * the stream ends.
+   *
+   * Returns the number of records delivered.  Throws as next() does.
+   */
+  size_t for_each(std::function<bool(std::unique_ptr<node>)> fn);
+
+  /** Return the number of records read so far. */
+  size_t count() const;
+};
+
+
+/** Writes JSON Lines records to a stream one at a time.
+ *
+ * Records are written compactly, each followed by a newline.  Output is
+ * accumulated in the stream's buffer and only emitted when that fills up,
+ * so small records are coalesced into large writes; call flush() when done
+ * (the destructor also flushes, but can not report errors).
+ *
+ * The stream must outlive the writer.
+ */
+class jsonl_writer {
+  sync_output_stream &m_out;
+  json_encoder m_enc;
+  byte *m_buf = nullptr;
+  size_t m_cap = 0;
+  size_t m_used = 0;
+  size_t m_count = 0;
+
+  void _next_buf();
+
+public:
+  explicit jsonl_writer(sync_output_stream &out);
+  ~jsonl_writer();
+
+  /** Append a record.  Throws an ellis::err on failure. */
+  void write(const node &rec);
+
+  /** Emit any buffered output.  Throws an ellis::err on failure. */
+  void flush();
+
+  /** Return the number of records written so far. */
+  size_t count() const;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CODEC_JSONL_HPP_ */
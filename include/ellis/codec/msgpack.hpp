@@ -35,34 +35,30 @@
 #include <ellis/core/decoder.hpp>
 #include <ellis/core/defs.hpp>
 #include <ellis/core/encoder.hpp>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace ellis {
 
 
+class element_stream;
+class node_builder;
+class projection;
+
+
 enum class msgpack_parse_state {
+  /** Expecting a value. */
   UNDEFINED,
-  COMPLETE,
-  ARRAY_HEADER,
-  BIN_HEADER,
-  MAP_HEADER,
-  STR_HEADER,
+  /** In an array; its current element is above on the stack. */
   ARRAY_DATA,
-  BIN_DATA,
-  STR_DATA,
+  /** In a map, expecting a key. */
   MAP_KEY_TYPE,
-  MAP_KEY_HEADER,
-  MAP_KEY_DATA,
+  /** In a map; the value for the current key is above on the stack. */
   MAP_VALUE_DATA,
-  FLOAT32_DATA,
-  FLOAT64_DATA,
-  INT16_DATA,
-  INT32_DATA,
-  INT64_DATA,
-  INT8_DATA,
-  UINT16_DATA,
-  UINT32_DATA,
-  UINT8_DATA,
+  /** Passing over a value outside the projection. */
+  SKIP,
 };
 
 
@@ -70,64 +66,187 @@ enum class msgpack_parse_state {
 struct msgpack_parse_ctx {
   /** The current parse state; used to interpret incoming parse data. */
   msgpack_parse_state state;
-  /** The length of the data currently being parsed. */
-  uint_fast32_t data_len;
-  union {
-    /** Header length, if currently parsing a header. Otherwise unused. */
-    uint_fast8_t header_len;
-    /** The current data, for numeric types. */
-    uint64_t data;
-  };
-  /* Possible optimization: fold buf and (and maybe node too) into the union. */
-
-  /** The length of a map, if parsing a map. Otherwise unused. */
-  uint_fast32_t map_len;
-  /** A buffer used to store vector data (e.g. strings or binary). */
-  std::unique_ptr<std::vector<byte>> buf;
-  /** The node output of the current parse. */
-  std::unique_ptr<ellis::node> node;
+  /** The number of elements still to come, if parsing an array. */
+  uint64_t data_len = 0;
+  /** The number of entries still to come, if parsing a map. */
+  uint64_t map_len = 0;
+  /** The key of the current entry, if parsing a map. */
+  std::string key;
+  /** The container being built, if parsing an array or map. */
+  ellis::node node;
+  /** The projection for this value; nullptr if it is being skipped. */
+  const projection *proj;
 
   msgpack_parse_ctx();
 };
 
 
-/** A msgpack decoder. */
+/** A msgpack decoder.
+ *
+ * Each value is decoded in one go, straight from the input buffer, as long
+ * as it is all there; a value that straddles the end of a buffer is copied
+ * aside until the rest of it arrives.  Values are built by value, straight
+ * into their parents, so the only heap allocations are those of the
+ * containers, strings and binaries themselves; use consume_buffer_into (or
+ * the load() that takes a node) to avoid one more for the result.
+ *
+ * With consume_buffer_into, the decoder also keeps what *out held before,
+ * and builds the next document in it, reusing its strings, binaries, arrays
+ * and map entries wherever the shape matches; decoding a stream of similar
+ * messages into the same node thus needs no heap allocation at all once it
+ * has warmed up.  This is not done while a projection or element callback
+ * is set.
+ */
 class msgpack_decoder : public decoder {
   std::vector<msgpack_parse_ctx> m_parse_stack;
+  std::unique_ptr<projection> m_proj;
+  const projection *m_root_proj;
+  std::unique_ptr<element_stream> m_stream;
+  std::unique_ptr<node_builder> m_build;
+  /** How many entries of m_parse_stack, from the bottom, are on the path to
+   * the streamed array. */
+  size_t m_onpath;
+
+  /** The start of a value that straddles the end of the input so far. */
+  std::vector<byte> m_carry;
+
+  /** The buffer that binaries may refer to in place; see set_slice_source. */
+  std::shared_ptr<const void> m_slice_owner;
+  const byte *m_slice_begin = nullptr;
+  const byte *m_slice_end = nullptr;
 
-  node_progress handle_type(msgpack_parse_ctx &ctx, byte b);
+  /* State for passing over a value outside the projection. */
+  /** Values still to be passed over, including nested ones. */
+  uint64_t m_skip_values;
+  /** Payload bytes still to be passed over. */
+  uint64_t m_skip_bytes;
 
-  void accum_str_header(msgpack_parse_ctx & ctx, byte b);
-  void accum_bin_header(msgpack_parse_ctx & ctx, byte b);
-  void accum_map_key_header(msgpack_parse_ctx & ctx, byte b);
-  node_progress accum_arr_header(msgpack_parse_ctx & ctx, byte b);
-  node_progress accum_map_header(msgpack_parse_ctx & ctx, byte b);
-  node_progress parse_byte(byte b);
+  /** The finished value, until it is handed over; then what it replaced,
+   * if anything, to build the next one in. */
+  node m_result;
+
+  size_t token_size(const byte *p, size_t avail) const;
+  progress parse_token(const byte *p);
+  progress finish_top(node &&done);
+  progress consume(const byte *buf, size_t *bytecount);
+  std::unique_ptr<err> chop_error() const;
+  void push_child(msgpack_parse_ctx &parent);
+  bool at_stream() const;
 
 public:
   msgpack_decoder();
+  ~msgpack_decoder();
+
+  /** Only build the parts of the document at the given paths (in the
+   * syntax of node::at), and whatever maps and arrays lead to them.
+   *
+   * Everything else is passed over without building nodes or strings.
+   * Skipped map entries are left out; skipped array elements are left as
+   * nulls, so that the selected elements keep their indices, or left out if
+   * no later element is selected.
+   *
+   * Resets the decoder.  Throws PATH_FAIL if a path is malformed.
+   */
+  void set_projection(const std::vector<std::string> &paths);
+
+  /** Go back to building the whole document.  Resets the decoder. */
+  void clear_projection();
+
+  /** Hand each element of the array at the given path (in the syntax of
+   * node::at; "" for the document itself) to fn as soon as it is complete,
+   * rather than adding it to the array.
+   *
+   * This bounds memory use by the largest element, rather than the whole
+   * array.  The array is left empty in the decoded document, which is
+   * otherwise built as usual.  If there is no array at the path, nothing is
+   * streamed.  fn may throw to abandon the decode, after which the decoder
+   * must be reset.
+   *
+   * Resets the decoder.  Throws PATH_FAIL if the path is malformed.
+   */
+  void set_element_callback(const std::string &path, element_fn fn);
+
+  /** Go back to building arrays whole.  Resets the decoder. */
+  void clear_element_callback();
+
+  /** Let binary values refer to the input in place, rather than copying it.
+   *
+   * Any binary of 64 bytes or more that lies wholly within [buf, buf+len),
+   * as passed to consume_buffer(), becomes a node that refers to those bytes
+   * and holds a reference to owner (see binary_node::is_slice); owner must
+   * keep the bytes valid and unchanged for as long as it lives.  This suits
+   * input that is all in memory, as with load_mem or a mapped file, and
+   * saves copying large blobs such as images.  Binaries that straddle two
+   * calls to consume_buffer(), and strings, are copied as usual.
+   *
+   * Lasts until cleared or replaced; does not reset the decoder.
+   */
+  void set_slice_source(
+      std::shared_ptr<const void> owner,
+      const void *buf,
+      size_t len);
+
+  /** Go back to copying all binaries, dropping the reference to owner. */
+  void clear_slice_source();
+
   node_progress consume_buffer(
       const byte *buf,
       size_t *bytecount) override;
   node_progress chop() override;
+  progress consume_buffer_into(
+      const byte *buf,
+      size_t *bytecount,
+      node *out) override;
+  progress chop_into(node *out) override;
   void reset() override;
 };
 
 
-/** A msgpack encoder. */
+/** A msgpack encoder.
+ *
+ * Output is written straight into the buffers given to fill_buffer(), as
+ * the node is walked; nothing is buffered beyond the few bytes of a header
+ * that does not fit.  The node must therefore stay alive and unchanged
+ * until encoding is done.
+ *
+ * With set_ref_min, string and binary bodies of at least that size are
+ * offered through next_ref instead, so that dump() can write them straight
+ * from the node.
+ *
+ * encoded_size() is exact, and costs a walk of the node with no copying;
+ * only the lengths of strings and binaries are looked at, not their bytes.
+ */
 class msgpack_encoder : public encoder {
-  std::vector<byte> m_buf;
-  size_t m_pos;
-  size_t m_end;
+  /** A container part way through being written. */
+  struct frame {
+    const node *n;
+    /** The next element or entry to write. */
+    size_t idx;
+    /** For maps, the entries in the order they are written. */
+    std::vector<std::pair<const std::string *, const node *>> entries;
+    /** For maps, whether the key of entries[idx] has been written. */
+    bool key_done;
+  };
 
-  void _clear_buf();
-  void _buf_out(const node &n);
-  void _buf_out_str(const char *s, size_t len);
+  const node *m_root = nullptr;
+  bool m_root_done = false;
+  std::vector<frame> m_stack;
+  /** A header that did not fit in the last buffer, and how much of it has
+   * been written. */
+  byte m_hdr[9];
+  size_t m_hdr_len = 0;
+  size_t m_hdr_pos = 0;
+  /** The rest of the current string or binary body. */
+  const byte *m_body = nullptr;
+  size_t m_body_len = 0;
+  /** Bodies at least this long are offered by reference; 0 for none. */
+  size_t m_ref_min = 0;
+  /** Whether fill_buffer() stopped short to offer m_body by reference. */
+  bool m_ref_offered = false;
 
-  void _push_be(uint8_t val);
-  void _push_be(uint16_t val);
-  void _push_be(uint32_t val);
-  void _push_be(uint64_t val);
+  bool _next(byte *out, size_t *pos, size_t cap);
+  size_t _header(const node &n, byte *dst);
+  size_t _str_header(size_t len, byte *dst);
 
 public:
   msgpack_encoder();
@@ -135,6 +254,9 @@ public:
       byte *buf,
       size_t *bytecount) override;
   void reset(const node *new_node) override;
+  void set_ref_min(size_t min_len) override;
+  bool next_ref(const byte **data, size_t *bytecount) override;
+  bool encoded_size(const node &n, size_t *bytecount) const override;
 };
 
 
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/codec/msgpack_seq.hpp
+ *
+ * @brief Ellis msgpack record sequence C++ header.
+ *
+ * A msgpack sequence is a stream of msgpack values ("records") written back
+ * to back, with nothing in between; since each value carries its own
+ * length, no framing is needed.  msgpack_seq_reader and msgpack_seq_writer
+ * handle such streams a record, or a batch of records, at a time.
+ */
+
+#pragma once
+#ifndef ELLIS_CODEC_MSGPACK_SEQ_HPP_
+#define ELLIS_CODEC_MSGPACK_SEQ_HPP_
+
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/core/defs.hpp>
+#include <ellis/core/node.hpp>
+#include <ellis/core/sync_input_stream.hpp>
+#include <ellis/core/sync_output_stream.hpp>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ellis {
+
+
+/** Reads msgpack records from a stream.
+ *
+ * The same msgpack_decoder is reused for each record, and bytes past the
+ * end of the records asked for are handed back to the stream, so memory use
+ * is bounded by the largest record (or batch) rather than the size of the
+ * stream.  Records that lie in the same input buffer are decoded one after
+ * another, without going back to the stream in between.
+ *
+ * The stream must outlive the reader.
+ */
+class msgpack_seq_reader {
+  sync_input_stream &m_in;
+  msgpack_decoder m_dec;
+  size_t m_count = 0;
+
+  size_t _read(size_t n, const std::function<void(std::unique_ptr<node>)> &fn);
+
+public:
+  explicit msgpack_seq_reader(sync_input_stream &in);
+
+  /** Read the next record.
+   *
+   * Returns nullptr at the end of the stream, provided the stream ended on
+   * a record boundary.  Throws an ellis::err on malformed or truncated
+   * input.
+   */
+  std::unique_ptr<node> next();
+
+  /** Read up to n more records, appending them to out.
+   *
+   * Returns the number of records read, which is less than n only at the
+   * end of the stream, and zero once the stream is exhausted.  Throws as
+   * next() does; records read before the error are still appended.
+   */
+  size_t next_batch(size_t n, std::vector<node> *out);
+
+  /** Call fn on each remaining record, in order, until fn returns false or
+   * the stream ends.
+   *
+   * Returns the number of records delivered.  Throws as next() does.
+   */
+  size_t for_each(std::function<bool(std::unique_ptr<node>)> fn);
+
+  /** Return the number of records read so far. */
+  size_t count() const;
+};
+
+
+/** Writes msgpack records to a stream, back to back.
+ *
+ * Records are encoded straight into the stream's buffer, which is only
+ * emitted when it fills up, so many small records are coalesced into large
+ * writes; call flush() when done (the destructor also flushes, but can not
+ * report errors).
+ *
+ * The stream must outlive the writer.
+ */
+class msgpack_seq_writer {
+  sync_output_stream &m_out;
+  msgpack_encoder m_enc;
+  byte *m_buf = nullptr;
+  size_t m_cap = 0;
+  size_t m_used = 0;
+  size_t m_count = 0;
+
+  void _next_buf();
+
+public:
+  explicit msgpack_seq_writer(sync_output_stream &out);
+  ~msgpack_seq_writer();
+
+  /** Append a record.  Throws an ellis::err on failure. */
+  void write(const node &rec);
+
+  /** Append each of the given records, in order.  Throws an ellis::err on
+   * failure, in which case some of the records may have been written. */
+  void write_batch(const std::vector<node> &recs);
+
+  /** Emit any buffered output.  Throws an ellis::err on failure. */
+  void flush();
+
+  /** Return the number of records written so far. */
+  size_t count() const;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CODEC_MSGPACK_SEQ_HPP_ */
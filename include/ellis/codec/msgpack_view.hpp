@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/codec/msgpack_view.hpp
+ *
+ * @brief Ellis on-demand msgpack access C++ header.
+ *
+ * Decoding a whole msgpack message into nodes is wasteful when only a few
+ * values are needed, for instance to route the message on.  A msgpack_view
+ * instead reads values straight out of the encoded bytes, passing over
+ * whatever lies before them, without allocating any nodes or strings.  The
+ * encoded bytes of any value can be had for forwarding as they are.
+ *
+ * Example:
+ *
+ *   msgpack_view msg(buf, len);
+ *   int64_t dest = msg["dest"].as_int64();
+ *   string topic = msg.at("{hdr}{topic}").as_u8str();
+ *   forward(dest, msg["body"].raw_bytes(), msg["body"].raw_length());
+ */
+
+#pragma once
+#ifndef ELLIS_CODEC_MSGPACK_VIEW_HPP_
+#define ELLIS_CODEC_MSGPACK_VIEW_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/node.hpp>
+#include <ellis/core/type.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ellis {
+
+
+/** A lightweight read-only handle to a msgpack value in a byte buffer.
+ *
+ * The bytes are not copied, and must remain valid and unchanged for as
+ * long as the view, or any view derived from it, is in use.  Views are
+ * cheap to copy.
+ *
+ * Nothing is checked up front.  Each access reads only as far as it needs
+ * to, checking as it goes; reaching an element or map entry means passing
+ * over the ones before it, so access takes time linear in the encoded
+ * size of what comes first.  Accessors mirror those of node.  They throw
+ * PARSE_FAIL for truncated input, TRANSLATE_FAIL for msgpack that ellis
+ * does not handle (as msgpack_decoder does), TYPE_MISMATCH when applied to
+ * the wrong type of value, INVALID_ARGS for an array index out of range,
+ * NO_SUCH for a missing map key, and PATH_FAIL from at().
+ */
+class msgpack_view {
+  /** The start of the value. */
+  const byte *m_p;
+  /** The end of the buffer the value lies in. */
+  const byte *m_end;
+
+  msgpack_view() = default;
+  static msgpack_view _view(const byte *p, const byte *end);
+  void _check_type(type t) const;
+  uint64_t _count() const;
+  const byte * _first() const;
+  const byte * _payload(size_t *len) const;
+  bool _find(const char *key, size_t keylen, msgpack_view *found) const;
+
+public:
+  /** View the first msgpack value in the given len bytes; anything after
+   * it is ignored.  Throws PARSE_FAIL if len is zero. */
+  msgpack_view(const void *buf, size_t len);
+
+  /** Return the type the value would have once decoded into a node. */
+  type get_type() const;
+  bool is_type(type t) const;
+
+  /** Return the number of elements of an array, or entries of a map. */
+  size_t length() const;
+
+  /** Return the given element of an array. */
+  msgpack_view operator[](size_t idx) const;
+  msgpack_view operator[](int idx) const;
+
+  /** Return the value for the given key of a map.  If the key appears more
+   * than once, the first is used. */
+  msgpack_view operator[](const std::string &key) const;
+  msgpack_view operator[](const char *key) const;
+
+  /** Return true iff this is a map containing the given key. */
+  bool has_key(const std::string &key) const;
+
+  /** Return the keys of a map, in encoded order. */
+  std::vector<std::string> keys() const;
+
+  /** Follow a path in the syntax of node::at, e.g. "{a}[2]{b}". */
+  msgpack_view at(const std::string &path) const;
+
+  bool as_bool() const;
+  int64_t as_int64() const;
+  double as_double() const;
+  std::string as_u8str() const;
+
+  /** Return the contents of a string or binary value, in place.  Strings
+   * are not NUL terminated. */
+  const byte * data() const;
+  size_t data_length() const;
+
+  /** Decode this value (and everything under it) into a new node. */
+  std::unique_ptr<node> to_node() const;
+
+  /** Return the encoded bytes of this value, e.g. for forwarding. */
+  const byte * raw_bytes() const;
+  size_t raw_length() const;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CODEC_MSGPACK_VIEW_HPP_ */
@@ -71,6 +71,7 @@ public:
   /** Append a node to the end of the array.
    */
   void append(const node &node);
+  void append(node &&node);
 
   /** Extend array by appending the contents of another array.
    */
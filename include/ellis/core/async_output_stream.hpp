@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/core/async_output_stream.hpp
+ *
+ * @brief Ellis non-blocking output stream C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_CORE_ASYNC_OUTPUT_STREAM_HPP_
+#define ELLIS_CORE_ASYNC_OUTPUT_STREAM_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/type.hpp>
+#include <memory>
+
+namespace ellis {
+
+
+/** Abstract API for asynchronous (non-blocking) output streams.
+ *
+ * As sync_output_stream, except that sending data never blocks; what can
+ * not be sent at once stays queued, and the caller waits for output_fd() to
+ * become writable (e.g. with epoll_reactor) and calls flush().
+ *
+ * Note--a class may implement both async_input_stream and
+ * async_output_stream.
+ */
+class async_output_stream {
+public:
+  /** Get another buffer, suitable for output to the stream, filling in buf
+   * and bytecount for the block of data.  Buffer remains owned by the
+   * stream; caller should not call next_output_buf() again until finished
+   * with the buffer, and until everything emitted has been sent.
+   *
+   * Return values:
+   *   true  --> Buffer is available (and has been returned).
+   *   false --> Buffer unavailable (check extract_output_error() for
+   *             details).
+   */
+  virtual bool next_output_buf(byte **buf, size_t *bytecount) = 0;
+
+  /** Queue bytecount bytes of data stored in the buffer (the last buffer
+   * returned by next_output_buf) and send as much as can be sent without
+   * blocking.
+   *
+   * Return values:
+   *   SUCCESS  --> Data all sent.
+   *   CONTINUE --> Some data still queued; call flush() once output_fd() is
+   *                writable.
+   *   ERROR    --> Problem writing (check extract_output_error() for
+   *                details).
+   */
+  virtual stream_state emit(size_t bytecount) = 0;
+
+  /** Send as much queued data as can be sent without blocking.  Return
+   * values are as for emit(). */
+  virtual stream_state flush() = 0;
+
+  /** Return the error details.  Caller owns it now.  */
+  virtual std::unique_ptr<err> extract_output_error() = 0;
+
+  /** The file descriptor whose writability means more data can be sent. */
+  virtual int output_fd() const = 0;
+
+  virtual ~async_output_stream() {}
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CORE_ASYNC_OUTPUT_STREAM_HPP_ */
@@ -85,6 +85,12 @@ public:
   /** Return true iff length == 0. */
   bool is_empty() const;
 
+  /** Return true iff the data is referred to in place, in a buffer owned
+   * elsewhere, rather than held by the node.  Any modification copies the
+   * data out, after which this returns false.
+   */
+  bool is_slice() const;
+
   /** Remove all data. */
   void clear();
 };
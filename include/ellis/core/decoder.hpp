@@ -36,6 +36,7 @@
 #include <ellis/core/disposition.hpp>
 #include <ellis/core/err.hpp>
 #include <ellis/core/node.hpp>
+#include <functional>
 #include <memory>
 
 namespace ellis {
@@ -44,6 +45,11 @@ namespace ellis {
 std::ostream & operator<<(std::ostream & os, const array_node & v);
 
 
+/** Receives array elements from decoders that can stream them out one at a
+ * time, rather than building the whole array. */
+using element_fn = std::function<void(std::unique_ptr<node>)>;
+
+
 /**
  * This abstract base class (interface) is used to decode/unpack/deserialize
  * JSON-encoded data from the provided buffers into a reconstructed in-memory
@@ -85,6 +91,23 @@ public:
    */
   virtual node_progress chop() = 0;
 
+  /**
+   * As consume_buffer(), except that on SUCCESS the finished node is moved
+   * into *out, and the returned progress carries no node.
+   *
+   * The default implementation unwraps what consume_buffer() returns.
+   * Decoders that build their nodes by value override this, so that the
+   * result is handed over without a heap allocation of its own.  They may
+   * also keep what *out held before, to build later nodes in.
+   */
+  virtual progress consume_buffer_into(
+      const byte *buf,
+      size_t *bytecount,
+      node *out);
+
+  /** As chop(), but delivering the node as consume_buffer_into() does. */
+  virtual progress chop_into(node *out);
+
   /**
    * Reset the encoder to start encoding a new ellis node.
    *
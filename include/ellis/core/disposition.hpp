@@ -71,6 +71,32 @@ class disposition {
     ERRTYPE m_err;
   };
 
+  /** Destroys the value or error held, if any. */
+  void _destroy() noexcept
+  {
+    if (m_state == STATE::ERROR) {
+      m_err.~ERRTYPE();
+    }
+    else if (m_state == STATE::SUCCESS) {
+      m_res.~VALUE();
+    }
+  }
+
+  /** Moves o's state and contents into this, which holds nothing, and
+   * leaves o holding nothing, in the CONTINUE state. */
+  void _take(disposition &o) noexcept
+  {
+    m_state = o.m_state;
+    if (m_state == STATE::ERROR) {
+      new (&m_err) ERRTYPE(std::move(o.m_err));
+    }
+    else if (m_state == STATE::SUCCESS) {
+      new (&m_res) VALUE(std::move(o.m_res));
+    }
+    o._destroy();
+    o.m_state = STATE::CONTINUE;
+  }
+
 public:
   explicit disposition(ERRTYPE e) :
     m_state(STATE::ERROR)
@@ -93,30 +119,20 @@ public:
 
   disposition(disposition &&o) noexcept
   {
-    *this = std::move(o);
+    _take(o);
   }
 
   ~disposition() noexcept
   {
-    if (m_state == STATE::ERROR) {
-      m_err.~ERRTYPE();
-    }
-    else if (m_state == STATE::SUCCESS) {
-      m_res.~VALUE();
-    }
+    _destroy();
   }
 
   disposition & operator=(disposition &&o) noexcept
   {
     if (this != &o) {
-      m_state = o.m_state;
-      o.m_state = STATE::CONTINUE;
-      if (m_state == STATE::ERROR) {
-        new (&m_err) ERRTYPE(std::move(o.m_err));
-      }
-      else if (m_state == STATE::SUCCESS) {
-        new (&m_res) VALUE(std::move(o.m_res));
-      }
+      /* Drop any value or error held already, rather than leak it. */
+      _destroy();
+      _take(o);
     }
     return *this;
   }
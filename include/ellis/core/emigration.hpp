@@ -37,6 +37,7 @@
 #include <ellis/core/encoder.hpp>
 #include <ellis/core/sync_output_stream.hpp>
 #include <memory>
+#include <vector>
 
 
 namespace ellis {
@@ -46,6 +47,10 @@ namespace ellis {
  * Synchronous (blocking) dump of an ellis node to the given output stream,
  * using the given encoder.
  *
+ * Where the stream and encoder allow (see sync_output_stream::ref_min and
+ * encoder::next_ref), large payloads are written straight from the node,
+ * rather than copied through the stream's buffer.
+ *
  * On failure, throws an ellis::err.
  */
 void dump(
@@ -105,7 +110,11 @@ void dump_file(const node *nod, const char *filename, TENCODER &&enco)
 
 
 /**
- * Dump to a memory buffer.
+ * Dump to a memory buffer, followed by a terminating NUL.
+ *
+ * The encoded output is written in a single pass; to size buf exactly, as
+ * for a length-prefixed message, ask encoder::encoded_size first, and allow
+ * one more byte for the NUL.
  *
  * Similar semantics and exceptions as dump() above.
  */
@@ -123,6 +132,45 @@ void dump_mem(const node *nod, void *buf, size_t len, TENCODER &&enco)
 }
 
 
+/**
+ * Dump to memory, returning the encoded bytes.
+ *
+ * Unlike dump_mem(), the size of the output need not be known in advance;
+ * the bytes are built in the returned vector, which grows as needed (see
+ * vector_output_stream), and are not copied again.
+ *
+ * Similar semantics and exceptions as dump() above.
+ */
+std::vector<byte> dump_vector(
+    const node *nod,
+    encoder *enco);
+
+/* See universal references above. */
+template<typename TENCODER>
+std::vector<byte> dump_vector(const node *nod, TENCODER &&enco)
+{
+  return dump_vector(nod, (encoder*)&enco);
+}
+
+
+/**
+ * As dump_vector() above, but replacing the contents of *out, and reusing
+ * its storage; dumping into the same vector each time thus allocates only
+ * when a document is larger than any before it.
+ */
+void dump_vector(
+    const node *nod,
+    std::vector<byte> *out,
+    encoder *enco);
+
+/* See universal references above. */
+template<typename TENCODER>
+void dump_vector(const node *nod, std::vector<byte> *out, TENCODER &&enco)
+{
+  dump_vector(nod, out, (encoder*)&enco);
+}
+
+
 /**
  * Synchronous (blocking) dump to a c++ stream.
  *
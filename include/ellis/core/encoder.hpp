@@ -55,7 +55,8 @@ public:
    * encode up to bytecount bytes of data into the provided buffer.
    *
    * The callee should use up to the given size, as needed, for encoding, and
-   * update bytecount to reflect the amount of unused buffer space left over.
+   * update bytecount to the number of bytes it wrote (starting at the
+   * beginning of buf).
    *
    * If there has been a non-recoverable error in the encoding process, the
    * ERROR status will be returned and the details provided; otherwise, if an
@@ -76,6 +77,48 @@ public:
    */
   virtual void reset(const node *new_node) = 0;
 
+  /**
+   * Offer runs of output of at least min_len bytes that are already in
+   * memory, such as the payloads of large binary or string nodes, by
+   * reference through next_ref(), rather than copying them into the buffers
+   * given to fill_buffer().  Lasts until the next reset(); 0 turns it off.
+   *
+   * Encoders that have nothing to offer may ignore this, as by default.
+   */
+  virtual void set_ref_min(size_t min_len) { (void)min_len; }
+
+  /**
+   * Called after fill_buffer() returns CONTINUE, to take the next run of
+   * output by reference, if one is on offer (see set_ref_min()).
+   *
+   * If so, fills in data and bytecount, moves the encoder past that run, and
+   * returns true; the run remains valid for as long as the node being
+   * encoded is alive and unchanged.  Otherwise returns false, and the run,
+   * if any, will be copied by the next call to fill_buffer() as usual.
+   */
+  virtual bool next_ref(const byte **data, size_t *bytecount)
+  {
+    (void)data;
+    (void)bytecount;
+    return false;
+  }
+
+  /**
+   * Work out how many bytes encoding n would produce, without producing
+   * them, and store it in *bytecount; this lets a caller size a buffer
+   * exactly, or write a length prefix, before encoding.
+   *
+   * Does not disturb any encoding in progress.  Throws as encoding would if
+   * n can not be encoded.  Returns false, leaving *bytecount alone, if the
+   * encoder can not tell without encoding, as by default.
+   */
+  virtual bool encoded_size(const node &n, size_t *bytecount) const
+  {
+    (void)n;
+    (void)bytecount;
+    return false;
+  }
+
   virtual ~encoder() {}
 };
 
@@ -75,6 +75,29 @@ std::unique_ptr<node> load(TSTREAM &&in, TDECODER &&deco)
 }
 
 
+/**
+ * As load() above, but decoding into the given node, replacing its
+ * contents, rather than into a new one.
+ *
+ * With decoders that support it (see decoder::consume_buffer_into), this
+ * saves allocating a node just to hand over the result, which adds up when
+ * loading many small values; the msgpack and JSON decoders also build each
+ * value in the storage of an earlier one.  On failure, throws an ellis::err
+ * and leaves *out unchanged.
+ */
+void load(
+    sync_input_stream *in,
+    decoder *deco,
+    node *out);
+
+/* See universal references above. */
+template<typename TSTREAM, typename TDECODER>
+void load(TSTREAM &&in, TDECODER &&deco, node *out)
+{
+  load((sync_input_stream*)&in, (decoder*)&deco, out);
+}
+
+
 /**
  * Synchronous (blocking) load from an open socket/fd.
  *
@@ -95,7 +118,9 @@ std::unique_ptr<node> load_fd(int fd, TDECODER &&deco)
 /**
  * Synchronous (blocking) load from a file.
  *
- * Similar behavior to load() above.
+ * Similar behavior to load() above.  Regular files are mapped into memory
+ * (see mmap_input_stream) rather than read; anything else, such as a pipe
+ * or "-" for standard input, is read as a stream.
  */
 std::unique_ptr<node> load_file(
     const char *filename,
@@ -126,6 +151,20 @@ std::unique_ptr<node> load_mem(const void *buf, size_t len, TDECODER &&deco)
   return load_mem(buf, len, (decoder*)&deco);
 }
 
+/** As load_mem() above, but decoding into the given node, as with load(). */
+void load_mem(
+    const void *buf,
+    size_t len,
+    decoder *deco,
+    node *out);
+
+/* See universal references above. */
+template<typename TDECODER>
+void load_mem(const void *buf, size_t len, TDECODER &&deco, node *out)
+{
+  load_mem(buf, len, (decoder*)&deco, out);
+}
+
 
 /**
  * Synchronous (blocking) load from a stream.
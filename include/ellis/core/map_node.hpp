@@ -151,6 +151,11 @@ public:
    */
   void erase(const char *);
 
+  /** Return a pointer to the value with the given key, or nullptr if key
+   * is not present. */
+  node * find(const std::string &);
+  const node * find(const std::string &) const;
+
   /** Return true iff the map has a key of the given name. */
   bool has_key(const std::string &) const;
 
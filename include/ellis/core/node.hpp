@@ -36,6 +36,7 @@
 #include <ellis/core/defs.hpp>
 #include <ellis/core/type.hpp>
 #include <initializer_list>
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -122,6 +123,16 @@ class node {
   /** Construct a BINARY node. */
   node(const byte *mem, size_t bytes);
 
+  /** Construct a BINARY node that refers to the given bytes in place,
+   * rather than copying them.
+   *
+   * The bytes must stay valid and unchanged for as long as owner (or any
+   * copy of it) is alive; the node, and any copies of it, hold a reference
+   * to owner until they are destroyed or modified.  Modifying the node
+   * copies the bytes out first, so the bytes themselves are never written.
+   */
+  node(std::shared_ptr<const void> owner, const byte *mem, size_t bytes);
+
   /** Construct a BOOL node.
    *
    * This is explicit in order to prevent accidental conversion from node*.
@@ -161,8 +172,9 @@ class node {
   /** Move constructor.
    *
    * Steals contents, without changing ref count.  Other no longer has a
-   * reference count, and will not affect the contents when deleted. */
-  node(node&& other);
+   * reference count, and will not affect the contents when deleted.  Never
+   * throws, so that containers of nodes move rather than copy them. */
+  node(node&& other) noexcept;
 
 
   ~node();
@@ -202,7 +214,7 @@ class node {
    *
    * Any prior contents of this node are lost (refcount decremented).
    */
-  node& operator=(node&& rhs);
+  node& operator=(node&& rhs) noexcept;
 
   /** Assignment operators from primitive types.
    *
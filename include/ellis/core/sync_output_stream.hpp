@@ -66,6 +66,23 @@ public:
    */
   virtual bool emit(size_t bytecount) = 0;
 
+  /** The smallest run of data worth passing to emit_ref(), rather than
+   * copying into the buffer; 0 (the default) if the stream can only copy it
+   * anyway.
+   */
+  virtual size_t ref_min() const { return 0; }
+
+  /** As emit(bytecount), then send len more bytes from data, which is not in
+   * a buffer of the stream and need only stay valid during the call.
+   *
+   * Streams that can send data in place, such as fd_output_stream with
+   * writev(), do so; by default, data is copied through next_output_buf()
+   * and emit().
+   *
+   * Return values are as for emit().
+   */
+  virtual bool emit_ref(size_t bytecount, const byte *data, size_t len);
+
   /** Return the error details.  Caller owns it now.  */
   virtual std::unique_ptr<err> extract_output_error() = 0;
 
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/async_fd_stream.hpp
+ *
+ * @brief Ellis non-blocking file descriptor stream C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_ASYNC_FD_STREAM_HPP_
+#define ELLIS_STREAM_ASYNC_FD_STREAM_HPP_
+
+#include <ellis/core/async_input_stream.hpp>
+#include <ellis/core/async_output_stream.hpp>
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/stream/stream_buffer.hpp>
+
+namespace ellis {
+
+
+/** A non-blocking stream over a file descriptor, such as a socket or pipe,
+ * for input, output or both.
+ *
+ * The descriptor is put into non-blocking mode, but is not owned; the
+ * caller closes it.  Writing to a socket whose peer has gone is an error
+ * rather than a SIGPIPE; for pipes, SIGPIPE must be ignored to get the
+ * same.  The buffers are as for fd_input_stream and fd_output_stream, but
+ * start smaller, since a reactor may hold thousands of these streams, mostly
+ * moving small messages; each is allocated on first use, and grows as for
+ * stream_buffer.
+ */
+class async_fd_stream : public async_input_stream, public async_output_stream {
+  int m_fd;
+
+  stream_buffer m_in;
+  size_t m_in_pos = 0;
+  size_t m_in_avail = 0;
+  std::unique_ptr<err> m_in_err;
+
+  stream_buffer m_out;
+  size_t m_out_pos = 0;
+  size_t m_out_len = 0;
+  std::unique_ptr<err> m_out_err;
+  /** Whether to send() rather than write(); cleared if fd is no socket. */
+  bool m_is_socket = true;
+
+public:
+  /** The default initial size of each buffer. */
+  static constexpr size_t k_default_size = 4 * 1024;
+
+  /** Throws IO if fd can not be made non-blocking. */
+  explicit async_fd_stream(
+      int fd,
+      size_t bufsize = k_default_size,
+      size_t max_bufsize = stream_buffer::k_default_max);
+
+  stream_state try_next_input_buf(
+      const byte **buf,
+      size_t *bytecount) override;
+  void put_back(size_t bytecount) override;
+  std::unique_ptr<err> extract_input_error() override;
+  int input_fd() const override;
+
+  bool next_output_buf(byte **buf, size_t *bytecount) override;
+  stream_state emit(size_t bytecount) override;
+  stream_state flush() override;
+  std::unique_ptr<err> extract_output_error() override;
+  int output_fd() const override;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_ASYNC_FD_STREAM_HPP_ */
@@ -35,19 +35,28 @@
 #include <ellis/core/defs.hpp>
 #include <ellis/core/err.hpp>
 #include <ellis/core/sync_input_stream.hpp>
+#include <ellis/stream/stream_buffer.hpp>
 
 namespace ellis {
 
 
+/** An input stream that reads from a std::istream into a buffer.
+ *
+ * The buffer starts at bufsize bytes and grows up to max_bufsize while reads
+ * keep filling it; see stream_buffer.
+ */
 class cpp_input_stream : public sync_input_stream {
   std::istream &m_is;
-  byte m_buf[4096];
-  int m_avail = 0;
-  int m_pos = 0;
+  stream_buffer m_buf;
+  size_t m_avail = 0;
+  size_t m_pos = 0;
   std::unique_ptr<err> m_err;
 
 public:
-  cpp_input_stream(std::istream &is);
+  cpp_input_stream(
+      std::istream &is,
+      size_t bufsize = stream_buffer::k_default_size,
+      size_t max_bufsize = stream_buffer::k_default_max);
 
   bool next_input_buf(const byte **buf, size_t *bytecount) override;
 
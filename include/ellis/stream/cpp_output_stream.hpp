@@ -35,21 +35,38 @@
 #include <ellis/core/defs.hpp>
 #include <ellis/core/err.hpp>
 #include <ellis/core/sync_output_stream.hpp>
+#include <ellis/stream/stream_buffer.hpp>
 
 namespace ellis {
 
 
+/** An output stream that writes to a std::ostream from a buffer.
+ *
+ * The buffer starts at bufsize bytes and grows up to max_bufsize while
+ * emits keep filling it; see stream_buffer.  Data given to emit_ref() goes
+ * straight to the ostream.
+ */
 class cpp_output_stream : public sync_output_stream {
   std::ostream &m_os;
-  byte m_buf[4096];
+  stream_buffer m_buf;
   std::unique_ptr<err> m_err;
+
+  bool _write(const byte *data, size_t len);
+
 public:
-  cpp_output_stream(std::ostream &os);
+  cpp_output_stream(
+      std::ostream &os,
+      size_t bufsize = stream_buffer::k_default_size,
+      size_t max_bufsize = stream_buffer::k_default_max);
 
   bool next_output_buf(byte **buf, size_t *bytecount) override;
 
   bool emit(size_t bytecount) override;
 
+  size_t ref_min() const override;
+
+  bool emit_ref(size_t bytecount, const byte *data, size_t len) override;
+
   std::unique_ptr<err> extract_output_error() override;
 };
 
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/epoll_reactor.hpp
+ *
+ * @brief Ellis epoll event loop C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_EPOLL_REACTOR_HPP_
+#define ELLIS_STREAM_EPOLL_REACTOR_HPP_
+
+#include <ellis/core/async_input_stream.hpp>
+#include <ellis/core/async_output_stream.hpp>
+#include <ellis/core/decoder.hpp>
+#include <ellis/core/defs.hpp>
+#include <ellis/core/disposition.hpp>
+#include <ellis/core/encoder.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/node.hpp>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace ellis {
+
+
+/** Called when an async load finishes: SUCCESS with the node, or ERROR. */
+using load_done_fn = std::function<void(node_progress)>;
+
+/** Called when an async dump finishes: SUCCESS, or ERROR. */
+using dump_done_fn = std::function<void(progress)>;
+
+
+/** A single-threaded event loop that drives many loads and dumps at once
+ * over non-blocking streams, using epoll.
+ *
+ * Each load feeds one stream to a decoder, as load() does, but only when the
+ * stream is readable; likewise each dump feeds an encoder's output to a
+ * stream when it is writable.  The streams, decoders, encoders and nodes
+ * belong to the caller, and must stay alive until the session's done
+ * function has been called; done functions are called from run_once(), and
+ * may start new sessions.
+ *
+ * A stream's descriptor may have a load and a dump going at the same time,
+ * but not two of either.
+ */
+class epoll_reactor {
+  struct session;
+
+  int m_epfd = -1;
+  /** Sessions by file descriptor. */
+  std::unordered_map<int, std::unique_ptr<session>> m_sessions;
+  /** Descriptors to step on the next run_once(), whatever epoll says. */
+  std::vector<int> m_ready;
+  size_t m_pending = 0;
+
+  session & _session(int fd);
+  void _watch(int fd, session &s);
+  size_t _step(int fd, bool readable, bool writable);
+
+public:
+  /** Throws IO if epoll is not available. */
+  epoll_reactor();
+  ~epoll_reactor();
+
+  epoll_reactor(const epoll_reactor &) = delete;
+  epoll_reactor & operator=(const epoll_reactor &) = delete;
+
+  /** Start decoding a node from in with deco, and call done when it is
+   * complete, or has failed.  deco is reset first.
+   *
+   * Throws INVALID_ARGS if the stream's descriptor already has a load
+   * going.
+   */
+  void load(async_input_stream *in, decoder *deco, load_done_fn done);
+
+  /** Start encoding nod to out with enco, and call done when it has all
+   * been sent, or has failed.
+   *
+   * Throws INVALID_ARGS if the stream's descriptor already has a dump
+   * going.
+   */
+  void dump(
+      const node *nod,
+      async_output_stream *out,
+      encoder *enco,
+      dump_done_fn done);
+
+  /** Wait up to timeout_ms milliseconds (-1 for as long as it takes) for
+   * some stream to be ready, and advance the sessions that are.  Returns the
+   * number of sessions that finished.  Throws IO if waiting fails.
+   */
+  size_t run_once(int timeout_ms = -1);
+
+  /** Run until there are no sessions left. */
+  void run();
+
+  /** The number of loads and dumps still going. */
+  size_t pending() const;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_EPOLL_REACTOR_HPP_ */
@@ -35,19 +35,28 @@
 #include <ellis/core/defs.hpp>
 #include <ellis/core/err.hpp>
 #include <ellis/core/sync_input_stream.hpp>
+#include <ellis/stream/stream_buffer.hpp>
 
 namespace ellis {
 
 
+/** An input stream that read()s from a file descriptor into a buffer.
+ *
+ * The buffer starts at bufsize bytes and grows up to max_bufsize while reads
+ * keep filling it; see stream_buffer.
+ */
 class fd_input_stream : public sync_input_stream {
-  char m_buf[4096];
+  stream_buffer m_buf;
   int m_fd;
-  int m_pos = 0;
-  int m_avail = 0;
+  size_t m_pos = 0;
+  size_t m_avail = 0;
   std::unique_ptr<err> m_err;
 
 public:
-  fd_input_stream(int fd);
+  fd_input_stream(
+      int fd,
+      size_t bufsize = stream_buffer::k_default_size,
+      size_t max_bufsize = stream_buffer::k_default_max);
 
   bool next_input_buf(const byte **buf, size_t *bytecount) override;
   void put_back(size_t bytecount) override;
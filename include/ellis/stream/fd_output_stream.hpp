@@ -35,19 +35,36 @@
 #include <ellis/core/defs.hpp>
 #include <ellis/core/err.hpp>
 #include <ellis/core/sync_output_stream.hpp>
+#include <ellis/stream/stream_buffer.hpp>
 
 namespace ellis {
 
 
+/** An output stream that write()s to a file descriptor from a buffer.
+ *
+ * The buffer starts at bufsize bytes and grows up to max_bufsize while
+ * emits keep filling it; see stream_buffer.  Data given to emit_ref() is
+ * written in place, along with the buffer, by writev().
+ *
+ * Writing to a socket whose peer has gone is an error, rather than a
+ * SIGPIPE.
+ */
 class fd_output_stream : public sync_output_stream {
-  char m_buf[4096];
+  stream_buffer m_buf;
   int m_fd;
+  /** Whether to send() rather than write(); cleared if fd is no socket. */
+  bool m_is_socket = true;
   std::unique_ptr<err> m_err;
 
 public:
-  fd_output_stream(int fd);
+  fd_output_stream(
+      int fd,
+      size_t bufsize = stream_buffer::k_default_size,
+      size_t max_bufsize = stream_buffer::k_default_max);
   bool next_output_buf(byte **buf, size_t *bytecount) override;
   bool emit(size_t bytecount) override;
+  size_t ref_min() const override;
+  bool emit_ref(size_t bytecount, const byte *data, size_t len) override;
   std::unique_ptr<err> extract_output_error() override;
 };
 
@@ -35,6 +35,7 @@
 #include <ellis/core/defs.hpp>
 #include <ellis/core/err.hpp>
 #include <ellis/core/sync_input_stream.hpp>
+#include <ellis/stream/stream_buffer.hpp>
 
 namespace ellis {
 
@@ -47,7 +48,12 @@ class file_input_stream : public sync_input_stream {
   int m_fd = -1;
 
 public:
-  file_input_stream(const char *filename);
+  /** Opens the file ("-" for standard input); the buffer sizes are as for
+   * fd_input_stream. */
+  file_input_stream(
+      const char *filename,
+      size_t bufsize = stream_buffer::k_default_size,
+      size_t max_bufsize = stream_buffer::k_default_max);
   ~file_input_stream();
 
   bool next_input_buf(const byte **buf, size_t *bytecount) override;
@@ -35,6 +35,7 @@
 #include <ellis/core/defs.hpp>
 #include <ellis/core/err.hpp>
 #include <ellis/core/sync_output_stream.hpp>
+#include <ellis/stream/stream_buffer.hpp>
 
 namespace ellis {
 
@@ -47,7 +48,12 @@ class file_output_stream : public sync_output_stream {
   int m_fd = -1;
 
 public:
-  file_output_stream(const char *filename);
+  /** Opens the file ("-" for standard output); the buffer sizes are as for
+   * fd_output_stream. */
+  file_output_stream(
+      const char *filename,
+      size_t bufsize = stream_buffer::k_default_size,
+      size_t max_bufsize = stream_buffer::k_default_max);
 
   ~file_output_stream();
 
@@ -55,6 +61,10 @@ public:
 
   bool emit(size_t bytecount) override;
 
+  size_t ref_min() const override;
+
+  bool emit_ref(size_t bytecount, const byte *data, size_t len) override;
+
   std::unique_ptr<err> extract_output_error() override;
 };
 
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/frame_input_stream.hpp
+ *
+ * @brief Ellis framed input stream C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_FRAME_INPUT_STREAM_HPP_
+#define ELLIS_STREAM_FRAME_INPUT_STREAM_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/sync_input_stream.hpp>
+#include <memory>
+
+namespace ellis {
+
+
+/** An input stream over one frame at a time of another stream, as written
+ * by frame_output_stream.
+ *
+ * Call next_frame() to start on each frame, then read it as a stream of
+ * its own; at the end of the frame, next_input_buf() returns false, so a
+ * decoder never reads into the next document, and sees the end of input
+ * where the document ends (as a JSON number at top level needs).
+ *
+ *   frame_input_stream frames(conn);
+ *   while (frames.next_frame()) {
+ *     auto doc = load(frames, msgpack_decoder());
+ *     ...
+ *   }
+ *
+ * The underlying stream must outlive this one; what is left of its current
+ * buffer is put back when this one is destroyed.
+ */
+class frame_input_stream : public sync_input_stream {
+  sync_input_stream &m_in;
+  /** The buffer last taken from m_in, and how far into it. */
+  const byte *m_buf = nullptr;
+  size_t m_len = 0;
+  size_t m_pos = 0;
+  /** Bytes of the current chunk not yet handed out. */
+  size_t m_chunk_left = 0;
+  /** Whether a frame has been started, and whether it has ended. */
+  bool m_in_frame = false;
+  bool m_frame_done = false;
+  std::unique_ptr<err> m_err;
+
+  bool _fill();
+  bool _read_header(uint32_t *len);
+
+public:
+  explicit frame_input_stream(sync_input_stream &in);
+  ~frame_input_stream();
+
+  frame_input_stream(const frame_input_stream &) = delete;
+  frame_input_stream & operator=(const frame_input_stream &) = delete;
+
+  /** Passes over whatever is left of the current frame, and starts on the
+   * next.  Returns false if the underlying stream has ended, or on error
+   * (see extract_input_error()). */
+  bool next_frame();
+
+  bool next_input_buf(const byte **buf, size_t *bytecount) override;
+  void put_back(size_t bytecount) override;
+  std::unique_ptr<err> extract_input_error() override;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_FRAME_INPUT_STREAM_HPP_ */
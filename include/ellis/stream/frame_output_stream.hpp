@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/frame_output_stream.hpp
+ *
+ * @brief Ellis framed output stream C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_FRAME_OUTPUT_STREAM_HPP_
+#define ELLIS_STREAM_FRAME_OUTPUT_STREAM_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/sync_output_stream.hpp>
+#include <memory>
+
+namespace ellis {
+
+
+/** An output stream that marks out documents (frames) on another stream,
+ * so that several can be sent over one connection, and read back one at a
+ * time with frame_input_stream.
+ *
+ * Each emit becomes a chunk: its length, as four bytes big endian, and
+ * then its bytes.  end_frame() writes a zero length to finish the frame.
+ * Since the chunk header is written in front of the data in the underlying
+ * stream's buffer, documents are neither buffered whole nor copied, and
+ * may be of any size.
+ *
+ * The underlying stream must outlive this one.
+ */
+class frame_output_stream : public sync_output_stream {
+  sync_output_stream &m_out;
+  byte *m_buf = nullptr;
+  std::unique_ptr<err> m_err;
+
+public:
+  /** The size of a chunk header. */
+  static constexpr size_t k_header_size = 4;
+
+  explicit frame_output_stream(sync_output_stream &out);
+
+  /** Finishes the current frame; what is written next starts another. */
+  bool end_frame();
+
+  bool next_output_buf(byte **buf, size_t *bytecount) override;
+  bool emit(size_t bytecount) override;
+  size_t ref_min() const override;
+  bool emit_ref(size_t bytecount, const byte *data, size_t len) override;
+  std::unique_ptr<err> extract_output_error() override;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_FRAME_OUTPUT_STREAM_HPP_ */
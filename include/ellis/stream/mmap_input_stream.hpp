@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/mmap_input_stream.hpp
+ *
+ * @brief Ellis memory-mapped file input stream C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_MMAP_INPUT_STREAM_HPP_
+#define ELLIS_STREAM_MMAP_INPUT_STREAM_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/sync_input_stream.hpp>
+
+namespace ellis {
+
+
+/** An input stream over a regular file, mapped into memory.
+ *
+ * Rather than read() the file in small blocks into a buffer, the file is
+ * mapped, and next_input_buf() hands out the mapping itself; there is no
+ * syscall per block and no copy.  Files larger than the window size are
+ * mapped one window at a time, so that address space use stays bounded.
+ * The kernel is told to expect sequential access, so it reads ahead and
+ * drops pages behind.
+ *
+ * The file must not shrink while it is mapped; touching a page past its new
+ * end raises SIGBUS.
+ */
+class mmap_input_stream : public sync_input_stream {
+  int m_fd = -1;
+  /** The size of the file, as of when it was opened. */
+  uint64_t m_size = 0;
+  /** The most to map at a time; a multiple of the page size. */
+  size_t m_window;
+  /** The current window, and the file offset it starts at. */
+  const byte *m_buf = nullptr;
+  size_t m_len = 0;
+  uint64_t m_off = 0;
+  /** The offset within the current window of the next byte to hand out. */
+  size_t m_pos = 0;
+  std::unique_ptr<err> m_err;
+
+  bool _map_window(uint64_t off);
+  void _unmap_window();
+
+public:
+  /** The default window: large enough to map nearly any file whole, yet
+   * well within the address space. */
+  static constexpr size_t k_default_window =
+    sizeof(void *) >= 8 ? ((size_t)1 << 30) : ((size_t)1 << 26);
+
+  /** Opens the given file for mapping.  The window size is rounded up to a
+   * multiple of the page size.
+   *
+   * Throws IO if the file can not be opened, or INVALID_ARGS if it is not a
+   * regular file.
+   */
+  explicit mmap_input_stream(
+      const char *filename,
+      size_t window = k_default_window);
+  ~mmap_input_stream();
+
+  mmap_input_stream(const mmap_input_stream &) = delete;
+  mmap_input_stream & operator=(const mmap_input_stream &) = delete;
+
+  bool next_input_buf(const byte **buf, size_t *bytecount) override;
+  void put_back(size_t bytecount) override;
+  std::unique_ptr<err> extract_input_error() override;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_MMAP_INPUT_STREAM_HPP_ */
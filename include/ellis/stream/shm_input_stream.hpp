@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/shm_input_stream.hpp
+ *
+ * @brief Ellis shared memory ring input stream C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_SHM_INPUT_STREAM_HPP_
+#define ELLIS_STREAM_SHM_INPUT_STREAM_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/sync_input_stream.hpp>
+#include <ellis/stream/shm_output_stream.hpp>
+#include <memory>
+
+namespace ellis {
+
+
+/** An input stream from a ring buffer in POSIX shared memory, written by a
+ * shm_output_stream; see there.
+ *
+ * Each buffer handed out stays in the ring, unread as far as the writer is
+ * concerned, until the next call to next_input_buf(), so decoders can use
+ * it in place.
+ */
+class shm_input_stream : public sync_input_stream {
+  std::unique_ptr<shm_ring> m_ring;
+  /** The tail position, as last published. */
+  uint64_t m_tail = 0;
+  /** The tail position when the writer was last notified. */
+  uint64_t m_notified = 0;
+  /** Bytes handed out but not yet released to the writer. */
+  size_t m_taken = 0;
+  std::unique_ptr<err> m_err;
+
+  void _release();
+
+public:
+  /** Attaches to the ring of the given name, and removes the name.  Throws
+   * IO if there is no such ring. */
+  explicit shm_input_stream(
+      const char *name,
+      shm_wait wait = shm_wait::FUTEX);
+
+  /** Tells the writer that nothing more will be read. */
+  ~shm_input_stream();
+
+  shm_input_stream(const shm_input_stream &) = delete;
+  shm_input_stream & operator=(const shm_input_stream &) = delete;
+
+  bool next_input_buf(const byte **buf, size_t *bytecount) override;
+  void put_back(size_t bytecount) override;
+  std::unique_ptr<err> extract_input_error() override;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_SHM_INPUT_STREAM_HPP_ */
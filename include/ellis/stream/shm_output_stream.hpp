@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/shm_output_stream.hpp
+ *
+ * @brief Ellis shared memory ring output stream C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_SHM_OUTPUT_STREAM_HPP_
+#define ELLIS_STREAM_SHM_OUTPUT_STREAM_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/sync_output_stream.hpp>
+#include <memory>
+
+namespace ellis {
+
+
+/* forward declare */
+class shm_ring;
+
+/** How a shared memory stream waits for the other side. */
+enum class shm_wait {
+  /** Busy-wait; lowest latency, but keeps a core busy while idle. */
+  SPIN,
+  /** Spin briefly, then sleep on a futex until woken. */
+  FUTEX,
+};
+
+
+/** An output stream into a ring buffer in POSIX shared memory, read by a
+ * shm_input_stream, usually in another process on the same host.
+ *
+ * There must be one writer and one reader; neither locks, and data passes
+ * through without a system call unless one side has to sleep.  The writer
+ * creates the ring (replacing any of the same name), so it must be
+ * constructed before the reader; the reader removes the name once it has
+ * attached.  When the writer is destroyed, the reader sees end of file
+ * once it has read everything.  If the reader goes first, writes fail.
+ *
+ * A process that dies without destroying its stream leaves the other side
+ * waiting; use FUTEX mode with some other means of supervision if that
+ * matters.
+ */
+class shm_output_stream : public sync_output_stream {
+  std::unique_ptr<shm_ring> m_ring;
+  /** The head position, as last published. */
+  uint64_t m_head = 0;
+  std::unique_ptr<err> m_err;
+
+public:
+  static constexpr size_t k_default_capacity = 1024 * 1024;
+
+  /** Creates the ring of the given name (as for shm_open, e.g. "/name"),
+   * with at least capacity bytes, rounded up to a power of two number of
+   * pages.  Throws IO on failure. */
+  explicit shm_output_stream(
+      const char *name,
+      size_t capacity = k_default_capacity,
+      shm_wait wait = shm_wait::FUTEX);
+
+  /** Marks the end of the data for the reader. */
+  ~shm_output_stream();
+
+  shm_output_stream(const shm_output_stream &) = delete;
+  shm_output_stream & operator=(const shm_output_stream &) = delete;
+
+  /** Waits for room in the ring, and returns all of it. */
+  bool next_output_buf(byte **buf, size_t *bytecount) override;
+  bool emit(size_t bytecount) override;
+  std::unique_ptr<err> extract_output_error() override;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_SHM_OUTPUT_STREAM_HPP_ */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/stream_buffer.hpp
+ *
+ * @brief Ellis stream buffer C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_STREAM_BUFFER_HPP_
+#define ELLIS_STREAM_STREAM_BUFFER_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <memory>
+
+namespace ellis {
+
+
+/** The heap buffer behind a stream that copies through read()/write() or a
+ * C++ stream.
+ *
+ * It starts out at a given size, and doubles, up to a given maximum, each
+ * time a transfer fills it; a source or sink that keeps filling the buffer
+ * can evidently move more per call than it is being asked to.  Growth only
+ * happens in fresh(), when the stream has no data left in the buffer.  To
+ * keep the size fixed, give the same initial and maximum size.
+ *
+ * Nothing is allocated until the first fresh(), so a stream pays nothing for
+ * a direction it never uses.
+ */
+class stream_buffer {
+  std::unique_ptr<byte[]> m_data;
+  size_t m_size;
+  size_t m_max;
+  bool m_grow = false;
+
+public:
+  /** The default initial size; see bench/stream/fd_bench.cpp. */
+  static constexpr size_t k_default_size = 64 * 1024;
+  /** The default maximum size; see bench/stream/fd_bench.cpp. */
+  static constexpr size_t k_default_max = 1024 * 1024;
+
+  /** A size of 0 is taken as 1; a max below size is taken as size. */
+  stream_buffer(size_t size, size_t max);
+
+  /** Returns the buffer, to be filled (or emptied) afresh; allocates it on
+   * first use, or grows it first if the last transfer filled it.  Invalidates
+   * earlier results of data(). */
+  byte * fresh();
+
+  /** Records a transfer of count bytes into or out of the buffer. */
+  void filled(size_t count)
+  {
+    m_grow = (count >= m_size && m_size < m_max);
+  }
+
+  /** The buffer as of the last fresh(); null before the first. */
+  byte * data() { return m_data.get(); }
+  size_t size() const { return m_size; }
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_STREAM_BUFFER_HPP_ */
@@ -22,10 +22,11 @@
  */
 
 
+
 /*
  * @file ellis/stream/tcp_client_stream.hpp
  *
- * @brief Ellis TBD C++ header.
+ * @brief Ellis TCP client stream C++ header.
  */
 
 #pragma once
@@ -36,18 +37,71 @@
 #include <ellis/core/err.hpp>
 #include <ellis/stream/fd_input_stream.hpp>
 #include <ellis/stream/fd_output_stream.hpp>
+#include <ellis/stream/stream_buffer.hpp>
+#include <memory>
 
 namespace ellis {
 
 
-class tcp_stream : public sync_input_stream, sync_output_stream {
+/** Tuning for a TCP connection. */
+struct tcp_options {
+  /** Send small writes at once, rather than waiting to coalesce them
+   * (TCP_NODELAY).  Each emit is already a whole buffer, so there is little
+   * to gain from waiting. */
+  bool nodelay = true;
+  /** Probe idle connections, to notice peers that have gone away
+   * (SO_KEEPALIVE). */
+  bool keepalive = false;
+  /** Kernel socket buffer sizes (SO_SNDBUF, SO_RCVBUF); 0 leaves the
+   * system default, which the kernel tunes automatically. */
+  int sndbuf = 0;
+  int rcvbuf = 0;
+  /** Stream buffer sizes, as for fd_input_stream and fd_output_stream. */
+  size_t bufsize = stream_buffer::k_default_size;
+  size_t max_bufsize = stream_buffer::k_default_max;
+};
+
+
+/** A TCP connection, as both an input and an output stream.
+ *
+ * Each document written is sent as it is emitted; to send several
+ * documents over one connection and tell them apart at the other end, wrap
+ * the two sides in frame_output_stream and frame_input_stream.
+ *
+ * Writing to a connection whose peer has gone is an error, not a SIGPIPE.
+ */
+class tcp_stream : public sync_input_stream, public sync_output_stream {
+  int m_fd = -1;
   std::unique_ptr<fd_input_stream> m_fdis;
   std::unique_ptr<fd_output_stream> m_fdos;
+
+  void _setup(const tcp_options &opts);
+
 public:
-  tcp_stream(const char *, const char *);
+  /** Connects to the given host and port (a service name or number),
+   * trying each address they resolve to in turn.  Throws IO if none can be
+   * reached. */
+  tcp_stream(
+      const char *host,
+      const char *port,
+      const tcp_options &opts = tcp_options());
+
+  /** Takes over an already connected socket, such as one from
+   * tcp_server::accept(); it is closed when the stream is destroyed. */
+  explicit tcp_stream(int fd, const tcp_options &opts = tcp_options());
 
   ~tcp_stream();
 
+  tcp_stream(const tcp_stream &) = delete;
+  tcp_stream & operator=(const tcp_stream &) = delete;
+
+  /** The socket. */
+  int fd() const;
+
+  /** Tells the peer that nothing more will be sent, so that its reads see
+   * end of file, while still letting this end read. */
+  void shutdown_output();
+
   bool next_input_buf(const byte **buf, size_t *bytecount) override;
 
   void put_back(size_t bytecount) override;
@@ -58,6 +112,10 @@ public:
 
   bool emit(size_t bytecount) override;
 
+  size_t ref_min() const override;
+
+  bool emit_ref(size_t bytecount, const byte *data, size_t len) override;
+
   std::unique_ptr<err> extract_output_error() override;
 };
 
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/tcp_server_stream.hpp
+ *
+ * @brief Ellis TCP server C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_TCP_SERVER_STREAM_HPP_
+#define ELLIS_STREAM_TCP_SERVER_STREAM_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/stream/tcp_client_stream.hpp>
+#include <memory>
+
+namespace ellis {
+
+
+/** A listening TCP socket, which hands out a tcp_stream for each
+ * connection. */
+class tcp_server {
+  int m_fd = -1;
+  tcp_options m_opts;
+
+public:
+  static constexpr int k_default_backlog = 128;
+
+  /** Listens on the given host and port; host may be nullptr for all
+   * addresses, and port may be "0" to have the system pick one (see
+   * port()).  The options apply to each accepted connection.  Throws IO if
+   * the address can not be bound. */
+  tcp_server(
+      const char *host,
+      const char *port,
+      const tcp_options &opts = tcp_options(),
+      int backlog = k_default_backlog);
+
+  ~tcp_server();
+
+  tcp_server(const tcp_server &) = delete;
+  tcp_server & operator=(const tcp_server &) = delete;
+
+  /** The listening socket, e.g. for polling. */
+  int fd() const;
+
+  /** The port being listened on. */
+  int port() const;
+
+  /** Waits for the next connection.  Throws IO on failure. */
+  std::unique_ptr<tcp_stream> accept();
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_TCP_SERVER_STREAM_HPP_ */
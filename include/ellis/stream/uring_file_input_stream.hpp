@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/uring_file_input_stream.hpp
+ *
+ * @brief Ellis io_uring file input stream C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_URING_FILE_INPUT_STREAM_HPP_
+#define ELLIS_STREAM_URING_FILE_INPUT_STREAM_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/sync_input_stream.hpp>
+#include <memory>
+#include <vector>
+
+namespace ellis {
+
+
+/* forward declare */
+class fd_input_stream;
+class uring;
+
+/** An input stream over a regular file that keeps several reads in flight
+ * with io_uring, so that the device always has work queued while the
+ * decoder is busy.
+ *
+ * The file is read ahead in blocks of bufsize bytes, into up to depth
+ * buffers, and handed to the decoder in order; for files long enough for it
+ * to pay off, the buffers are registered with the kernel.
+ *
+ * If io_uring is unavailable, if the file is not a regular file (or "-",
+ * for standard input), if it is empty, or if depth is 0, it falls back to
+ * fd_input_stream.
+ */
+class uring_file_input_stream : public sync_input_stream {
+  /** A buffer and the read into it. */
+  struct slot {
+    byte *buf;
+    uint64_t off;
+    size_t len;
+    /** Submitted, and not yet handed out in full. */
+    bool queued;
+    /** Submitted, and not yet completed. */
+    bool in_flight;
+    int32_t res;
+  };
+
+  int m_fd = -1;
+  std::unique_ptr<fd_input_stream> m_fallback;
+  std::unique_ptr<uring> m_ring;
+  std::unique_ptr<byte, void (*)(void *)> m_mem;
+  size_t m_bufsize;
+  std::vector<slot> m_slots;
+  uint64_t m_size = 0;
+  /** The offset of the next read to submit. */
+  uint64_t m_next_off = 0;
+  /** The slot being handed out, and how far into it. */
+  size_t m_cur = 0;
+  bool m_have_cur = false;
+  size_t m_pos = 0;
+  std::unique_ptr<err> m_err;
+
+  bool _submit(size_t idx);
+  bool _wait(size_t idx);
+
+public:
+  static constexpr size_t k_default_depth = 8;
+  static constexpr size_t k_default_bufsize = 256 * 1024;
+
+  /** Opens the file; throws IO if it can not be opened. */
+  explicit uring_file_input_stream(
+      const char *filename,
+      size_t depth = k_default_depth,
+      size_t bufsize = k_default_bufsize);
+  ~uring_file_input_stream();
+
+  uring_file_input_stream(const uring_file_input_stream &) = delete;
+  uring_file_input_stream & operator=(
+      const uring_file_input_stream &) = delete;
+
+  /** Whether io_uring is in use, rather than the fallback. */
+  bool using_uring() const;
+
+  bool next_input_buf(const byte **buf, size_t *bytecount) override;
+  void put_back(size_t bytecount) override;
+  std::unique_ptr<err> extract_input_error() override;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_URING_FILE_INPUT_STREAM_HPP_ */
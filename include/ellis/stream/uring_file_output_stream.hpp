@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/uring_file_output_stream.hpp
+ *
+ * @brief Ellis io_uring file output stream C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_URING_FILE_OUTPUT_STREAM_HPP_
+#define ELLIS_STREAM_URING_FILE_OUTPUT_STREAM_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/sync_output_stream.hpp>
+#include <memory>
+#include <vector>
+
+namespace ellis {
+
+
+/* forward declare */
+class fd_output_stream;
+class uring;
+
+/** An output stream to a file that keeps several writes in flight with
+ * io_uring, so that the encoder can fill the next buffer while the last
+ * ones are written.
+ *
+ * Each emitted buffer becomes a write at the next offset in the file, from
+ * one of depth buffers; once the file is long enough for it to pay off, the
+ * buffers are registered with the kernel.  If io_uring is
+ * unavailable, if the file is "-" (standard output), or if depth is 0, it
+ * falls back to fd_output_stream.
+ *
+ * This pays off when the writes are slow enough to be worth overlapping;
+ * where they only reach the page cache, and the kernel hands them to its
+ * worker threads, file_output_stream may well be faster.
+ *
+ * A write that fails is reported by a later call, or by finish(); call
+ * finish() to be sure everything has been written.
+ */
+class uring_file_output_stream : public sync_output_stream {
+  /** A buffer and the write from it. */
+  struct slot {
+    byte *buf;
+    uint64_t off;
+    size_t len;
+    bool in_flight;
+    int32_t res;
+  };
+
+  int m_fd = -1;
+  std::unique_ptr<fd_output_stream> m_fallback;
+  std::unique_ptr<uring> m_ring;
+  std::unique_ptr<byte, void (*)(void *)> m_mem;
+  size_t m_bufsize;
+  std::vector<slot> m_slots;
+  /** The offset of the next write. */
+  uint64_t m_off = 0;
+  /** The slot handed out by next_output_buf(). */
+  size_t m_cur = 0;
+  /** Whether registering the buffers has been tried. */
+  bool m_registered = false;
+  std::unique_ptr<err> m_err;
+
+  void _register();
+  bool _wait(size_t idx);
+
+public:
+  static constexpr size_t k_default_depth = 8;
+  static constexpr size_t k_default_bufsize = 256 * 1024;
+
+  /** Creates or truncates the file; throws IO if it can not be opened. */
+  explicit uring_file_output_stream(
+      const char *filename,
+      size_t depth = k_default_depth,
+      size_t bufsize = k_default_bufsize);
+  /** Waits for any writes still in flight. */
+  ~uring_file_output_stream();
+
+  uring_file_output_stream(const uring_file_output_stream &) = delete;
+  uring_file_output_stream & operator=(
+      const uring_file_output_stream &) = delete;
+
+  /** Whether io_uring is in use, rather than the fallback. */
+  bool using_uring() const;
+
+  /** Waits for all writes so far to complete.  Returns false if any failed
+   * (check extract_output_error() for details). */
+  bool finish();
+
+  bool next_output_buf(byte **buf, size_t *bytecount) override;
+  bool emit(size_t bytecount) override;
+  std::unique_ptr<err> extract_output_error() override;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_URING_FILE_OUTPUT_STREAM_HPP_ */
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis/stream/vector_output_stream.hpp
+ *
+ * @brief Ellis growable memory output stream C++ header.
+ */
+
+#pragma once
+#ifndef ELLIS_STREAM_VECTOR_OUTPUT_STREAM_HPP_
+#define ELLIS_STREAM_VECTOR_OUTPUT_STREAM_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/sync_output_stream.hpp>
+#include <vector>
+
+namespace ellis {
+
+
+/** An output stream into memory that grows as needed, for when the size of
+ * the output is not known in advance.
+ *
+ * The output is built in a std::vector, which doubles in size whenever it
+ * fills up, so that each byte is moved a bounded number of times however
+ * large the output; release() then hands the vector over as it is, without
+ * a final copy.  To avoid allocating at all once warmed up, pass in the
+ * vector from last time, whose storage is reused.
+ */
+class vector_output_stream : public sync_output_stream {
+  std::vector<byte> m_vec;
+  size_t m_pos = 0;
+
+public:
+  static constexpr size_t k_default_size = 256;
+
+  /** Starts with room for size bytes. */
+  explicit vector_output_stream(size_t size = k_default_size);
+
+  /** Writes into vec's storage, discarding what it holds. */
+  explicit vector_output_stream(std::vector<byte> &&vec);
+
+  /** The bytes written so far. */
+  const byte *data() const;
+  size_t size() const;
+
+  /** Hands over the bytes written so far, and starts again, empty. */
+  std::vector<byte> release();
+
+  bool next_output_buf(byte **buf, size_t *bytecount) override;
+  bool emit(size_t bytecount) override;
+  std::unique_ptr<err> extract_output_error() override;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_STREAM_VECTOR_OUTPUT_STREAM_HPP_ */
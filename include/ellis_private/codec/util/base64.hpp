@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis_private/codec/util/base64.hpp
+ *
+ * @brief Base64 (RFC 4648, standard alphabet, padded) for text codecs.
+ */
+
+#pragma once
+#ifndef ELLIS_CODEC_UTIL_BASE64_HPP_
+#define ELLIS_CODEC_UTIL_BASE64_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <cstddef>
+
+namespace ellis {
+
+
+/** Returns the number of characters base64_encode writes for len bytes. */
+inline size_t base64_encoded_len(size_t len)
+{
+  return ((len + 2) / 3) * 4;
+}
+
+/** Returns an upper bound on the bytes base64_decode writes for len chars. */
+inline size_t base64_decoded_max(size_t len)
+{
+  return (len / 4) * 3;
+}
+
+
+/** Writes the padded base64 encoding of src into dst.
+ *
+ * Uses SSSE3 at runtime where the CPU has it, and a table driven loop
+ * otherwise; the output is identical either way.  No NUL terminator is
+ * written.
+ *
+ * @param src the bytes to encode
+ * @param len the number of bytes to encode
+ * @param dst output buffer of at least base64_encoded_len(len) chars
+ *
+ * @return the number of characters written
+ */
+size_t base64_encode(const byte *src, size_t len, char *dst);
+
+/** Decodes padded base64 text into dst.
+ *
+ * The input must be a whole number of 4-character groups from the standard
+ * alphabet, with '=' padding only at the end; whitespace is not skipped.
+ *
+ * @param src the text to decode
+ * @param len the number of characters of text
+ * @param dst output buffer of at least base64_decoded_max(len) bytes
+ * @param outlen set to the number of bytes written, on success
+ *
+ * @return true on success, false if the text is not valid base64
+ */
+bool base64_decode(const char *src, size_t len, byte *dst, size_t *outlen);
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CODEC_UTIL_BASE64_HPP_ */
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis_private/codec/util/element_stream.hpp
+ *
+ * @brief Locating the array whose elements a decoder streams out.
+ */
+
+#pragma once
+#ifndef ELLIS_CODEC_UTIL_ELEMENT_STREAM_HPP_
+#define ELLIS_CODEC_UTIL_ELEMENT_STREAM_HPP_
+
+#include <ellis/core/decoder.hpp>
+#include <string>
+#include <vector>
+
+namespace ellis {
+
+
+/** The path to a streamed array, and where its elements go.
+ *
+ * Decoders number the containers they are building by depth, with the root
+ * at depth 0, and keep track of how many of them, counting from the root,
+ * lie on the path.  The streamed array is the one on the path at depth
+ * steps(); each of its completed elements is handed to deliver() instead of
+ * being added to it.
+ */
+class element_stream {
+  struct step {
+    bool is_key;
+    std::string key;
+    size_t index;
+  };
+  std::vector<step> m_steps;
+  element_fn m_fn;
+  size_t m_count = 0;
+
+public:
+  /** Throws PATH_FAIL if the path (in node::at syntax) is malformed. */
+  element_stream(const std::string &path, element_fn fn);
+
+  /** The depth of the streamed array. */
+  size_t steps() const { return m_steps.size(); }
+
+  /** Whether the entry with key k, in a map on the path at the given depth,
+   * is also on the path. */
+  bool on_path(size_t depth, const std::string &k) const
+  {
+    return depth < m_steps.size()
+      && m_steps[depth].is_key
+      && m_steps[depth].key == k;
+  }
+
+  /** Whether element i, of an array on the path at the given depth, is
+   * also on the path. */
+  bool on_path(size_t depth, size_t i) const
+  {
+    return depth < m_steps.size()
+      && ! m_steps[depth].is_key
+      && m_steps[depth].index == i;
+  }
+
+  /** Hand over the next element of the streamed array. */
+  void deliver(std::unique_ptr<node> n)
+  {
+    m_count++;
+    m_fn(std::move(n));
+  }
+
+  /** Number of elements delivered since the last reset; this is also the
+   * index of the next element. */
+  size_t count() const { return m_count; }
+
+  void reset() { m_count = 0; }
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CODEC_UTIL_ELEMENT_STREAM_HPP_ */
@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis_private/codec/util/msgpack_format.hpp
+ *
+ * @brief Msgpack wire format constants and helpers, shared by the msgpack
+ * codec and msgpack_view.
+ */
+
+#pragma once
+#ifndef ELLIS_PRIVATE_CODEC_UTIL_MSGPACK_FORMAT_HPP_
+#define ELLIS_PRIVATE_CODEC_UTIL_MSGPACK_FORMAT_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/system.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+/* We do this instead of an if statement or a range map for performance. */
+#define HEX_POS_FIXINT \
+       0x00: case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: \
+  case 0x07: case 0x08: case 0x09: case 0x0a: case 0x0b: case 0x0c: case 0x0d: \
+  case 0x0e: case 0x0f: case 0x10: case 0x11: case 0x12: case 0x13: case 0x14: \
+  case 0x15: case 0x16: case 0x17: case 0x18: case 0x19: case 0x1a: case 0x1b: \
+  case 0x1c: case 0x1d: case 0x1e: case 0x1f: case 0x20: case 0x21: case 0x22: \
+  case 0x23: case 0x24: case 0x25: case 0x26: case 0x27: case 0x28: case 0x29: \
+  case 0x2a: case 0x2b: case 0x2c: case 0x2d: case 0x2e: case 0x2f: case 0x30: \
+  case 0x31: case 0x32: case 0x33: case 0x34: case 0x35: case 0x36: case 0x37: \
+  case 0x38: case 0x39: case 0x3a: case 0x3b: case 0x3c: case 0x3d: case 0x3e: \
+  case 0x3f: case 0x40: case 0x41: case 0x42: case 0x43: case 0x44: case 0x45: \
+  case 0x46: case 0x47: case 0x48: case 0x49: case 0x4a: case 0x4b: case 0x4c: \
+  case 0x4d: case 0x4e: case 0x4f: case 0x50: case 0x51: case 0x52: case 0x53: \
+  case 0x54: case 0x55: case 0x56: case 0x57: case 0x58: case 0x59: case 0x5a: \
+  case 0x5b: case 0x5c: case 0x5d: case 0x5e: case 0x5f: case 0x60: case 0x61: \
+  case 0x62: case 0x63: case 0x64: case 0x65: case 0x66: case 0x67: case 0x68: \
+  case 0x69: case 0x6a: case 0x6b: case 0x6c: case 0x6d: case 0x6e: case 0x6f: \
+  case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x76: \
+  case 0x77: case 0x78: case 0x79: case 0x7a: case 0x7b: case 0x7c: case 0x7d: \
+  case 0x7e: case 0x7f
+
+#define HEX_FIXMAP \
+       0x80: case 0x81: case 0x82: case 0x83: case 0x84: case 0x85: case 0x86: \
+  case 0x87: case 0x88: case 0x89: case 0x8a: case 0x8b: case 0x8c: case 0x8d: \
+  case 0x8e: case 0x8f
+
+#define HEX_FIXARRAY \
+       0x90: case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: \
+  case 0x97: case 0x98: case 0x99: case 0x9a: case 0x9b: case 0x9c: case 0x9d: \
+  case 0x9e: case 0x9f
+
+#define HEX_FIXSTR \
+       0xa0: case 0xa1: case 0xa2: case 0xa3: case 0xa4: case 0xa5: case 0xa6: \
+  case 0xa7: case 0xa8: case 0xa9: case 0xaa: case 0xab: case 0xac: case 0xad: \
+  case 0xae: case 0xaf: case 0xb0: case 0xb1: case 0xb2: case 0xb3: case 0xb4: \
+  case 0xb5: case 0xb6: case 0xb7: case 0xb8: case 0xb9: case 0xba: case 0xbb: \
+  case 0xbc: case 0xbd: case 0xbe: case 0xbf
+
+#define HEX_NEG_FIXINT \
+       0xe0: case 0xe1: case 0xe2: case 0xe3: case 0xe4: case 0xe5: case 0xe6: \
+  case 0xe7: case 0xe8: case 0xe9: case 0xea: case 0xeb: case 0xec: case 0xed: \
+  case 0xee: case 0xef: case 0xf0: case 0xf1: case 0xf2: case 0xf3: case 0xf4: \
+  case 0xf5: case 0xf6: case 0xf7: case 0xf8: case 0xf9: case 0xfa: case 0xfb: \
+  case 0xfc: case 0xfd: case 0xfe: case 0xff
+
+#define HEX_NIL 0xc0
+#define HEX_UNUSED 0xc1
+#define HEX_FALSE 0xc2
+#define HEX_TRUE 0xc3
+#define HEX_BIN8 0xc4
+#define HEX_BIN16 0xc5
+#define HEX_BIN32 0xc6
+#define HEX_EXT 0xc7: case 0xc8: case 0xc9
+#define HEX_FLOAT32 0xca
+#define HEX_FLOAT64 0xcb
+#define HEX_UINT8 0xcc
+#define HEX_UINT16 0xcd
+#define HEX_UINT32 0xce
+#define HEX_UINT64 0xcf
+#define HEX_INT8 0xd0
+#define HEX_INT16 0xd1
+#define HEX_INT32 0xd2
+#define HEX_INT64 0xd3
+#define HEX_FIXEXT 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8
+#define HEX_STR8 0xd9
+#define HEX_STR16 0xda
+#define HEX_STR32 0xdb
+#define HEX_ARRAY16 0xdc
+#define HEX_ARRAY32 0xdd
+#define HEX_MAP16 0xde
+#define HEX_MAP32 0xdf
+
+namespace ellis {
+
+
+/** The kinds of value in the msgpack format that ellis handles. */
+enum class msgpack_type {
+  NIL,
+  FALSE,
+  TRUE,
+  POS_FIXINT,
+  NEG_FIXINT,
+  FIXMAP,
+  FIXARRAY,
+  FIXSTR,
+  BIN8,
+  BIN16,
+  BIN32,
+  /* ext not supported */
+  FLOAT32,
+  FLOAT64,
+  UINT8,
+  UINT16,
+  UINT32,
+  /* uint64 not supported */
+  INT8,
+  INT16,
+  INT32,
+  INT64,
+  /* fixext not supported */
+  STR8,
+  STR16,
+  STR32,
+  ARRAY16,
+  ARRAY32,
+  MAP16,
+  MAP32
+};
+
+
+/** Classifies a type byte; throws for types that ellis does not support. */
+inline msgpack_type get_msgpack_type(byte b)
+{
+  switch (b) {
+    case HEX_POS_FIXINT:
+      return msgpack_type::POS_FIXINT;
+
+    case HEX_FIXMAP:
+      return msgpack_type::FIXMAP;
+
+    case HEX_FIXARRAY:
+      return msgpack_type::FIXARRAY;
+
+    case HEX_FIXSTR:
+      return msgpack_type::FIXSTR;
+
+    case HEX_NIL:
+      return msgpack_type::NIL;
+
+    case HEX_UNUSED:
+      THROW_ELLIS_ERR(PARSE_FAIL,
+          "type byte is 0xc1, which can't be used");
+
+    case HEX_FALSE:
+      return msgpack_type::FALSE;
+
+    case HEX_TRUE:
+      return msgpack_type::TRUE;
+
+    case HEX_BIN8:
+      return msgpack_type::BIN8;
+
+    case HEX_BIN16:
+      return msgpack_type::BIN16;
+
+    case HEX_BIN32:
+      return msgpack_type::BIN32;
+
+    case HEX_EXT:
+      THROW_ELLIS_ERR(TRANSLATE_FAIL,
+          "type byte corresponds to an ext type, which is unsupported");
+
+    case HEX_FLOAT32:
+      return msgpack_type::FLOAT32;
+
+    case HEX_FLOAT64:
+      return msgpack_type::FLOAT64;
+
+    case HEX_UINT8:
+      return msgpack_type::UINT8;
+
+    case HEX_UINT16:
+      return msgpack_type::UINT16;
+
+    case HEX_UINT32:
+      return msgpack_type::UINT32;
+
+    case HEX_UINT64:
+      THROW_ELLIS_ERR(TRANSLATE_FAIL,
+          "type byte corresponds to a uint64, which is unsupported");
+
+    case HEX_INT8:
+      return msgpack_type::INT8;
+
+    case HEX_INT16:
+      return msgpack_type::INT16;
+
+    case HEX_INT32:
+      return msgpack_type::INT32;
+
+    case HEX_INT64:
+      return msgpack_type::INT64;
+
+    case HEX_FIXEXT:
+      THROW_ELLIS_ERR(TRANSLATE_FAIL,
+          "type byte maps fixext, which is unsupported");
+
+    case HEX_STR8:
+      return msgpack_type::STR8;
+
+    case HEX_STR16:
+      return msgpack_type::STR16;
+
+    case HEX_STR32:
+      return msgpack_type::STR32;
+
+    case HEX_ARRAY16:
+      return msgpack_type::ARRAY16;
+
+    case HEX_ARRAY32:
+      return msgpack_type::ARRAY32;
+
+    case HEX_MAP16:
+      return msgpack_type::MAP16;
+
+    case HEX_MAP32:
+      return msgpack_type::MAP32;
+
+    case HEX_NEG_FIXINT:
+      return msgpack_type::NEG_FIXINT;
+    default:
+      ELLIS_ASSERT_UNREACHABLE();
+  }
+}
+
+
+/** Reads a big-endian unsigned integer. */
+template <typename T>
+inline T load_be(const byte *p)
+{
+  T val = 0;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    val = (val << 8) | p[i];
+  }
+  return val;
+}
+
+
+inline bool type_is_string(msgpack_type type)
+{
+  switch (type) {
+    case msgpack_type::FIXSTR:
+    case msgpack_type::STR8:
+    case msgpack_type::STR16:
+    case msgpack_type::STR32:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+/** Returns the length of the type byte plus length field of a value. */
+inline size_t header_len(msgpack_type type)
+{
+  switch (type) {
+    case msgpack_type::STR8:
+    case msgpack_type::BIN8:
+      return 1 + sizeof(uint8_t);
+    case msgpack_type::STR16:
+    case msgpack_type::BIN16:
+    case msgpack_type::ARRAY16:
+    case msgpack_type::MAP16:
+      return 1 + sizeof(uint16_t);
+    case msgpack_type::STR32:
+    case msgpack_type::BIN32:
+    case msgpack_type::ARRAY32:
+    case msgpack_type::MAP32:
+      return 1 + sizeof(uint32_t);
+    default:
+      return 1;
+  }
+}
+
+
+/** Returns the number of bytes following the header of a value.
+ *
+ * Containers have no payload of their own; their elements are values in
+ * their own right.
+ */
+inline uint64_t payload_len(msgpack_type type, const byte *p)
+{
+  switch (type) {
+    case msgpack_type::FIXSTR:
+      return p[0] & 0x1f;
+    case msgpack_type::STR8:
+    case msgpack_type::BIN8:
+      return p[1];
+    case msgpack_type::STR16:
+    case msgpack_type::BIN16:
+      return load_be<uint16_t>(p + 1);
+    case msgpack_type::STR32:
+    case msgpack_type::BIN32:
+      return load_be<uint32_t>(p + 1);
+    case msgpack_type::UINT8:
+    case msgpack_type::INT8:
+      return sizeof(uint8_t);
+    case msgpack_type::UINT16:
+    case msgpack_type::INT16:
+      return sizeof(uint16_t);
+    case msgpack_type::FLOAT32:
+    case msgpack_type::UINT32:
+    case msgpack_type::INT32:
+      return sizeof(uint32_t);
+    case msgpack_type::FLOAT64:
+    case msgpack_type::INT64:
+      return sizeof(uint64_t);
+    default:
+      return 0;
+  }
+}
+
+
+/** Returns the number of elements (or entries, for a map) of a container. */
+inline uint64_t element_count(msgpack_type type, const byte *p)
+{
+  switch (type) {
+    case msgpack_type::FIXARRAY:
+    case msgpack_type::FIXMAP:
+      return p[0] & 0x0f;
+    case msgpack_type::ARRAY16:
+    case msgpack_type::MAP16:
+      return load_be<uint16_t>(p + 1);
+    case msgpack_type::ARRAY32:
+    case msgpack_type::MAP32:
+      return load_be<uint32_t>(p + 1);
+    default:
+      return 0;
+  }
+}
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_PRIVATE_CODEC_UTIL_MSGPACK_FORMAT_HPP_ */
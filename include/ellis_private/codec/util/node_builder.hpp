@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * @file ellis_private/codec/util/node_builder.hpp
+ *
+ * @brief Building decoded values in the storage of the ones they replace.
+ */
+
+#pragma once
+#ifndef ELLIS_CODEC_UTIL_NODE_BUILDER_HPP_
+#define ELLIS_CODEC_UTIL_NODE_BUILDER_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/node.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ellis {
+
+
+/** Builds the values a decoder produces, reusing the storage of an old
+ * value where the new one has the same shape.
+ *
+ * The decoder hands each value it starts the node that value replaces (for
+ * the root, the caller's previous result; below that, what element() and
+ * entry() return), or nil if there is none.  Strings, binaries, arrays and
+ * maps are then built into the old node when it has the same type, keeping
+ * its allocated capacity; map entries with the same keys keep their nodes.
+ * Decoding a stream of same-shaped messages into the same node thus settles
+ * down to no heap allocation beyond the decoder's own.
+ *
+ * Containers are started with begin_array() or begin_map() and finished
+ * with end_array() or end_map(), and must nest; element()/append() and
+ * entry()/insert() work on the innermost one.  With no old value, the
+ * result is exactly what building from scratch would give: elements are
+ * appended, and entries inserted with the first of repeated keys winning.
+ * Shared contents are copied on write as usual, so other copies of the old
+ * value are never changed.
+ */
+class node_builder {
+  struct frame {
+    /** Arrays: elements added so far.  Maps: old entries reused so far. */
+    size_t count;
+    /** Length of the old container, whose contents may still be reused. */
+    size_t old_len;
+    /** Maps: start of this map's entries in m_pending. */
+    size_t base;
+    /** Maps: where the value for the current key goes; nullptr to drop it,
+     * when the key is a repeat. */
+    node *slot;
+  };
+  std::vector<frame> m_frames;
+  /** Values of reused map entries, held back until the map is done, so
+   * that entries taken so far can be told apart by being nil. */
+  std::vector<std::pair<node *, node>> m_pending;
+
+public:
+  /** A string holding len bytes at s. */
+  static node make_string(node &&old, const char *s, size_t len);
+
+  /** A binary holding a copy of len bytes at data. */
+  static node make_binary(node &&old, const byte *data, size_t len);
+
+  /** Start an array. */
+  node begin_array(node &&old);
+
+  /** The old value of the next element of arr, if any. */
+  node element(node &arr);
+
+  /** Add the next element to arr. */
+  void append(node &arr, node &&val);
+
+  /** Finish arr, dropping any old elements beyond the new ones. */
+  void end_array(node &arr);
+
+  /** Start a map. */
+  node begin_map(node &&old);
+
+  /** The old value for key in map, if any; call before building the value,
+   * and follow with insert() if the value is to be kept. */
+  node entry(node &map, const std::string &key);
+
+  /** Add the value for key, as last looked up with entry(). */
+  void insert(node &map, const std::string &key, node &&val);
+
+  /** Finish map, dropping any old entries whose keys did not come up. */
+  void end_map(node &map);
+
+  /** Abandon any values under construction. */
+  void reset();
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CODEC_UTIL_NODE_BUILDER_HPP_ */
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * @file ellis_private/codec/util/num_format.hpp
+ *
+ * @brief Locale-free number to text formatting for text codecs.
+ */
+
+#pragma once
+#ifndef ELLIS_CODEC_UTIL_NUM_FORMAT_HPP_
+#define ELLIS_CODEC_UTIL_NUM_FORMAT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ellis {
+
+
+/** Buffer size sufficient for any output of format_int64. */
+constexpr size_t k_int64_fmt_max = 24;
+
+/** Buffer size sufficient for any output of format_double. */
+constexpr size_t k_double_fmt_max = 32;
+
+
+/** Writes the decimal representation of an int64 into buf.
+ *
+ * No NUL terminator is written.
+ *
+ * @param val the value to format
+ * @param buf output buffer of at least k_int64_fmt_max bytes
+ *
+ * @return the number of characters written
+ */
+size_t format_int64(int64_t val, char *buf);
+
+/** Writes the shortest text that reads back as exactly the given double.
+ *
+ * Digits are generated with Grisu2, so the output always round trips through
+ * strtod and is the shortest such representation in all but a tiny fraction
+ * of cases.  The text always contains either a decimal point or an
+ * exponent (e.g. "3.0", "0.001", "2.5e15", "1e-9"), so that decoders can
+ * distinguish it from an integer.  No NUL terminator is written.
+ *
+ * The value must be finite; NaN and infinities have no textual
+ * representation here, and the caller must handle them.
+ *
+ * @param val the finite value to format
+ * @param buf output buffer of at least k_double_fmt_max bytes
+ *
+ * @return the number of characters written
+ */
+size_t format_double(double val, char *buf);
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CODEC_UTIL_NUM_FORMAT_HPP_ */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis_private/codec/util/projection.hpp
+ *
+ * @brief Sets of node paths that decoders use to prune what they build.
+ */
+
+#pragma once
+#ifndef ELLIS_CODEC_UTIL_PROJECTION_HPP_
+#define ELLIS_CODEC_UTIL_PROJECTION_HPP_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ellis {
+
+
+/** A tree of the map keys and array indices leading to the selected paths.
+ *
+ * Decoders hold a pointer to the projection for each value they are working
+ * on, and look up each child as they get to it: a null result means the
+ * child is not wanted and can be skipped.  A selected path takes in the whole
+ * subtree below it, in which case every lookup returns the same projection.
+ */
+class projection {
+  bool m_all = false;
+  std::unordered_map<std::string, std::unique_ptr<projection>> m_keys;
+  std::map<size_t, std::unique_ptr<projection>> m_indices;
+
+  void _add(const std::string &path);
+
+public:
+  /** Select nothing. */
+  projection();
+
+  /** Select the given paths, in the syntax of node::at.
+   *
+   * Throws PATH_FAIL if a path is malformed.
+   */
+  explicit projection(const std::vector<std::string> &paths);
+
+  projection(const projection &) = delete;
+  projection & operator=(const projection &) = delete;
+
+  /** Return the projection selecting everything. */
+  static const projection * all();
+
+  /** Return the projection for the given map key, or nullptr to skip it. */
+  const projection * key(const std::string &k) const;
+
+  /** Return the projection for the given array index, or nullptr to skip
+   * it. */
+  const projection * index(size_t i) const;
+
+  /** Return true if no index at or after i is selected.
+   *
+   * Skipped array elements are kept as nulls, so that the indices of the
+   * selected ones are unchanged; past the last selected one they can be
+   * dropped instead. */
+  bool none_from(size_t i) const;
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_CODEC_UTIL_PROJECTION_HPP_ */
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * @file ellis_private/core/parse_path.hpp
+ *
+ * @brief Parsing of node paths such as {key}[3]{other}.
+ *
+ * Shared by node::at/install and by codecs that evaluate paths without
+ * building nodes.
+ */
+
+#pragma once
+#ifndef ELLIS_PRIVATE_CORE_PARSE_PATH_HPP_
+#define ELLIS_PRIVATE_CORE_PARSE_PATH_HPP_
+
+#include <functional>
+#include <string>
+
+namespace ellis {
+
+
+/** Called for each {key} selector, with the position of its closing brace. */
+using map_selector_cb = std::function<void(
+    const std::string & pattern,
+    size_t path_position)>;
+
+
+/** Called for each [index] selector, with the position of its closing
+ * bracket.  Currently start and stop are always equal. */
+using array_selector_cb = std::function<void(
+    size_t start,
+    size_t stop,
+    size_t path_position)>;
+
+
+/** Parse path, invoking the given callbacks on each selector in order.
+ *
+ * Throws PATH_FAIL on syntax errors.
+ */
+void parse_path(
+    const std::string & path,
+    const map_selector_cb & got_map_selector,
+    const array_selector_cb & got_array_selector);
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_PRIVATE_CORE_PARSE_PATH_HPP_ */
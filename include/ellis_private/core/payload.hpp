@@ -34,6 +34,7 @@
 #define ELLIS_PRIVATE_CORE_PAYLOAD_HPP_
 
 #include <ellis/core/node.hpp>
+#include <memory>
 #include <stdint.h>
 #include <string>
 #include <unordered_map>
@@ -48,6 +49,13 @@ namespace payload_types {
   using bin_t = std::vector<byte>;
   using str_t = std::string;
   using refcount_t = unsigned;
+
+  /** Binary data that lives in someone else's buffer, kept alive by owner. */
+  struct slice_t {
+    std::shared_ptr<const void> owner;
+    const byte *data;
+    size_t len;
+  };
 }
 
 
@@ -55,11 +63,14 @@ namespace payload_types {
 struct payload {
  /** The refcount for the underlying container. */
   payload_types::refcount_t m_refcount;
+  /** For BINARY, whether m_slice rather than m_bin holds the data. */
+  bool m_is_slice;
   union {
     payload_types::arr_t m_arr;
     payload_types::map_t m_map;
     payload_types::bin_t m_bin;
     payload_types::str_t m_str;
+    payload_types::slice_t m_slice;
   };
 };
 
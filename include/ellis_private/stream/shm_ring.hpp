@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis_private/stream/shm_ring.hpp
+ *
+ * @brief A single-producer, single-consumer byte ring in shared memory.
+ */
+
+#pragma once
+#ifndef ELLIS_PRIVATE_STREAM_SHM_RING_HPP_
+#define ELLIS_PRIVATE_STREAM_SHM_RING_HPP_
+
+#include <atomic>
+#include <ellis/core/defs.hpp>
+#include <ellis/stream/shm_output_stream.hpp>
+#include <memory>
+#include <sched.h>
+#include <stdint.h>
+
+namespace ellis {
+
+
+/** The shared part of the ring, at the start of the shared memory object,
+ * followed by the data one page in.
+ *
+ * head and tail count bytes written and read since the start; each is
+ * written only by its own side.  The seq words are futexes, bumped
+ * whenever head or tail moves, for the other side to sleep on while its
+ * waiting flag is set.  The producer's and consumer's words are on
+ * separate cache lines, so that they do not bounce between cores.
+ */
+struct shm_ring_header {
+  std::atomic<uint64_t> magic;
+  uint64_t capacity;
+
+  alignas(64) std::atomic<uint64_t> head;
+  std::atomic<uint32_t> head_seq;
+  std::atomic<uint32_t> writer_closed;
+  std::atomic<uint32_t> reader_waiting;
+
+  alignas(64) std::atomic<uint64_t> tail;
+  std::atomic<uint32_t> tail_seq;
+  std::atomic<uint32_t> reader_closed;
+  std::atomic<uint32_t> writer_waiting;
+};
+
+
+/** A mapping of the ring.
+ *
+ * The data is mapped twice, back to back, so that any run of bytes in the
+ * ring can be handed out as one buffer, even where it wraps around.
+ */
+class shm_ring {
+  shm_ring_header *m_hdr = nullptr;
+  byte *m_data = nullptr;
+  uint64_t m_capacity = 0;
+  shm_wait m_wait;
+  /** How many times to check before yielding or sleeping. */
+  unsigned m_spins;
+
+  void _map(int fd, uint64_t capacity);
+
+public:
+  static constexpr uint64_t k_magic = 0x676e6972736c6c65ULL;  /* "ellsring" */
+  /** How many times to check before yielding or sleeping, when there is
+   * another core for the other side to be running on: a few microseconds,
+   * about what a futex round trip costs. */
+  static constexpr unsigned k_spins = 128;
+
+  /** Creates (or replaces) the named ring, of at least capacity bytes.
+   * Throws IO on failure. */
+  static std::unique_ptr<shm_ring> create(
+      const char *name,
+      uint64_t capacity,
+      shm_wait wait);
+
+  /** Maps an existing ring.  Throws IO if there is none. */
+  static std::unique_ptr<shm_ring> open(const char *name, shm_wait wait);
+
+  explicit shm_ring(shm_wait wait);
+  ~shm_ring();
+
+  shm_ring(const shm_ring &) = delete;
+  shm_ring & operator=(const shm_ring &) = delete;
+
+  shm_ring_header *hdr() const { return m_hdr; }
+  byte *data() const { return m_data; }
+  uint64_t capacity() const { return m_capacity; }
+
+  /** The most either side takes at once: a quarter of the ring, so that
+   * the writer can fill one part while the reader works through another,
+   * and neither waits for the other to finish a whole ring's worth. */
+  uint64_t chunk() const { return m_capacity / 4; }
+
+  /** Waits for ready() to return true, or for closed to be set; returns
+   * whatever ready() last returned.  Spins, and then in FUTEX mode sleeps
+   * on seq with the waiting flag set, to be woken by notify(). */
+  template <typename READY>
+  bool wait(
+      READY ready,
+      std::atomic<uint32_t> &seq,
+      std::atomic<uint32_t> &waiting,
+      const std::atomic<uint32_t> &closed);
+
+  /** Bumps seq, and wakes the other side if it is asleep on it.  Clears
+   * the waiting flag, so that it is woken once, not for every notify()
+   * until it gets to run. */
+  static void notify(
+      std::atomic<uint32_t> &seq,
+      std::atomic<uint32_t> &waiting);
+
+  static void futex_wait(std::atomic<uint32_t> &word, uint32_t val);
+  static void futex_wake(std::atomic<uint32_t> &word);
+  static void relax();
+};
+
+
+template <typename READY>
+bool shm_ring::wait(
+    READY ready,
+    std::atomic<uint32_t> &seq,
+    std::atomic<uint32_t> &waiting,
+    const std::atomic<uint32_t> &closed)
+{
+  /* Spin a while first, as the other side is usually just about to catch
+   * up.  In SPIN mode, carry on, but yield now and then in case the other
+   * side shares the core. */
+  for (unsigned i = 1; ; i++) {
+    if (ready()) {
+      return true;
+    }
+    if (closed.load(std::memory_order_acquire)) {
+      return ready();
+    }
+    if (i % m_spins != 0) {
+      relax();
+    }
+    else if (m_wait == shm_wait::SPIN) {
+      sched_yield();
+    }
+    else {
+      break;
+    }
+  }
+  while (1) {
+    const uint32_t s = seq.load(std::memory_order_seq_cst);
+    waiting.store(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    /* Check again, now that notify() will see the flag. */
+    if (ready() || closed.load(std::memory_order_acquire)) {
+      waiting.store(0, std::memory_order_relaxed);
+      return ready();
+    }
+    futex_wait(seq, s);
+    waiting.store(0, std::memory_order_relaxed);
+  }
+}
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_PRIVATE_STREAM_SHM_RING_HPP_ */
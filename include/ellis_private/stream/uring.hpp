@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/*
+ * @file ellis_private/stream/uring.hpp
+ *
+ * @brief A minimal io_uring submission/completion ring.
+ */
+
+#pragma once
+#ifndef ELLIS_PRIVATE_STREAM_URING_HPP_
+#define ELLIS_PRIVATE_STREAM_URING_HPP_
+
+#include <ellis/core/defs.hpp>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+namespace ellis {
+
+
+/** Just enough of io_uring, over the raw system calls, for the uring file
+ * streams: one ring, reads and writes at given offsets, optionally from
+ * registered buffers, and waiting for their completions.
+ *
+ * Not thread safe; each stream has its own.
+ */
+class uring {
+  int m_fd = -1;
+
+  void *m_sq_ring = nullptr;
+  size_t m_sq_ring_len = 0;
+  void *m_cq_ring = nullptr;
+  size_t m_cq_ring_len = 0;
+  io_uring_sqe *m_sqes = nullptr;
+  size_t m_sqes_len = 0;
+
+  unsigned *m_sq_head = nullptr;
+  unsigned *m_sq_tail = nullptr;
+  unsigned m_sq_mask = 0;
+  unsigned m_sq_entries = 0;
+  unsigned *m_sq_array = nullptr;
+  unsigned *m_cq_head = nullptr;
+  unsigned *m_cq_tail = nullptr;
+  unsigned m_cq_mask = 0;
+  io_uring_cqe *m_cqes = nullptr;
+
+  /** Entries queued since the last io_uring_enter(). */
+  unsigned m_to_submit = 0;
+  bool m_fixed = false;
+
+  io_uring_sqe * _get_sqe();
+  bool _enter(unsigned min_complete);
+
+public:
+  /** Registering buffers pins them all up front, which only pays off over
+   * pinning pages for each operation once each buffer has been used about
+   * this many times. */
+  static constexpr uint64_t k_register_min_reuse = 4;
+
+  uring() = default;
+  ~uring();
+
+  uring(const uring &) = delete;
+  uring & operator=(const uring &) = delete;
+
+  /** Sets up a ring for up to entries operations in flight.  Returns false,
+   * with errno set, if io_uring is not available (e.g. an old kernel, or
+   * one that forbids it). */
+  bool init(unsigned entries);
+
+  /** Registers buffers for read_fixed and write_fixed.  Returns false if
+   * that is not allowed (e.g. past RLIMIT_MEMLOCK); plain reads and writes
+   * still work. */
+  bool register_buffers(const struct iovec *iov, unsigned count);
+
+  /** Whether buffers have been registered. */
+  bool fixed() const { return m_fixed; }
+
+  /** Queue a read of len bytes at offset off of fd into buf, which must be
+   * registered buffer buf_index if fixed().  tag comes back with the
+   * completion.  Returns false if the ring is full. */
+  bool read(int fd, byte *buf, size_t len, uint64_t off, unsigned buf_index,
+      uint64_t tag);
+
+  /** As read(), but writing len bytes from buf. */
+  bool write(int fd, const byte *buf, size_t len, uint64_t off,
+      unsigned buf_index, uint64_t tag);
+
+  /** Submit what has been queued, without waiting.  Returns false, with
+   * errno set, on failure. */
+  bool submit();
+
+  /** Submit what has been queued, and wait for a completion, filling in
+   * its tag and result (a byte count, or a negated errno).  Returns false,
+   * with errno set, on failure. */
+  bool wait(uint64_t *tag, int32_t *res);
+};
+
+
+}  /* namespace ellis */
+
+#endif  /* ELLIS_PRIVATE_STREAM_URING_HPP_ */
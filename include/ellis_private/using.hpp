@@ -38,6 +38,7 @@
 #include <array>
 #include <condition_variable>
 #include <deque>
+#include <functional>
 #include <initializer_list>
 #include <list>
 #include <map>
@@ -34,7 +34,8 @@
 namespace ellis {
 
 
-static class dummy_init {
+namespace {
+class dummy_init {
 public:
   dummy_init()
   {
@@ -49,6 +50,7 @@ public:
             new ellis::delimited_text_encoder()); }));
   }
 } unused_dummy_init;
+}  /* namespace */
 
 
 void delimited_text_decoder::_clear_ss() {
@@ -31,17 +31,27 @@
 #include <ellis/core/map_node.hpp>
 #include <ellis/core/system.hpp>
 #include <ellis/core/u8str_node.hpp>
+#include <ellis_private/codec/util/base64.hpp>
+#include <ellis_private/codec/util/element_stream.hpp>
+#include <ellis_private/codec/util/node_builder.hpp>
+#include <ellis_private/codec/util/num_format.hpp>
+#include <ellis_private/codec/util/projection.hpp>
 #include <ellis_private/using.hpp>
+#include <algorithm>
 #include <array>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <cstring>
 #include <numeric>
 
-// TODO: support binary blobs
-
 
 namespace ellis {
 
 
-static class dummy_init {
+namespace {
+class dummy_init {
 public:
   dummy_init()
   {
@@ -54,6 +64,7 @@ public:
           [](){ return unique_ptr<encoder>(new ellis::json_encoder()); }));
   }
 } unused_dummy_init;
+}  /* namespace */
 
 
 using std::array;
@@ -91,6 +102,131 @@ static inline char hex_digit(int i)
   return k_hexdigits[i];
 }
 
+/** Escapes needed inside JSON strings, indexed by byte value.
+ *
+ * Zero means the byte is copied as is; 'u' means a \u00XX escape; anything
+ * else is the character to put after the backslash.
+ */
+static const char k_json_escapes[256] = {
+  'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',   /* 0x00 */
+  'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',   /* 0x08 */
+  'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',   /* 0x10 */
+  'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',   /* 0x18 */
+  0, 0, '"', 0, 0, 0, 0, 0,                 /* 0x20 */
+  0, 0, 0, 0, 0, 0, 0, '/',                 /* 0x28 */
+  0, 0, 0, 0, 0, 0, 0, 0,                   /* 0x30 */
+  0, 0, 0, 0, 0, 0, 0, 0,                   /* 0x38 */
+  0, 0, 0, 0, 0, 0, 0, 0,                   /* 0x40 */
+  0, 0, 0, 0, 0, 0, 0, 0,                   /* 0x48 */
+  0, 0, 0, 0, 0, 0, 0, 0,                   /* 0x50 */
+  0, 0, 0, 0, '\\', 0, 0, 0,                /* 0x58 */
+};
+
+/** Returns the index of the first byte of s that needs escaping in a JSON
+ * string, or len if there is none.
+ *
+ * Checks 16 bytes at a time where SSE2 is available, which lets typical
+ * text (long runs of plain characters) be copied out in bulk.
+ */
+static inline size_t find_json_escape(const char *s, size_t len)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i ctrl_max = _mm_set1_epi8(0x1f);
+  for (; i + 16 <= len; i += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    /* Unsigned v <= 0x1f iff max(v, 0x1f) == 0x1f. */
+    const __m128i ctrl = _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl_max), ctrl_max);
+    const __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+        _mm_or_si128(_mm_cmpeq_epi8(v, slash), ctrl));
+    const int mask = _mm_movemask_epi8(hits);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; i < len; i++) {
+    if (k_json_escapes[(unsigned char)s[i]]) {
+      return i;
+    }
+  }
+  return len;
+}
+
+/** Returns the index of the first quote or backslash in s, or len if there
+ * is none; i.e. the length of the run the decoder can copy into a string
+ * token as is. */
+static inline size_t find_json_string_special(const char *s, size_t len)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  for (; i + 16 <= len; i += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    const int mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; i < len; i++) {
+    if (s[i] == '"' || s[i] == '\\') {
+      return i;
+    }
+  }
+  return len;
+}
+
+/** Returns the index of the first quote, bracket, brace or slash in s, or
+ * len if there is none; i.e. how far the decoder can pass over the inside
+ * of a skipped array or map without anything changing. */
+static inline size_t find_json_nesting_special(const char *s, size_t len)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i lower = _mm_set1_epi8(0x20);
+  const __m128i lcurly = _mm_set1_epi8('{');
+  const __m128i rcurly = _mm_set1_epi8('}');
+  for (; i + 16 <= len; i += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    /* Setting 0x20 maps '[' onto '{' and ']' onto '}'. */
+    const __m128i vl = _mm_or_si128(v, lower);
+    const int mask = _mm_movemask_epi8(_mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(vl, lcurly), _mm_cmpeq_epi8(vl, rcurly)),
+          _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash))));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; i < len; i++) {
+    switch (s[i]) {
+      case '"': case '/': case '[': case ']': case '{': case '}':
+        return i;
+    }
+  }
+  return len;
+}
+
+/** Marks a JSON string as a base64 encoded binary blob.
+ *
+ * It only counts when written literally at the start of the string; the
+ * encoder escapes every '/' in ordinary strings, so a text value that happens
+ * to begin with these characters comes out as "\/ELLIS_BINARY\/..." and is
+ * read back as text.  So is a string with the prefix whose remainder is not
+ * valid base64, since other producers may write one.
+ */
+static const char k_json_binary_prefix[] = "/ELLIS_BINARY/";
+static const int k_json_binary_prefix_len = sizeof(k_json_binary_prefix) - 1;
+
 static void uni_cp_to_u8(
     int cp,
     std::ostream &os)
@@ -162,6 +298,12 @@ static void uni_cp_to_u8(
   TOKSTAT(COMMENTSLASH2) /* Have first slash; waiting for second. */           \
   TOKSTAT(COMMENT)       /* In a // comment; waiting for newline. */           \
   TOKSTAT(BAREWORD)      /* Inside a bare word, might be true/false/null. */   \
+  TOKSTAT(SKIP)          /* Passing over a value outside the projection. */    \
+  TOKSTAT(SKIP_STR)      /* Passing over a string within a skipped value. */   \
+  TOKSTAT(SKIP_ESC)      /* Just got a backslash in a skipped string. */       \
+  TOKSTAT(SKIP_SCALAR)   /* Passing over a skipped number or bare word. */     \
+  TOKSTAT(SKIP_SLASH2)   /* Have first comment slash in a skipped value. */    \
+  TOKSTAT(SKIP_COMMENT)  /* In a // comment within a skipped value. */         \
   TOKSTAT(END)           /* Parser said done; accept no more until reset. */   \
   TOKSTAT(ERROR)         /* Encountered error; accept no more until reset. */  \
   /* End of ELLIS_JSON_TOK_STATE_ENTRIES */
@@ -214,6 +356,7 @@ static inline const char * enum_name(json_tok_state x)
   JSONTOK(TRUE) \
   JSONTOK(FALSE) \
   JSONTOK(NIL) \
+  JSONTOK(SKIPPED) \
   JSONTOK(EOS) \
   JSONTOK(ERROR) \
   /* End of ELLIS_JSON_TOK_ENTRIES */
@@ -303,8 +446,30 @@ struct json_parser_state {
   vector<string> m_keys;
   json_tok m_thistok;
   const char * m_thistokstr;
-
-  json_parser_state() {
+  /** Decoded contents if the current string token is a binary blob. */
+  const vector<byte> * m_thistokbin;
+  /** Projection for each entry of m_nodes; nullptr marks a skipped value. */
+  vector<const projection *> m_projs;
+  /** Projection for the next value to be pushed onto m_nodes. */
+  const projection * m_next_proj;
+  /** Projection for the whole document. */
+  const projection * m_root_proj;
+  /** Where to send elements of the streamed array, if any. */
+  element_stream * m_stream = nullptr;
+  /** How many entries of m_nodes, from the bottom, are on the path to the
+   * streamed array. */
+  size_t m_onpath;
+  node_builder m_build;
+  /** What the document replaces, to build it in; see json_parser::recycle. */
+  node m_root_old;
+  /** What the value for the current map key replaces, if anything. */
+  node m_next_old;
+
+  json_parser_state() :
+    m_root_proj(projection::all()),
+    m_root_old(type::NIL),
+    m_next_old(type::NIL)
+  {
     reset();
   }
 
@@ -312,21 +477,120 @@ struct json_parser_state {
     m_keys.clear();
     m_syms.clear();
     m_nodes.clear();
+    m_projs.clear();
+    m_next_proj = m_root_proj;
+    m_onpath = 0;
+    if (m_stream) {
+      m_stream->reset();
+    }
+    m_build.reset();
     m_syms.push_back(json_sym(json_nts::VAL));
   }
 
-  void array_swallow() {
-    auto n = m_nodes.back();
+  /** The node that the value about to be pushed replaces, if any. */
+  node take_old() {
+    if (m_nodes.empty()) {
+      return std::move(m_root_old);
+    }
+    if (m_nodes.back().get_type() == type::ARRAY) {
+      return m_build.element(m_nodes.back());
+    }
+    return std::move(m_next_old);
+  }
+
+  /** True iff the next value pushed will be on the path to the streamed
+   * array. */
+  bool next_on_path() const {
+    const size_t depth = m_nodes.size();
+    if (m_onpath != depth) {
+      return false;
+    }
+    if (depth == 0) {
+      return true;
+    }
+    const node &parent = m_nodes.back();
+    if (parent.get_type() == type::MAP) {
+      return m_stream->on_path(depth - 1, m_keys.back());
+    }
+    return m_stream->on_path(depth - 1, parent.as_array().length());
+  }
+
+  /** True iff the top of m_nodes is the streamed array. */
+  bool at_stream() const {
+    return m_stream
+      && m_onpath == m_nodes.size()
+      && m_onpath == m_stream->steps() + 1
+      && m_nodes.back().get_type() == type::ARRAY;
+  }
+
+  void push(node n) {
+    if (m_stream && next_on_path()) {
+      m_onpath++;
+    }
+    m_nodes.push_back(std::move(n));
+    m_projs.push_back(m_next_proj);
+  }
+
+  node pop() {
+    node n = std::move(m_nodes.back());
     m_nodes.pop_back();
-    m_nodes.back().as_mutable_array().append(n);
+    m_projs.pop_back();
+    m_onpath = std::min(m_onpath, m_nodes.size());
+    return n;
+  }
+
+  void array_swallow() {
+    const bool skipped = (m_projs.back() == nullptr);
+    node n = pop();
+    if (at_stream()) {
+      if (! skipped || ! m_projs.back()->none_from(m_stream->count())) {
+        m_stream->deliver(make_unique<node>(std::move(n)));
+      }
+      return;
+    }
+    if (skipped
+        && m_projs.back()->none_from(m_nodes.back().as_array().length())) {
+      /* Nothing selected from here on; drop rather than pad with nulls. */
+      return;
+    }
+    m_build.append(m_nodes.back(), std::move(n));
   }
 
   void map_swallow() {
-    auto n = m_nodes.back();
-    m_nodes.pop_back();
-    m_nodes.back().as_mutable_map().insert(m_keys.back(), n);
+    const bool skipped = (m_projs.back() == nullptr);
+    node n = pop();
+    if (! skipped) {
+      m_build.insert(m_nodes.back(), m_keys.back(), std::move(n));
+    }
     m_keys.pop_back();
   }
+
+  /** Having just consumed the given token, work out the projection for the
+   * value that follows it, if any.
+   *
+   * Returns true iff that value is outside the projection, in which case
+   * the tokenizer should pass over it and emit a SKIPPED token instead. */
+  bool choose_next(json_tok tok) {
+    if (m_nodes.empty()) {
+      return false;
+    }
+    const projection *cur = m_projs.back();
+    if (tok == json_tok::COLON) {
+      m_next_proj = cur->key(m_keys.back());
+    }
+    else if (tok == json_tok::LEFT_SQUARE
+        || (tok == json_tok::COMMA
+          && m_nodes.back().get_type() == type::ARRAY))
+    {
+      m_next_proj = cur->index(at_stream()
+          ? m_stream->count()
+          : m_nodes.back().as_array().length());
+    }
+    else {
+      return false;
+    }
+    return m_next_proj == nullptr;
+  }
 };
 
 
@@ -362,48 +626,65 @@ static const vector<json_parse_rule> g_rules {
     { json_sym(json_tok::STRING) },
     [](json_parser_state &state)
     {
-      state.m_nodes.push_back(node(state.m_thistokstr));
+      if (state.m_thistokbin) {
+        state.push(node_builder::make_binary(state.take_old(),
+              state.m_thistokbin->data(), state.m_thistokbin->size()));
+      }
+      else {
+        state.push(node_builder::make_string(state.take_old(),
+              state.m_thistokstr, strlen(state.m_thistokstr)));
+      }
     } },
   { json_nts::VAL, "VAL --> integer",
     { json_sym(json_tok::INTEGER) },
     [](json_parser_state &state)
     {
-      state.m_nodes.push_back(node(atol(state.m_thistokstr)));
+      state.push(node(atol(state.m_thistokstr)));
     } },
   { json_nts::VAL, "VAL --> real",
     { json_sym(json_tok::REAL) },
     [](json_parser_state &state)
     {
-      state.m_nodes.push_back(node(atof(state.m_thistokstr)));
+      state.push(node(atof(state.m_thistokstr)));
     } },
   { json_nts::VAL, "VAL --> true",
     { json_sym(json_tok::TRUE) },
     [](json_parser_state &state)
     {
-      state.m_nodes.push_back(node(true));
+      state.push(node(true));
     } },
   { json_nts::VAL, "VAL --> false",
     { json_sym(json_tok::FALSE) },
     [](json_parser_state &state)
     {
-      state.m_nodes.push_back(node(false));
+      state.push(node(false));
     } },
   { json_nts::VAL, "VAL --> null",
     { json_sym(json_tok::NIL) },
     [](json_parser_state &state)
     {
-      state.m_nodes.push_back(node(type::NIL));
+      state.push(node(type::NIL));
+    } },
+  { json_nts::VAL, "VAL --> skipped",
+    { json_sym(json_tok::SKIPPED) },
+    [](json_parser_state &state)
+    {
+      /* Placeholder; dropped or kept as null when swallowed. */
+      state.push(node(type::NIL));
     } },
   { json_nts::ARR, "ARR --> [ ARR_CONT",
     { json_sym(json_tok::LEFT_SQUARE),
       json_sym(json_nts::ARR_CONT) },
     [](json_parser_state &state)
     {
-      state.m_nodes.push_back(node(type::ARRAY));
+      state.push(state.m_build.begin_array(state.take_old()));
     } },
   { json_nts::ARR_CONT, "ARR_CONT --> ]",
     { json_sym(json_tok::RIGHT_SQUARE) },
-    {} },
+    [](json_parser_state &state)
+    {
+      state.m_build.end_array(state.m_nodes.back());
+    } },
   { json_nts::ARR_CONT, "ARR_CONT --> VAL ARR_ETC",
     { json_sym(json_nts::VAL),
       json_sym(json_nts::ARR_ETC) },
@@ -413,6 +694,7 @@ static const vector<json_parse_rule> g_rules {
     [](json_parser_state &state)
     {
       state.array_swallow();
+      state.m_build.end_array(state.m_nodes.back());
     } },
   { json_nts::ARR_ETC, "ARR_ETC --> , VAL ARR_ETC",
     { json_sym(json_tok::COMMA),
@@ -426,11 +708,14 @@ static const vector<json_parse_rule> g_rules {
     { json_sym(json_tok::LEFT_CURLY), json_sym(json_nts::MAP_CONT) },
     [](json_parser_state &state)
     {
-      state.m_nodes.push_back(node(type::MAP));
+      state.push(state.m_build.begin_map(state.take_old()));
     } },
   { json_nts::MAP_CONT, "MAP_CONT --> }",
     { json_sym(json_tok::RIGHT_CURLY) },
-    {} },
+    [](json_parser_state &state)
+    {
+      state.m_build.end_map(state.m_nodes.back());
+    } },
   { json_nts::MAP_CONT, "MAP_CONT --> MAP_PAIR MAP_ETC",
     { json_sym(json_nts::MAP_PAIR),
       json_sym(json_nts::MAP_ETC) },
@@ -442,12 +727,15 @@ static const vector<json_parse_rule> g_rules {
     [](json_parser_state &state)
     {
       state.m_keys.push_back(state.m_thistokstr);
+      state.m_next_old =
+        state.m_build.entry(state.m_nodes.back(), state.m_keys.back());
     } },
   { json_nts::MAP_ETC, "MAP_ETC --> }",
     { json_sym(json_tok::RIGHT_CURLY) },
     [](json_parser_state &state)
     {
       state.map_swallow();
+      state.m_build.end_map(state.m_nodes.back());
     } },
   { json_nts::MAP_ETC, "MAP_ETC --> , MAP_PAIR MAP_ETC",
     { json_sym(json_tok::COMMA),
@@ -472,6 +760,7 @@ static const vector<json_parse_rule> g_rules {
 
 class json_parser {
   json_parser_state m_state;
+  bool m_skip_next = false;
   vector<json_parse_rule> m_rules;
   /* The rule matrix tells you which rule to apply when you have a particular
    * NTS (non-terminating symbol) on the top of the stack, and you are
@@ -592,6 +881,38 @@ public:
   {
     ELLIS_LOG(INFO, "Resetting json parser");
     m_state.reset();
+    m_skip_next = false;
+  }
+
+  /** Set the projection for the whole document; takes effect on reset(). */
+  void set_projection(const projection *proj)
+  {
+    m_state.m_root_proj = proj;
+    m_state.m_root_old = node(type::NIL);
+  }
+
+  /** Set where to stream array elements to; takes effect on reset(). */
+  void set_element_stream(element_stream *stream)
+  {
+    m_state.m_stream = stream;
+    m_state.m_root_old = node(type::NIL);
+  }
+
+  /** Build the next document in old, as far as it has the same shape.
+   *
+   * Not done while there is a projection or element stream, since those
+   * leave parts of the document out. */
+  void recycle(node &&old)
+  {
+    if (m_state.m_root_proj == projection::all() && ! m_state.m_stream) {
+      m_state.m_root_old = std::move(old);
+    }
+  }
+
+  /** True iff the value following the last token should be skipped. */
+  bool skip_next() const
+  {
+    return m_skip_next;
   }
 
   node_progress progdoom(const char *msg)
@@ -617,7 +938,7 @@ public:
   {
     ELLIS_LOG(DBUG, "This json parse is done!");
     ELLIS_ASSERT_EQ(m_state.m_nodes.size(), 1);
-    unique_ptr<node> ret(make_unique<node>(m_state.m_nodes[0]));
+    unique_ptr<node> ret(make_unique<node>(std::move(m_state.m_nodes[0])));
     m_state.m_nodes.clear();
     return node_progress(std::move(ret));
   }
@@ -626,9 +947,15 @@ public:
    *
    * Returns true if document has been successfully built.
    */
-  node_progress accept_token(json_tok tok, const char *tokstr) {
+  node_progress accept_token(
+      json_tok tok,
+      const char *tokstr,
+      const vector<byte> *tokbin)
+  {
     m_state.m_thistok = tok;
     m_state.m_thistokstr = tokstr;
+    m_state.m_thistokbin = tokbin;
+    m_skip_next = false;
 
     ELLIS_LOG(DBUG, "Parser accepting token %s (txt %s)",
         enum_name(tok), tokstr);
@@ -651,6 +978,7 @@ public:
           ELLIS_LOG(DBUG, "Yay, token %s matches top of stack--popping",
               enum_name(tok));
           stak.pop_back();
+          m_skip_next = m_state.choose_next(tok);
           /* If this was the last thing on stack, then done parsing. */
           if (stak.empty()) {
             return progdone();
@@ -704,11 +1032,21 @@ public:
 class json_tokenizer {
 public:
   using tokcb_t = std::function<node_progress(
-      json_tok &tok, const char *str)>;
+      json_tok &tok, const char *str, const vector<byte> *bin)>;
   json_tok_state m_tokstate;
   std::ostringstream m_txt;
   int m_int;
   int m_digitcount;
+  /** How much of k_json_binary_prefix the current string starts with, taking
+   * only literal characters; -1 once it can no longer be a binary blob. */
+  int m_binmatch;
+  /** Decoded blob, when a string token turns out to be binary. */
+  vector<byte> m_bin;
+  bool m_is_bin;
+  /** Set by the parser (through the token callback) to skip the next value. */
+  bool m_skip_requested;
+  /** Closing brackets expected within a skipped value, innermost last. */
+  string m_skipclose;
   tokcb_t m_tokcb;
 
   void _clear_txt()
@@ -735,6 +1073,78 @@ public:
   {
     _clear_txt();
     m_tokstate = json_tok_state::INIT;
+    m_binmatch = -1;
+    m_is_bin = false;
+    m_skip_requested = false;
+    m_skipclose.clear();
+  }
+
+  /** Have the tokenizer pass over the next value without tokenizing it,
+   * emitting a single SKIPPED token in its place. */
+  void request_skip()
+  {
+    m_skip_requested = true;
+  }
+
+  /** Track literal string characters against the binary blob prefix. */
+  void _match_bin_prefix(const char *s, size_t len)
+  {
+    for (size_t i = 0; i < len; i++) {
+      if (m_binmatch < 0 || m_binmatch == k_json_binary_prefix_len) {
+        return;
+      }
+      if (s[i] == k_json_binary_prefix[m_binmatch]) {
+        m_binmatch++;
+      }
+      else {
+        m_binmatch = -1;
+      }
+    }
+  }
+
+  /** Accept as many of the given characters as can be handled in bulk
+   * (string contents, and the insides of skipped values), returning how many
+   * that was.
+   *
+   * Equivalent to calling accept_char on each, since none of them can end a
+   * token or change state. */
+  size_t accept_run(const char *s, size_t len)
+  {
+    size_t run = 0;
+    if (m_tokstate == json_tok_state::STRING) {
+      run = find_json_string_special(s, len);
+      _match_bin_prefix(s, run);
+      m_txt.write(s, run);
+    }
+    else if (m_tokstate == json_tok_state::SKIP_STR) {
+      run = find_json_string_special(s, len);
+    }
+    else if (m_tokstate == json_tok_state::SKIP && ! m_skipclose.empty()) {
+      run = find_json_nesting_special(s, len);
+    }
+    return run;
+  }
+
+  /** Finish a string token, decoding it first if it is a binary blob.
+   *
+   * Anything after the prefix that does not decode leaves it as text. */
+  node_progress emit_string()
+  {
+    if (m_binmatch == k_json_binary_prefix_len) {
+      const string txt = m_txt.str();
+      const char *b64 = txt.c_str() + k_json_binary_prefix_len;
+      const size_t b64len = txt.length() - k_json_binary_prefix_len;
+      m_bin.resize(base64_decoded_max(b64len));
+      size_t binlen = 0;
+      if (base64_decode(b64, b64len, m_bin.data(), &binlen)) {
+        m_bin.resize(binlen);
+        m_is_bin = true;
+      }
+      else {
+        m_bin.clear();
+      }
+    }
+    return emit_token(json_tok::STRING);
   }
 
   node_progress progdoom(const char *msg)
@@ -756,19 +1166,29 @@ public:
     if (tok == json_tok::ERROR) {
       return progdoom("invalid token");
     }
-    node_progress rv = m_tokcb(tok, m_txt.str().c_str());
+    node_progress rv = m_tokcb(
+        tok, m_txt.str().c_str(), m_is_bin ? &m_bin : nullptr);
     ELLIS_LOG(DBUG, "Post token emission cleanup");
     _clear_txt();
+    if (m_is_bin) {
+      m_bin.clear();
+      m_is_bin = false;
+    }
     if (rv.state() == stream_state::ERROR) {
       m_tokstate = json_tok_state::ERROR;
     }
     else if (rv.state() == stream_state::SUCCESS) {
       m_tokstate = json_tok_state::END;
     }
+    else if (m_skip_requested) {
+      m_tokstate = json_tok_state::SKIP;
+      m_skipclose.clear();
+    }
     else {
       m_tokstate = json_tok_state::INIT;
     }
-    return std::move(rv);
+    m_skip_requested = false;
+    return rv;
   }
 
   json_tok token_from_bareword()
@@ -824,8 +1244,16 @@ public:
       case json_tok_state::EXPSIGN:
       case json_tok_state::COMMENTSLASH2:
       case json_tok_state::COMMENT:
+      case json_tok_state::SKIP:
+      case json_tok_state::SKIP_STR:
+      case json_tok_state::SKIP_ESC:
+      case json_tok_state::SKIP_SLASH2:
+      case json_tok_state::SKIP_COMMENT:
         return progdoom("stream termination inside of token");
 
+      case json_tok_state::SKIP_SCALAR:
+        return emit_token(json_tok::SKIPPED);
+
       case json_tok_state::ZERO:
       case json_tok_state::INT:
         return emit_token(json_tok::INTEGER);
@@ -883,6 +1311,7 @@ public:
     }
     else if (ch == '"') {
       m_tokstate = json_tok_state::STRING;
+      m_binmatch = 0;
     }
     else if (ch == '-') {
       m_txt << ch;
@@ -922,7 +1351,7 @@ public:
        * may never occur in the language; still, it is the parser's job to deal
        * with such issues.  We'll start a new token if it looks like we
        * could. */
-      return start_new_token(nextch);
+      return accept_char(nextch);
     } else {
       return rv;
     }
@@ -945,12 +1374,16 @@ public:
       case json_tok_state::STRING:
         if (ch == '\\') {
           m_tokstate = json_tok_state::ESC;
+          if (m_binmatch != k_json_binary_prefix_len) {
+            m_binmatch = -1;
+          }
         }
         else if (ch == '"') {
           m_tokstate = json_tok_state::INIT;
-          return emit_token(json_tok::STRING);
+          return emit_string();
         }
         else {
+          _match_bin_prefix(&ch, 1);
           m_txt << ch;
         }
         break;
@@ -1150,6 +1583,79 @@ public:
         }
         break;
 
+      case json_tok_state::SKIP:
+        /* Only brackets and strings matter here; the skipped text is not
+         * otherwise checked. */
+        if (isspace(ch)) {
+          /* Ignore whitespace. */
+        }
+        else if (ch == '/') {
+          m_tokstate = json_tok_state::SKIP_SLASH2;
+        }
+        else if (ch == '"') {
+          m_tokstate = json_tok_state::SKIP_STR;
+        }
+        else if (ch == '[' || ch == '{') {
+          m_skipclose.push_back(ch == '[' ? ']' : '}');
+        }
+        else if (! m_skipclose.empty()) {
+          if (ch == ']' || ch == '}') {
+            if (ch != m_skipclose.back()) {
+              return progdoom("mismatched brackets");
+            }
+            m_skipclose.pop_back();
+            if (m_skipclose.empty()) {
+              return emit_token(json_tok::SKIPPED);
+            }
+          }
+        }
+        else if (ch == '-' || isalnum(ch)) {
+          m_tokstate = json_tok_state::SKIP_SCALAR;
+        }
+        else {
+          /* No value here after all (e.g. an empty array); let the parser
+           * sort it out. */
+          m_tokstate = json_tok_state::INIT;
+          return start_new_token(ch);
+        }
+        break;
+
+      case json_tok_state::SKIP_STR:
+        if (ch == '\\') {
+          m_tokstate = json_tok_state::SKIP_ESC;
+        }
+        else if (ch == '"') {
+          if (m_skipclose.empty()) {
+            return emit_token(json_tok::SKIPPED);
+          }
+          m_tokstate = json_tok_state::SKIP;
+        }
+        break;
+
+      case json_tok_state::SKIP_ESC:
+        m_tokstate = json_tok_state::SKIP_STR;
+        break;
+
+      case json_tok_state::SKIP_SCALAR:
+        if (! isalnum(ch) && ch != '.' && ch != '-' && ch != '+') {
+          return advance_token(json_tok::SKIPPED, ch);
+        }
+        break;
+
+      case json_tok_state::SKIP_SLASH2:
+        if (ch == '/') {
+          m_tokstate = json_tok_state::SKIP_COMMENT;
+        } else {
+          return progdoom("bad character after first comment slash");
+        }
+        break;
+
+      case json_tok_state::SKIP_COMMENT:
+        if (ch == '\n') {
+          m_tokstate = json_tok_state::SKIP;
+        }
+        break;
+
       case json_tok_state::END:
         return progdoom("already returned result");
         break;
@@ -1178,9 +1684,13 @@ json_decoder::json_decoder() :
   m_parser(make_unique<json_parser>(g_rules))
 {
   m_toker->set_token_callback(
-      [this](json_tok tok, const char *tokstr)
+      [this](json_tok tok, const char *tokstr, const vector<byte> *tokbin)
       {
-        return m_parser->accept_token(tok, tokstr);
+        auto rv = m_parser->accept_token(tok, tokstr, tokbin);
+        if (m_parser->skip_next()) {
+          m_toker->request_skip();
+        }
+        return rv;
       });
 }
 
@@ -1195,6 +1705,12 @@ node_progress json_decoder::consume_buffer(
   ELLIS_LOG(DBUG, "Consuming buffer of length %zu", *bytecount);
   const byte *p_end = buf + *bytecount;
   for (const byte *p = buf; p < p_end; p++) {
+    /* Bulk copy string contents, and pass over skipped values, up to the
+     * next character that needs a closer look. */
+    p += m_toker->accept_run((const char *)p, p_end - p);
+    if (p == p_end) {
+      break;
+    }
     auto st = m_toker->accept_char(*p);
     ELLIS_LOG(DBUG, "Tokenizer state: %s", enum_name(st.state()));
     if (st.state() == stream_state::SUCCESS
@@ -1220,6 +1736,31 @@ node_progress json_decoder::chop()
   return st;
 }
 
+progress json_decoder::consume_buffer_into(
+    const byte *buf,
+    size_t *bytecount,
+    node *out)
+{
+  node res(type::NIL);
+  progress st = decoder::consume_buffer_into(buf, bytecount, &res);
+  if (st.state() == stream_state::SUCCESS) {
+    out->swap(res);
+    m_parser->recycle(std::move(res));
+  }
+  return st;
+}
+
+progress json_decoder::chop_into(node *out)
+{
+  node res(type::NIL);
+  progress st = decoder::chop_into(&res);
+  if (st.state() == stream_state::SUCCESS) {
+    out->swap(res);
+    m_parser->recycle(std::move(res));
+  }
+  return st;
+}
+
 void json_decoder::reset()
 {
   ELLIS_LOG(DBUG, "Resetting decoder");
@@ -1227,6 +1768,36 @@ void json_decoder::reset()
   m_parser->reset();
 }
 
+void json_decoder::set_projection(const vector<string> &paths)
+{
+  auto proj = make_unique<projection>(paths);
+  m_parser->set_projection(proj.get());
+  m_proj = std::move(proj);
+  reset();
+}
+
+void json_decoder::clear_projection()
+{
+  m_parser->set_projection(projection::all());
+  m_proj.reset();
+  reset();
+}
+
+void json_decoder::set_element_callback(const string &path, element_fn fn)
+{
+  auto stream = make_unique<element_stream>(path, std::move(fn));
+  m_parser->set_element_stream(stream.get());
+  m_stream = std::move(stream);
+  reset();
+}
+
+void json_decoder::clear_element_callback()
+{
+  m_parser->set_element_stream(nullptr);
+  m_stream.reset();
+  reset();
+}
+
 
 /*  _____                     _
  * | ____|_ __   ___ ___   __| | ___ _ __
@@ -1244,6 +1815,36 @@ void json_encoder::_clear_obuf() {
   m_obuf.clear();
 }
 
+void json_encoder::_stream_out_str(
+    const char *s,
+    size_t len,
+    std::ostream &os)
+{
+  os.put('"');
+  while (len > 0) {
+    /* Copy the run of plain characters in one go. */
+    const size_t run = find_json_escape(s, len);
+    os.write(s, run);
+    if (run == len) {
+      break;
+    }
+    const unsigned char u = (unsigned char)s[run];
+    const char esc = k_json_escapes[u];
+    if (esc == 'u') {
+      const char ubuf[6] = {
+        '\\', 'u', '0', '0', hex_digit(u >> 4), hex_digit(u & 15) };
+      os.write(ubuf, sizeof(ubuf));
+    }
+    else {
+      const char ebuf[2] = { '\\', esc };
+      os.write(ebuf, sizeof(ebuf));
+    }
+    s += run + 1;
+    len -= run + 1;
+  }
+  os.put('"');
+}
+
 void json_encoder::_stream_out(const node &n, std::ostream &os) {
   switch (n.get_type()) {
     case type::NIL:
@@ -1255,46 +1856,28 @@ void json_encoder::_stream_out(const node &n, std::ostream &os) {
       return;
 
     case type::INT64:
-      os << (n.as_int64());
+      {
+        char nbuf[k_int64_fmt_max];
+        os.write(nbuf, format_int64(n.as_int64(), nbuf));
+      }
       return;
 
     case type::DOUBLE:
-      os << std::to_string(n.as_double());
+      {
+        const double d = n.as_double();
+        if (! std::isfinite(d)) {
+          THROW_ELLIS_ERR(TRANSLATE_FAIL,
+              "JSON can not represent non-finite double " << d);
+        }
+        char nbuf[k_double_fmt_max];
+        os.write(nbuf, format_double(d, nbuf));
+      }
       return;
 
     case type::U8STR:
       {
-        os << '"';
-        // TODO: iterators over u8str_node
-        const string s(n.as_u8str().c_str());
-        for (auto &ch : s) {
-          if (ch == '"' || ch == '\\' || ch == '/') {
-            os << '\\' << ch;
-          }
-          else if (ch == '\b') {
-            os << '\\' << 'b';
-          }
-          else if (ch == '\f') {
-            os << '\\' << 'f';
-          }
-          else if (ch == '\n') {
-            os << '\\' << 'n';
-          }
-          else if (ch == '\r') {
-            os << '\\' << 'r';
-          }
-          else if (ch == '\t') {
-            os << '\\' << 't';
-          }
-          else if ((unsigned)ch <= 0x1f) {
-            unsigned char u = (unsigned char)ch;
-            os << "\\u00" << hex_digit(u >> 4) << hex_digit(u & 15);
-          }
-          else {
-            os << ch;
-          }
-        }
-        os << '"';
+        const auto &str = n.as_u8str();
+        _stream_out_str(str.c_str(), str.length(), os);
       }
       return;
 
@@ -1305,15 +1888,15 @@ void json_encoder::_stream_out(const node &n, std::ostream &os) {
         bool separate = false;
         for (size_t i = 0; i < a.length(); i++) {
           if (separate) {
-            os << ", ";
+            os << (m_opts.compact ? "," : ", ");
           }
-          else {
+          else if (! m_opts.compact) {
             os << " ";
           }
           separate = true;
           _stream_out(a[i], os);
         }
-        if (separate) {
+        if (separate && ! m_opts.compact) {
           os << " ";
         }
         os << "]";
@@ -1322,36 +1905,58 @@ void json_encoder::_stream_out(const node &n, std::ostream &os) {
 
     case type::BINARY:
       {
-        // TODO: mime encode, not this
-        os << "\"/ELLIS_BINARY/";
+        /* Written as a base64 string behind a literal (unescaped) prefix;
+         * see k_json_binary_prefix. */
         const auto &a = n.as_binary();
-        for (size_t i = 0; i < a.length(); i++) {
-          byte b = a[i];
-          os << "x" << hex_digit(b >> 8) << hex_digit(b & 15);
-          _stream_out(a[i], os);
-        }
-        os << "]";
+        string b64(base64_encoded_len(a.length()), '\0');
+        base64_encode(a.data(), a.length(), &b64[0]);
+        os.put('"');
+        os.write(k_json_binary_prefix, k_json_binary_prefix_len);
+        os.write(b64.data(), b64.length());
+        os.put('"');
       }
       return;
 
     case type::MAP:
       {
         os << "{";
-        const auto &a = n.as_map();
         bool separate = false;
-        auto keys = a.keys();
-        for (const auto &k : keys) {
+        auto emit_entry = [this, &os, &separate](
+            const string &k,
+            const node &v)
+        {
           if (separate) {
-            os << ", ";
+            os << (m_opts.compact ? "," : ", ");
           }
-          else {
+          else if (! m_opts.compact) {
             os << " ";
           }
           separate = true;
-          os << '"' << k << '"' << ": ";
-          _stream_out(a[k], os);
+          _stream_out_str(k.c_str(), k.length(), os);
+          os << (m_opts.compact ? ":" : ": ");
+          _stream_out(v, os);
+        };
+        if (m_opts.sort_keys) {
+          vector<std::pair<const string *, const node *>> entries;
+          entries.reserve(n.as_map().length());
+          n.as_map().foreach([&entries](const string &k, const node &v)
+              {
+                entries.emplace_back(&k, &v);
+              });
+          std::sort(entries.begin(), entries.end(),
+              [](const std::pair<const string *, const node *> &x,
+                 const std::pair<const string *, const node *> &y)
+              {
+                return *x.first < *y.first;
+              });
+          for (const auto &e : entries) {
+            emit_entry(*e.first, *e.second);
+          }
+        }
+        else {
+          n.as_map().foreach(emit_entry);
         }
-        if (separate) {
+        if (separate && ! m_opts.compact) {
           os << " ";
         }
         os << "}";
@@ -1360,10 +1965,111 @@ void json_encoder::_stream_out(const node &n, std::ostream &os) {
   }
 }
 
+/** The size of s as written by _stream_out_str, quotes included. */
+static size_t json_str_size(const char *s, size_t len)
+{
+  size_t total = 2 + len;
+  while (len > 0) {
+    const size_t run = find_json_escape(s, len);
+    if (run == len) {
+      break;
+    }
+    /* A backslash and the escape character, or \u00XX. */
+    total += (k_json_escapes[(unsigned char)s[run]] == 'u') ? 5 : 1;
+    s += run + 1;
+    len -= run + 1;
+  }
+  return total;
+}
+
+/** The size of n as written by _stream_out. */
+size_t json_encoder::_size(const node &n) const {
+  switch (n.get_type()) {
+    case type::NIL:
+      return 4;
+
+    case type::BOOL:
+      return n.as_bool() ? 4 : 5;
+
+    case type::INT64:
+      {
+        char nbuf[k_int64_fmt_max];
+        return format_int64(n.as_int64(), nbuf);
+      }
+
+    case type::DOUBLE:
+      {
+        const double d = n.as_double();
+        if (! std::isfinite(d)) {
+          THROW_ELLIS_ERR(TRANSLATE_FAIL,
+              "JSON can not represent non-finite double " << d);
+        }
+        char nbuf[k_double_fmt_max];
+        return format_double(d, nbuf);
+      }
+
+    case type::U8STR:
+      {
+        const auto &str = n.as_u8str();
+        return json_str_size(str.c_str(), str.length());
+      }
+
+    case type::ARRAY:
+      {
+        const auto &a = n.as_array();
+        const size_t len = a.length();
+        /* The brackets, and the separators: ", " (or ",") between elements,
+         * and " " inside each bracket unless compact or empty. */
+        size_t total = 2;
+        if (len > 0) {
+          total += m_opts.compact ? len - 1 : 2 * len;
+        }
+        for (size_t i = 0; i < len; i++) {
+          total += _size(a[i]);
+        }
+        return total;
+      }
+
+    case type::BINARY:
+      return 2 + k_json_binary_prefix_len
+        + base64_encoded_len(n.as_binary().length());
+
+    case type::MAP:
+      {
+        const size_t len = n.as_map().length();
+        /* As for arrays, plus ": " (or ":") after each key. */
+        size_t total = 2;
+        if (len > 0) {
+          total += m_opts.compact ? 2 * len - 1 : 4 * len;
+        }
+        n.as_map().foreach([this, &total](const string &k, const node &v) {
+            total += json_str_size(k.c_str(), k.length()) + _size(v);
+          });
+        return total;
+      }
+  }
+  ELLIS_ASSERT_UNREACHABLE();
+}
+
 json_encoder::json_encoder()
 {
 }
 
+json_encoder::json_encoder(const json_encoder_opts &opts) :
+  m_opts(opts)
+{
+}
+
+void json_encoder::set_opts(const json_encoder_opts &opts)
+{
+  m_opts = opts;
+}
+
+const json_encoder_opts & json_encoder::opts() const
+{
+  return m_opts;
+}
+
 progress json_encoder::fill_buffer(
     byte *buf,
     size_t *bytecount)
@@ -1389,5 +2095,11 @@ void json_encoder::reset(const node *new_node)
   m_obufend = m_obuf.tellp();
 }
 
+bool json_encoder::encoded_size(const node &n, size_t *bytecount) const
+{
+  *bytecount = _size(n);
+  return true;
+}
+
 
 }  /* namespace ellis */
@@ -0,0 +1,488 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/codec/json_parallel.hpp>
+
+#include <ellis/codec/json.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis_private/core/parse_path.hpp>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <thread>
+#include <vector>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+/*  ____
+ * / ___|  ___ __ _ _ __  _ __   ___ _ __
+ * \___ \ / __/ _` | '_ \| '_ \ / _ \ '__|
+ *  ___) | (_| (_| | | | | | | |  __/ |
+ * |____/ \___\__,_|_| |_|_| |_|\___|_|
+ *
+ */
+
+
+/* The scanner only has to find the array and the commas between its
+ * elements; it checks nothing else.  All of the text is still fed through
+ * json_decoder one way or another, and any scan that goes wrong just sends
+ * the document down the sequential path, so malformed input is always
+ * reported by json_decoder itself. */
+
+static const size_t k_npos = (size_t)-1;
+
+
+/** Returns the position of the next quote, bracket, brace, comma or slash at
+ * or after pos, or len. */
+static inline size_t find_structural(const char *s, size_t len, size_t pos)
+{
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i lower = _mm_set1_epi8(0x20);
+  const __m128i lcurly = _mm_set1_epi8('{');
+  const __m128i rcurly = _mm_set1_epi8('}');
+  for (; pos + 16 <= len; pos += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(s + pos));
+    /* Setting 0x20 maps '[' onto '{' and ']' onto '}'. */
+    const __m128i vl = _mm_or_si128(v, lower);
+    const __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(vl, lcurly), _mm_cmpeq_epi8(vl, rcurly)),
+        _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, comma)),
+          _mm_cmpeq_epi8(v, slash)));
+    const int mask = _mm_movemask_epi8(hits);
+    if (mask != 0) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; pos < len; pos++) {
+    switch (s[pos]) {
+      case '"': case ',': case '/':
+      case '[': case ']': case '{': case '}':
+        return pos;
+    }
+  }
+  return len;
+}
+
+
+/** Returns the position of the next quote or backslash at or after pos, or
+ * len. */
+static inline size_t find_string_special(const char *s, size_t len, size_t pos)
+{
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  for (; pos + 16 <= len; pos += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(s + pos));
+    const int mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)));
+    if (mask != 0) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; pos < len; pos++) {
+    if (s[pos] == '"' || s[pos] == '\\') {
+      return pos;
+    }
+  }
+  return len;
+}
+
+
+/** Skips a // comment starting at pos; returns the position after it. */
+static inline size_t skip_comment(const char *s, size_t len, size_t pos)
+{
+  if (pos + 1 >= len || s[pos + 1] != '/') {
+    return k_npos;
+  }
+  const void *nl = memchr(s + pos, '\n', len - pos);
+  return nl ? (const char *)nl - s + 1 : len;
+}
+
+
+/** Skips whitespace and comments, as json_decoder does. */
+static size_t skip_space(const char *s, size_t len, size_t pos)
+{
+  while (pos < len) {
+    if (isspace((unsigned char)s[pos])) {
+      pos++;
+    }
+    else if (s[pos] == '/') {
+      pos = skip_comment(s, len, pos);
+      if (pos == k_npos) {
+        return k_npos;
+      }
+    }
+    else {
+      return pos;
+    }
+  }
+  return pos;
+}
+
+
+/** Skips the string whose opening quote is at pos. */
+static size_t skip_string(const char *s, size_t len, size_t pos)
+{
+  pos++;
+  for (;;) {
+    pos = find_string_special(s, len, pos);
+    if (pos >= len) {
+      return k_npos;
+    }
+    if (s[pos] == '"') {
+      return pos + 1;
+    }
+    pos += 2;
+  }
+}
+
+
+/** Skips the array or map whose opening bracket is at pos, returning the
+ * position after its closing bracket.
+ *
+ * If commas is given, the positions of the commas directly inside the
+ * container are appended to it. */
+static size_t skip_nested(
+    const char *s,
+    size_t len,
+    size_t pos,
+    vector<size_t> *commas)
+{
+  size_t depth = 0;
+  while (pos < len) {
+    pos = find_structural(s, len, pos);
+    if (pos >= len) {
+      break;
+    }
+    switch (s[pos]) {
+      case '"':
+        pos = skip_string(s, len, pos);
+        if (pos == k_npos) {
+          return k_npos;
+        }
+        continue;
+      case '/':
+        pos = skip_comment(s, len, pos);
+        if (pos == k_npos) {
+          return k_npos;
+        }
+        continue;
+      case '[':
+      case '{':
+        depth++;
+        break;
+      case ']':
+      case '}':
+        if (--depth == 0) {
+          return pos + 1;
+        }
+        break;
+      case ',':
+        if (depth == 1 && commas) {
+          commas->push_back(pos);
+        }
+        break;
+    }
+    pos++;
+  }
+  return k_npos;
+}
+
+
+/** Skips the value starting at pos. */
+static size_t skip_value(const char *s, size_t len, size_t pos)
+{
+  if (pos >= len) {
+    return k_npos;
+  }
+  if (s[pos] == '[' || s[pos] == '{') {
+    return skip_nested(s, len, pos, nullptr);
+  }
+  if (s[pos] == '"') {
+    return skip_string(s, len, pos);
+  }
+  while (pos < len && ! isspace((unsigned char)s[pos])
+      && ! strchr(",]}/", s[pos]))
+  {
+    pos++;
+  }
+  return pos;
+}
+
+
+/** One step of a path: a map key or an array index. */
+struct path_step {
+  bool is_key;
+  string key;
+  size_t index;
+};
+
+
+/** Returns the decoded contents of the JSON string at [pos, end). */
+static string string_at(const char *s, size_t pos, size_t end)
+{
+  if (! memchr(s + pos, '\\', end - pos)) {
+    return string(s + pos + 1, end - pos - 2);
+  }
+  json_decoder dec;
+  auto n = load_mem(s + pos, end - pos, dec);
+  return string(n->as_u8str().c_str(), n->as_u8str().length());
+}
+
+
+/** Follows steps from the value at pos, returning the position of the value
+ * they lead to, or k_npos if they can not be followed. */
+static size_t find_path(
+    const char *s,
+    size_t len,
+    size_t pos,
+    const vector<path_step> &steps)
+{
+  for (const auto &step : steps) {
+    pos = skip_space(s, len, pos);
+    if (pos >= len || s[pos] != (step.is_key ? '{' : '[')) {
+      return k_npos;
+    }
+    const char closer = step.is_key ? '}' : ']';
+    pos++;
+    for (size_t i = 0; ; i++) {
+      pos = skip_space(s, len, pos);
+      if (pos >= len || s[pos] == closer) {
+        return k_npos;
+      }
+      bool found = false;
+      if (step.is_key) {
+        /* Take the first match, since map_node::insert keeps the first. */
+        size_t key_end = skip_string(s, len, pos);
+        if (s[pos] != '"' || key_end == k_npos) {
+          return k_npos;
+        }
+        found = (string_at(s, pos, key_end) == step.key);
+        pos = skip_space(s, len, key_end);
+        if (pos >= len || s[pos] != ':') {
+          return k_npos;
+        }
+        pos = skip_space(s, len, pos + 1);
+      }
+      else {
+        found = (i == step.index);
+      }
+      if (found) {
+        break;
+      }
+      pos = skip_space(s, len, skip_value(s, len, pos));
+      if (pos >= len || s[pos] != ',') {
+        return k_npos;
+      }
+      pos++;
+    }
+  }
+  return skip_space(s, len, pos);
+}
+
+
+
+/*  ____                     _
+ * |  _ \  ___  ___ ___   __| | ___
+ * | | | |/ _ \/ __/ _ \ / _` |/ _ \
+ * | |_| |  __/ (_| (_) | (_| |  __/
+ * |____/ \___|\___\___/ \__,_|\___|
+ *
+ */
+
+
+/** Decodes a run of array elements (the text between two of the array's
+ * commas) as if it were an array of its own. */
+static unique_ptr<node> decode_chunk(const char *s, size_t len)
+{
+  json_decoder dec;
+  const byte open = '[';
+  const byte close = ']';
+  size_t count = 1;
+  auto st = dec.consume_buffer(&open, &count);
+  if (st.state() == stream_state::CONTINUE) {
+    count = len;
+    st = dec.consume_buffer((const byte *)s, &count);
+    if (st.state() == stream_state::SUCCESS) {
+      THROW_ELLIS_ERR(PARSE_FAIL, "unbalanced brackets in array element");
+    }
+  }
+  if (st.state() == stream_state::CONTINUE) {
+    count = 1;
+    st = dec.consume_buffer(&close, &count);
+  }
+  if (st.state() == stream_state::ERROR) {
+    throw *(st.extract_error());
+  }
+  if (st.state() == stream_state::CONTINUE) {
+    THROW_ELLIS_ERR(PARSE_FAIL, "unterminated array element");
+  }
+  return st.extract_value();
+}
+
+
+static unique_ptr<node> decode_sequential(const char *text, size_t len)
+{
+  json_decoder dec;
+  return load_mem(text, len, dec);
+}
+
+
+unique_ptr<node> json_parallel_decode(
+    const char *text,
+    size_t len,
+    const json_parallel_opts &opts)
+{
+  vector<path_step> steps;
+  parse_path(opts.path,
+      [&steps](const string &key, size_t)
+      {
+        steps.push_back(path_step { true, key, 0 });
+      },
+      [&steps](size_t start, size_t, size_t)
+      {
+        steps.push_back(path_step { false, string(), start });
+      });
+
+  unsigned threads = opts.threads;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (threads == 1) {
+    return decode_sequential(text, len);
+  }
+
+  /* Find the array and the commas between its elements. */
+  const size_t arr_start = find_path(text, len, 0, steps);
+  if (arr_start >= len || text[arr_start] != '[') {
+    ELLIS_LOG(INFO, "No array at path %s; decoding sequentially",
+        opts.path.c_str());
+    return decode_sequential(text, len);
+  }
+  vector<size_t> commas;
+  const size_t arr_end = skip_nested(text, len, arr_start, &commas);
+  if (arr_end == k_npos || arr_end - arr_start < opts.min_parallel_bytes) {
+    return decode_sequential(text, len);
+  }
+
+  /* Split the elements into a few runs per thread (to even out the load),
+   * each beginning after one of the array's commas. */
+  const size_t nchunks = std::min<size_t>(threads * 4, commas.size() + 1);
+  vector<size_t> bounds { arr_start };
+  for (size_t i = 1, c = 0; i < nchunks; i++) {
+    const size_t target = arr_start + (arr_end - arr_start) * i / nchunks;
+    while (c < commas.size() && commas[c] < target) {
+      c++;
+    }
+    if (c < commas.size() && commas[c] > bounds.back()) {
+      bounds.push_back(commas[c]);
+    }
+  }
+  bounds.push_back(arr_end - 1);
+
+  /* Decode the runs on worker threads. */
+  const size_t nruns = bounds.size() - 1;
+  vector<unique_ptr<node>> runs(nruns);
+  vector<unique_ptr<err>> errs(nruns);
+  std::atomic<size_t> next_run(0);
+  auto work = [&]() {
+    for (size_t i = next_run++; i < nruns; i = next_run++) {
+      try {
+        runs[i] = decode_chunk(
+            text + bounds[i] + 1, bounds[i + 1] - bounds[i] - 1);
+      } catch (const err &e) {
+        errs[i] = make_unique<err>(e);
+      }
+    }
+  };
+  vector<std::thread> workers;
+  for (unsigned t = 1; t < std::min<size_t>(threads, nruns); t++) {
+    workers.emplace_back(work);
+  }
+  /* The rest of the document is decoded here meanwhile, with the array
+   * left empty. */
+  unique_ptr<node> rv;
+  unique_ptr<err> outer_err;
+  try {
+    string outer;
+    outer.reserve(len - (arr_end - arr_start) + 2);
+    outer.append(text, arr_start);
+    outer.append("[]");
+    outer.append(text + arr_end, len - arr_end);
+    rv = decode_sequential(outer.data(), outer.size());
+  } catch (const err &e) {
+    outer_err = make_unique<err>(e);
+  }
+  work();
+  for (auto &w : workers) {
+    w.join();
+  }
+
+  /* Report errors in document order. */
+  if (outer_err) {
+    throw *outer_err;
+  }
+  for (size_t i = 0; i < nruns; i++) {
+    if (errs[i]) {
+      throw *errs[i];
+    }
+    if (nruns > 1 && runs[i]->as_array().length() == 0) {
+      /* e.g. [1,,2] or [1,] split into an empty run. */
+      THROW_ELLIS_ERR(PARSE_FAIL, "empty array element");
+    }
+  }
+
+  /* Splice the runs in order. */
+  node &arr = steps.empty() ? *rv : rv->at_mutable(opts.path);
+  auto &a = arr.as_mutable_array();
+  size_t total = 0;
+  for (const auto &r : runs) {
+    total += r->as_array().length();
+  }
+  a.reserve(total);
+  for (const auto &r : runs) {
+    a.extend(r->as_array());
+  }
+  return rv;
+}
+
+
+}  /* namespace ellis */
@@ -0,0 +1,645 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <ellis/codec/json_view.hpp>
+
+#include <ellis/codec/json.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis_private/codec/util/base64.hpp>
+#include <ellis_private/core/parse_path.hpp>
+#include <climits>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+/*  ____
+ * / ___|  ___ __ _ _ __  _ __   ___ _ __
+ * \___ \ / __/ _` | '_ \| '_ \ / _ \ '__|
+ *  ___) | (_| (_| | | | | | | |  __/ |
+ * |____/ \___\__,_|_| |_|_| |_|\___|_|
+ *
+ */
+
+
+#define BOOM(POS, DETAILS) \
+  do { \
+    THROW_ELLIS_ERR(PARSE_FAIL, \
+        "malformed JSON at offset " << (POS) << ": " << DETAILS); \
+  } while (0)
+
+
+/** Literal start of a base64 binary blob string, as written by
+ * json_encoder. */
+static const char k_binary_prefix[] = "/ELLIS_BINARY/";
+static const size_t k_binary_prefix_len = sizeof(k_binary_prefix) - 1;
+
+
+/** Skips whitespace and // comments, as json_decoder does. */
+static inline size_t skip_space(const char *s, size_t len, size_t pos)
+{
+  while (pos < len) {
+    const char c = s[pos];
+    if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      pos++;
+    }
+    else if (c == '/' && pos + 1 < len && s[pos + 1] == '/') {
+      pos += 2;
+      while (pos < len && s[pos] != '\n') {
+        pos++;
+      }
+    }
+    else {
+      break;
+    }
+  }
+  return pos;
+}
+
+
+/** Scans a string starting at its opening quote; returns the position just
+ * past the closing quote, and notes whether any escapes were seen. */
+static inline size_t scan_string(
+    const char *s,
+    size_t len,
+    size_t pos,
+    bool *escaped)
+{
+  const size_t start = pos;
+  pos++;
+  for (;;) {
+#ifdef __SSE2__
+    /* Skip ahead 16 bytes at a time to the next quote or backslash. */
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    while (pos + 16 <= len) {
+      const __m128i v = _mm_loadu_si128((const __m128i *)(s + pos));
+      const int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)));
+      if (mask != 0) {
+        pos += __builtin_ctz(mask);
+        break;
+      }
+      pos += 16;
+    }
+#endif
+    while (pos < len && s[pos] != '"' && s[pos] != '\\') {
+      pos++;
+    }
+    if (pos >= len) {
+      BOOM(start, "unterminated string");
+    }
+    if (s[pos] == '"') {
+      return pos + 1;
+    }
+    /* Backslash; the escaped character is checked when read. */
+    *escaped = true;
+    pos += 2;
+  }
+}
+
+
+/** Whether the string scanned from pos to end is a binary blob; as with
+ * json_decoder, that takes the literal prefix followed by valid base64. */
+static bool is_binary_string(
+    const char *s,
+    size_t pos,
+    size_t end,
+    bool escaped)
+{
+  if (end - pos < k_binary_prefix_len + 2
+      || memcmp(s + pos + 1, k_binary_prefix, k_binary_prefix_len) != 0)
+  {
+    return false;
+  }
+  if (escaped) {
+    /* Rare enough to let the decoder sort out the escapes. */
+    json_decoder dec;
+    return load_mem(s + pos, end - pos, dec)->is_type(type::BINARY);
+  }
+  const size_t b64len = end - pos - 2 - k_binary_prefix_len;
+  vector<byte> bin(base64_decoded_max(b64len));
+  size_t binlen = 0;
+  return base64_decode(s + pos + 1 + k_binary_prefix_len, b64len,
+      bin.data(), &binlen);
+}
+
+
+static inline bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+
+/** Scans a number; returns the position just past it. */
+static inline size_t scan_number(
+    const char *s,
+    size_t len,
+    size_t pos,
+    bool *is_real)
+{
+  const size_t start = pos;
+  if (s[pos] == '-') {
+    pos++;
+  }
+  if (pos >= len || ! is_digit(s[pos])) {
+    BOOM(start, "bad number");
+  }
+  if (s[pos] == '0') {
+    pos++;
+    if (pos < len && is_digit(s[pos])) {
+      BOOM(start, "initial zero can not be followed by digits");
+    }
+  }
+  else {
+    while (pos < len && is_digit(s[pos])) {
+      pos++;
+    }
+  }
+  *is_real = false;
+  if (pos < len && s[pos] == '.') {
+    *is_real = true;
+    pos++;
+    if (pos >= len || ! is_digit(s[pos])) {
+      BOOM(start, "decimal point must be followed by digit");
+    }
+    while (pos < len && is_digit(s[pos])) {
+      pos++;
+    }
+  }
+  if (pos < len && (s[pos] == 'e' || s[pos] == 'E')) {
+    *is_real = true;
+    pos++;
+    if (pos < len && (s[pos] == '+' || s[pos] == '-')) {
+      pos++;
+    }
+    if (pos >= len || ! is_digit(s[pos])) {
+      BOOM(start, "exponent must be followed by digit");
+    }
+    while (pos < len && is_digit(s[pos])) {
+      pos++;
+    }
+  }
+  return pos;
+}
+
+
+/** Checks for the given literal (true, false, null) at pos; returns the
+ * position just past it. */
+static inline size_t scan_literal(
+    const char *s,
+    size_t len,
+    size_t pos,
+    const char *lit)
+{
+  const size_t litlen = strlen(lit);
+  if (len - pos < litlen || memcmp(s + pos, lit, litlen) != 0
+      || (len - pos > litlen && isalnum((unsigned char)s[pos + litlen]))) {
+    BOOM(pos, "unrecognized literal");
+  }
+  return pos + litlen;
+}
+
+
+json_tape::json_tape(const char *text, size_t len) :
+  m_text(text),
+  m_len(len)
+{
+  _build();
+}
+
+
+void json_tape::_build()
+{
+  const char *s = m_text;
+  const size_t len = m_len;
+  /* Tape indices of the arrays and maps currently open. */
+  vector<uint32_t> open;
+
+  /* Appends an entry for a map key at pos, and consumes the colon. */
+  auto add_key = [this, s, len, &open](size_t pos) {
+    if (pos >= len || s[pos] != '"') {
+      BOOM(pos, "expected string for map key");
+    }
+    entry e { pos, 0, (uint32_t)m_tape.size() + 1, 0, type::U8STR, false };
+    const size_t end = scan_string(s, len, pos, &e.escaped);
+    e.len = end - pos;
+    m_tape.push_back(e);
+    pos = skip_space(s, len, end);
+    if (pos >= len || s[pos] != ':') {
+      BOOM(pos, "expected : after map key");
+    }
+    return skip_space(s, len, pos + 1);
+  };
+
+  m_tape.clear();
+  size_t pos = skip_space(s, len, 0);
+  for (;;) {
+    /* A value is expected at pos. */
+    if (pos >= len) {
+      BOOM(pos, "unexpected end of input");
+    }
+    if (m_tape.size() >= UINT32_MAX - 1) {
+      THROW_ELLIS_ERR(OVER_CAPACITY, "JSON document has too many values");
+    }
+    const uint32_t idx = (uint32_t)m_tape.size();
+    entry e { pos, 0, idx + 1, 0, type::NIL, false };
+    const char c = s[pos];
+    if (c == '[' || c == '{') {
+      e.kind = (c == '[') ? type::ARRAY : type::MAP;
+      m_tape.push_back(e);
+      const char closer = (c == '[') ? ']' : '}';
+      pos = skip_space(s, len, pos + 1);
+      if (pos >= len || s[pos] != closer) {
+        /* Non-empty; go get the first element. */
+        open.push_back(idx);
+        if (c == '{') {
+          pos = add_key(pos);
+        }
+        continue;
+      }
+      /* Empty container. */
+      m_tape[idx].len = pos + 1 - e.offset;
+      pos++;
+    }
+    else {
+      size_t end = 0;
+      if (c == '"') {
+        e.kind = type::U8STR;
+        end = scan_string(s, len, pos, &e.escaped);
+        if (is_binary_string(s, pos, end, e.escaped)) {
+          e.kind = type::BINARY;
+        }
+      }
+      else if (c == 't') {
+        e.kind = type::BOOL;
+        end = scan_literal(s, len, pos, "true");
+      }
+      else if (c == 'f') {
+        e.kind = type::BOOL;
+        end = scan_literal(s, len, pos, "false");
+      }
+      else if (c == 'n') {
+        e.kind = type::NIL;
+        end = scan_literal(s, len, pos, "null");
+      }
+      else if (c == '-' || is_digit(c)) {
+        bool is_real = false;
+        end = scan_number(s, len, pos, &is_real);
+        e.kind = is_real ? type::DOUBLE : type::INT64;
+      }
+      else {
+        BOOM(pos, "unexpected character");
+      }
+      e.len = end - pos;
+      m_tape.push_back(e);
+      pos = end;
+    }
+
+    /* A value is complete; close any containers that end here. */
+    for (;;) {
+      if (open.empty()) {
+        pos = skip_space(s, len, pos);
+        if (pos != len) {
+          BOOM(pos, "unexpected data after end of document");
+        }
+        return;
+      }
+      const uint32_t cidx = open.back();
+      const bool is_map = (m_tape[cidx].kind == type::MAP);
+      m_tape[cidx].count++;
+      pos = skip_space(s, len, pos);
+      if (pos >= len) {
+        BOOM(pos, "unexpected end of input");
+      }
+      if (s[pos] == ',') {
+        pos = skip_space(s, len, pos + 1);
+        if (is_map) {
+          pos = add_key(pos);
+        }
+        break;
+      }
+      if (s[pos] != (is_map ? '}' : ']')) {
+        BOOM(pos, (is_map ? "expected , or }" : "expected , or ]"));
+      }
+      m_tape[cidx].len = pos + 1 - m_tape[cidx].offset;
+      m_tape[cidx].next = (uint32_t)m_tape.size();
+      open.pop_back();
+      /* The container is itself a completed value; go around again. */
+      pos++;
+    }
+  }
+}
+
+#undef BOOM
+
+
+json_view json_tape::root() const
+{
+  return json_view(this, 0);
+}
+
+
+size_t json_tape::size() const
+{
+  return m_tape.size();
+}
+
+
+/* __     ___
+ * \ \   / (_) _____      __
+ *  \ \ / /| |/ _ \ \ /\ / /
+ *   \ V / | |  __/\ V  V /
+ *    \_/  |_|\___| \_/\_/
+ *
+ */
+
+
+json_view::json_view(const json_tape *tape, uint32_t idx) :
+  m_tape(tape),
+  m_idx(idx)
+{
+}
+
+
+const json_tape::entry & json_view::_ent() const
+{
+  return m_tape->m_tape[m_idx];
+}
+
+
+void json_view::_check_type(type t) const
+{
+  if (_ent().kind != t) {
+    THROW_ELLIS_ERR(TYPE_MISMATCH,
+        "JSON value is " << type_str(_ent().kind) << ", not " << type_str(t));
+  }
+}
+
+
+type json_view::get_type() const
+{
+  return _ent().kind;
+}
+
+
+bool json_view::is_type(type t) const
+{
+  return _ent().kind == t;
+}
+
+
+size_t json_view::length() const
+{
+  if (_ent().kind != type::ARRAY && _ent().kind != type::MAP) {
+    THROW_ELLIS_ERR(TYPE_MISMATCH,
+        "JSON value is " << type_str(_ent().kind) << ", not array or map");
+  }
+  return _ent().count;
+}
+
+
+json_view json_view::operator[](size_t idx) const
+{
+  _check_type(type::ARRAY);
+  if (idx >= _ent().count) {
+    THROW_ELLIS_ERR(INVALID_ARGS, "array index out of bounds");
+  }
+  uint32_t i = m_idx + 1;
+  for (; idx > 0; idx--) {
+    i = m_tape->m_tape[i].next;
+  }
+  return json_view(m_tape, i);
+}
+
+
+json_view json_view::operator[](int idx) const
+{
+  if (idx < 0) {
+    THROW_ELLIS_ERR(INVALID_ARGS, "array index out of bounds");
+  }
+  return (*this)[(size_t)idx];
+}
+
+
+std::string json_view::_key(uint32_t key_idx) const
+{
+  return json_view(m_tape, key_idx).as_u8str();
+}
+
+
+bool json_view::_key_equals(
+    uint32_t key_idx,
+    const char *key,
+    size_t keylen) const
+{
+  const auto &k = m_tape->m_tape[key_idx];
+  if (k.escaped) {
+    const string unescaped = _key(key_idx);
+    return unescaped.size() == keylen
+      && memcmp(unescaped.data(), key, keylen) == 0;
+  }
+  return k.len - 2 == keylen
+    && memcmp(m_tape->m_text + k.offset + 1, key, keylen) == 0;
+}
+
+
+bool json_view::_find(
+    const char *key,
+    size_t keylen,
+    json_view *found) const
+{
+  _check_type(type::MAP);
+  uint32_t i = m_idx + 1;
+  for (uint32_t n = 0; n < _ent().count; n++) {
+    /* Entries alternate: key, then value. */
+    if (_key_equals(i, key, keylen)) {
+      *found = json_view(m_tape, i + 1);
+      return true;
+    }
+    i = m_tape->m_tape[i + 1].next;
+  }
+  return false;
+}
+
+
+json_view json_view::operator[](const std::string &key) const
+{
+  json_view found(*this);
+  if (! _find(key.data(), key.size(), &found)) {
+    THROW_ELLIS_ERR(NO_SUCH, "key " << key << " not found in map");
+  }
+  return found;
+}
+
+
+json_view json_view::operator[](const char *key) const
+{
+  return (*this)[string(key)];
+}
+
+
+bool json_view::has_key(const std::string &key) const
+{
+  json_view found(*this);
+  return _find(key.data(), key.size(), &found);
+}
+
+
+vector<string> json_view::keys() const
+{
+  _check_type(type::MAP);
+  vector<string> rv;
+  rv.reserve(_ent().count);
+  uint32_t i = m_idx + 1;
+  for (uint32_t n = 0; n < _ent().count; n++) {
+    rv.push_back(_key(i));
+    i = m_tape->m_tape[i + 1].next;
+  }
+  return rv;
+}
+
+
+json_view json_view::at(const std::string &path) const
+{
+  json_view cur(*this);
+
+#define BOOM(POS, DETAILS) \
+  do { \
+    THROW_ELLIS_ERR(PATH_FAIL, \
+      "access failure at position " << (POS) \
+      << " of path " << path << ": " << DETAILS); \
+  } while (0)
+
+  auto got_map_selector =
+    [&cur, &path]
+    (const string &pattern, size_t pos)
+    {
+      if (! cur.is_type(type::MAP)) {
+        BOOM(pos, "map pattern selector applied to non-map");
+      }
+      if (! cur._find(pattern.data(), pattern.size(), &cur)) {
+        BOOM(pos, "pattern not found in map");
+      }
+    };
+
+  auto got_array_selector =
+    [&cur, &path]
+    (size_t start, size_t stop, size_t pos)
+    {
+      if (start != stop) {
+        BOOM(pos, "array range not supported in this mode");
+      }
+      if (! cur.is_type(type::ARRAY)) {
+        BOOM(pos, "array index applied to non-array");
+      }
+      if (start >= cur.length()) {
+        BOOM(pos, "index out of range");
+      }
+      cur = cur[start];
+    };
+#undef BOOM
+
+  parse_path(path, got_map_selector, got_array_selector);
+  return cur;
+}
+
+
+bool json_view::as_bool() const
+{
+  _check_type(type::BOOL);
+  return m_tape->m_text[_ent().offset] == 't';
+}
+
+
+int64_t json_view::as_int64() const
+{
+  _check_type(type::INT64);
+  /* Numbers need not be followed by a terminator in the text, so copy. */
+  const auto &e = _ent();
+  char buf[32];
+  if (e.len < sizeof(buf)) {
+    memcpy(buf, m_tape->m_text + e.offset, e.len);
+    buf[e.len] = '\0';
+    return atol(buf);
+  }
+  return atol(string(m_tape->m_text + e.offset, e.len).c_str());
+}
+
+
+double json_view::as_double() const
+{
+  _check_type(type::DOUBLE);
+  const auto &e = _ent();
+  char buf[32];
+  if (e.len < sizeof(buf)) {
+    memcpy(buf, m_tape->m_text + e.offset, e.len);
+    buf[e.len] = '\0';
+    return atof(buf);
+  }
+  return atof(string(m_tape->m_text + e.offset, e.len).c_str());
+}
+
+
+string json_view::as_u8str() const
+{
+  _check_type(type::U8STR);
+  const auto &e = _ent();
+  if (! e.escaped) {
+    return string(m_tape->m_text + e.offset + 1, e.len - 2);
+  }
+  /* Let the decoder deal with escapes, so the results match exactly. */
+  auto n = to_node();
+  return string(n->as_u8str().c_str(), n->as_u8str().length());
+}
+
+
+unique_ptr<node> json_view::to_node() const
+{
+  json_decoder dec;
+  return load_mem(raw_text(), raw_length(), dec);
+}
+
+
+const char * json_view::raw_text() const
+{
+  return m_tape->m_text + _ent().offset;
+}
+
+
+size_t json_view::raw_length() const
+{
+  return _ent().len;
+}
+
+
+}  /* namespace ellis */
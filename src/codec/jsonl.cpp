@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <ellis/codec/jsonl.hpp>
+
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/data_format.hpp>
+#include <ellis/core/disposition.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+namespace {
+class dummy_init {
+public:
+  dummy_init()
+  {
+    system_add_data_format(
+        make_unique<const data_format>(
+          "builtin.jsonl.generic",
+          "jsonl",
+          "JSON Lines (newline delimited JSON records)",
+          [](){ return unique_ptr<decoder>(new ellis::jsonl_decoder()); },
+          [](){ return unique_ptr<encoder>(new ellis::jsonl_encoder()); }));
+  }
+} unused_dummy_init;
+}  /* namespace */
+
+
+static inline bool is_jsonl_space(byte b)
+{
+  return b == ' ' || b == '\n' || b == '\r' || b == '\t';
+}
+
+
+/** Returns the first non-whitespace position in [p, end), or end. */
+static inline const byte * skip_jsonl_space(const byte *p, const byte *end)
+{
+  while (p < end && is_jsonl_space(*p)) {
+    p++;
+  }
+  return p;
+}
+
+
+static json_encoder_opts record_opts()
+{
+  json_encoder_opts opts;
+  opts.compact = true;
+  return opts;
+}
+
+
+/*  ____                     _
+ * |  _ \  ___  ___ ___   __| | ___ _ __
+ * | | | |/ _ \/ __/ _ \ / _` |/ _ \ '__|
+ * | |_| |  __/ (_| (_) | (_| |  __/ |
+ * |____/ \___|\___\___/ \__,_|\___|_|
+ *
+ */
+
+
+jsonl_decoder::jsonl_decoder()
+{
+  reset();
+}
+
+node_progress jsonl_decoder::consume_buffer(
+    const byte *buf,
+    size_t *bytecount)
+{
+  const byte *p = buf;
+  const byte *p_end = buf + *bytecount;
+  while (p < p_end) {
+    if (! m_in_record) {
+      p = skip_jsonl_space(p, p_end);
+      if (p == p_end) {
+        break;
+      }
+      m_in_record = true;
+    }
+    size_t remain = p_end - p;
+    auto st = m_dec.consume_buffer(p, &remain);
+    p = p_end - remain;
+    if (st.state() == stream_state::ERROR) {
+      *bytecount = remain;
+      return st;
+    }
+    if (st.state() == stream_state::SUCCESS) {
+      m_records->as_mutable_array().append(*st.extract_value());
+      m_dec.reset();
+      m_in_record = false;
+    }
+  }
+  *bytecount = 0;
+  return node_progress(stream_state::CONTINUE);
+}
+
+node_progress jsonl_decoder::chop()
+{
+  if (m_in_record) {
+    auto st = m_dec.chop();
+    if (st.state() != stream_state::SUCCESS) {
+      return st;
+    }
+    m_records->as_mutable_array().append(*st.extract_value());
+    m_in_record = false;
+  }
+  return node_progress(std::move(m_records));
+}
+
+void jsonl_decoder::reset()
+{
+  m_dec.reset();
+  m_records = make_unique<node>(type::ARRAY);
+  m_in_record = false;
+}
+
+
+/*  _____                     _
+ * | ____|_ __   ___ ___   __| | ___ _ __
+ * |  _| | '_ \ / __/ _ \ / _` |/ _ \ '__|
+ * | |___| | | | (_| (_) | (_| |  __/ |
+ * |_____|_| |_|\___\___/ \__,_|\___|_|
+ *
+ */
+
+
+jsonl_encoder::jsonl_encoder() :
+  m_enc(record_opts())
+{
+}
+
+progress jsonl_encoder::fill_buffer(
+    byte *buf,
+    size_t *bytecount)
+{
+  const auto &a = m_records->as_array();
+  size_t pos = 0;
+  while (m_idx < a.length() && pos < *bytecount) {
+    if (m_need_newline) {
+      buf[pos++] = '\n';
+      m_need_newline = false;
+      m_idx++;
+      if (m_idx < a.length()) {
+        m_enc.reset(&a[m_idx]);
+      }
+      continue;
+    }
+    size_t bc = *bytecount - pos;
+    auto st = m_enc.fill_buffer(buf + pos, &bc);
+    pos += bc;
+    if (st.state() == stream_state::ERROR) {
+      *bytecount = pos;
+      return st;
+    }
+    if (st.state() == stream_state::SUCCESS) {
+      m_need_newline = true;
+    }
+  }
+  *bytecount = pos;
+  if (m_idx == a.length()) {
+    return progress(true);
+  }
+  return progress(stream_state::CONTINUE);
+}
+
+void jsonl_encoder::reset(const node *new_node)
+{
+  if (new_node->get_type() != type::ARRAY) {
+    THROW_ELLIS_ERR(TRANSLATE_FAIL,
+        "JSON Lines output requires an array of records, not "
+        << type_str(new_node->get_type()));
+  }
+  m_records = new_node;
+  m_idx = 0;
+  m_need_newline = false;
+  const auto &a = m_records->as_array();
+  if (a.length() > 0) {
+    m_enc.reset(&a[0]);
+  }
+}
+
+
+/*  ____                _
+ * |  _ \ ___  __ _  __| | ___ _ __
+ * | |_) / _ \/ _` |/ _` |/ _ \ '__|
+ * |  _ <  __/ (_| | (_| |  __/ |
+ * |_| \_\___|\__,_|\__,_|\___|_|
+ *
+ */
+
+
+jsonl_reader::jsonl_reader(sync_input_stream &in) :
+  m_in(in)
+{
+}
+
+unique_ptr<node> jsonl_reader::next()
+{
+  m_dec.reset();
+  bool in_record = false;
+  while (1) {
+    const byte *buf = nullptr;
+    size_t buf_remain = 0;
+    if (! m_in.next_input_buf(&buf, &buf_remain)) {
+      /* End of stream.  Fine between records, otherwise the last record
+       * either ends here (e.g. a bare number) or is truncated. */
+      if (! in_record) {
+        return nullptr;
+      }
+      auto st = m_dec.chop();
+      if (st.state() == stream_state::ERROR) {
+        throw *(st.extract_error());
+      }
+      m_count++;
+      return st.extract_value();
+    }
+    ELLIS_ASSERT(buf != nullptr);
+    const byte *p_end = buf + buf_remain;
+    const byte *p = buf;
+    if (! in_record) {
+      p = skip_jsonl_space(p, p_end);
+      if (p == p_end) {
+        continue;
+      }
+      in_record = true;
+    }
+    buf_remain = p_end - p;
+    auto st = m_dec.consume_buffer(p, &buf_remain);
+    switch (st.state()) {
+      case stream_state::ERROR:
+        m_in.put_back(buf_remain);
+        throw *(st.extract_error());
+
+      case stream_state::SUCCESS:
+        /* Leave the following records for the next call. */
+        m_in.put_back(buf_remain);
+        m_count++;
+        return st.extract_value();
+
+      case stream_state::CONTINUE:
+        ELLIS_ASSERT_EQ(buf_remain, 0);
+        break;
+    }
+  }
+  ELLIS_ASSERT_UNREACHABLE();
+}
+
+size_t jsonl_reader::for_each(std::function<bool(unique_ptr<node>)> fn)
+{
+  size_t delivered = 0;
+  while (auto rec = next()) {
+    delivered++;
+    if (! fn(std::move(rec))) {
+      break;
+    }
+  }
+  return delivered;
+}
+
+size_t jsonl_reader::count() const
+{
+  return m_count;
+}
+
+
+/* __        __    _ _
+ * \ \      / / __(_) |_ ___ _ __
+ *  \ \ /\ / / '__| | __/ _ \ '__|
+ *   \ V  V /| |  | | ||  __/ |
+ *    \_/\_/ |_|  |_|\__\___|_|
+ *
+ */
+
+
+jsonl_writer::jsonl_writer(sync_output_stream &out) :
+  m_out(out),
+  m_enc(record_opts())
+{
+}
+
+jsonl_writer::~jsonl_writer()
+{
+  try {
+    flush();
+  }
+  catch (const err &e) {
+    ELLIS_LOG(WARN, "jsonl_writer: unflushed output lost: %s", e.what());
+  }
+}
+
+void jsonl_writer::_next_buf()
+{
+  if (m_buf != nullptr) {
+    /* Current buffer is full; send it out. */
+    if (! m_out.emit(m_used)) {
+      m_buf = nullptr;
+      throw *(m_out.extract_output_error());
+    }
+  }
+  m_buf = nullptr;
+  m_cap = 0;
+  m_used = 0;
+  if (! m_out.next_output_buf(&m_buf, &m_cap)) {
+    m_buf = nullptr;
+    throw *(m_out.extract_output_error());
+  }
+  ELLIS_ASSERT(m_buf != nullptr);
+  ELLIS_ASSERT_GT(m_cap, 0);
+}
+
+void jsonl_writer::write(const node &rec)
+{
+  m_enc.reset(&rec);
+  while (1) {
+    if (m_used == m_cap) {
+      _next_buf();
+    }
+    size_t bc = m_cap - m_used;
+    auto st = m_enc.fill_buffer(m_buf + m_used, &bc);
+    m_used += bc;
+    if (st.state() == stream_state::ERROR) {
+      throw *(st.extract_error());
+    }
+    if (st.state() == stream_state::SUCCESS) {
+      break;
+    }
+  }
+  if (m_used == m_cap) {
+    _next_buf();
+  }
+  m_buf[m_used++] = '\n';
+  m_count++;
+}
+
+void jsonl_writer::flush()
+{
+  if (m_buf == nullptr) {
+    return;
+  }
+  /* Give the buffer back to the stream, even on failure. */
+  const size_t used = m_used;
+  m_buf = nullptr;
+  m_cap = 0;
+  m_used = 0;
+  if (used > 0 && ! m_out.emit(used)) {
+    throw *(m_out.extract_output_error());
+  }
+}
+
+size_t jsonl_writer::count() const
+{
+  return m_count;
+}
+
+
+}  /* namespace ellis */
@@ -34,93 +34,19 @@
 #include <ellis/core/map_node.hpp>
 #include <ellis/core/type.hpp>
 #include <ellis/core/u8str_node.hpp>
+#include <ellis_private/codec/util/element_stream.hpp>
+#include <ellis_private/codec/util/msgpack_format.hpp>
+#include <ellis_private/codec/util/node_builder.hpp>
+#include <ellis_private/codec/util/projection.hpp>
 #include <ellis_private/using.hpp>
 #include <ellis_private/utility.hpp>
 #include <endian.h>
 
-/* TODO: The encoder currently encodes an entire node at a time, thus copying
- * all the  memory given, which is wasteful. It should instead explicitly
- * represent its state in order to encode only as much of the buffer as is given
- * and do minimal copying.
- */
-
-/* We do this instead of an if statement or a range map for performance. */
-#define HEX_POS_FIXINT \
-       0x00: case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: \
-  case 0x07: case 0x08: case 0x09: case 0x0a: case 0x0b: case 0x0c: case 0x0d: \
-  case 0x0e: case 0x0f: case 0x10: case 0x11: case 0x12: case 0x13: case 0x14: \
-  case 0x15: case 0x16: case 0x17: case 0x18: case 0x19: case 0x1a: case 0x1b: \
-  case 0x1c: case 0x1d: case 0x1e: case 0x1f: case 0x20: case 0x21: case 0x22: \
-  case 0x23: case 0x24: case 0x25: case 0x26: case 0x27: case 0x28: case 0x29: \
-  case 0x2a: case 0x2b: case 0x2c: case 0x2d: case 0x2e: case 0x2f: case 0x30: \
-  case 0x31: case 0x32: case 0x33: case 0x34: case 0x35: case 0x36: case 0x37: \
-  case 0x38: case 0x39: case 0x3a: case 0x3b: case 0x3c: case 0x3d: case 0x3e: \
-  case 0x3f: case 0x40: case 0x41: case 0x42: case 0x43: case 0x44: case 0x45: \
-  case 0x46: case 0x47: case 0x48: case 0x49: case 0x4a: case 0x4b: case 0x4c: \
-  case 0x4d: case 0x4e: case 0x4f: case 0x50: case 0x51: case 0x52: case 0x53: \
-  case 0x54: case 0x55: case 0x56: case 0x57: case 0x58: case 0x59: case 0x5a: \
-  case 0x5b: case 0x5c: case 0x5d: case 0x5e: case 0x5f: case 0x60: case 0x61: \
-  case 0x62: case 0x63: case 0x64: case 0x65: case 0x66: case 0x67: case 0x68: \
-  case 0x69: case 0x6a: case 0x6b: case 0x6c: case 0x6d: case 0x6e: case 0x6f: \
-  case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x76: \
-  case 0x77: case 0x78: case 0x79: case 0x7a: case 0x7b: case 0x7c: case 0x7d: \
-  case 0x7e: case 0x7f
-
-#define HEX_FIXMAP \
-       0x80: case 0x81: case 0x82: case 0x83: case 0x84: case 0x85: case 0x86: \
-  case 0x87: case 0x88: case 0x89: case 0x8a: case 0x8b: case 0x8c: case 0x8d: \
-  case 0x8e: case 0x8f
-
-#define HEX_FIXARRAY \
-       0x90: case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: \
-  case 0x97: case 0x98: case 0x99: case 0x9a: case 0x9b: case 0x9c: case 0x9d: \
-  case 0x9e: case 0x9f
-
-#define HEX_FIXSTR \
-       0xa0: case 0xa1: case 0xa2: case 0xa3: case 0xa4: case 0xa5: case 0xa6: \
-  case 0xa7: case 0xa8: case 0xa9: case 0xaa: case 0xab: case 0xac: case 0xad: \
-  case 0xae: case 0xaf: case 0xb0: case 0xb1: case 0xb2: case 0xb3: case 0xb4: \
-  case 0xb5: case 0xb6: case 0xb7: case 0xb8: case 0xb9: case 0xba: case 0xbb: \
-  case 0xbc: case 0xbd: case 0xbe: case 0xbf
-
-#define HEX_NEG_FIXINT \
-       0xe0: case 0xe1: case 0xe2: case 0xe3: case 0xe4: case 0xe5: case 0xe6: \
-  case 0xe7: case 0xe8: case 0xe9: case 0xea: case 0xeb: case 0xec: case 0xed: \
-  case 0xee: case 0xef: case 0xf0: case 0xf1: case 0xf2: case 0xf3: case 0xf4: \
-  case 0xf5: case 0xf6: case 0xf7: case 0xf8: case 0xf9: case 0xfa: case 0xfb: \
-  case 0xfc: case 0xfd: case 0xfe: case 0xff
-
-#define HEX_NIL 0xc0
-#define HEX_UNUSED 0xc1
-#define HEX_FALSE 0xc2
-#define HEX_TRUE 0xc3
-#define HEX_BIN8 0xc4
-#define HEX_BIN16 0xc5
-#define HEX_BIN32 0xc6
-#define HEX_EXT 0xc7: case 0xc8: case 0xc9
-#define HEX_FLOAT32 0xca
-#define HEX_FLOAT64 0xcb
-#define HEX_UINT8 0xcc
-#define HEX_UINT16 0xcd
-#define HEX_UINT32 0xce
-#define HEX_UINT64 0xcf
-#define HEX_INT8 0xd0
-#define HEX_INT16 0xd1
-#define HEX_INT32 0xd2
-#define HEX_INT64 0xd3
-#define HEX_FIXEXT 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8
-#define HEX_STR8 0xd9
-#define HEX_STR16 0xda
-#define HEX_STR32 0xdb
-#define HEX_ARRAY16 0xdc
-#define HEX_ARRAY32 0xdd
-#define HEX_MAP16 0xde
-#define HEX_MAP32 0xdf
-
 namespace ellis {
 
 
-static class dummy_init {
+namespace {
+class dummy_init {
 public:
   dummy_init()
   {
@@ -133,963 +59,1014 @@ public:
           [](){ return unique_ptr<encoder>(new ellis::msgpack_encoder()); }));
   }
 } unused_dummy_init;
-
-
-enum class msgpack_type {
-  NIL,
-  FALSE,
-  TRUE,
-  POS_FIXINT,
-  NEG_FIXINT,
-  FIXMAP,
-  FIXARRAY,
-  FIXSTR,
-  BIN8,
-  BIN16,
-  BIN32,
-  /* ext not supported */
-  FLOAT32,
-  FLOAT64,
-  UINT8,
-  UINT16,
-  UINT32,
-  /* uint64 not supported */
-  INT8,
-  INT16,
-  INT32,
-  INT64,
-  /* fixext not supported */
-  STR8,
-  STR16,
-  STR32,
-  ARRAY16,
-  ARRAY32,
-  MAP16,
-  MAP32
-};
+}  /* namespace */
 
 
 msgpack_parse_ctx::msgpack_parse_ctx() :
-  state(msgpack_parse_state::UNDEFINED)
+  state(msgpack_parse_state::UNDEFINED),
+  node(ellis::type::NIL),
+  proj(projection::all())
 {
 }
 
 
-// TODO: doc
-msgpack_type get_msgpack_type(byte b)
-{
-  switch (b) {
-    case HEX_POS_FIXINT:
-      return msgpack_type::POS_FIXINT;
-
-    case HEX_FIXMAP:
-      return msgpack_type::FIXMAP;
-
-    case HEX_FIXARRAY:
-      return msgpack_type::FIXARRAY;
-
-    case HEX_FIXSTR:
-      return msgpack_type::FIXSTR;
-
-    case HEX_NIL:
-      return msgpack_type::NIL;
-
-    case HEX_UNUSED:
-      THROW_ELLIS_ERR(PARSE_FAIL,
-          "type byte is 0xc1, which can't be used");
+/** Upper bound on storage reserved up front on the strength of a length
+ * field, so that a bogus length can not make us allocate a lot of memory
+ * before noticing the input is short. */
+static constexpr size_t k_max_reserve = 1 << 20;
 
-    case HEX_FALSE:
-      return msgpack_type::FALSE;
+/** Binaries shorter than this are copied even when they could be sliced;
+ * copying a few bytes is cheaper than sharing the owner, and does not keep
+ * the whole input alive for their sake. */
+static constexpr size_t k_min_slice = 64;
 
-    case HEX_TRUE:
-      return msgpack_type::TRUE;
 
-    case HEX_BIN8:
-      return msgpack_type::BIN8;
+size_t msgpack_decoder::token_size(const byte *p, size_t avail) const
+{
+  const msgpack_type type = get_msgpack_type(p[0]);
+  const size_t hdr = header_len(type);
+  if (avail < hdr
+      || m_parse_stack.back().state == msgpack_parse_state::SKIP)
+  {
+    /* Skipped payloads are passed over without being gathered up. */
+    return hdr;
+  }
+  return hdr + payload_len(type, p);
+}
 
-    case HEX_BIN16:
-      return msgpack_type::BIN16;
 
-    case HEX_BIN32:
-      return msgpack_type::BIN32;
+progress msgpack_decoder::parse_token(const byte *p)
+{
+  msgpack_parse_ctx &ctx = m_parse_stack.back();
+  const msgpack_type type = get_msgpack_type(p[0]);
+  const size_t hdr = header_len(type);
+
+  if (ctx.state == msgpack_parse_state::SKIP) {
+    --m_skip_values;
+    switch (type) {
+      case msgpack_type::FIXMAP:
+      case msgpack_type::MAP16:
+      case msgpack_type::MAP32:
+        m_skip_values += 2 * element_count(type, p);
+        break;
+      case msgpack_type::FIXARRAY:
+      case msgpack_type::ARRAY16:
+      case msgpack_type::ARRAY32:
+        m_skip_values += element_count(type, p);
+        break;
+      default:
+        m_skip_bytes = payload_len(type, p);
+        break;
+    }
+    if (m_skip_values == 0 && m_skip_bytes == 0) {
+      /* A skipped value has no node; this is just a placeholder. */
+      return finish_top(node(ellis::type::NIL));
+    }
+    return progress(stream_state::CONTINUE);
+  }
 
-    case HEX_EXT:
-      THROW_ELLIS_ERR(TRANSLATE_FAIL,
-          "type byte corresponds to an ext type, which is unsupported");
+  if (ctx.state == msgpack_parse_state::MAP_KEY_TYPE) {
+    if (! type_is_string(type)) {
+      THROW_ELLIS_ERR(TRANSLATE_FAIL, "Map key must be a string");
+    }
+    ctx.key.assign((const char *)p + hdr, payload_len(type, p));
+    ctx.state = msgpack_parse_state::MAP_VALUE_DATA;
+    push_child(ctx);
+    return progress(stream_state::CONTINUE);
+  }
 
-    case HEX_FLOAT32:
-      return msgpack_type::FLOAT32;
+  if (m_parse_stack.size() == 1) {
+    /* Build the document in what the caller's last one was, if anything. */
+    ctx.node = std::move(m_result);
+  }
 
-    case HEX_FLOAT64:
-      return msgpack_type::FLOAT64;
+  switch (type) {
+    case msgpack_type::NIL:
+      return finish_top(node(ellis::type::NIL));
 
-    case HEX_UINT8:
-      return msgpack_type::UINT8;
+    case msgpack_type::FALSE:
+      return finish_top(node(false));
 
-    case HEX_UINT16:
-      return msgpack_type::UINT16;
+    case msgpack_type::TRUE:
+      return finish_top(node(true));
 
-    case HEX_UINT32:
-      return msgpack_type::UINT32;
+    case msgpack_type::POS_FIXINT:
+      return finish_top(node(static_cast<int64_t>(p[0])));
 
-    case HEX_UINT64:
-      THROW_ELLIS_ERR(TRANSLATE_FAIL,
-          "type byte corresponds to a uint64, which is unsupported");
+    case msgpack_type::NEG_FIXINT:
+      return finish_top(node(
+            static_cast<int64_t>(static_cast<int8_t>(p[0]))));
 
-    case HEX_INT8:
-      return msgpack_type::INT8;
+    case msgpack_type::UINT8:
+      return finish_top(node(static_cast<int64_t>(p[1])));
 
-    case HEX_INT16:
-      return msgpack_type::INT16;
+    case msgpack_type::UINT16:
+      return finish_top(node(
+            static_cast<int64_t>(load_be<uint16_t>(p + 1))));
 
-    case HEX_INT32:
-      return msgpack_type::INT32;
+    case msgpack_type::UINT32:
+      return finish_top(node(
+            static_cast<int64_t>(load_be<uint32_t>(p + 1))));
 
-    case HEX_INT64:
-      return msgpack_type::INT64;
+    case msgpack_type::INT8:
+      return finish_top(node(
+            static_cast<int64_t>(static_cast<int8_t>(p[1]))));
 
-    case HEX_FIXEXT:
-      THROW_ELLIS_ERR(TRANSLATE_FAIL,
-          "type byte maps fixext, which is unsupported");
+    case msgpack_type::INT16:
+      return finish_top(node(static_cast<int64_t>(
+              union_cast<uint16_t, int16_t>(load_be<uint16_t>(p + 1)))));
 
-    case HEX_STR8:
-      return msgpack_type::STR8;
+    case msgpack_type::INT32:
+      return finish_top(node(static_cast<int64_t>(
+              union_cast<uint32_t, int32_t>(load_be<uint32_t>(p + 1)))));
 
-    case HEX_STR16:
-      return msgpack_type::STR16;
+    case msgpack_type::INT64:
+      return finish_top(node(
+            union_cast<uint64_t, int64_t>(load_be<uint64_t>(p + 1))));
 
-    case HEX_STR32:
-      return msgpack_type::STR32;
+    case msgpack_type::FLOAT32:
+      return finish_top(node(static_cast<double>(
+              union_cast<uint32_t, float>(load_be<uint32_t>(p + 1)))));
 
-    case HEX_ARRAY16:
-      return msgpack_type::ARRAY16;
+    case msgpack_type::FLOAT64:
+      return finish_top(node(
+            union_cast<uint64_t, double>(load_be<uint64_t>(p + 1))));
 
-    case HEX_ARRAY32:
-      return msgpack_type::ARRAY32;
+    case msgpack_type::FIXSTR:
+    case msgpack_type::STR8:
+    case msgpack_type::STR16:
+    case msgpack_type::STR32:
+      return finish_top(node_builder::make_string(std::move(ctx.node),
+            (const char *)p + hdr, payload_len(type, p)));
 
-    case HEX_MAP16:
-      return msgpack_type::MAP16;
+    case msgpack_type::BIN8:
+    case msgpack_type::BIN16:
+    case msgpack_type::BIN32:
+      {
+        const byte *data = p + hdr;
+        const size_t len = payload_len(type, p);
+        if (m_slice_owner && len >= k_min_slice
+            && data >= m_slice_begin && data + len <= m_slice_end) {
+          return finish_top(node(m_slice_owner, data, len));
+        }
+        return finish_top(
+            node_builder::make_binary(std::move(ctx.node), data, len));
+      }
 
-    case HEX_MAP32:
-      return msgpack_type::MAP32;
+    case msgpack_type::FIXARRAY:
+    case msgpack_type::ARRAY16:
+    case msgpack_type::ARRAY32:
+      {
+        const uint64_t len = element_count(type, p);
+        ctx.node = m_build->begin_array(std::move(ctx.node));
+        if (len == 0) {
+          m_build->end_array(ctx.node);
+          return finish_top(std::move(ctx.node));
+        }
+        if (! at_stream()) {
+          ctx.node.as_mutable_array().reserve(
+              std::min<uint64_t>(len, k_max_reserve));
+        }
+        ctx.data_len = len;
+        ctx.state = msgpack_parse_state::ARRAY_DATA;
+        push_child(ctx);
+        return progress(stream_state::CONTINUE);
+      }
 
-    case HEX_NEG_FIXINT:
-      return msgpack_type::NEG_FIXINT;
-    default:
-      ELLIS_ASSERT_UNREACHABLE();
+    case msgpack_type::FIXMAP:
+    case msgpack_type::MAP16:
+    case msgpack_type::MAP32:
+      {
+        const uint64_t len = element_count(type, p);
+        ctx.node = m_build->begin_map(std::move(ctx.node));
+        if (len == 0) {
+          m_build->end_map(ctx.node);
+          return finish_top(std::move(ctx.node));
+        }
+        ctx.map_len = len;
+        ctx.state = msgpack_parse_state::MAP_KEY_TYPE;
+        return progress(stream_state::CONTINUE);
+      }
   }
+  ELLIS_ASSERT_UNREACHABLE();
 }
 
 
-template <typename T>
-static inline
-T accum_be(T num, byte b)
-{
-  return (num << 8) | b;
-}
-
-
-void accum_header(msgpack_parse_ctx & ctx, byte b, msgpack_parse_state next)
+progress msgpack_decoder::finish_top(node &&done)
 {
-  ctx.data_len = accum_be(ctx.data_len, b);
-  --ctx.header_len;
-  if (ctx.header_len == 0) {
-    ctx.state = next;
+  /*
+   * Absorb the finished value into its parent, and so on down the stack for
+   * as long as that finishes the parent too.
+   */
+  node cur(std::move(done));
+  while (m_parse_stack.size() > 1) {
+    const bool skipped = (m_parse_stack.back().proj == nullptr);
+    m_parse_stack.pop_back();
+    m_onpath = std::min(m_onpath, m_parse_stack.size());
+    msgpack_parse_ctx &parent = m_parse_stack.back();
+    if (parent.state == msgpack_parse_state::ARRAY_DATA) {
+      if (at_stream()) {
+        if (! skipped || ! parent.proj->none_from(m_stream->count())) {
+          m_stream->deliver(make_unique<node>(std::move(cur)));
+        }
+      }
+      else if (! skipped
+          || ! parent.proj->none_from(parent.node.as_array().length())) {
+        /* Skipped elements are kept as nulls while later elements are
+         * selected, so that those keep their indices. */
+        m_build->append(parent.node, std::move(cur));
+      }
+      if (--parent.data_len > 0) {
+        push_child(parent);
+        return progress(stream_state::CONTINUE);
+      }
+      m_build->end_array(parent.node);
+    }
+    else {
+      ELLIS_ASSERT(parent.state == msgpack_parse_state::MAP_VALUE_DATA);
+      if (! skipped) {
+        m_build->insert(parent.node, parent.key, std::move(cur));
+      }
+      if (--parent.map_len > 0) {
+        parent.state = msgpack_parse_state::MAP_KEY_TYPE;
+        return progress(stream_state::CONTINUE);
+      }
+      m_build->end_map(parent.node);
+    }
+    cur = std::move(parent.node);
   }
-}
 
-
-void init_vec_data(msgpack_parse_ctx & ctx, size_t len)
-{
-  ctx.buf = make_unique<vector<byte>>();
-  ctx.buf->reserve(len);
+  m_parse_stack.pop_back();
+  m_result = std::move(cur);
+  return progress(true);
 }
 
 
-void msgpack_decoder::accum_str_header(msgpack_parse_ctx & ctx, byte b)
+void msgpack_decoder::push_child(msgpack_parse_ctx &parent)
 {
-  accum_header(ctx, b, msgpack_parse_state::STR_DATA);
-  if (ctx.state == msgpack_parse_state::STR_DATA) {
-    init_vec_data(ctx, ctx.data_len);
+  const size_t depth = m_parse_stack.size() - 1;
+  const bool track = m_stream && m_onpath == depth + 1;
+  const projection *proj = parent.proj;
+  bool on_path = false;
+  if (parent.node.get_type() == type::ARRAY) {
+    const size_t i = at_stream()
+      ? m_stream->count()
+      : parent.node.as_array().length();
+    if (proj != projection::all()) {
+      proj = proj->index(i);
+    }
+    on_path = track && m_stream->on_path(depth, i);
   }
-}
-
-
-void msgpack_decoder::accum_map_key_header(msgpack_parse_ctx & ctx, byte b)
-{
-  accum_header(ctx, b, msgpack_parse_state::MAP_KEY_DATA);
-  if (ctx.state == msgpack_parse_state::MAP_KEY_DATA) {
-    /* We store the map length separately from data length so we don't
-     * clobber it when we start parsing the data length of each map key. */
-    init_vec_data(ctx, ctx.data_len);
-    ctx.map_len = ctx.data_len;
+  else if (proj != projection::all() || track) {
+    if (proj != projection::all()) {
+      proj = proj->key(parent.key);
+    }
+    on_path = track && m_stream->on_path(depth, parent.key);
   }
-}
-
-
-void msgpack_decoder::accum_bin_header(msgpack_parse_ctx & ctx, byte b)
-{
-  accum_header(ctx, b, msgpack_parse_state::BIN_DATA);
-  if (ctx.state == msgpack_parse_state::BIN_DATA) {
-    init_vec_data(ctx, ctx.data_len);
+  if (on_path) {
+    m_onpath++;
+  }
+  /* What the child replaces, if we are building over an old document. */
+  node old(type::NIL);
+  if (proj != nullptr) {
+    old = (parent.node.get_type() == type::ARRAY)
+      ? m_build->element(parent.node)
+      : m_build->entry(parent.node, parent.key);
+  }
+  /* Note that this may invalidate parent. */
+  m_parse_stack.emplace_back();
+  msgpack_parse_ctx &child = m_parse_stack.back();
+  child.node = std::move(old);
+  child.proj = proj;
+  if (proj == nullptr) {
+    child.state = msgpack_parse_state::SKIP;
+    m_skip_values = 1;
+    m_skip_bytes = 0;
   }
 }
 
 
-node_progress msgpack_decoder::accum_arr_header(msgpack_parse_ctx & ctx, byte b)
+msgpack_decoder::msgpack_decoder() :
+  m_root_proj(projection::all()),
+  m_build(make_unique<node_builder>()),
+  m_result(type::NIL)
 {
-  accum_header(ctx, b, msgpack_parse_state::ARRAY_DATA);
-  if (ctx.state == msgpack_parse_state::ARRAY_DATA) {
-    /* Empty array. */
-    unique_ptr<node> n = make_unique<node>(ellis::type::ARRAY);
-    if (ctx.data_len == 0) {
-      return node_progress(std::move(n));
-    }
-    else {
-      ctx.node = std::move(n);
-      m_parse_stack.emplace_back();
-    }
-  }
-  return node_progress(stream_state::CONTINUE);
+  msgpack_decoder::reset();
 }
 
 
-node_progress msgpack_decoder::accum_map_header(msgpack_parse_ctx & ctx, byte b)
+msgpack_decoder::~msgpack_decoder()
 {
-  const msgpack_parse_state next = msgpack_parse_state::MAP_KEY_TYPE;
-  accum_header(ctx, b, next);
-  if (ctx.state == next) {
-    /* We store the map length separately from data length so we don't
-     * clobber it when we start parsing the data length of each map key. */
-    ctx.map_len = ctx.data_len;
-    unique_ptr<node> n = make_unique<node>(ellis::type::MAP);
-    if (ctx.map_len == 0) {
-      return node_progress(std::move(n));
-    }
-    else {
-      ctx.node = std::move(n);
-    }
-  }
-  return node_progress(stream_state::CONTINUE);
 }
 
 
-template <typename T>
-node_progress accum_num_data(msgpack_parse_ctx & ctx, byte b)
+void msgpack_decoder::set_projection(const vector<string> &paths)
 {
-  ctx.data = accum_be(ctx.data, b);
-  --ctx.data_len;
-  if (ctx.data_len == 0) {
-    unique_ptr<node> n = make_unique<node>(
-        union_cast<decltype(ctx.data), T>(ctx.data));
-    return node_progress(std::move(n));
-  }
-  return node_progress(stream_state::CONTINUE);
+  m_proj = make_unique<projection>(paths);
+  m_root_proj = m_proj.get();
+  m_result = node(type::NIL);
+  reset();
 }
 
 
-bool accum_str(msgpack_parse_ctx & ctx, byte b)
+void msgpack_decoder::clear_projection()
 {
-  ctx.buf->push_back(b);
-  --ctx.data_len;
-  if (ctx.data_len == 0) {
-    return true;
-  }
-  return false;
+  m_root_proj = projection::all();
+  reset();
+  m_proj.reset();
 }
 
 
-node_progress accum_str_node(msgpack_parse_ctx & ctx, byte b)
+void msgpack_decoder::set_element_callback(const string &path, element_fn fn)
 {
-  bool done = accum_str(ctx, b);
-  if (done) {
-    /* TODO: Should not have to copy into a string */
-    const string s((char *) ctx.buf->data(), ctx.buf->size());
-    unique_ptr<node> n = make_unique<node>(std::move(s));
-    return node_progress(std::move(n));
-  }
-
-  return node_progress(stream_state::CONTINUE);
+  m_stream = make_unique<element_stream>(path, std::move(fn));
+  m_result = node(type::NIL);
+  reset();
 }
 
 
-node_progress accum_bin(msgpack_parse_ctx & ctx, byte b)
+void msgpack_decoder::clear_element_callback()
 {
-  ctx.buf->push_back(b);
-  --ctx.data_len;
-  if (ctx.data_len == 0) {
-    unique_ptr<node> n = make_unique<node>(ctx.buf->data(), ctx.buf->size());
-    return node_progress(std::move(n));
-  }
-  return node_progress(stream_state::CONTINUE);
+  m_stream.reset();
+  reset();
 }
 
 
-bool type_is_string(msgpack_type type)
+void msgpack_decoder::set_slice_source(
+    std::shared_ptr<const void> owner,
+    const void *buf,
+    size_t len)
 {
-  switch (type) {
-    case msgpack_type::FIXSTR:
-    case msgpack_type::STR8:
-    case msgpack_type::STR16:
-    case msgpack_type::STR32:
-      return true;
-    default:
-      return false;
-  }
+  m_slice_owner = std::move(owner);
+  m_slice_begin = (const byte *)buf;
+  m_slice_end = m_slice_begin + len;
 }
 
 
-uint_fast32_t get_fixstr_length(byte b) {
-  return b & 0x1f;
+void msgpack_decoder::clear_slice_source()
+{
+  m_slice_owner.reset();
+  m_slice_begin = nullptr;
+  m_slice_end = nullptr;
 }
 
 
-node_progress progmore()
+bool msgpack_decoder::at_stream() const
 {
-  return node_progress(stream_state::CONTINUE);
+  return m_stream
+    && m_onpath == m_parse_stack.size()
+    && m_onpath == m_stream->steps() + 1
+    && m_parse_stack.back().node.get_type() == type::ARRAY;
 }
 
 
-node_progress msgpack_decoder::handle_type(msgpack_parse_ctx &ctx, byte b)
+/** Decodes as consume_buffer_into does, leaving the value in m_result. */
+progress msgpack_decoder::consume(
+    const byte *buf,
+    size_t *bytecount)
 {
-  msgpack_type type = get_msgpack_type(b);
-  switch (type) {
-    case msgpack_type::NIL:
-      return node_progress(make_unique<node>(ellis::type::NIL));
-
-    case msgpack_type::FALSE:
-      return node_progress(make_unique<node>(false));
-
-    case msgpack_type::TRUE:
-      return node_progress(make_unique<node>(true));
-
-    case msgpack_type::POS_FIXINT:
-      return node_progress(make_unique<node>(static_cast<uint8_t>(b)));
-
-    case msgpack_type::NEG_FIXINT:
-      return node_progress(make_unique<node>(static_cast<int8_t>(b)));
-
-    /* TODO: refactor so the FIX* versions don't require any duplication. */
-
-    case msgpack_type::FIXMAP:
-      ctx.state = msgpack_parse_state::MAP_KEY_TYPE;
-      ctx.map_len = b & 0x0f;
-      {
-        unique_ptr<node> n = make_unique<node>(ellis::type::MAP);
-        if (ctx.map_len == 0) {
-          return node_progress(std::move(n));
+  const byte *p = buf;
+  const byte *end = buf + *bytecount;
+  try {
+    while (true) {
+      if (m_skip_bytes > 0) {
+        /* Pass over skipped payload in bulk. */
+        const size_t n = std::min<uint64_t>(m_skip_bytes, end - p);
+        m_skip_bytes -= n;
+        p += n;
+        if (m_skip_bytes > 0) {
+          break;
         }
-        else {
-          ctx.node = std::move(n);
+        if (m_skip_values == 0) {
+          progress st = finish_top(node(type::NIL));
+          if (st.state() != stream_state::CONTINUE) {
+            *bytecount = end - p;
+            return st;
+          }
         }
+        continue;
       }
-      return progmore();
 
-    case msgpack_type::FIXARRAY:
-      ctx.state = msgpack_parse_state::ARRAY_DATA;
-      ctx.data_len = b & 0x0f;
-      {
-        unique_ptr<node> n = make_unique<node>(ellis::type::ARRAY);
-        if (ctx.data_len == 0) {
-          return node_progress(std::move(n));
+      /* Decode straight out of the caller's buffer when the whole value is
+       * there; otherwise gather it up in m_carry across calls. */
+      const bool carrying = ! m_carry.empty();
+      if (! carrying && p == end) {
+        break;
+      }
+      const byte *tok = carrying ? m_carry.data() : p;
+      const size_t avail = carrying ? m_carry.size() : end - p;
+      const size_t need = token_size(tok, avail);
+      if (need > avail) {
+        if (p == end) {
+          break;
         }
-        else {
-          ctx.node = std::move(n);
-          m_parse_stack.emplace_back();
+        if (! carrying) {
+          m_carry.reserve(std::min(need, k_max_reserve));
         }
+        const size_t n = std::min<size_t>(need - avail, end - p);
+        m_carry.insert(m_carry.end(), p, p + n);
+        p += n;
+        continue;
       }
-      return progmore();
-
-    case msgpack_type::FIXSTR:
-      ctx.state = msgpack_parse_state::STR_DATA;
-      ctx.data_len = get_fixstr_length(b);
-      if (ctx.data_len == 0) {
-        return node_progress(make_unique<node>(""));
+      progress st = parse_token(tok);
+      if (carrying) {
+        m_carry.clear();
+        if (m_carry.capacity() > k_max_reserve) {
+          vector<byte>().swap(m_carry);
+        }
       }
-      init_vec_data(ctx, ctx.data_len);
-      return progmore();
-
-    case msgpack_type::BIN8:
-      ctx.state = msgpack_parse_state::BIN_DATA;
-      ctx.header_len = sizeof(uint8_t);
-      return progmore();
-
-    case msgpack_type::BIN16:
-      ctx.state = msgpack_parse_state::BIN_DATA;
-      ctx.header_len = sizeof(uint16_t);
-      return progmore();
-
-    case msgpack_type::BIN32:
-      ctx.state = msgpack_parse_state::BIN_DATA;
-      ctx.header_len = sizeof(uint32_t);
-      return progmore();
-
-    case msgpack_type::FLOAT32:
-      ctx.state = msgpack_parse_state::FLOAT32_DATA;
-      ctx.data_len = sizeof(float);
-      ctx.data = 0;
-      return progmore();
-
-    case msgpack_type::FLOAT64:
-      ctx.state = msgpack_parse_state::FLOAT64_DATA;
-      ctx.data_len = sizeof(double);
-      ctx.data = 0;
-      return progmore();
-
-    case msgpack_type::UINT8:
-      ctx.state = msgpack_parse_state::UINT8_DATA;
-      ctx.data_len = sizeof(uint8_t);
-      ctx.data = 0;
-      return progmore();
-
-    case msgpack_type::UINT16:
-      ctx.state = msgpack_parse_state::UINT16_DATA;
-      ctx.data_len = sizeof(uint16_t);
-      ctx.data = 0;
-      return progmore();
-
-    case msgpack_type::UINT32:
-      ctx.state = msgpack_parse_state::UINT32_DATA;
-      ctx.data_len = sizeof(uint32_t);
-      ctx.data = 0;
-      return progmore();
-
-    case msgpack_type::INT8:
-      ctx.state = msgpack_parse_state::INT8_DATA;
-      ctx.data_len = sizeof(int8_t);
-      ctx.data = 0;
-      return progmore();
-
-    case msgpack_type::INT16:
-      ctx.state = msgpack_parse_state::INT16_DATA;
-      ctx.data_len = sizeof(int16_t);
-      ctx.data = 0;
-      return progmore();
-
-    case msgpack_type::INT32:
-      ctx.state = msgpack_parse_state::INT32_DATA;
-      ctx.data_len = sizeof(int32_t);
-      ctx.data = 0;
-      return progmore();
+      else {
+        p += need;
+      }
+      if (st.state() != stream_state::CONTINUE) {
+        *bytecount = end - p;
+        return st;
+      }
+    }
+  }
+  catch (const err &e) {
+    return progress(make_unique<err>(e));
+  }
+  *bytecount = 0;
+  return progress(stream_state::CONTINUE);
+}
 
-    case msgpack_type::INT64:
-      ctx.state = msgpack_parse_state::INT64_DATA;
-      ctx.data_len = sizeof(int64_t);
-      ctx.data = 0;
-      return progmore();
 
-    case msgpack_type::STR8:
-      ctx.state = msgpack_parse_state::STR_HEADER;
-      ctx.header_len = sizeof(uint8_t);
-      return progmore();
+node_progress msgpack_decoder::consume_buffer(
+    const byte *buf,
+    size_t *bytecount)
+{
+  progress st = consume(buf, bytecount);
+  switch (st.state()) {
+    case stream_state::ERROR:
+      return node_progress(st.extract_error());
 
-    case msgpack_type::STR16:
-      ctx.state = msgpack_parse_state::STR_HEADER;
-      ctx.header_len = sizeof(uint16_t);
-      return progmore();
+    case stream_state::SUCCESS:
+      return node_progress(make_unique<node>(std::move(m_result)));
 
-    case msgpack_type::STR32:
-      ctx.state = msgpack_parse_state::STR_HEADER;
-      ctx.header_len = sizeof(uint32_t);
-      return progmore();
+    case stream_state::CONTINUE:
+      break;
+  }
+  return node_progress(stream_state::CONTINUE);
+}
 
-    case msgpack_type::ARRAY16:
-      ctx.state = msgpack_parse_state::ARRAY_HEADER;
-      ctx.header_len = sizeof(uint16_t);
-      return progmore();
 
-    case msgpack_type::ARRAY32:
-      ctx.state = msgpack_parse_state::ARRAY_HEADER;
-      ctx.header_len = sizeof(uint32_t);
-      return progmore();
+progress msgpack_decoder::consume_buffer_into(
+    const byte *buf,
+    size_t *bytecount,
+    node *out)
+{
+  progress st = consume(buf, bytecount);
+  if (st.state() == stream_state::SUCCESS) {
+    if (m_root_proj == projection::all() && ! m_stream) {
+      /* Keep what *out held, to build the next document in. */
+      out->swap(m_result);
+    }
+    else {
+      *out = std::move(m_result);
+    }
+  }
+  return st;
+}
 
-    case msgpack_type::MAP16:
-      ctx.state = msgpack_parse_state::MAP_HEADER;
-      ctx.header_len = sizeof(uint16_t);
-      return progmore();
 
-    case msgpack_type::MAP32:
-      ctx.state = msgpack_parse_state::MAP_HEADER;
-      ctx.header_len = sizeof(uint32_t);
-      return progmore();
+void msgpack_decoder::reset()
+{
+  m_parse_stack.clear();
+  m_parse_stack.emplace_back();
+  m_parse_stack.back().proj = m_root_proj;
+  /* The root is always on the path to the streamed array. */
+  m_onpath = 1;
+  if (m_stream) {
+    m_stream->reset();
   }
-  ELLIS_ASSERT_UNREACHABLE();
+  m_skip_values = 0;
+  m_skip_bytes = 0;
+  m_carry.clear();
+  m_build->reset();
 }
 
 
-node_progress msgpack_decoder::parse_byte(byte b)
+unique_ptr<err> msgpack_decoder::chop_error() const
 {
-  /* TODO: Don't copy if the entire buffer is available in memory (IOW, skip buf
-   * in that case. */
+  /* Every msgpack value ends on its own, so there is never a value to
+   * return here; only a distinction between no input and too little. */
+  const bool started = m_parse_stack.size() > 1
+    || (m_parse_stack.size() == 1
+        && m_parse_stack.back().state != msgpack_parse_state::UNDEFINED)
+    || ! m_carry.empty()
+    || m_skip_bytes > 0;
+  if (! started) {
+    return MAKE_UNIQUE_ELLIS_ERR(PARSE_FAIL, "no msgpack value in input");
+  }
+  return MAKE_UNIQUE_ELLIS_ERR(PARSE_FAIL, "truncated input");
+}
 
-  /*
-   * Reserve storage so that the reference we make here does not get
-   * invalidated if we push another context onto the stack. Reserve twice the
-   * amount we need so we get amortized O(1) time in copying elements.
-   */
-  m_parse_stack.reserve(m_parse_stack.size() * 2);
 
-  msgpack_parse_ctx &ctx = m_parse_stack.back();
-  node_progress prog(stream_state::CONTINUE);
-  switch (ctx.state) {
-    case msgpack_parse_state::UNDEFINED:
-      prog = handle_type(ctx, b);
-      break;
+node_progress msgpack_decoder::chop()
+{
+  return node_progress(chop_error());
+}
 
-    case msgpack_parse_state::STR_HEADER:
-      accum_str_header(ctx, b);
-      break;
 
-    case msgpack_parse_state::BIN_HEADER:
-      accum_bin_header(ctx, b);
-      break;
+progress msgpack_decoder::chop_into(node *)
+{
+  return progress(chop_error());
+}
 
-    case msgpack_parse_state::ARRAY_HEADER:
-      prog = accum_arr_header(ctx, b);
-      break;
 
-    case msgpack_parse_state::MAP_HEADER:
-      prog = accum_map_header(ctx, b);
-      break;
+/*  _____                     _
+ * | ____|_ __   ___ ___   __| | ___ _ __
+ * |  _| | '_ \ / __/ _ \ / _` |/ _ \ '__|
+ * | |___| | | | (_| (_) | (_| |  __/ |
+ * |_____|_| |_|\___\___/ \__,_|\___|_|
+ *
+ */
 
-    case msgpack_parse_state::UINT8_DATA:
-      prog = node_progress(make_unique<node>(static_cast<int64_t>(b)));
-      break;
 
-    case msgpack_parse_state::UINT16_DATA:
-      prog = accum_num_data<uint16_t>(ctx, b);
-      break;
+/** Writes an unsigned integer big-endian; returns the number of bytes. */
+template <typename T>
+static inline
+size_t store_be(byte *dst, T val)
+{
+  uint64_t v = val;
+  for (size_t i = sizeof(T); i > 0; i--) {
+    dst[i - 1] = static_cast<byte>(v & 0xff);
+    v >>= 8;
+  }
+  return sizeof(T);
+}
 
-    case msgpack_parse_state::UINT32_DATA:
-      prog = accum_num_data<uint32_t>(ctx, b);
-      break;
 
-    case msgpack_parse_state::INT8_DATA:
-      prog = accum_num_data<int8_t>(ctx, b);
-      break;
+msgpack_encoder::msgpack_encoder()
+{
+}
 
-    case msgpack_parse_state::INT16_DATA:
-      prog = accum_num_data<int16_t>(ctx, b);
-      break;
 
-    case msgpack_parse_state::INT32_DATA:
-      prog = accum_num_data<int32_t>(ctx, b);
-      break;
+/** Writes a string header for the given length to dst; returns its size. */
+size_t msgpack_encoder::_str_header(size_t len, byte *dst)
+{
+  if (len <= 31) {
+    dst[0] = 0xa0 | len;
+    return 1;
+  }
+  else if (len <= UINT8_MAX) {
+    dst[0] = HEX_STR8;
+    return 1 + store_be(dst + 1, (uint8_t)len);
+  }
+  else if (len <= UINT16_MAX) {
+    dst[0] = HEX_STR16;
+    return 1 + store_be(dst + 1, (uint16_t)len);
+  }
+  else if (len <= UINT32_MAX) {
+    dst[0] = HEX_STR32;
+    return 1 + store_be(dst + 1, (uint32_t)len);
+  }
+  THROW_ELLIS_ERR(TRANSLATE_FAIL, "String too long for msgpack");
+}
 
-    case msgpack_parse_state::INT64_DATA:
-      prog = accum_num_data<int64_t>(ctx, b);
-      break;
 
-    case msgpack_parse_state::FLOAT32_DATA:
-      prog = accum_num_data<float>(ctx, b);
-      break;
+/** Writes the header of n to dst, and returns its size.
+ *
+ * Scalars are written whole.  For strings and binaries, the body is left in
+ * m_body; for non-empty containers, a frame is pushed to write their
+ * contents.
+ */
+size_t msgpack_encoder::_header(const node &n, byte *dst)
+{
+  switch (n.get_type()) {
+    case type::NIL:
+      dst[0] = HEX_NIL;
+      return 1;
 
-    case msgpack_parse_state::FLOAT64_DATA:
-      prog = accum_num_data<double>(ctx, b);
-      break;
+    case type::BOOL:
+      dst[0] = (n == true) ? HEX_TRUE : HEX_FALSE;
+      return 1;
 
-    case msgpack_parse_state::STR_DATA:
-      prog = accum_str_node(ctx, b);
-      break;
+    case type::INT64:
+      {
+        int64_t val = n.as_int64();
+        if (val < 0) {
+          if (val >= -32) {
+            dst[0] = static_cast<byte>(val);
+            return 1;
+          }
+          else if (val >= INT8_MIN) {
+            dst[0] = HEX_INT8;
+            return 1 + store_be(dst + 1, union_cast<int64_t, uint8_t>(val));
+          }
+          else if (val >= INT16_MIN) {
+            dst[0] = HEX_INT16;
+            return 1 + store_be(dst + 1, union_cast<int64_t, uint16_t>(val));
+          }
+          else if (val >= INT32_MIN) {
+            dst[0] = HEX_INT32;
+            return 1 + store_be(dst + 1, union_cast<int64_t, uint32_t>(val));
+          }
+        }
+        else {
+          if (val <= 127) {
+            dst[0] = static_cast<byte>(val);
+            return 1;
+          }
+          else if (val <= UINT8_MAX) {
+            dst[0] = HEX_UINT8;
+            return 1 + store_be(dst + 1, (uint8_t)val);
+          }
+          else if (val <= UINT16_MAX) {
+            dst[0] = HEX_UINT16;
+            return 1 + store_be(dst + 1, (uint16_t)val);
+          }
+          else if (val <= UINT32_MAX) {
+            dst[0] = HEX_UINT32;
+            return 1 + store_be(dst + 1, (uint32_t)val);
+          }
+        }
+        /* Ellis doesn't support uint64, so use int64 for big positives. */
+        dst[0] = HEX_INT64;
+        return 1 + store_be(dst + 1, union_cast<int64_t, uint64_t>(val));
+      }
 
-    case msgpack_parse_state::BIN_DATA:
-      prog = accum_bin(ctx, b);
-      break;
+    case type::DOUBLE:
+      dst[0] = HEX_FLOAT64;
+      return 1 + store_be(dst + 1, union_cast<double, uint64_t>(n.as_double()));
 
-    case msgpack_parse_state::ARRAY_DATA:
-      ELLIS_ASSERT_UNREACHABLE();
-      break;
+    case type::U8STR:
+      {
+        const u8str_node &s = n.as_u8str();
+        m_body = (const byte *)s.c_str();
+        m_body_len = s.length();
+        return _str_header(m_body_len, dst);
+      }
 
-    case msgpack_parse_state::MAP_KEY_TYPE:
+    case type::ARRAY:
       {
-        msgpack_type type = get_msgpack_type(b);
-        if (!type_is_string(type)) {
-          THROW_ELLIS_ERR(TRANSLATE_FAIL, "Map key must be a string");
+        const size_t len = n.as_array().length();
+        size_t hlen;
+        if (len <= 15) {
+          dst[0] = 0x90 | len;
+          hlen = 1;
         }
-        if (type != msgpack_type::FIXSTR) {
-          ctx.state = msgpack_parse_state::MAP_KEY_HEADER;
+        else if (len <= UINT16_MAX) {
+          dst[0] = HEX_ARRAY16;
+          hlen = 1 + store_be(dst + 1, (uint16_t)len);
+        }
+        else if (len <= UINT32_MAX) {
+          dst[0] = HEX_ARRAY32;
+          hlen = 1 + store_be(dst + 1, (uint32_t)len);
         }
         else {
-          ctx.data_len = get_fixstr_length(b);
-          ctx.state = msgpack_parse_state::MAP_KEY_DATA;
-          init_vec_data(ctx, ctx.data_len);
+          THROW_ELLIS_ERR(TRANSLATE_FAIL, "Too many array elements for msgpack");
         }
+        if (len > 0) {
+          m_stack.push_back(frame{ &n, 0, {}, false });
+        }
+        return hlen;
       }
-      break;
-
-    case msgpack_parse_state::MAP_KEY_HEADER:
-      accum_map_key_header(ctx, b);
-      break;
 
-    case msgpack_parse_state::MAP_KEY_DATA:
+    case type::BINARY:
       {
-        bool done = accum_str(ctx, b);
-        if (done) {
-          ctx.state = msgpack_parse_state::MAP_VALUE_DATA;
-          m_parse_stack.emplace_back();
+        const binary_node &b = n.as_binary();
+        const size_t len = b.length();
+        m_body = b.data();
+        m_body_len = len;
+        if (len <= UINT8_MAX) {
+          dst[0] = HEX_BIN8;
+          return 1 + store_be(dst + 1, (uint8_t)len);
         }
+        else if (len <= UINT16_MAX) {
+          dst[0] = HEX_BIN16;
+          return 1 + store_be(dst + 1, (uint16_t)len);
+        }
+        else if (len <= UINT32_MAX) {
+          dst[0] = HEX_BIN32;
+          return 1 + store_be(dst + 1, (uint32_t)len);
+        }
+        THROW_ELLIS_ERR(TRANSLATE_FAIL, "Binary too long for msgpack");
       }
-      break;
-
-    case msgpack_parse_state::MAP_VALUE_DATA:
-      ELLIS_ASSERT_UNREACHABLE();
-      break;
 
-    case msgpack_parse_state::COMPLETE:
-      ELLIS_ASSERT_UNREACHABLE();
-  }
-
-  if (prog.state() != stream_state::SUCCESS) {
-    return prog;
+    case type::MAP:
+      {
+        const map_node &m = n.as_map();
+        const size_t len = m.length();
+        size_t hlen;
+        if (len <= 15) {
+          dst[0] = 0x80 | len;
+          hlen = 1;
+        }
+        else if (len <= UINT16_MAX) {
+          dst[0] = HEX_MAP16;
+          hlen = 1 + store_be(dst + 1, (uint16_t)len);
+        }
+        else if (len <= UINT32_MAX) {
+          dst[0] = HEX_MAP32;
+          hlen = 1 + store_be(dst + 1, (uint32_t)len);
+        }
+        else {
+          THROW_ELLIS_ERR(TRANSLATE_FAIL, "Too many map entries for msgpack");
+        }
+        if (len > 0) {
+          m_stack.push_back(frame{ &n, 0, {}, false });
+          auto &entries = m_stack.back().entries;
+          entries.reserve(len);
+          m.foreach([&entries](const string &k, const node &v) {
+              entries.emplace_back(&k, &v);
+            });
+        }
+        return hlen;
+      }
   }
-  ctx.node = std::move(prog.extract_value());
-  ctx.state = msgpack_parse_state::COMPLETE;
-
-  /*
-   * Reduce the stack by absorbing the top of the stack into parent containers
-   * lower in the stack.
-   */
+  ELLIS_ASSERT_UNREACHABLE();
+}
 
-  while (m_parse_stack.size() > 1) {
-    msgpack_parse_ctx &top = m_parse_stack.back();
-    if (top.state != msgpack_parse_state::COMPLETE) {
-      /* Node is not complete. */
-      return node_progress(stream_state::CONTINUE);
-    }
 
-    unique_ptr<node> n = std::move(top.node);
-    m_parse_stack.pop_back();
-    msgpack_parse_ctx &parent = m_parse_stack.back();
-    if (parent.node->get_type() == type::ARRAY) {
-      parent.node->as_mutable_array().append(*n);
-      --parent.data_len;
-      if (parent.data_len > 0) {
-        m_parse_stack.emplace_back();
+/** Moves on to the next thing to write, writing its header at out + *pos
+ * if there is room, and otherwise into m_hdr.
+ *
+ * Returns false if there is nothing left to write.
+ */
+bool msgpack_encoder::_next(byte *out, size_t *pos, size_t cap)
+{
+  const node *n = nullptr;
+  const string *key = nullptr;
+  while (n == nullptr && key == nullptr) {
+    if (m_stack.empty()) {
+      if (m_root_done) {
+        return false;
       }
-      else {
-        parent.state = msgpack_parse_state::COMPLETE;
+      m_root_done = true;
+      n = m_root;
+      break;
+    }
+    frame &f = m_stack.back();
+    if (f.n->get_type() == type::ARRAY) {
+      const array_node &a = f.n->as_array();
+      if (f.idx == a.length()) {
+        m_stack.pop_back();
+        continue;
       }
+      n = &a[f.idx++];
     }
-    else if (parent.node->get_type() == type::MAP) {
-      /* TODO: Should not have to copy into a string */
-      const string key((char *) parent.buf->data(), parent.buf->size());
-      parent.node->as_mutable_map().insert(std::move(key).c_str(), *n);
-      --parent.map_len;
-      if (parent.map_len > 0) {
-        parent.state = msgpack_parse_state::MAP_KEY_TYPE;
+    else {
+      if (f.idx == f.entries.size()) {
+        m_stack.pop_back();
+        continue;
+      }
+      if (! f.key_done) {
+        key = f.entries[f.idx].first;
+        f.key_done = true;
       }
       else {
-        parent.state = msgpack_parse_state::COMPLETE;
+        n = f.entries[f.idx++].second;
+        f.key_done = false;
       }
     }
-    else {
-      THROW_ELLIS_ERR(
-        PARSE_FAIL, "Parsed two primitives in a row not inside a container");
-    }
   }
 
-  msgpack_parse_ctx &top = m_parse_stack.back();
-  if (top.state != msgpack_parse_state::COMPLETE) {
-    /* Node is not complete. */
-    return node_progress(stream_state::CONTINUE);
+  byte *dst = (cap - *pos >= sizeof(m_hdr)) ? out + *pos : m_hdr;
+  size_t len;
+  if (key != nullptr) {
+    m_body = (const byte *)key->data();
+    m_body_len = key->size();
+    len = _str_header(m_body_len, dst);
   }
-
-  unique_ptr<node> n = std::move(top.node);
-  m_parse_stack.pop_back();
-  return node_progress(std::move(n));
-}
-
-
-msgpack_decoder::msgpack_decoder()
-{
-  msgpack_decoder::reset();
+  else {
+    len = _header(*n, dst);
+  }
+  if (dst == m_hdr) {
+    m_hdr_len = len;
+    m_hdr_pos = 0;
+  }
+  else {
+    *pos += len;
+  }
+  return true;
 }
 
 
-node_progress msgpack_decoder::consume_buffer(
-    const byte *buf,
+progress msgpack_encoder::fill_buffer(
+    byte *buf,
     size_t *bytecount)
 {
-  const byte *end = buf + *bytecount;
-  for (const byte *p = buf; p < end; p++) {
-    try {
-      node_progress st = parse_byte(*p);
-      if (st.state() == stream_state::SUCCESS
-          || st.state() == stream_state::ERROR) {
-        *bytecount = end - p - 1;
-        return st;
+  const size_t cap = *bytecount;
+  size_t pos = 0;
+  try {
+    while (true) {
+      if (m_hdr_pos < m_hdr_len) {
+        const size_t n = std::min(m_hdr_len - m_hdr_pos, cap - pos);
+        std::memcpy(buf + pos, m_hdr + m_hdr_pos, n);
+        m_hdr_pos += n;
+        pos += n;
+        if (m_hdr_pos < m_hdr_len) {
+          break;
+        }
+      }
+      if (m_body_len > 0) {
+        if (m_ref_min > 0 && m_body_len >= m_ref_min && ! m_ref_offered) {
+          /* Stop here, and let next_ref() hand the body over in place; if
+           * it is not taken, copy it next time. */
+          m_ref_offered = true;
+          break;
+        }
+        m_ref_offered = false;
+        const size_t n = std::min(m_body_len, cap - pos);
+        std::memcpy(buf + pos, m_body, n);
+        m_body += n;
+        m_body_len -= n;
+        pos += n;
+        if (m_body_len > 0) {
+          break;
+        }
+      }
+      if (! _next(buf, &pos, cap)) {
+        *bytecount = pos;
+        return progress(true);
       }
-    }
-    catch (const err &e) {
-      return node_progress(make_unique<err>(e));
     }
   }
-  *bytecount = 0;
-  return node_progress(stream_state::CONTINUE);
-}
-
-
-void msgpack_decoder::reset()
-{
-  m_parse_stack.clear();
-  m_parse_stack.emplace_back();
-}
-
-
-node_progress msgpack_decoder::chop()
-{
-  return node_progress(MAKE_UNIQUE_ELLIS_ERR(PARSE_FAIL,
-        "Cannot chop a msgpack decoder node"));
+  catch (const err &e) {
+    *bytecount = pos;
+    return progress(make_unique<err>(e));
+  }
+  *bytecount = pos;
+  return progress(stream_state::CONTINUE);
 }
 
 
-/*  _____                     _
- * | ____|_ __   ___ ___   __| | ___ _ __
- * |  _| | '_ \ / __/ _ \ / _` |/ _ \ '__|
- * | |___| | | | (_| (_) | (_| |  __/ |
- * |_____|_| |_|\___\___/ \__,_|\___|_|
- *
- */
-
-
-msgpack_encoder::msgpack_encoder() :
-  m_pos(0),
-  m_end(0)
+void msgpack_encoder::reset(const node *new_node)
 {
+  m_root = new_node;
+  m_root_done = false;
+  m_stack.clear();
+  m_hdr_len = 0;
+  m_hdr_pos = 0;
+  m_body = nullptr;
+  m_body_len = 0;
+  m_ref_min = 0;
+  m_ref_offered = false;
 }
 
 
-/* These functions are used for pushing a value into memory as big-endian. */
-
-void msgpack_encoder::_push_be(uint8_t val)
+void msgpack_encoder::set_ref_min(size_t min_len)
 {
-  m_buf.push_back(val);
+  m_ref_min = min_len;
 }
 
-void msgpack_encoder::_push_be(uint16_t val)
-{
-  // TODO: macro to extract nth byte from LSB.
-  m_buf.push_back((val & 0xff00) >> 8);
-  m_buf.push_back((val & 0x00ff) >> 0);
-}
 
-void msgpack_encoder::_push_be(uint32_t val)
+bool msgpack_encoder::next_ref(const byte **data, size_t *bytecount)
 {
-  m_buf.push_back((val & 0xff000000) >> 24);
-  m_buf.push_back((val & 0x00ff0000) >> 16);
-  m_buf.push_back((val & 0x0000ff00) >> 8);
-  m_buf.push_back((val & 0x000000ff) >> 0);
+  if (! m_ref_offered) {
+    return false;
+  }
+  m_ref_offered = false;
+  *data = m_body;
+  *bytecount = m_body_len;
+  m_body = nullptr;
+  m_body_len = 0;
+  return true;
 }
 
-void msgpack_encoder::_push_be(uint64_t val)
-{
-  m_buf.push_back((val & 0xff00000000000000) >> 56);
-  m_buf.push_back((val & 0x00ff000000000000) >> 48);
-  m_buf.push_back((val & 0x0000ff0000000000) >> 40);
-  m_buf.push_back((val & 0x000000ff00000000) >> 32);
-  m_buf.push_back((val & 0x00000000ff000000) >> 24);
-  m_buf.push_back((val & 0x0000000000ff0000) >> 16);
-  m_buf.push_back((val & 0x000000000000ff00) >> 8);
-  m_buf.push_back((val & 0x00000000000000ff) >> 0);
-}
 
-void msgpack_encoder::_buf_out_str(const char *s, size_t len)
+/** The size of the header for a string of the given length; mirrors
+ * _str_header. */
+static size_t str_header_size(size_t len)
 {
   if (len <= 31) {
-    m_buf.push_back(0xa0 | len);
+    return 1;
   }
   else if (len <= UINT8_MAX) {
-    m_buf.push_back(HEX_STR8);
-    _push_be((uint8_t)len);
+    return 2;
   }
   else if (len <= UINT16_MAX) {
-    m_buf.push_back(HEX_STR16);
-    _push_be((uint16_t)len);
+    return 3;
   }
-  else {
-    m_buf.push_back(HEX_STR32);
-    _push_be((uint32_t)len);
-  }
-  const char *end = s + len;
-  for (const char *p = s; p < end; p++) {
-    m_buf.push_back(*p);
+  else if (len <= UINT32_MAX) {
+    return 5;
   }
+  THROW_ELLIS_ERR(TRANSLATE_FAIL, "String too long for msgpack");
 }
 
 
-void msgpack_encoder::_buf_out(const node &n) {
+/** The size of the encoding of n; mirrors _header and _next. */
+static size_t encoded_size_of(const node &n)
+{
   switch (n.get_type()) {
     case type::NIL:
-      m_buf.push_back(HEX_NIL);
-      return;
-
     case type::BOOL:
-      if (n == true) {
-        m_buf.push_back(HEX_TRUE);
-      }
-      else {
-        m_buf.push_back(HEX_FALSE);
-      }
-      return;
+      return 1;
 
     case type::INT64:
       {
-        int64_t val = n.as_int64();
+        const int64_t val = n.as_int64();
         if (val < 0) {
           if (val >= -32) {
-            m_buf.push_back(val);
+            return 1;
           }
           else if (val >= INT8_MIN) {
-            m_buf.push_back(HEX_INT8);
-            _push_be(union_cast<int64_t, uint8_t>(val));
+            return 2;
           }
           else if (val >= INT16_MIN) {
-            m_buf.push_back(HEX_INT16);
-            _push_be(union_cast<int64_t, uint16_t>(val));
+            return 3;
           }
           else if (val >= INT32_MIN) {
-            m_buf.push_back(HEX_INT32);
-            _push_be(union_cast<int64_t, uint32_t>(val));
-          }
-          else {
-            m_buf.push_back(HEX_INT64);
-            _push_be(union_cast<int64_t, uint64_t>(val));
+            return 5;
           }
         }
         else {
           if (val <= 127) {
-            m_buf.push_back(val);
+            return 1;
           }
           else if (val <= UINT8_MAX) {
-            m_buf.push_back(HEX_UINT8);
-            _push_be(union_cast<int64_t, uint8_t>(val));
+            return 2;
           }
           else if (val <= UINT16_MAX) {
-            m_buf.push_back(HEX_UINT16);
-            _push_be(union_cast<int64_t, uint16_t>(val));
+            return 3;
           }
           else if (val <= UINT32_MAX) {
-            m_buf.push_back(HEX_UINT32);
-            _push_be(union_cast<int64_t, uint32_t>(val));
-          }
-          else {
-            /* Ellis doesn't support uint64 */
-            ELLIS_ASSERT_UNREACHABLE();
+            return 5;
           }
         }
+        return 9;
       }
-      return;
 
     case type::DOUBLE:
-      {
-        double d = n.as_double();
-        m_buf.push_back(HEX_FLOAT64);
-        uint64_t val = union_cast<double, uint64_t>(d);
-        _push_be(val);
-      }
-      return;
+      return 9;
 
     case type::U8STR:
       {
-        const u8str_node &s = n.as_u8str();
-        _buf_out_str(s.c_str(), s.length());
+        const size_t len = n.as_u8str().length();
+        return str_header_size(len) + len;
       }
-      return;
 
     case type::ARRAY:
       {
         const array_node &a = n.as_array();
-        size_t len = a.length();
+        const size_t len = a.length();
+        size_t total;
         if (len <= 15) {
-          m_buf.push_back(0x90 | len);
+          total = 1;
         }
         else if (len <= UINT16_MAX) {
-          m_buf.push_back(HEX_ARRAY16);
-          _push_be((uint16_t)len);
+          total = 3;
+        }
+        else if (len <= UINT32_MAX) {
+          total = 5;
         }
         else {
-          m_buf.push_back(HEX_ARRAY32);
-          _push_be((uint32_t)len);
+          THROW_ELLIS_ERR(TRANSLATE_FAIL, "Too many array elements for msgpack");
         }
-        a.foreach([this](const node &item) {
-          _buf_out(item);
-        });
+        for (size_t i = 0; i < len; i++) {
+          total += encoded_size_of(a[i]);
+        }
+        return total;
       }
-      return;
 
     case type::BINARY:
       {
-        const binary_node &b = n.as_binary();
-        size_t len = b.length();
+        const size_t len = n.as_binary().length();
         if (len <= UINT8_MAX) {
-          m_buf.push_back(HEX_BIN8);
-          _push_be((uint8_t)len);
+          return 2 + len;
         }
         else if (len <= UINT16_MAX) {
-          m_buf.push_back(HEX_BIN16);
-          _push_be((uint16_t)len);
+          return 3 + len;
         }
-        else {
-          m_buf.push_back(HEX_BIN32);
-          _push_be((uint32_t)len);
-        }
-        const byte *end = b.data() + len;
-        for (const byte *p = b.data(); p < end; p++) {
-          m_buf.push_back(*p);
+        else if (len <= UINT32_MAX) {
+          return 5 + len;
         }
+        THROW_ELLIS_ERR(TRANSLATE_FAIL, "Binary too long for msgpack");
       }
-      return;
 
     case type::MAP:
       {
         const map_node &m = n.as_map();
-        size_t len = m.length();
+        const size_t len = m.length();
+        size_t total;
         if (len <= 15) {
-          m_buf.push_back(0x80 | len);
+          total = 1;
         }
         else if (len <= UINT16_MAX) {
-          m_buf.push_back(HEX_MAP16);
-          _push_be((uint16_t)len);
+          total = 3;
         }
         else if (len <= UINT32_MAX) {
-          m_buf.push_back(HEX_MAP32);
-          _push_be((uint32_t)len);
+          total = 5;
         }
         else {
           THROW_ELLIS_ERR(TRANSLATE_FAIL, "Too many map entries for msgpack");
         }
-        m.foreach([this](const string &k, const node &v) {
-          _buf_out_str(k.c_str(), k.length());
-          _buf_out(v);
-        });
+        m.foreach([&total](const string &k, const node &v) {
+            total += str_header_size(k.size()) + k.size() + encoded_size_of(v);
+          });
+        return total;
       }
-      return;
   }
+  ELLIS_ASSERT_UNREACHABLE();
 }
 
 
-progress msgpack_encoder::fill_buffer(
-    byte *buf,
-    size_t *bytecount)
-{
-  size_t avail = m_end - m_pos;
-  size_t actual_bc = std::min(*bytecount, avail);
-  std::memcpy(buf, m_buf.data() + m_pos, actual_bc);
-  m_pos += actual_bc;
-  *bytecount -= actual_bc;
-  if (m_pos == m_end) {
-    return progress(true);
-  }
-  return progress(stream_state::CONTINUE);
-}
-
-
-void msgpack_encoder::reset(const node *new_node)
+bool msgpack_encoder::encoded_size(const node &n, size_t *bytecount) const
 {
-  m_buf.clear();
-  _buf_out(*new_node);
-  m_pos = 0;
-  m_end = m_buf.size();
+  *bytecount = encoded_size_of(n);
+  return true;
 }
 
 
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <ellis/codec/msgpack_seq.hpp>
+
+#include <ellis/core/disposition.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+/*  ____                _
+ * |  _ \ ___  __ _  __| | ___ _ __
+ * | |_) / _ \/ _` |/ _` |/ _ \ '__|
+ * |  _ <  __/ (_| | (_| |  __/ |
+ * |_| \_\___|\__,_|\__,_|\___|_|
+ *
+ */
+
+
+msgpack_seq_reader::msgpack_seq_reader(sync_input_stream &in) :
+  m_in(in)
+{
+}
+
+/** Decode up to n records, handing each to fn, and return how many. */
+size_t msgpack_seq_reader::_read(
+    size_t n,
+    const std::function<void(unique_ptr<node>)> &fn)
+{
+  size_t got = 0;
+  bool in_record = false;
+  m_dec.reset();
+  while (got < n) {
+    const byte *buf = nullptr;
+    size_t buf_remain = 0;
+    if (! m_in.next_input_buf(&buf, &buf_remain)) {
+      /* End of stream.  Fine between records, otherwise the last record is
+       * truncated. */
+      if (in_record) {
+        auto st = m_dec.chop();
+        m_dec.reset();
+        throw *(st.extract_error());
+      }
+      break;
+    }
+    ELLIS_ASSERT(buf != nullptr);
+    const byte *p_end = buf + buf_remain;
+    const byte *p = buf;
+    /* Decode as many records as are wanted from this buffer. */
+    while (p < p_end && got < n) {
+      in_record = true;
+      buf_remain = p_end - p;
+      auto st = m_dec.consume_buffer(p, &buf_remain);
+      p = p_end - buf_remain;
+      if (st.state() == stream_state::ERROR) {
+        m_in.put_back(buf_remain);
+        m_dec.reset();
+        throw *(st.extract_error());
+      }
+      if (st.state() == stream_state::SUCCESS) {
+        in_record = false;
+        m_dec.reset();
+        m_count++;
+        got++;
+        fn(st.extract_value());
+      }
+    }
+    /* Leave the following records for the next call. */
+    if (p < p_end) {
+      m_in.put_back(p_end - p);
+    }
+  }
+  return got;
+}
+
+unique_ptr<node> msgpack_seq_reader::next()
+{
+  unique_ptr<node> rec;
+  _read(1, [&rec](unique_ptr<node> n) { rec = std::move(n); });
+  return rec;
+}
+
+size_t msgpack_seq_reader::next_batch(size_t n, vector<node> *out)
+{
+  out->reserve(out->size() + n);
+  return _read(n, [out](unique_ptr<node> rec) {
+      out->push_back(std::move(*rec));
+    });
+}
+
+size_t msgpack_seq_reader::for_each(
+    std::function<bool(unique_ptr<node>)> fn)
+{
+  size_t delivered = 0;
+  while (auto rec = next()) {
+    delivered++;
+    if (! fn(std::move(rec))) {
+      break;
+    }
+  }
+  return delivered;
+}
+
+size_t msgpack_seq_reader::count() const
+{
+  return m_count;
+}
+
+
+/* __        __    _ _
+ * \ \      / / __(_) |_ ___ _ __
+ *  \ \ /\ / / '__| | __/ _ \ '__|
+ *   \ V  V /| |  | | ||  __/ |
+ *    \_/\_/ |_|  |_|\__\___|_|
+ *
+ */
+
+
+msgpack_seq_writer::msgpack_seq_writer(sync_output_stream &out) :
+  m_out(out)
+{
+}
+
+msgpack_seq_writer::~msgpack_seq_writer()
+{
+  try {
+    flush();
+  }
+  catch (const err &e) {
+    ELLIS_LOG(WARN, "msgpack_seq_writer: unflushed output lost: %s",
+        e.what());
+  }
+}
+
+void msgpack_seq_writer::_next_buf()
+{
+  if (m_buf != nullptr) {
+    /* Current buffer is full; send it out. */
+    if (! m_out.emit(m_used)) {
+      m_buf = nullptr;
+      throw *(m_out.extract_output_error());
+    }
+  }
+  m_buf = nullptr;
+  m_cap = 0;
+  m_used = 0;
+  if (! m_out.next_output_buf(&m_buf, &m_cap)) {
+    m_buf = nullptr;
+    throw *(m_out.extract_output_error());
+  }
+  ELLIS_ASSERT(m_buf != nullptr);
+  ELLIS_ASSERT_GT(m_cap, 0);
+}
+
+void msgpack_seq_writer::write(const node &rec)
+{
+  m_enc.reset(&rec);
+  while (1) {
+    if (m_used == m_cap) {
+      _next_buf();
+    }
+    size_t bc = m_cap - m_used;
+    auto st = m_enc.fill_buffer(m_buf + m_used, &bc);
+    m_used += bc;
+    if (st.state() == stream_state::ERROR) {
+      throw *(st.extract_error());
+    }
+    if (st.state() == stream_state::SUCCESS) {
+      break;
+    }
+  }
+  m_count++;
+}
+
+void msgpack_seq_writer::write_batch(const vector<node> &recs)
+{
+  for (const auto &rec : recs) {
+    write(rec);
+  }
+}
+
+void msgpack_seq_writer::flush()
+{
+  if (m_buf == nullptr) {
+    return;
+  }
+  /* Give the buffer back to the stream, even on failure. */
+  const size_t used = m_used;
+  m_buf = nullptr;
+  m_cap = 0;
+  m_used = 0;
+  if (used > 0 && ! m_out.emit(used)) {
+    throw *(m_out.extract_output_error());
+  }
+}
+
+size_t msgpack_seq_writer::count() const
+{
+  return m_count;
+}
+
+
+}  /* namespace ellis */
@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <ellis/codec/msgpack_view.hpp>
+
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/core/err.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis_private/codec/util/msgpack_format.hpp>
+#include <ellis_private/core/parse_path.hpp>
+#include <ellis_private/utility.hpp>
+#include <cstring>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+/** Throws unless there are at least n bytes in [p, end). */
+static inline void need(const byte *p, uint64_t n, const byte *end)
+{
+  if ((uint64_t)(end - p) < n) {
+    THROW_ELLIS_ERR(PARSE_FAIL, "truncated msgpack input");
+  }
+}
+
+
+/** Classifies the value at p. */
+static inline msgpack_type type_at(const byte *p, const byte *end)
+{
+  need(p, 1, end);
+  return get_msgpack_type(p[0]);
+}
+
+
+/** Returns the position just past the value at p, having checked that all
+ * of it lies before end.  Nested values are counted off rather than
+ * recursed into, so deep nesting costs no stack. */
+static const byte * skip_value(const byte *p, const byte *end)
+{
+  uint64_t pending = 1;
+  while (pending > 0) {
+    const msgpack_type t = type_at(p, end);
+    const size_t hdr = header_len(t);
+    need(p, hdr, end);
+    const uint64_t len = payload_len(t, p);
+    need(p + hdr, len, end);
+    switch (t) {
+      case msgpack_type::FIXMAP:
+      case msgpack_type::MAP16:
+      case msgpack_type::MAP32:
+        pending += 2 * element_count(t, p);
+        break;
+      case msgpack_type::FIXARRAY:
+      case msgpack_type::ARRAY16:
+      case msgpack_type::ARRAY32:
+        pending += element_count(t, p);
+        break;
+      default:
+        break;
+    }
+    pending--;
+    p += hdr + len;
+  }
+  return p;
+}
+
+
+/** Returns the type a value of the given msgpack type decodes to. */
+static type ellis_type(msgpack_type t)
+{
+  switch (t) {
+    case msgpack_type::NIL:
+      return type::NIL;
+    case msgpack_type::FALSE:
+    case msgpack_type::TRUE:
+      return type::BOOL;
+    case msgpack_type::FLOAT32:
+    case msgpack_type::FLOAT64:
+      return type::DOUBLE;
+    case msgpack_type::FIXSTR:
+    case msgpack_type::STR8:
+    case msgpack_type::STR16:
+    case msgpack_type::STR32:
+      return type::U8STR;
+    case msgpack_type::BIN8:
+    case msgpack_type::BIN16:
+    case msgpack_type::BIN32:
+      return type::BINARY;
+    case msgpack_type::FIXARRAY:
+    case msgpack_type::ARRAY16:
+    case msgpack_type::ARRAY32:
+      return type::ARRAY;
+    case msgpack_type::FIXMAP:
+    case msgpack_type::MAP16:
+    case msgpack_type::MAP32:
+      return type::MAP;
+    default:
+      return type::INT64;
+  }
+}
+
+
+msgpack_view msgpack_view::_view(const byte *p, const byte *end)
+{
+  msgpack_view v;
+  v.m_p = p;
+  v.m_end = end;
+  return v;
+}
+
+
+msgpack_view::msgpack_view(const void *buf, size_t len) :
+  m_p((const byte *)buf),
+  m_end((const byte *)buf + len)
+{
+  if (len == 0) {
+    THROW_ELLIS_ERR(PARSE_FAIL, "empty msgpack input");
+  }
+}
+
+
+void msgpack_view::_check_type(type t) const
+{
+  const type actual = get_type();
+  if (actual != t) {
+    THROW_ELLIS_ERR(TYPE_MISMATCH,
+        "msgpack value is " << type_str(actual) << ", not " << type_str(t));
+  }
+}
+
+
+/** Returns the element (or entry) count of a container. */
+uint64_t msgpack_view::_count() const
+{
+  const msgpack_type t = type_at(m_p, m_end);
+  need(m_p, header_len(t), m_end);
+  return element_count(t, m_p);
+}
+
+
+/** Returns the start of the first element (or key) of a container. */
+const byte * msgpack_view::_first() const
+{
+  return m_p + header_len(type_at(m_p, m_end));
+}
+
+
+/** Returns the contents of a string or binary, checked to be in bounds. */
+const byte * msgpack_view::_payload(size_t *len) const
+{
+  const msgpack_type t = type_at(m_p, m_end);
+  const type et = ellis_type(t);
+  if (et != type::U8STR && et != type::BINARY) {
+    THROW_ELLIS_ERR(TYPE_MISMATCH,
+        "msgpack value is " << type_str(et) << ", not u8str or binary");
+  }
+  const size_t hdr = header_len(t);
+  need(m_p, hdr, m_end);
+  *len = payload_len(t, m_p);
+  need(m_p + hdr, *len, m_end);
+  return m_p + hdr;
+}
+
+
+type msgpack_view::get_type() const
+{
+  return ellis_type(type_at(m_p, m_end));
+}
+
+
+bool msgpack_view::is_type(type t) const
+{
+  return get_type() == t;
+}
+
+
+size_t msgpack_view::length() const
+{
+  const type t = get_type();
+  if (t != type::ARRAY && t != type::MAP) {
+    THROW_ELLIS_ERR(TYPE_MISMATCH,
+        "msgpack value is " << type_str(t) << ", not array or map");
+  }
+  return _count();
+}
+
+
+msgpack_view msgpack_view::operator[](size_t idx) const
+{
+  _check_type(type::ARRAY);
+  if (idx >= _count()) {
+    THROW_ELLIS_ERR(INVALID_ARGS, "array index out of bounds");
+  }
+  const byte *p = _first();
+  for (; idx > 0; idx--) {
+    p = skip_value(p, m_end);
+  }
+  return _view(p, m_end);
+}
+
+
+msgpack_view msgpack_view::operator[](int idx) const
+{
+  if (idx < 0) {
+    THROW_ELLIS_ERR(INVALID_ARGS, "array index out of bounds");
+  }
+  return (*this)[(size_t)idx];
+}
+
+
+bool msgpack_view::_find(
+    const char *key,
+    size_t keylen,
+    msgpack_view *found) const
+{
+  _check_type(type::MAP);
+  const uint64_t count = _count();
+  const byte *p = _first();
+  for (uint64_t n = 0; n < count; n++) {
+    /* Entries alternate: key, then value. */
+    const msgpack_type kt = type_at(p, m_end);
+    if (! type_is_string(kt)) {
+      THROW_ELLIS_ERR(TRANSLATE_FAIL, "Map key must be a string");
+    }
+    size_t klen = 0;
+    const byte *k = _view(p, m_end)._payload(&klen);
+    const byte *val = k + klen;
+    if (klen == keylen && memcmp(k, key, keylen) == 0) {
+      *found = _view(val, m_end);
+      return true;
+    }
+    p = skip_value(val, m_end);
+  }
+  return false;
+}
+
+
+msgpack_view msgpack_view::operator[](const std::string &key) const
+{
+  msgpack_view found(*this);
+  if (! _find(key.data(), key.size(), &found)) {
+    THROW_ELLIS_ERR(NO_SUCH, "key " << key << " not found in map");
+  }
+  return found;
+}
+
+
+msgpack_view msgpack_view::operator[](const char *key) const
+{
+  msgpack_view found(*this);
+  if (! _find(key, strlen(key), &found)) {
+    THROW_ELLIS_ERR(NO_SUCH, "key " << key << " not found in map");
+  }
+  return found;
+}
+
+
+bool msgpack_view::has_key(const std::string &key) const
+{
+  msgpack_view found(*this);
+  return _find(key.data(), key.size(), &found);
+}
+
+
+vector<string> msgpack_view::keys() const
+{
+  _check_type(type::MAP);
+  const uint64_t count = _count();
+  vector<string> rv;
+  rv.reserve(std::min<uint64_t>(count, m_end - m_p));
+  const byte *p = _first();
+  for (uint64_t n = 0; n < count; n++) {
+    const msgpack_view k = _view(p, m_end);
+    rv.push_back(k.as_u8str());
+    p = skip_value(k.raw_bytes() + k.raw_length(), m_end);
+  }
+  return rv;
+}
+
+
+msgpack_view msgpack_view::at(const std::string &path) const
+{
+  msgpack_view cur(*this);
+
+#define BOOM(POS, DETAILS) \
+  do { \
+    THROW_ELLIS_ERR(PATH_FAIL, \
+      "access failure at position " << (POS) \
+      << " of path " << path << ": " << DETAILS); \
+  } while (0)
+
+  auto got_map_selector =
+    [&cur, &path]
+    (const string &pattern, size_t pos)
+    {
+      if (! cur.is_type(type::MAP)) {
+        BOOM(pos, "map pattern selector applied to non-map");
+      }
+      if (! cur._find(pattern.data(), pattern.size(), &cur)) {
+        BOOM(pos, "pattern not found in map");
+      }
+    };
+
+  auto got_array_selector =
+    [&cur, &path]
+    (size_t start, size_t stop, size_t pos)
+    {
+      if (start != stop) {
+        BOOM(pos, "array range not supported in this mode");
+      }
+      if (! cur.is_type(type::ARRAY)) {
+        BOOM(pos, "array index applied to non-array");
+      }
+      if (start >= cur.length()) {
+        BOOM(pos, "index out of range");
+      }
+      cur = cur[start];
+    };
+#undef BOOM
+
+  parse_path(path, got_map_selector, got_array_selector);
+  return cur;
+}
+
+
+bool msgpack_view::as_bool() const
+{
+  _check_type(type::BOOL);
+  return m_p[0] == HEX_TRUE;
+}
+
+
+int64_t msgpack_view::as_int64() const
+{
+  _check_type(type::INT64);
+  const msgpack_type t = type_at(m_p, m_end);
+  need(m_p, header_len(t) + payload_len(t, m_p), m_end);
+  const byte *p = m_p;
+  switch (t) {
+    case msgpack_type::POS_FIXINT:
+      return static_cast<int64_t>(p[0]);
+    case msgpack_type::NEG_FIXINT:
+      return static_cast<int64_t>(static_cast<int8_t>(p[0]));
+    case msgpack_type::UINT8:
+      return static_cast<int64_t>(p[1]);
+    case msgpack_type::UINT16:
+      return static_cast<int64_t>(load_be<uint16_t>(p + 1));
+    case msgpack_type::UINT32:
+      return static_cast<int64_t>(load_be<uint32_t>(p + 1));
+    case msgpack_type::INT8:
+      return static_cast<int64_t>(static_cast<int8_t>(p[1]));
+    case msgpack_type::INT16:
+      return static_cast<int64_t>(
+          union_cast<uint16_t, int16_t>(load_be<uint16_t>(p + 1)));
+    case msgpack_type::INT32:
+      return static_cast<int64_t>(
+          union_cast<uint32_t, int32_t>(load_be<uint32_t>(p + 1)));
+    case msgpack_type::INT64:
+      return union_cast<uint64_t, int64_t>(load_be<uint64_t>(p + 1));
+    default:
+      ELLIS_ASSERT_UNREACHABLE();
+  }
+}
+
+
+double msgpack_view::as_double() const
+{
+  _check_type(type::DOUBLE);
+  const msgpack_type t = type_at(m_p, m_end);
+  need(m_p, header_len(t) + payload_len(t, m_p), m_end);
+  if (t == msgpack_type::FLOAT32) {
+    return static_cast<double>(
+        union_cast<uint32_t, float>(load_be<uint32_t>(m_p + 1)));
+  }
+  return union_cast<uint64_t, double>(load_be<uint64_t>(m_p + 1));
+}
+
+
+string msgpack_view::as_u8str() const
+{
+  _check_type(type::U8STR);
+  size_t len = 0;
+  const byte *s = _payload(&len);
+  return string((const char *)s, len);
+}
+
+
+const byte * msgpack_view::data() const
+{
+  size_t len = 0;
+  return _payload(&len);
+}
+
+
+size_t msgpack_view::data_length() const
+{
+  size_t len = 0;
+  _payload(&len);
+  return len;
+}
+
+
+unique_ptr<node> msgpack_view::to_node() const
+{
+  msgpack_decoder dec;
+  return load_mem(raw_bytes(), raw_length(), dec);
+}
+
+
+const byte * msgpack_view::raw_bytes() const
+{
+  return m_p;
+}
+
+
+size_t msgpack_view::raw_length() const
+{
+  return skip_value(m_p, m_end) - m_p;
+}
+
+
+}  /* namespace ellis */
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis_private/codec/util/base64.hpp>
+
+#include <array>
+#include <cstdint>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ELLIS_BASE64_SSSE3
+#include <tmmintrin.h>
+#endif
+#include <ellis_private/using.hpp>
+
+/*
+ * The SSSE3 paths follow Wojciech Muła and Daniel Lemire, "Faster Base64
+ * Encoding and Decoding Using AVX2 Instructions" (ACM TWEB, 2018), scaled
+ * down to 128-bit registers.  They are compiled with a function target
+ * attribute and picked at runtime, so the library itself still builds for the
+ * baseline instruction set.
+ */
+
+
+namespace ellis {
+
+
+static const char k_b64_chars[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/** Six bit value of each base64 char, or -1 for chars outside the alphabet. */
+static std::array<int8_t, 256> make_b64_vals()
+{
+  std::array<int8_t, 256> rv;
+  rv.fill(-1);
+  for (int i = 0; i < 64; i++) {
+    rv[(unsigned char)k_b64_chars[i]] = (int8_t)i;
+  }
+  return rv;
+}
+
+static const std::array<int8_t, 256> k_b64_vals = make_b64_vals();
+
+
+
+/*  ____             _
+ * / ___|  ___  __ _| | __ _ _ __
+ * \___ \ / __/ _` | |/ _` | '__|
+ *  ___) | (_| (_| | | (_| | |
+ * |____/ \___\__,_|_|\__,_|_|
+ *
+ */
+
+
+static size_t encode_scalar(const byte *src, size_t len, char *dst)
+{
+  char *out = dst;
+  size_t i = 0;
+  for (; i + 3 <= len; i += 3) {
+    const uint32_t v = (uint32_t)src[i] << 16
+      | (uint32_t)src[i + 1] << 8
+      | (uint32_t)src[i + 2];
+    out[0] = k_b64_chars[(v >> 18) & 63];
+    out[1] = k_b64_chars[(v >> 12) & 63];
+    out[2] = k_b64_chars[(v >> 6) & 63];
+    out[3] = k_b64_chars[v & 63];
+    out += 4;
+  }
+  if (i < len) {
+    uint32_t v = (uint32_t)src[i] << 16;
+    if (i + 1 < len) {
+      v |= (uint32_t)src[i + 1] << 8;
+    }
+    out[0] = k_b64_chars[(v >> 18) & 63];
+    out[1] = k_b64_chars[(v >> 12) & 63];
+    out[2] = (i + 1 < len) ? k_b64_chars[(v >> 6) & 63] : '=';
+    out[3] = '=';
+    out += 4;
+  }
+  return out - dst;
+}
+
+static bool decode_scalar(
+    const char *src,
+    size_t len,
+    byte *dst,
+    size_t *outlen)
+{
+  if (len % 4 != 0) {
+    return false;
+  }
+  byte *out = dst;
+  for (size_t i = 0; i < len; i += 4) {
+    const int a = k_b64_vals[(unsigned char)src[i]];
+    const int b = k_b64_vals[(unsigned char)src[i + 1]];
+    int c = k_b64_vals[(unsigned char)src[i + 2]];
+    int d = k_b64_vals[(unsigned char)src[i + 3]];
+    size_t nbytes = 3;
+    if (i + 4 == len) {
+      /* Padding may only appear in the last group, as "xx==" or "xxx=". */
+      if (src[i + 3] == '=') {
+        nbytes = 2;
+        d = 0;
+        if (src[i + 2] == '=') {
+          nbytes = 1;
+          c = 0;
+        }
+      }
+    }
+    if ((a | b | c | d) < 0) {
+      return false;
+    }
+    const uint32_t v = (uint32_t)a << 18 | (uint32_t)b << 12
+      | (uint32_t)c << 6 | (uint32_t)d;
+    out[0] = (byte)(v >> 16);
+    if (nbytes > 1) {
+      out[1] = (byte)(v >> 8);
+    }
+    if (nbytes > 2) {
+      out[2] = (byte)v;
+    }
+    out += nbytes;
+  }
+  *outlen = out - dst;
+  return true;
+}
+
+
+
+/*  ____ ____ ____  _____ _____
+ * / ___/ ___/ ___|| ____|___ /
+ * \___ \___ \___ \|  _|   |_ \
+ *  ___) |__) |__) | |___ ___) |
+ * |____/____/____/|_____|____/
+ *
+ */
+
+
+#ifdef ELLIS_BASE64_SSSE3
+
+static bool cpu_has_ssse3()
+{
+  static const bool rv = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3") != 0;
+  }();
+  return rv;
+}
+
+/** Encodes 12 bytes at a time; returns the number of input bytes consumed.
+ *
+ * Each step loads 16 bytes, so it stops while at least 16 remain. */
+__attribute__((target("ssse3")))
+static size_t encode_ssse3(const byte *src, size_t len, char *dst)
+{
+  const __m128i spread = _mm_set_epi8(
+      10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  const __m128i shift_lut = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+      '/' - 63, 'A', 0, 0);
+  size_t i = 0;
+  for (; len - i >= 16; i += 12, dst += 16) {
+    __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+    /* Gather each 3 byte group into a 32 bit lane, then move the four 6 bit
+     * fields of each lane into their own bytes. */
+    in = _mm_shuffle_epi8(in, spread);
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    const __m128i idx = _mm_or_si128(t1, t3);
+    /* Map 0..63 onto the alphabet by adding a per-range offset. */
+    __m128i range = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+    range = _mm_or_si128(range, _mm_and_si128(less, _mm_set1_epi8(13)));
+    const __m128i out = _mm_add_epi8(_mm_shuffle_epi8(shift_lut, range), idx);
+    _mm_storeu_si128((__m128i *)dst, out);
+  }
+  return i;
+}
+
+/** Decodes 16 chars at a time into 12 bytes; returns the number of input
+ * chars consumed, and the bytes written via outlen.
+ *
+ * Each step stores 16 bytes, so it stops while the rest of the input still
+ * decodes to at least 4 more bytes; that also keeps the padded last group out
+ * of the vector loop.  A block with an invalid char stops the loop, leaving
+ * it to the scalar code to report. */
+__attribute__((target("ssse3")))
+static size_t decode_ssse3(
+    const char *src,
+    size_t len,
+    byte *dst,
+    size_t *outlen)
+{
+  const __m128i lut_lo = _mm_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i lut_hi = _mm_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i pack = _mm_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  size_t i = 0;
+  size_t o = 0;
+  for (; len - i >= 24; i += 16, o += 12) {
+    const __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+    const __m128i hi = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+    const __m128i lo = _mm_and_si128(in, nibble);
+    /* A char is valid iff its low and high nibble classes share no bit. */
+    const __m128i bad = _mm_and_si128(
+        _mm_shuffle_epi8(lut_lo, lo), _mm_shuffle_epi8(lut_hi, hi));
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(bad, _mm_setzero_si128()))) {
+      break;
+    }
+    const __m128i eq_slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+    const __m128i roll = _mm_shuffle_epi8(
+        lut_roll, _mm_add_epi8(eq_slash, hi));
+    const __m128i vals = _mm_add_epi8(in, roll);
+    /* Merge the four 6 bit values of each lane into 24 bits, then pack the
+     * lanes' three bytes each (big-endian order) into the low 12 bytes. */
+    const __m128i ab_bc = _mm_maddubs_epi16(vals, _mm_set1_epi32(0x01400140));
+    const __m128i abc = _mm_madd_epi16(ab_bc, _mm_set1_epi32(0x00011000));
+    _mm_storeu_si128((__m128i *)(dst + o), _mm_shuffle_epi8(abc, pack));
+  }
+  *outlen = o;
+  return i;
+}
+
+#endif  /* ELLIS_BASE64_SSSE3 */
+
+
+
+/*  ____        _     _ _
+ * |  _ \ _   _| |__ | (_) ___
+ * | |_) | | | | '_ \| | |/ __|
+ * |  __/| |_| | |_) | | | (__
+ * |_|    \__,_|_.__/|_|_|\___|
+ *
+ */
+
+
+size_t base64_encode(const byte *src, size_t len, char *dst)
+{
+  size_t done = 0;
+  size_t written = 0;
+#ifdef ELLIS_BASE64_SSSE3
+  if (cpu_has_ssse3()) {
+    done = encode_ssse3(src, len, dst);
+    written = done / 3 * 4;
+  }
+#endif
+  return written + encode_scalar(src + done, len - done, dst + written);
+}
+
+
+bool base64_decode(const char *src, size_t len, byte *dst, size_t *outlen)
+{
+  if (len % 4 != 0) {
+    return false;
+  }
+  size_t done = 0;
+  size_t written = 0;
+#ifdef ELLIS_BASE64_SSSE3
+  if (cpu_has_ssse3()) {
+    done = decode_ssse3(src, len, dst, &written);
+  }
+#endif
+  size_t tail = 0;
+  if (! decode_scalar(src + done, len - done, dst + written, &tail)) {
+    return false;
+  }
+  *outlen = written + tail;
+  return true;
+}
+
+
+}  /* namespace ellis */
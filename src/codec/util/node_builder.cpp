@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis_private/codec/util/node_builder.hpp>
+
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/binary_node.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+node node_builder::make_string(node &&old, const char *s, size_t len)
+{
+  if (old.get_type() == type::U8STR) {
+    old.as_mutable_u8str().assign(s, len);
+    return std::move(old);
+  }
+  node n(type::U8STR);
+  n.as_mutable_u8str().assign(s, len);
+  return n;
+}
+
+
+node node_builder::make_binary(node &&old, const byte *data, size_t len)
+{
+  /* Writing to a slice would copy it out first, for nothing. */
+  if (old.get_type() == type::BINARY && ! old.as_binary().is_slice()) {
+    binary_node &bin = old.as_mutable_binary();
+    bin.clear();
+    bin.append(data, len);
+    return std::move(old);
+  }
+  if (len == 0) {
+    /* data may be null; there is nothing to copy. */
+    return node(type::BINARY);
+  }
+  return node(data, len);
+}
+
+
+node node_builder::begin_array(node &&old)
+{
+  m_frames.push_back(frame{ 0, 0, 0, nullptr });
+  if (old.get_type() != type::ARRAY) {
+    return node(type::ARRAY);
+  }
+  m_frames.back().old_len = old.as_mutable_array().length();
+  return std::move(old);
+}
+
+
+node node_builder::element(node &arr)
+{
+  const frame &f = m_frames.back();
+  if (f.count < f.old_len) {
+    return node(std::move(arr.as_mutable_array()[f.count]));
+  }
+  return node(type::NIL);
+}
+
+
+void node_builder::append(node &arr, node &&val)
+{
+  frame &f = m_frames.back();
+  if (f.count < f.old_len) {
+    arr.as_mutable_array()[f.count] = std::move(val);
+  }
+  else {
+    arr.as_mutable_array().append(std::move(val));
+  }
+  f.count++;
+}
+
+
+void node_builder::end_array(node &arr)
+{
+  const frame f = m_frames.back();
+  m_frames.pop_back();
+  if (f.count < f.old_len) {
+    array_node &a = arr.as_mutable_array();
+    for (size_t i = f.old_len; i > f.count; i--) {
+      a.erase(i - 1);
+    }
+  }
+}
+
+
+node node_builder::begin_map(node &&old)
+{
+  m_frames.push_back(frame{ 0, 0, m_pending.size(), nullptr });
+  if (old.get_type() != type::MAP) {
+    return node(type::MAP);
+  }
+  map_node &m = old.as_mutable_map();
+  m_frames.back().old_len = m.length();
+  /* Entries are nil from being taken by entry() until end_map(); make sure
+   * that none start out that way. */
+  m.foreach_mutable([](const std::string &, node &v)
+      {
+        if (v.get_type() == type::NIL) {
+          v = false;
+        }
+      });
+  return std::move(old);
+}
+
+
+node node_builder::entry(node &obj, const std::string &key)
+{
+  frame &f = m_frames.back();
+  if (f.old_len == 0) {
+    return node(type::NIL);
+  }
+  map_node &m = obj.as_mutable_map();
+  node *v = m.find(key);
+  if (v == nullptr) {
+    m.insert(key, node(type::NIL));
+    f.slot = m.find(key);
+    return node(type::NIL);
+  }
+  if (v->get_type() == type::NIL) {
+    /* A repeated key; the first value stands. */
+    f.slot = nullptr;
+    return node(type::NIL);
+  }
+  f.count++;
+  f.slot = v;
+  return node(std::move(*v));
+}
+
+
+void node_builder::insert(node &obj, const std::string &key, node &&val)
+{
+  const frame &f = m_frames.back();
+  if (f.old_len == 0) {
+    obj.as_mutable_map().insert(key, val);
+  }
+  else if (f.slot != nullptr) {
+    m_pending.emplace_back(f.slot, std::move(val));
+  }
+}
+
+
+void node_builder::end_map(node &obj)
+{
+  const frame f = m_frames.back();
+  m_frames.pop_back();
+  if (f.old_len == 0) {
+    return;
+  }
+  map_node &m = obj.as_mutable_map();
+  if (f.count < f.old_len) {
+    /* Some old keys did not come up; theirs are the only entries that are
+     * not nil. */
+    vector<std::string> stale;
+    m.foreach([&stale](const std::string &k, const node &v)
+        {
+          if (v.get_type() != type::NIL) {
+            stale.push_back(k);
+          }
+        });
+    for (const auto &k : stale) {
+      m.erase(k);
+    }
+  }
+  const auto first = m_pending.begin() + f.base;
+  for (auto it = first; it != m_pending.end(); ++it) {
+    *it->first = std::move(it->second);
+  }
+  m_pending.erase(first, m_pending.end());
+}
+
+
+void node_builder::reset()
+{
+  m_frames.clear();
+  m_pending.clear();
+}
+
+
+}  /* namespace ellis */
@@ -0,0 +1,563 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <ellis_private/codec/util/num_format.hpp>
+
+#include <ellis/core/system.hpp>
+#include <ellis_private/utility.hpp>
+#include <cmath>
+#include <cstring>
+#include <ellis_private/using.hpp>
+
+/*
+ * The double formatting below is Grisu2, as described by Florian Loitsch in
+ * "Printing Floating-Point Numbers Quickly and Accurately with Integers"
+ * (PLDI 2010).  It generates digits using only 64-bit integer arithmetic and
+ * a small table of cached powers of ten, and its output always reads back
+ * as the original double.
+ */
+
+
+namespace ellis {
+
+
+/*  ___       _
+ * |_ _|_ __ | |_ ___  __ _  ___ _ __ ___
+ *  | || '_ \| __/ _ \/ _` |/ _ \ '__/ __|
+ *  | || | | | ||  __/ (_| |  __/ |  \__ \
+ * |___|_| |_|\__\___|\__, |\___|_|  |___/
+ *                    |___/
+ */
+
+
+static const char k_digit_pairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+
+/** Returns the number of decimal digits in val (at least 1). */
+static inline int count_digits(uint64_t val)
+{
+  int n = 1;
+  for (;;) {
+    if (val < 10) {
+      return n;
+    }
+    if (val < 100) {
+      return n + 1;
+    }
+    if (val < 1000) {
+      return n + 2;
+    }
+    if (val < 10000) {
+      return n + 3;
+    }
+    val /= 10000;
+    n += 4;
+  }
+}
+
+
+/** Writes exactly ndigits digits of val, ending at buf + ndigits. */
+static inline void write_digits(uint64_t val, int ndigits, char *buf)
+{
+  char *p = buf + ndigits;
+  while (val >= 100) {
+    unsigned i = (unsigned)(val % 100) * 2;
+    val /= 100;
+    *--p = k_digit_pairs[i + 1];
+    *--p = k_digit_pairs[i];
+  }
+  if (val >= 10) {
+    unsigned i = (unsigned)val * 2;
+    *--p = k_digit_pairs[i + 1];
+    *--p = k_digit_pairs[i];
+  }
+  else {
+    *--p = (char)('0' + val);
+  }
+}
+
+
+size_t format_int64(int64_t val, char *buf)
+{
+  char *p = buf;
+  uint64_t u = (uint64_t)val;
+  if (val < 0) {
+    *p++ = '-';
+    /* Two's complement negation; also correct for INT64_MIN. */
+    u = 0 - u;
+  }
+  int n = count_digits(u);
+  write_digits(u, n, p);
+  return (size_t)(p - buf) + n;
+}
+
+
+/*  ____              _     _
+ * |  _ \  ___  _   _| |__ | | ___  ___
+ * | | | |/ _ \| | | | '_ \| |/ _ \/ __|
+ * | |_| | (_) | |_| | |_) | |  __/\__ \
+ * |____/ \___/ \__,_|_.__/|_|\___||___/
+ *
+ */
+
+
+/** An unnormalized floating point value f * 2^e with a 64-bit mantissa. */
+struct diyfp {
+  uint64_t f;
+  int e;
+
+  diyfp(uint64_t f_, int e_) : f(f_), e(e_) {}
+};
+
+
+static inline diyfp diyfp_sub(const diyfp &x, const diyfp &y)
+{
+  ELLIS_ASSERT_EQ(x.e, y.e);
+  ELLIS_ASSERT_GTE(x.f, y.f);
+  return diyfp(x.f - y.f, x.e);
+}
+
+
+/** Returns the upper 64 bits of the 128-bit product, rounded. */
+static inline diyfp diyfp_mul(const diyfp &x, const diyfp &y)
+{
+  const uint64_t lo_mask = 0xFFFFFFFFu;
+  const uint64_t x_lo = x.f & lo_mask;
+  const uint64_t x_hi = x.f >> 32;
+  const uint64_t y_lo = y.f & lo_mask;
+  const uint64_t y_hi = y.f >> 32;
+
+  const uint64_t p0 = x_lo * y_lo;
+  const uint64_t p1 = x_lo * y_hi;
+  const uint64_t p2 = x_hi * y_lo;
+  const uint64_t p3 = x_hi * y_hi;
+
+  uint64_t mid = (p0 >> 32) + (p1 & lo_mask) + (p2 & lo_mask);
+  /* Round half up. */
+  mid += 1u << 31;
+
+  return diyfp(p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+
+static inline diyfp diyfp_normalize(diyfp x)
+{
+  ELLIS_ASSERT_NEQ(x.f, 0UL);
+  while ((x.f >> 63) == 0) {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+
+static inline diyfp diyfp_normalize_to(const diyfp &x, int target_e)
+{
+  const int delta = x.e - target_e;
+  ELLIS_ASSERT_GTE(delta, 0);
+  return diyfp(x.f << delta, target_e);
+}
+
+
+/** The value v and its neighbor boundaries, all with the same exponent. */
+struct boundaries {
+  diyfp w;
+  diyfp minus;
+  diyfp plus;
+};
+
+
+/** Computes the boundaries m- and m+ of the rounding interval of v.
+ *
+ * Any number strictly between m- and m+ reads back as v.
+ */
+static boundaries compute_boundaries(double v)
+{
+  const int k_precision = 53;
+  const int k_bias = 1023 + k_precision - 1;
+  const int k_min_exp = 1 - k_bias;
+  const uint64_t k_hidden_bit = uint64_t{1} << (k_precision - 1);
+
+  const uint64_t bits = union_cast<double, uint64_t>(v);
+  const uint64_t ex = bits >> (k_precision - 1);
+  const uint64_t fr = bits & (k_hidden_bit - 1);
+
+  const diyfp d = (ex == 0)
+    ? diyfp(fr, k_min_exp)
+    : diyfp(fr + k_hidden_bit, (int)ex - k_bias);
+
+  /* The lower boundary is closer when v is a power of two (and not the
+   * smallest normal), because the exponent changes below it. */
+  const bool lower_closer = (fr == 0 && ex > 1);
+  const diyfp m_plus(2 * d.f + 1, d.e - 1);
+  const diyfp m_minus = lower_closer
+    ? diyfp(4 * d.f - 1, d.e - 2)
+    : diyfp(2 * d.f - 1, d.e - 1);
+
+  const diyfp w_plus = diyfp_normalize(m_plus);
+  const diyfp w_minus = diyfp_normalize_to(m_minus, w_plus.e);
+  return { diyfp_normalize(d), w_minus, w_plus };
+}
+
+
+/** A normalized power of ten, f * 2^e ~= 10^k. */
+struct cached_power {
+  uint64_t f;
+  int e;
+  int k;
+};
+
+
+/* Powers of ten 10^k for k = -348, -340, ..., 340, rounded to 64 bits. */
+static const int k_cached_powers_min_dec_exp = -348;
+static const int k_cached_powers_dec_step = 8;
+static const cached_power k_cached_powers[] = {
+  { 0xFA8FD5A0081C0288, -1220, -348 },
+  { 0xBAAEE17FA23EBF76, -1193, -340 },
+  { 0x8B16FB203055AC76, -1166, -332 },
+  { 0xCF42894A5DCE35EA, -1140, -324 },
+  { 0x9A6BB0AA55653B2D, -1113, -316 },
+  { 0xE61ACF033D1A45DF, -1087, -308 },
+  { 0xAB70FE17C79AC6CA, -1060, -300 },
+  { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+  { 0xBE5691EF416BD60C, -1007, -284 },
+  { 0x8DD01FAD907FFC3C,  -980, -276 },
+  { 0xD3515C2831559A83,  -954, -268 },
+  { 0x9D71AC8FADA6C9B5,  -927, -260 },
+  { 0xEA9C227723EE8BCB,  -901, -252 },
+  { 0xAECC49914078536D,  -874, -244 },
+  { 0x823C12795DB6CE57,  -847, -236 },
+  { 0xC21094364DFB5637,  -821, -228 },
+  { 0x9096EA6F3848984F,  -794, -220 },
+  { 0xD77485CB25823AC7,  -768, -212 },
+  { 0xA086CFCD97BF97F4,  -741, -204 },
+  { 0xEF340A98172AACE5,  -715, -196 },
+  { 0xB23867FB2A35B28E,  -688, -188 },
+  { 0x84C8D4DFD2C63F3B,  -661, -180 },
+  { 0xC5DD44271AD3CDBA,  -635, -172 },
+  { 0x936B9FCEBB25C996,  -608, -164 },
+  { 0xDBAC6C247D62A584,  -582, -156 },
+  { 0xA3AB66580D5FDAF6,  -555, -148 },
+  { 0xF3E2F893DEC3F126,  -529, -140 },
+  { 0xB5B5ADA8AAFF80B8,  -502, -132 },
+  { 0x87625F056C7C4A8B,  -475, -124 },
+  { 0xC9BCFF6034C13053,  -449, -116 },
+  { 0x964E858C91BA2655,  -422, -108 },
+  { 0xDFF9772470297EBD,  -396, -100 },
+  { 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+  { 0xF8A95FCF88747D94,  -343,  -84 },
+  { 0xB94470938FA89BCF,  -316,  -76 },
+  { 0x8A08F0F8BF0F156B,  -289,  -68 },
+  { 0xCDB02555653131B6,  -263,  -60 },
+  { 0x993FE2C6D07B7FAC,  -236,  -52 },
+  { 0xE45C10C42A2B3B06,  -210,  -44 },
+  { 0xAA242499697392D3,  -183,  -36 },
+  { 0xFD87B5F28300CA0E,  -157,  -28 },
+  { 0xBCE5086492111AEB,  -130,  -20 },
+  { 0x8CBCCC096F5088CC,  -103,  -12 },
+  { 0xD1B71758E219652C,   -77,   -4 },
+  { 0x9C40000000000000,   -50,    4 },
+  { 0xE8D4A51000000000,   -24,   12 },
+  { 0xAD78EBC5AC620000,     3,   20 },
+  { 0x813F3978F8940984,    30,   28 },
+  { 0xC097CE7BC90715B3,    56,   36 },
+  { 0x8F7E32CE7BEA5C70,    83,   44 },
+  { 0xD5D238A4ABE98068,   109,   52 },
+  { 0x9F4F2726179A2245,   136,   60 },
+  { 0xED63A231D4C4FB27,   162,   68 },
+  { 0xB0DE65388CC8ADA8,   189,   76 },
+  { 0x83C7088E1AAB65DB,   216,   84 },
+  { 0xC45D1DF942711D9A,   242,   92 },
+  { 0x924D692CA61BE758,   269,  100 },
+  { 0xDA01EE641A708DEA,   295,  108 },
+  { 0xA26DA3999AEF774A,   322,  116 },
+  { 0xF209787BB47D6B85,   348,  124 },
+  { 0xB454E4A179DD1877,   375,  132 },
+  { 0x865B86925B9BC5C2,   402,  140 },
+  { 0xC83553C5C8965D3D,   428,  148 },
+  { 0x952AB45CFA97A0B3,   455,  156 },
+  { 0xDE469FBD99A05FE3,   481,  164 },
+  { 0xA59BC234DB398C25,   508,  172 },
+  { 0xF6C69A72A3989F5C,   534,  180 },
+  { 0xB7DCBF5354E9BECE,   561,  188 },
+  { 0x88FCF317F22241E2,   588,  196 },
+  { 0xCC20CE9BD35C78A5,   614,  204 },
+  { 0x98165AF37B2153DF,   641,  212 },
+  { 0xE2A0B5DC971F303A,   667,  220 },
+  { 0xA8D9D1535CE3B396,   694,  228 },
+  { 0xFB9B7CD9A4A7443C,   720,  236 },
+  { 0xBB764C4CA7A44410,   747,  244 },
+  { 0x8BAB8EEFB6409C1A,   774,  252 },
+  { 0xD01FEF10A657842C,   800,  260 },
+  { 0x9B10A4E5E9913129,   827,  268 },
+  { 0xE7109BFBA19C0C9D,   853,  276 },
+  { 0xAC2820D9623BF429,   880,  284 },
+  { 0x80444B5E7AA7CF85,   907,  292 },
+  { 0xBF21E44003ACDD2D,   933,  300 },
+  { 0x8E679C2F5E44FF8F,   960,  308 },
+  { 0xD433179D9C8CB841,   986,  316 },
+  { 0x9E19DB92B4E31BA9,  1013,  324 },
+  { 0xEB96BF6EBADF77D9,  1039,  332 },
+  { 0xAF87023B9BF0EE6B,  1066,  340 },
+};
+
+
+/* The target range for the binary exponent of the scaled value, chosen so
+ * that the integral part of the scaled value fits in 32 bits. */
+static const int k_alpha = -60;
+static const int k_gamma = -32;
+
+
+/** Finds a cached power c such that k_alpha <= c.e + e + 64 <= k_gamma. */
+static inline const cached_power & get_cached_power(int e)
+{
+  /* k = ceil((k_alpha - e - 1) * log10(2)), with 78913 / 2^18 ~ log10(2). */
+  const int f = k_alpha - e - 1;
+  const int k = (f * 78913) / (1 << 18) + (int)(f > 0);
+  const int index = (-k_cached_powers_min_dec_exp + k
+      + (k_cached_powers_dec_step - 1)) / k_cached_powers_dec_step;
+  ELLIS_ASSERT_GTE(index, 0);
+  ELLIS_ASSERT_LT((size_t)index,
+      sizeof(k_cached_powers) / sizeof(k_cached_powers[0]));
+
+  const cached_power &cached = k_cached_powers[index];
+  ELLIS_ASSERT_GTE(cached.e + e + 64, k_alpha);
+  ELLIS_ASSERT_LTE(cached.e + e + 64, k_gamma);
+  return cached;
+}
+
+
+/** Returns the number of digits of n, and sets pow10 to 10^(digits-1). */
+static inline int find_largest_pow10(uint32_t n, uint32_t *pow10)
+{
+  static const uint32_t k_pow10[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+    1000000000 };
+  int digits = 10;
+  while (digits > 1 && n < k_pow10[digits - 1]) {
+    digits--;
+  }
+  *pow10 = k_pow10[digits - 1];
+  return digits;
+}
+
+
+/** Moves the last digit towards w while staying inside the safe interval. */
+static inline void grisu2_round(
+    char *buf,
+    int len,
+    uint64_t dist,
+    uint64_t delta,
+    uint64_t rest,
+    uint64_t ten_k)
+{
+  while (rest < dist
+      && delta - rest >= ten_k
+      && (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+    buf[len - 1]--;
+    rest += ten_k;
+  }
+}
+
+
+/** Generates the digits of w, stopping as soon as they uniquely identify it.
+ *
+ * On return, value = buf[0..len) * 10^dec_exp.
+ */
+static void grisu2_digit_gen(
+    char *buf,
+    int *len,
+    int *dec_exp,
+    diyfp m_minus,
+    diyfp w,
+    diyfp m_plus)
+{
+  uint64_t delta = diyfp_sub(m_plus, m_minus).f;
+  uint64_t dist = diyfp_sub(m_plus, w).f;
+
+  /* Split m+ into an integral part p1 and a fractional part p2. */
+  const diyfp one(uint64_t{1} << -m_plus.e, m_plus.e);
+  uint32_t p1 = (uint32_t)(m_plus.f >> -one.e);
+  uint64_t p2 = m_plus.f & (one.f - 1);
+
+  uint32_t pow10 = 0;
+  int n = find_largest_pow10(p1, &pow10);
+  while (n > 0) {
+    const uint32_t d = p1 / pow10;
+    p1 %= pow10;
+    buf[(*len)++] = (char)('0' + d);
+    n--;
+    const uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+    if (rest <= delta) {
+      *dec_exp += n;
+      grisu2_round(buf, *len, dist, delta, rest,
+          (uint64_t)pow10 << -one.e);
+      return;
+    }
+    pow10 /= 10;
+  }
+
+  /* The integral part was not enough; continue with fractional digits. */
+  int m = 0;
+  for (;;) {
+    p2 *= 10;
+    const uint64_t d = p2 >> -one.e;
+    p2 &= one.f - 1;
+    buf[(*len)++] = (char)('0' + d);
+    m++;
+    delta *= 10;
+    dist *= 10;
+    if (p2 <= delta) {
+      break;
+    }
+  }
+  *dec_exp -= m;
+  grisu2_round(buf, *len, dist, delta, p2, one.f);
+}
+
+
+/** Produces the digits and decimal exponent of a positive finite double. */
+static void grisu2(char *buf, int *len, int *dec_exp, double v)
+{
+  const boundaries b = compute_boundaries(v);
+  ELLIS_ASSERT_EQ(b.w.e, b.plus.e);
+
+  const cached_power &cached = get_cached_power(b.plus.e);
+  const diyfp c_minus_k(cached.f, cached.e);
+
+  const diyfp w = diyfp_mul(b.w, c_minus_k);
+  const diyfp w_minus = diyfp_mul(b.minus, c_minus_k);
+  const diyfp w_plus = diyfp_mul(b.plus, c_minus_k);
+
+  /* Shrink the interval by one ulp on each side to account for the
+   * rounding error of the multiplications above. */
+  const diyfp m_minus(w_minus.f + 1, w_minus.e);
+  const diyfp m_plus(w_plus.f - 1, w_plus.e);
+
+  *len = 0;
+  *dec_exp = -cached.k;
+  grisu2_digit_gen(buf, len, dec_exp, m_minus, w, m_plus);
+}
+
+
+/* Beyond these decimal point positions, scientific notation is used. */
+static const int k_fixed_min_exp = -4;
+static const int k_fixed_max_exp = 15;
+
+
+/** Writes a decimal exponent such as "15" or "-9"; returns the end. */
+static inline char * write_exponent(int e, char *p)
+{
+  if (e < 0) {
+    *p++ = '-';
+    e = -e;
+  }
+  int n = count_digits((uint64_t)e);
+  write_digits((uint64_t)e, n, p);
+  return p + n;
+}
+
+
+/** Lays out the digits in buf[0..len) * 10^dec_exp as text, in place.
+ *
+ * The buffer must have room for the digits plus any zero padding, decimal
+ * point and exponent.
+ */
+static char * format_digits(char *buf, int len, int dec_exp)
+{
+  /* Position of the decimal point relative to the start of the digits. */
+  const int n = len + dec_exp;
+
+  if (len <= n && n <= k_fixed_max_exp) {
+    /* Integral value: digits, zero padding, then ".0" (e.g. 1234500.0). */
+    std::memset(buf + len, '0', n - len);
+    buf[n] = '.';
+    buf[n + 1] = '0';
+    return buf + n + 2;
+  }
+
+  if (0 < n && n <= k_fixed_max_exp) {
+    /* Decimal point inside the digits (e.g. 1234.5). */
+    std::memmove(buf + n + 1, buf + n, len - n);
+    buf[n] = '.';
+    return buf + len + 1;
+  }
+
+  if (k_fixed_min_exp < n && n <= 0) {
+    /* Leading zeros after the decimal point (e.g. 0.0012345). */
+    std::memmove(buf + 2 - n, buf, len);
+    buf[0] = '0';
+    buf[1] = '.';
+    std::memset(buf + 2, '0', -n);
+    return buf + 2 - n + len;
+  }
+
+  /* Scientific notation (e.g. 1e-9 or 1.2345e21). */
+  if (len == 1) {
+    buf[1] = 'e';
+    return write_exponent(n - 1, buf + 2);
+  }
+  std::memmove(buf + 2, buf + 1, len - 1);
+  buf[1] = '.';
+  buf[len + 1] = 'e';
+  return write_exponent(n - 1, buf + len + 2);
+}
+
+
+size_t format_double(double val, char *buf)
+{
+  char *p = buf;
+  if (std::signbit(val)) {
+    *p++ = '-';
+    val = -val;
+  }
+
+  if (val == 0) {
+    *p++ = '0';
+    *p++ = '.';
+    *p++ = '0';
+    return p - buf;
+  }
+
+  ELLIS_ASSERT(std::isfinite(val));
+
+  int len = 0;
+  int dec_exp = 0;
+  grisu2(p, &len, &dec_exp, val);
+  ELLIS_ASSERT_LTE(len, 17);
+  return format_digits(p, len, dec_exp) - buf;
+}
+
+
+}  /* namespace ellis */
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis_private/codec/util/projection.hpp>
+
+#include <ellis_private/core/parse_path.hpp>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+projection::projection()
+{
+}
+
+
+projection::projection(const vector<string> &paths)
+{
+  for (const auto &path : paths) {
+    _add(path);
+  }
+}
+
+
+void projection::_add(const string &path)
+{
+  projection *cur = this;
+  parse_path(path,
+      [&cur](const string &key, size_t)
+      {
+        auto &child = cur->m_keys[key];
+        if (! child) {
+          child = make_unique<projection>();
+        }
+        cur = child.get();
+      },
+      [&cur](size_t start, size_t, size_t)
+      {
+        auto &child = cur->m_indices[start];
+        if (! child) {
+          child = make_unique<projection>();
+        }
+        cur = child.get();
+      });
+  cur->m_all = true;
+}
+
+
+const projection * projection::all()
+{
+  static const unique_ptr<projection> rv = []() {
+    auto p = make_unique<projection>();
+    p->m_all = true;
+    return p;
+  }();
+  return rv.get();
+}
+
+
+const projection * projection::key(const string &k) const
+{
+  if (m_all) {
+    return this;
+  }
+  auto it = m_keys.find(k);
+  if (it == m_keys.end()) {
+    return nullptr;
+  }
+  return it->second->m_all ? all() : it->second.get();
+}
+
+
+const projection * projection::index(size_t i) const
+{
+  if (m_all) {
+    return this;
+  }
+  auto it = m_indices.find(i);
+  if (it == m_indices.end()) {
+    return nullptr;
+  }
+  return it->second->m_all ? all() : it->second.get();
+}
+
+
+bool projection::none_from(size_t i) const
+{
+  if (m_all) {
+    return false;
+  }
+  return m_indices.empty() || m_indices.rbegin()->first < i;
+}
+
+
+}  /* namespace ellis */
@@ -75,6 +75,12 @@ void array_node::append(const node &node)
 }
 
 
+void array_node::append(node &&node)
+{
+  GETARR.push_back(std::move(node));
+}
+
+
 void array_node::extend(const array_node &other)
 {
   GETARR.insert(
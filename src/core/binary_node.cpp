@@ -28,11 +28,28 @@
 #include <ellis/core/system.hpp>
 #include <ellis_private/core/payload.hpp>
 #include <ellis_private/using.hpp>
+#include <string.h>
 
 namespace ellis {
 
 
-#define GETBIN m_node.m_pay->m_bin
+#define GETPAY m_node.m_pay
+#define GETBIN _owned_bin(GETPAY)
+
+
+/** Return the vector holding the data, first copying the data out of the
+ * slice it refers to, if any.  Only for use on a writable node. */
+static payload_types::bin_t & _owned_bin(payload *pay)
+{
+  using namespace ::ellis::payload_types;
+  if (pay->m_is_slice) {
+    slice_t sl = std::move(pay->m_slice);
+    pay->m_slice.~slice_t();
+    new (&(pay->m_bin)) bin_t(sl.data, sl.data + sl.len);
+    pay->m_is_slice = false;
+  }
+  return pay->m_bin;
+}
 
 
 binary_node::~binary_node()
@@ -53,19 +70,21 @@ byte& binary_node::operator[](size_t index)
 
 const byte& binary_node::operator[](size_t index) const
 {
-  return GETBIN[index];
+  return data()[index];
 }
 
 
 bool binary_node::operator==(const binary_node &o) const
 {
-  return GETBIN == o.GETBIN;
+  const size_t len = length();
+  return len == o.length() && (len == 0 || memcmp(data(), o.data(), len) == 0);
 }
 
 
 void binary_node::append(const byte *srcdata, size_t len)
 {
-  GETBIN.insert(GETBIN.end(), srcdata, srcdata+len);
+  auto &bin = GETBIN;
+  bin.insert(bin.end(), srcdata, srcdata+len);
 }
 
 
@@ -83,19 +102,31 @@ byte * binary_node::data()
 
 const byte * binary_node::data() const
 {
-  return GETBIN.data();
+  if (GETPAY->m_is_slice) {
+    return GETPAY->m_slice.data;
+  }
+  return GETPAY->m_bin.data();
 }
 
 
 size_t binary_node::length() const
 {
-  return GETBIN.size();
+  if (GETPAY->m_is_slice) {
+    return GETPAY->m_slice.len;
+  }
+  return GETPAY->m_bin.size();
 }
 
 
 bool binary_node::is_empty() const
 {
-  return GETBIN.empty();
+  return length() == 0;
+}
+
+
+bool binary_node::is_slice() const
+{
+  return GETPAY->m_is_slice;
 }
 
 
@@ -29,5 +29,37 @@
 namespace ellis {
 
 
+/** Moves a finished node into *out, passing on any other outcome. */
+static progress unwrap(node_progress st, node *out)
+{
+  switch (st.state()) {
+    case stream_state::ERROR:
+      return progress(st.extract_error());
+
+    case stream_state::SUCCESS:
+      *out = std::move(*st.extract_value());
+      return progress(true);
+
+    case stream_state::CONTINUE:
+      break;
+  }
+  return progress(stream_state::CONTINUE);
+}
+
+
+progress decoder::consume_buffer_into(
+    const byte *buf,
+    size_t *bytecount,
+    node *out)
+{
+  return unwrap(consume_buffer(buf, bytecount), out);
+}
+
+
+progress decoder::chop_into(node *out)
+{
+  return unwrap(chop(), out);
+}
+
 
 } /*  namespace ellis */
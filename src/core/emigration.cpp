@@ -30,6 +30,7 @@
 #include <ellis/stream/fd_output_stream.hpp>
 #include <ellis/stream/file_output_stream.hpp>
 #include <ellis/stream/mem_output_stream.hpp>
+#include <ellis/stream/vector_output_stream.hpp>
 #include <ellis_private/convenience/file.hpp>
 #include <ellis_private/using.hpp>
 
@@ -43,6 +44,9 @@ void dump(
     encoder *enco)
 {
   enco->reset(nod);
+  /* Let large payloads go from the node to the stream without a copy, if
+   * both sides can manage it. */
+  enco->set_ref_min(out->ref_min());
   while (1) {
     byte *buf = nullptr;
     size_t bytecount = 0;
@@ -52,8 +56,15 @@ void dump(
     }
     /* Have encoder fill the buffer. */
     auto st = enco->fill_buffer(buf, &bytecount);
-    /* Emit whatever we were given to emit, regardless of error status. */
-    if (! out->emit(bytecount)) {
+    /* Emit whatever we were given to emit, regardless of error status,
+     * followed by the next payload if the encoder offers it in place. */
+    const byte *ref = nullptr;
+    size_t ref_len = 0;
+    bool emitted = (st.state() == stream_state::CONTINUE
+        && enco->next_ref(&ref, &ref_len))
+      ? out->emit_ref(bytecount, ref, ref_len)
+      : out->emit(bytecount);
+    if (! emitted) {
       throw *(out->extract_output_error());
     }
     switch (st.state()) {
@@ -90,6 +101,33 @@ void dump_mem(
 }
 
 
+vector<byte> dump_vector(
+    const node *nod,
+    encoder *enco)
+{
+  vector_output_stream out;
+  dump(nod, out, *enco);
+  return out.release();
+}
+
+
+void dump_vector(
+    const node *nod,
+    vector<byte> *out,
+    encoder *enco)
+{
+  vector_output_stream vos(std::move(*out));
+  try {
+    dump(nod, vos, *enco);
+  } catch (...) {
+    /* Give the storage back, though what it holds is of no use. */
+    *out = vos.release();
+    throw;
+  }
+  *out = vos.release();
+}
+
+
 void dump_stream(
     const node *nod,
     std::ostream &os,
@@ -30,34 +30,37 @@
 #include <ellis/stream/fd_input_stream.hpp>
 #include <ellis/stream/file_input_stream.hpp>
 #include <ellis/stream/mem_input_stream.hpp>
+#include <ellis/stream/mmap_input_stream.hpp>
 #include <ellis_private/convenience/file.hpp>
 #include <ellis_private/using.hpp>
+#include <linux/magic.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
 
 
 namespace ellis {
 
 
-unique_ptr<node> load(
-    sync_input_stream *in,
-    decoder *deco)
+/** Feeds the stream to the decoder through consume and chop until it
+ * finishes, and returns the finished progress.  Throws on error. */
+template <typename PROGRESS, typename CONSUME, typename CHOP>
+static PROGRESS drive(sync_input_stream *in, CONSUME consume, CHOP chop)
 {
-  deco->reset();
-  unique_ptr<node> rv;
-  auto st = node_progress(stream_state::CONTINUE);
+  auto st = PROGRESS(stream_state::CONTINUE);
   while (st.state() == stream_state::CONTINUE) {
     const byte *buf = nullptr;
     size_t buf_remain = 0;
     /* Need another block; request it. */
     if (! in->next_input_buf(&buf, &buf_remain)) {
       /* No block available. */
-      st = deco->chop();
+      st = chop();
     }
     else {
       /* Block obtained. */
       ELLIS_ASSERT(buf != nullptr);
       ELLIS_ASSERT(buf_remain > 0);
       /* Give block to decoder. */
-      st = deco->consume_buffer(buf, &buf_remain);
+      st = consume(buf, &buf_remain);
     }
     switch (st.state()) {
       case stream_state::ERROR:
@@ -66,7 +69,7 @@ unique_ptr<node> load(
 
       case stream_state::SUCCESS:
         in->put_back(buf_remain);
-        return st.extract_value();
+        return st;
 
       case stream_state::CONTINUE:
         /* All the input should have been used; we're going to get more. */
@@ -78,6 +81,35 @@ unique_ptr<node> load(
 }
 
 
+unique_ptr<node> load(
+    sync_input_stream *in,
+    decoder *deco)
+{
+  deco->reset();
+  return drive<node_progress>(in,
+      [deco](const byte *buf, size_t *bytecount)
+      {
+        return deco->consume_buffer(buf, bytecount);
+      },
+      [deco]() { return deco->chop(); }).extract_value();
+}
+
+
+void load(
+    sync_input_stream *in,
+    decoder *deco,
+    node *out)
+{
+  deco->reset();
+  drive<progress>(in,
+      [deco, out](const byte *buf, size_t *bytecount)
+      {
+        return deco->consume_buffer_into(buf, bytecount, out);
+      },
+      [deco, out]() { return deco->chop_into(out); });
+}
+
+
 //std::unique_ptr<node> load_fd(
 //    int fd,
 //    decoder *deco)
@@ -86,10 +118,42 @@ unique_ptr<node> load(
 //}
 
 
+/** Whether the file can be mapped, rather than read; pipes, devices and
+ * "-" (standard input) can not.  Nor can empty files, or the pseudo-files
+ * of proc, sysfs, debugfs and tracefs, which look regular but whose sizes
+ * (0, or a nominal 4096) say nothing of what a read returns. */
+static bool is_mappable(const char *filename)
+{
+  struct stat st;
+  if (strcmp(filename, "-") == 0
+      || stat(filename, &st) != 0
+      || ! S_ISREG(st.st_mode)
+      || st.st_size == 0)
+  {
+    return false;
+  }
+  struct statfs fs;
+  if (statfs(filename, &fs) != 0) {
+    return false;
+  }
+  switch (fs.f_type) {
+    case PROC_SUPER_MAGIC:
+    case SYSFS_MAGIC:
+    case DEBUGFS_MAGIC:
+    case TRACEFS_MAGIC:
+      return false;
+  }
+  return true;
+}
+
+
 std::unique_ptr<node> load_file(
     const char *filename,
     decoder *deco)
 {
+  if (is_mappable(filename)) {
+    return load(mmap_input_stream(filename), *deco);
+  }
   return load(file_input_stream(filename), *deco);
 }
 
@@ -103,6 +167,16 @@ std::unique_ptr<node> load_mem(
 }
 
 
+void load_mem(
+    const void *buf,
+    size_t len,
+    decoder *deco,
+    node *out)
+{
+  load(mem_input_stream(buf, len), *deco, out);
+}
+
+
 std::unique_ptr<node> load_stream(
     std::istream &is,
     decoder *deco)
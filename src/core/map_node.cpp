@@ -169,6 +169,19 @@ void map_node::erase(const char *key)
 }
 
 
+node * map_node::find(const std::string &key)
+{
+  return const_cast<node*>(static_cast<const map_node*>(this)->find(key));
+}
+
+
+const node * map_node::find(const std::string &key) const
+{
+  const auto it = GETMAP.find(key);
+  return it == GETMAP.end() ? nullptr : &it->second;
+}
+
+
 bool map_node::has_key(const char *key) const
 {
   return GETMAP.count(key) > 0;
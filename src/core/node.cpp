@@ -31,6 +31,7 @@
 #include <ellis/core/system.hpp>
 #include <ellis/core/type.hpp>
 #include <ellis/core/u8str_node.hpp>
+#include <ellis_private/core/parse_path.hpp>
 #include <ellis_private/core/payload.hpp>
 #include <ellis_private/using.hpp>
 #include <stddef.h>
@@ -296,6 +297,7 @@ void node::_zap_contents(type t)
     // any payload might take.
     m_pay = (payload*)malloc(sizeof(*m_pay));
     m_pay->m_refcount = 1;
+    m_pay->m_is_slice = false;
     switch (type(m_type)) {
       case type::ARRAY:
         new (&(m_pay->m_arr)) arr_t();
@@ -361,7 +363,12 @@ void node::_release_contents()
           break;
 
         case type::BINARY:
-          m_pay->m_bin.~bin_t();
+          if (m_pay->m_is_slice) {
+            m_pay->m_slice.~slice_t();
+          }
+          else {
+            m_pay->m_bin.~bin_t();
+          }
           break;
 
         case type::MAP:
@@ -451,8 +458,21 @@ node::node(type t)
 node::node(const byte *mem, size_t bytes)
 {
   _zap_contents(type::BINARY);
-  m_pay->m_bin.resize(bytes);
-  memcpy(m_pay->m_bin.data(), mem, bytes);
+  if (bytes > 0) {
+    m_pay->m_bin.resize(bytes);
+    memcpy(m_pay->m_bin.data(), mem, bytes);
+  }
+}
+
+
+node::node(std::shared_ptr<const void> owner, const byte *mem, size_t bytes)
+{
+  using namespace ::ellis::payload_types;
+
+  _zap_contents(type::BINARY);
+  m_pay->m_bin.~bin_t();
+  new (&(m_pay->m_slice)) slice_t{std::move(owner), mem, bytes};
+  m_pay->m_is_slice = true;
 }
 
 
@@ -531,7 +551,7 @@ node::node(const node& other)
 }
 
 
-node::node(node&& other)
+node::node(node&& other) noexcept
 {
   _grab_contents(other);
   other._release_contents();
@@ -567,7 +587,13 @@ void node::deep_copy(const node &o)
         break;
 
       case type::BINARY:
-        m_pay->m_bin = tmp.m_pay->m_bin;
+        if (tmp.m_pay->m_is_slice) {
+          const auto &sl = tmp.m_pay->m_slice;
+          m_pay->m_bin.assign(sl.data, sl.data + sl.len);
+        }
+        else {
+          m_pay->m_bin = tmp.m_pay->m_bin;
+        }
         break;
 
       case type::MAP:
@@ -599,7 +625,7 @@ node& node::operator=(const node& rhs)
 }
 
 
-node& node::operator=(node&& rhs)
+node& node::operator=(node&& rhs) noexcept
 {
   _release_contents();
   _grab_contents(rhs);
@@ -711,18 +737,7 @@ type node::get_type() const
 }
 
 
-using map_selector_cb = std::function<void(
-    const string & pattern,
-    size_t path_position)>;
-
-
-using array_selector_cb = std::function<void(
-    size_t start,
-    size_t stop,
-    size_t path_position)>;
-
-
-static void parse_path(
+void parse_path(
     const string & path,
     const map_selector_cb & got_map_selector,
     const array_selector_cb & got_array_selector)
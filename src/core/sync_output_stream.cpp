@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/core/sync_output_stream.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <ellis_private/using.hpp>
+
+namespace ellis {
+
+
+bool sync_output_stream::emit_ref(
+    size_t bytecount,
+    const byte *data,
+    size_t len)
+{
+  if (! emit(bytecount)) {
+    return false;
+  }
+  while (len > 0) {
+    byte *buf = nullptr;
+    size_t avail = 0;
+    if (! next_output_buf(&buf, &avail)) {
+      return false;
+    }
+    const size_t n = std::min(len, avail);
+    memcpy(buf, data, n);
+    if (! emit(n)) {
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+
+}  /* namespace ellis */
@@ -164,7 +164,7 @@ void default_system_log_function(
   gmtime_r(&(ts.tv_sec), &t);
   char timestr[23];
   strftime(timestr, sizeof(timestr), "%Y-%m-%d Z%T", &t);
-  va_list(args);
+  va_list args;
   va_start(args, fmt);
   flockfile(stderr);
   fprintf(stderr, "%s.%03d %s/%d %s:%d ",
@@ -212,7 +212,7 @@ void default_crash_function(
   get_sys()->m_crash_file = file;
   get_sys()->m_crash_line = line;
   get_sys()->m_crash_funcname = func;
-  va_list(args);
+  va_list args;
   va_start(args, fmt);
   vsnprintf(get_sys()->m_crash_epitaph, sizeof(get_sys()->m_crash_epitaph),
       fmt, args);
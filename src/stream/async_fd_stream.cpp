@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/async_fd_stream.hpp>
+
+#include <ellis/core/err.hpp>
+#include <ellis/core/system.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <ellis_private/using.hpp>
+
+namespace ellis {
+
+
+constexpr size_t async_fd_stream::k_default_size;
+
+
+async_fd_stream::async_fd_stream(
+    int fd,
+    size_t bufsize,
+    size_t max_bufsize) :
+  m_fd(fd),
+  m_in(bufsize, max_bufsize),
+  m_out(bufsize, max_bufsize)
+{
+  int flags = fcntl(m_fd, F_GETFL);
+  if (flags < 0 || fcntl(m_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    THROW_ELLIS_ERR(IO, "can not make fd " << fd << " non-blocking");
+  }
+}
+
+stream_state async_fd_stream::try_next_input_buf(
+    const byte **buf,
+    size_t *bytecount)
+{
+  if (m_in_pos >= m_in_avail) {
+    /* No more bytes in current block?  Then try to get another one. */
+    m_in_pos = 0;
+    m_in_avail = 0;
+    m_in.fresh();
+    ssize_t n;
+    do {
+      n = read(m_fd, m_in.data(), m_in.size());
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return stream_state::CONTINUE;
+    }
+    else if (n < 0) {
+      m_in_err = MAKE_UNIQUE_ELLIS_ERR(IO, "I/O error");
+      return stream_state::ERROR;
+    }
+    else if (n == 0) {
+      m_in_err = MAKE_UNIQUE_ELLIS_ERR(IO, "end of file");
+      return stream_state::ERROR;
+    }
+    m_in_avail = n;
+    m_in.filled(n);
+  }
+  *buf = m_in.data() + m_in_pos;
+  *bytecount = m_in_avail - m_in_pos;
+  /* Treat input as consumed unless put_back is called. */
+  m_in_pos = m_in_avail;
+  return stream_state::SUCCESS;
+}
+
+void async_fd_stream::put_back(size_t bytecount)
+{
+  m_in_pos = m_in_avail - bytecount;
+}
+
+unique_ptr<err> async_fd_stream::extract_input_error()
+{
+  return std::move(m_in_err);
+}
+
+int async_fd_stream::input_fd() const
+{
+  return m_fd;
+}
+
+bool async_fd_stream::next_output_buf(byte **buf, size_t *bytecount)
+{
+  ELLIS_ASSERT_EQ(m_out_pos, m_out_len);
+  *buf = m_out.fresh();
+  *bytecount = m_out.size();
+  return true;
+}
+
+stream_state async_fd_stream::emit(size_t bytecount)
+{
+  ELLIS_ASSERT_LTE(bytecount, m_out.size());
+  m_out.filled(bytecount);
+  m_out_pos = 0;
+  m_out_len = bytecount;
+  return flush();
+}
+
+stream_state async_fd_stream::flush()
+{
+  while (m_out_pos < m_out_len) {
+    const byte *p = m_out.data() + m_out_pos;
+    const size_t len = m_out_len - m_out_pos;
+    /* For sockets, a closed peer should be an error, not a SIGPIPE. */
+    ssize_t n = m_is_socket ? send(m_fd, p, len, MSG_NOSIGNAL) : -1;
+    if (n < 0 && m_is_socket && errno == ENOTSOCK) {
+      m_is_socket = false;
+    }
+    if (! m_is_socket) {
+      n = write(m_fd, p, len);
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return stream_state::CONTINUE;
+    }
+    else if (n < 0) {
+      m_out_err = MAKE_UNIQUE_ELLIS_ERR(IO, "I/O error");
+      return stream_state::ERROR;
+    }
+    m_out_pos += n;
+  }
+  return stream_state::SUCCESS;
+}
+
+unique_ptr<err> async_fd_stream::extract_output_error()
+{
+  return std::move(m_out_err);
+}
+
+int async_fd_stream::output_fd() const
+{
+  return m_fd;
+}
+
+
+}  /* namespace ellis */
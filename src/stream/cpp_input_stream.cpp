@@ -29,7 +29,13 @@
 
 namespace ellis {
 
-cpp_input_stream::cpp_input_stream(std::istream &is) : m_is(is) {
+cpp_input_stream::cpp_input_stream(
+    std::istream &is,
+    size_t bufsize,
+    size_t max_bufsize) :
+  m_is(is),
+  m_buf(bufsize, max_bufsize)
+{
 }
 
 bool cpp_input_stream::next_input_buf(const byte **buf, size_t *bytecount) {
@@ -46,16 +52,17 @@ bool cpp_input_stream::next_input_buf(const byte **buf, size_t *bytecount) {
   }
 
   m_pos = 0;
-  m_is.read((char*)m_buf, sizeof(m_buf));
-  m_avail = (int)m_is.gcount();
-  if (m_avail <= 0) {
+  m_is.read((char*)m_buf.fresh(), m_buf.size());
+  m_avail = (size_t)m_is.gcount();
+  m_buf.filled(m_avail);
+  if (m_avail == 0) {
     // TODO: check fail bits?
     m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "end of file");
     return false;
   }
 
 give_buffer:
-  *buf = m_buf + m_pos;
+  *buf = m_buf.data() + m_pos;
   *bytecount = m_avail - m_pos;
   /* Treat input as consumed unless put_back is called. */
   m_pos = m_avail;
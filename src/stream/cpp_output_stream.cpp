@@ -30,22 +30,50 @@
 namespace ellis {
 
 
-cpp_output_stream::cpp_output_stream(std::ostream &os) : m_os(os) {
+cpp_output_stream::cpp_output_stream(
+    std::ostream &os,
+    size_t bufsize,
+    size_t max_bufsize) :
+  m_os(os),
+  m_buf(bufsize, max_bufsize)
+{
 }
 
 bool cpp_output_stream::next_output_buf(byte **buf, size_t *bytecount) {
-  *buf = m_buf;
-  *bytecount = sizeof(m_buf);
+  *buf = m_buf.fresh();
+  *bytecount = m_buf.size();
   return true;
 }
 
-bool cpp_output_stream::emit(size_t bytecount) {
-  ELLIS_ASSERT_LTE(bytecount, sizeof(m_buf));
-  // TODO: handle failure
-  m_os.write((char*)m_buf, bytecount);
+/** Writes to the ostream, turning a failure into m_err. */
+bool cpp_output_stream::_write(const byte *data, size_t len) {
+  m_os.write((const char *)data, len);
+  if (! m_os) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "I/O error");
+    return false;
+  }
   return true;
 }
 
+bool cpp_output_stream::emit(size_t bytecount) {
+  ELLIS_ASSERT_LTE(bytecount, m_buf.size());
+  m_buf.filled(bytecount);
+  return _write(m_buf.data(), bytecount);
+}
+
+size_t cpp_output_stream::ref_min() const {
+  /* The ostream does its own buffering, so there is only a call to save. */
+  return 4096;
+}
+
+bool cpp_output_stream::emit_ref(
+    size_t bytecount,
+    const byte *data,
+    size_t len)
+{
+  return emit(bytecount) && _write(data, len);
+}
+
 unique_ptr<err> cpp_output_stream::extract_output_error() {
   return std::move(m_err);
 }
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/epoll_reactor.hpp>
+
+#include <ellis/core/err.hpp>
+#include <ellis/core/system.hpp>
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <vector>
+#include <ellis_private/using.hpp>
+
+namespace ellis {
+
+
+/** The load and dump going on one file descriptor. */
+struct epoll_reactor::session {
+  /* The load, if any. */
+  async_input_stream *in = nullptr;
+  decoder *deco = nullptr;
+  load_done_fn load_done;
+
+  /* The dump, if any. */
+  async_output_stream *out = nullptr;
+  encoder *enco = nullptr;
+  dump_done_fn dump_done;
+  /** Whether output is queued, waiting for the stream to be writable. */
+  bool flushing = false;
+  /** Whether the encoder has finished, so that only queued output is
+   * left. */
+  bool enc_done = false;
+
+  /** The events registered with epoll; 0 if not registered. */
+  uint32_t events = 0;
+};
+
+
+/** Feeds the stream to the decoder for as long as it has data ready. */
+static node_progress step_load(async_input_stream *in, decoder *deco)
+{
+  while (true) {
+    const byte *buf = nullptr;
+    size_t buf_remain = 0;
+    auto st = in->try_next_input_buf(&buf, &buf_remain);
+    if (st == stream_state::CONTINUE) {
+      return node_progress(stream_state::CONTINUE);
+    }
+    else if (st == stream_state::ERROR) {
+      /* No more data coming. */
+      return deco->chop();
+    }
+    ELLIS_ASSERT(buf != nullptr);
+    ELLIS_ASSERT(buf_remain > 0);
+    auto res = deco->consume_buffer(buf, &buf_remain);
+    if (res.state() != stream_state::CONTINUE) {
+      in->put_back(buf_remain);
+      return res;
+    }
+    /* All the input should have been used; we're going to get more. */
+    ELLIS_ASSERT_EQ(buf_remain, 0);
+  }
+}
+
+
+/** Feeds the encoder's output to the stream for as long as it is taken. */
+static progress step_dump(
+    async_output_stream *out,
+    encoder *enco,
+    bool *flushing,
+    bool *enc_done)
+{
+  if (*flushing) {
+    auto st = out->flush();
+    if (st == stream_state::CONTINUE) {
+      return progress(stream_state::CONTINUE);
+    }
+    else if (st == stream_state::ERROR) {
+      return progress(out->extract_output_error());
+    }
+    *flushing = false;
+    if (*enc_done) {
+      return progress(true);
+    }
+  }
+  while (true) {
+    byte *buf = nullptr;
+    size_t bytecount = 0;
+    if (! out->next_output_buf(&buf, &bytecount)) {
+      return progress(out->extract_output_error());
+    }
+    auto res = enco->fill_buffer(buf, &bytecount);
+    /* Emit whatever we were given to emit, regardless of error status. */
+    auto st = out->emit(bytecount);
+    if (st == stream_state::ERROR) {
+      return progress(out->extract_output_error());
+    }
+    else if (res.state() == stream_state::ERROR) {
+      return res;
+    }
+    *enc_done = (res.state() == stream_state::SUCCESS);
+    if (st == stream_state::CONTINUE) {
+      *flushing = true;
+      return progress(stream_state::CONTINUE);
+    }
+    else if (*enc_done) {
+      return progress(true);
+    }
+  }
+}
+
+
+epoll_reactor::epoll_reactor()
+{
+  m_epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (m_epfd < 0) {
+    THROW_ELLIS_ERR(IO, "epoll_create1 failed: " << strerror(errno));
+  }
+}
+
+epoll_reactor::~epoll_reactor()
+{
+  close(m_epfd);
+}
+
+epoll_reactor::session & epoll_reactor::_session(int fd)
+{
+  auto &s = m_sessions[fd];
+  if (! s) {
+    s.reset(new session());
+  }
+  return *s;
+}
+
+/** Brings what epoll watches fd for into line with what s is waiting for:
+ * input for a load, and room for output for a dump that has some queued. */
+void epoll_reactor::_watch(int fd, session &s)
+{
+  uint32_t want = 0;
+  if (s.in) {
+    want |= EPOLLIN;
+  }
+  if (s.flushing) {
+    want |= EPOLLOUT;
+  }
+  if (want == s.events) {
+    return;
+  }
+  int op = (s.events == 0) ? EPOLL_CTL_ADD
+    : (want == 0) ? EPOLL_CTL_DEL
+    : EPOLL_CTL_MOD;
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = want;
+  ev.data.fd = fd;
+  if (epoll_ctl(m_epfd, op, fd, &ev) != 0) {
+    THROW_ELLIS_ERR(IO, "can not watch fd " << fd << ": " << strerror(errno));
+  }
+  s.events = want;
+}
+
+void epoll_reactor::load(
+    async_input_stream *in,
+    decoder *deco,
+    load_done_fn done)
+{
+  int fd = in->input_fd();
+  session &s = _session(fd);
+  if (s.in) {
+    THROW_ELLIS_ERR(INVALID_ARGS, "fd " << fd << " already has a load");
+  }
+  s.in = in;
+  s.deco = deco;
+  s.load_done = std::move(done);
+  try {
+    _watch(fd, s);
+  }
+  catch (...) {
+    s.in = nullptr;
+    s.deco = nullptr;
+    if (! s.out) {
+      m_sessions.erase(fd);
+    }
+    throw;
+  }
+  deco->reset();
+  m_pending++;
+  /* The stream may have data buffered already, which epoll can not see. */
+  m_ready.push_back(fd);
+}
+
+void epoll_reactor::dump(
+    const node *nod,
+    async_output_stream *out,
+    encoder *enco,
+    dump_done_fn done)
+{
+  int fd = out->output_fd();
+  session &s = _session(fd);
+  if (s.out) {
+    THROW_ELLIS_ERR(INVALID_ARGS, "fd " << fd << " already has a dump");
+  }
+  s.out = out;
+  s.enco = enco;
+  s.dump_done = std::move(done);
+  s.flushing = false;
+  s.enc_done = false;
+  enco->reset(nod);
+  m_pending++;
+  /* Start writing at once; epoll is only needed once the stream is full. */
+  m_ready.push_back(fd);
+}
+
+size_t epoll_reactor::_step(int fd, bool readable, bool writable)
+{
+  auto it = m_sessions.find(fd);
+  if (it == m_sessions.end()) {
+    return 0;
+  }
+  session &s = *it->second;
+  size_t finished = 0;
+
+  node_progress load_res(stream_state::CONTINUE);
+  load_done_fn load_done;
+  if (s.in && readable) {
+    load_res = step_load(s.in, s.deco);
+    if (load_res.state() != stream_state::CONTINUE) {
+      load_done = std::move(s.load_done);
+      s.in = nullptr;
+      s.deco = nullptr;
+      finished++;
+    }
+  }
+
+  progress dump_res(stream_state::CONTINUE);
+  dump_done_fn dump_done;
+  if (s.out && writable) {
+    dump_res = step_dump(s.out, s.enco, &s.flushing, &s.enc_done);
+    if (dump_res.state() != stream_state::CONTINUE) {
+      dump_done = std::move(s.dump_done);
+      s.out = nullptr;
+      s.enco = nullptr;
+      s.flushing = false;
+      finished++;
+    }
+  }
+
+  /* Settle our own state before calling out, since the done functions may
+   * close the descriptor, or start new sessions on it. */
+  _watch(fd, s);
+  if (! s.in && ! s.out) {
+    m_sessions.erase(it);
+  }
+  m_pending -= finished;
+  if (load_done) {
+    load_done(std::move(load_res));
+  }
+  if (dump_done) {
+    dump_done(std::move(dump_res));
+  }
+  return finished;
+}
+
+size_t epoll_reactor::run_once(int timeout_ms)
+{
+  struct epoll_event evs[64];
+  int n;
+  do {
+    n = epoll_wait(m_epfd, evs, 64, m_ready.empty() ? timeout_ms : 0);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    THROW_ELLIS_ERR(IO, "epoll_wait failed: " << strerror(errno));
+  }
+
+  size_t finished = 0;
+  vector<int> ready;
+  ready.swap(m_ready);
+  for (int fd : ready) {
+    finished += _step(fd, true, true);
+  }
+  for (int i = 0; i < n; i++) {
+    const uint32_t e = evs[i].events;
+    /* Let the streams find out about errors and hangups for themselves. */
+    const bool bad = (e & (EPOLLERR | EPOLLHUP)) != 0;
+    finished += _step(evs[i].data.fd,
+        bad || (e & EPOLLIN) != 0,
+        bad || (e & EPOLLOUT) != 0);
+  }
+  return finished;
+}
+
+void epoll_reactor::run()
+{
+  while (m_pending > 0) {
+    run_once(-1);
+  }
+}
+
+size_t epoll_reactor::pending() const
+{
+  return m_pending;
+}
+
+
+}  /* namespace ellis */
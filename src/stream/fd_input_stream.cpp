@@ -30,11 +30,17 @@
 
 namespace ellis {
 
-fd_input_stream::fd_input_stream(int fd) : m_fd(fd) {
+fd_input_stream::fd_input_stream(
+    int fd,
+    size_t bufsize,
+    size_t max_bufsize) :
+  m_buf(bufsize, max_bufsize),
+  m_fd(fd)
+{
 }
 
 bool fd_input_stream::next_input_buf(const byte **buf, size_t *bytecount) {
-  int n = 0;
+  ssize_t n = 0;
   if (m_pos < m_avail) {
     /* We have some leftover buffer from earlier.  Return that. */
     goto give_buffer;
@@ -43,8 +49,9 @@ bool fd_input_stream::next_input_buf(const byte **buf, size_t *bytecount) {
   /* No more bytes in current block?  Then try to get another one. */
   m_pos = 0;
   m_avail = 0;
+  m_buf.fresh();
   while (1) {
-    n = read(m_fd, m_buf, sizeof(m_buf));
+    n = read(m_fd, m_buf.data(), m_buf.size());
     if (n < 0 && errno == EINTR) {
       continue;
     }
@@ -63,9 +70,10 @@ bool fd_input_stream::next_input_buf(const byte **buf, size_t *bytecount) {
   }
   /* Got some data. */
   m_avail = n;
+  m_buf.filled(n);
 
 give_buffer:
-  *buf = (const byte *)(m_buf + m_pos);
+  *buf = m_buf.data() + m_pos;
   *bytecount = m_avail - m_pos;
   /* Treat input as consumed unless put_back is called. */
   m_pos = m_avail;
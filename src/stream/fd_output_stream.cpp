@@ -26,25 +26,45 @@
 
 #include <ellis/core/err.hpp>
 #include <ellis_private/using.hpp>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace ellis {
 
 
-fd_output_stream::fd_output_stream(int fd) : m_fd(fd) {
+fd_output_stream::fd_output_stream(
+    int fd,
+    size_t bufsize,
+    size_t max_bufsize) :
+  m_buf(bufsize, max_bufsize),
+  m_fd(fd)
+{
 }
 
 bool fd_output_stream::next_output_buf(byte **buf, size_t *bytecount) {
-  *buf = (byte *)m_buf;
-  *bytecount = sizeof(m_buf);
+  *buf = m_buf.fresh();
+  *bytecount = m_buf.size();
   return true;
 }
 
 bool fd_output_stream::emit(size_t bytecount) {
-  ELLIS_ASSERT_LTE(bytecount, sizeof(m_buf));
+  ELLIS_ASSERT_LTE(bytecount, m_buf.size());
+  m_buf.filled(bytecount);
   size_t pos = 0;
   while (pos < bytecount) {
-    int n = write(m_fd, m_buf, bytecount - pos);
+    const byte *p = m_buf.data() + pos;
+    const size_t len = bytecount - pos;
+    /* For sockets, a closed peer should be an error, not a SIGPIPE. */
+    ssize_t n = m_is_socket ? send(m_fd, p, len, MSG_NOSIGNAL) : -1;
+    if (n < 0 && m_is_socket && errno == ENOTSOCK) {
+      m_is_socket = false;
+    }
+    if (! m_is_socket) {
+      n = write(m_fd, p, len);
+    }
     if (n == 0 || (n < 0 && errno == EINTR)) {
       continue;
     }
@@ -59,6 +79,64 @@ bool fd_output_stream::emit(size_t bytecount) {
   return true;
 }
 
+size_t fd_output_stream::ref_min() const {
+  /* Each body written in place costs a writev of its own, where copied
+   * bodies share one.  See msgpack_dump_{file,pipe}_* in
+   * bench/codec/msgpack_bench.cpp.  To a file, writing in place wins from
+   * 32 KB; to a pipe drained on the same CPU it only breaks even at 64 KB,
+   * and loses below. */
+  return 32 * 1024;
+}
+
+bool fd_output_stream::emit_ref(
+    size_t bytecount,
+    const byte *data,
+    size_t len)
+{
+  ELLIS_ASSERT_LTE(bytecount, m_buf.size());
+  m_buf.filled(bytecount);
+  /* The buffered bytes and then the data, in one writev() if possible. */
+  struct iovec iov[2];
+  iov[0].iov_base = m_buf.data();
+  iov[0].iov_len = bytecount;
+  iov[1].iov_base = (void *)data;
+  iov[1].iov_len = len;
+  struct iovec *v = (bytecount > 0) ? iov : iov + 1;
+  int vcount = (bytecount > 0) ? 2 : 1;
+  while (vcount > 0) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = v;
+    msg.msg_iovlen = vcount;
+    ssize_t n = m_is_socket ? sendmsg(m_fd, &msg, MSG_NOSIGNAL) : -1;
+    if (n < 0 && m_is_socket && errno == ENOTSOCK) {
+      m_is_socket = false;
+    }
+    if (! m_is_socket) {
+      n = writev(m_fd, v, vcount);
+    }
+    if (n == 0 || (n < 0 && errno == EINTR)) {
+      continue;
+    }
+    else if (n < 0) {
+      m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "I/O error");
+      return false;
+    }
+    /* Skip past what was written, which may end part way into a vector. */
+    size_t done = n;
+    while (vcount > 0 && done >= v->iov_len) {
+      done -= v->iov_len;
+      v++;
+      vcount--;
+    }
+    if (vcount > 0) {
+      v->iov_base = (byte *)v->iov_base + done;
+      v->iov_len -= done;
+    }
+  }
+  return true;
+}
+
 unique_ptr<err> fd_output_stream::extract_output_error() {
   return std::move(m_err);
 }
@@ -36,7 +36,11 @@
 namespace ellis {
 
 
-file_input_stream::file_input_stream(const char *filename) {
+file_input_stream::file_input_stream(
+    const char *filename,
+    size_t bufsize,
+    size_t max_bufsize)
+{
   if (strcmp(filename, "-") == 0) {
     m_fd = 0;
   } else {
@@ -46,7 +50,7 @@ file_input_stream::file_input_stream(const char *filename) {
     // TODO: map errno for more specifics
     THROW_ELLIS_ERR(IO, "bad pathname: " << filename);
   }
-  m_fdis.reset(new fd_input_stream(m_fd));
+  m_fdis.reset(new fd_input_stream(m_fd, bufsize, max_bufsize));
 }
 
 file_input_stream::~file_input_stream() {
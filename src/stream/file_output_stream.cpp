@@ -36,7 +36,11 @@
 namespace ellis {
 
 
-file_output_stream::file_output_stream(const char *filename) {
+file_output_stream::file_output_stream(
+    const char *filename,
+    size_t bufsize,
+    size_t max_bufsize)
+{
   if (strcmp(filename, "-") == 0) {
     m_fd = 1;
   } else {
@@ -46,7 +50,7 @@ file_output_stream::file_output_stream(const char *filename) {
     // TODO: map errno for more specifics
     THROW_ELLIS_ERR(IO, "bad pathname: " << filename);
   }
-  m_fdos.reset(new fd_output_stream(m_fd));
+  m_fdos.reset(new fd_output_stream(m_fd, bufsize, max_bufsize));
 }
 
 file_output_stream::~file_output_stream() {
@@ -65,6 +69,18 @@ bool file_output_stream::emit(size_t bytecount) {
   return m_fdos->emit(bytecount);
 }
 
+size_t file_output_stream::ref_min() const {
+  return m_fdos->ref_min();
+}
+
+bool file_output_stream::emit_ref(
+    size_t bytecount,
+    const byte *data,
+    size_t len)
+{
+  return m_fdos->emit_ref(bytecount, data, len);
+}
+
 unique_ptr<err> file_output_stream::extract_output_error() {
   return m_fdos->extract_output_error();
 }
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/frame_input_stream.hpp>
+
+#include <algorithm>
+#include <ellis/core/err.hpp>
+#include <ellis/core/system.hpp>
+#include <stdint.h>
+#include <ellis_private/using.hpp>
+
+namespace ellis {
+
+
+frame_input_stream::frame_input_stream(sync_input_stream &in) :
+  m_in(in)
+{
+}
+
+frame_input_stream::~frame_input_stream() {
+  /* Leave the rest for whoever reads the underlying stream next. */
+  if (m_pos < m_len) {
+    m_in.put_back(m_len - m_pos);
+  }
+}
+
+/** Makes sure there is something left in m_buf, taking the next buffer
+ * from the underlying stream if need be. */
+bool frame_input_stream::_fill() {
+  if (m_pos < m_len) {
+    return true;
+  }
+  m_buf = nullptr;
+  m_len = 0;
+  m_pos = 0;
+  if (! m_in.next_input_buf(&m_buf, &m_len)) {
+    m_err = m_in.extract_input_error();
+    return false;
+  }
+  return true;
+}
+
+/** Reads a chunk header, which may straddle buffers. */
+bool frame_input_stream::_read_header(uint32_t *len) {
+  uint32_t v = 0;
+  for (size_t i = 0; i < 4; i++) {
+    if (! _fill()) {
+      m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "truncated frame");
+      return false;
+    }
+    v = (v << 8) | m_buf[m_pos++];
+  }
+  *len = v;
+  return true;
+}
+
+bool frame_input_stream::next_frame() {
+  m_err.reset();
+  /* Pass over the rest of the current frame. */
+  if (m_in_frame) {
+    while (! m_frame_done) {
+      while (m_chunk_left > 0) {
+        if (! _fill()) {
+          m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "truncated frame");
+          return false;
+        }
+        const size_t n = std::min(m_chunk_left, m_len - m_pos);
+        m_pos += n;
+        m_chunk_left -= n;
+      }
+      uint32_t len;
+      if (! _read_header(&len)) {
+        return false;
+      }
+      m_chunk_left = len;
+      m_frame_done = (len == 0);
+    }
+  }
+  m_in_frame = false;
+  m_frame_done = false;
+  m_chunk_left = 0;
+  /* Is there another frame at all? */
+  if (! _fill()) {
+    return false;
+  }
+  m_in_frame = true;
+  return true;
+}
+
+bool frame_input_stream::next_input_buf(const byte **buf, size_t *bytecount) {
+  if (! m_in_frame || m_frame_done) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "end of frame");
+    return false;
+  }
+  while (m_chunk_left == 0) {
+    uint32_t len;
+    if (! _read_header(&len)) {
+      return false;
+    }
+    if (len == 0) {
+      m_frame_done = true;
+      m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "end of frame");
+      return false;
+    }
+    m_chunk_left = len;
+  }
+  if (! _fill()) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "truncated frame");
+    return false;
+  }
+  const size_t n = std::min(m_chunk_left, m_len - m_pos);
+  *buf = m_buf + m_pos;
+  *bytecount = n;
+  m_pos += n;
+  m_chunk_left -= n;
+  return true;
+}
+
+void frame_input_stream::put_back(size_t bytecount) {
+  ELLIS_ASSERT_LTE(bytecount, m_pos);
+  m_pos -= bytecount;
+  m_chunk_left += bytecount;
+}
+
+unique_ptr<err> frame_input_stream::extract_input_error() {
+  return std::move(m_err);
+}
+
+
+}  /* namespace ellis */
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/frame_output_stream.hpp>
+
+#include <ellis/core/err.hpp>
+#include <ellis/core/system.hpp>
+#include <stdint.h>
+#include <ellis_private/using.hpp>
+
+namespace ellis {
+
+
+constexpr size_t frame_output_stream::k_header_size;
+
+
+static void put_header(byte *dst, uint32_t len)
+{
+  dst[0] = (byte)(len >> 24);
+  dst[1] = (byte)(len >> 16);
+  dst[2] = (byte)(len >> 8);
+  dst[3] = (byte)len;
+}
+
+
+frame_output_stream::frame_output_stream(sync_output_stream &out) :
+  m_out(out)
+{
+}
+
+bool frame_output_stream::end_frame() {
+  byte *buf;
+  size_t avail;
+  if (! m_out.next_output_buf(&buf, &avail)) {
+    return false;
+  }
+  if (avail < k_header_size) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "no room for frame header");
+    return false;
+  }
+  put_header(buf, 0);
+  return m_out.emit(k_header_size);
+}
+
+bool frame_output_stream::next_output_buf(byte **buf, size_t *bytecount) {
+  size_t avail;
+  if (! m_out.next_output_buf(&m_buf, &avail)) {
+    return false;
+  }
+  if (avail <= k_header_size) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "no room for frame header");
+    return false;
+  }
+  /* Leave room in front for the chunk header. */
+  *buf = m_buf + k_header_size;
+  *bytecount = avail - k_header_size;
+  return true;
+}
+
+bool frame_output_stream::emit(size_t bytecount) {
+  /* An empty chunk would end the frame. */
+  if (bytecount == 0) {
+    return true;
+  }
+  put_header(m_buf, bytecount);
+  return m_out.emit(k_header_size + bytecount);
+}
+
+size_t frame_output_stream::ref_min() const {
+  return m_out.ref_min();
+}
+
+bool frame_output_stream::emit_ref(
+    size_t bytecount,
+    const byte *data,
+    size_t len)
+{
+  const size_t total = bytecount + len;
+  if (total > UINT32_MAX) {
+    /* Too long for one chunk; copy it over several. */
+    return sync_output_stream::emit_ref(bytecount, data, len);
+  }
+  if (total == 0) {
+    return true;
+  }
+  put_header(m_buf, total);
+  return m_out.emit_ref(k_header_size + bytecount, data, len);
+}
+
+unique_ptr<err> frame_output_stream::extract_output_error() {
+  if (m_err) {
+    return std::move(m_err);
+  }
+  return m_out.extract_output_error();
+}
+
+
+}  /* namespace ellis */
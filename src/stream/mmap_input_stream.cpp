@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/mmap_input_stream.hpp>
+
+#include <algorithm>
+#include <ellis/core/err.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+constexpr size_t mmap_input_stream::k_default_window;
+
+
+mmap_input_stream::mmap_input_stream(const char *filename, size_t window)
+{
+  m_fd = open(filename, O_RDONLY);
+  if (m_fd < 0) {
+    THROW_ELLIS_ERR(IO, "bad pathname: " << filename
+        << " (" << strerror(errno) << ")");
+  }
+  struct stat st;
+  if (fstat(m_fd, &st) != 0 || ! S_ISREG(st.st_mode)) {
+    close(m_fd);
+    m_fd = -1;
+    THROW_ELLIS_ERR(INVALID_ARGS, "not a regular file: " << filename);
+  }
+  m_size = st.st_size;
+
+  size_t page = sysconf(_SC_PAGESIZE);
+  m_window = std::max(page, (window + page - 1) / page * page);
+}
+
+mmap_input_stream::~mmap_input_stream()
+{
+  _unmap_window();
+  if (m_fd >= 0) {
+    close(m_fd);
+    m_fd = -1;
+  }
+}
+
+bool mmap_input_stream::_map_window(uint64_t off)
+{
+  _unmap_window();
+  size_t len = (size_t)std::min<uint64_t>(m_window, m_size - off);
+  void *p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, m_fd, off);
+  if (p == MAP_FAILED) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "mmap failed: " << strerror(errno));
+    return false;
+  }
+  /* Only a hint; nothing to be done if it is not taken. */
+  (void)madvise(p, len, MADV_SEQUENTIAL);
+  m_buf = (const byte *)p;
+  m_len = len;
+  m_off = off;
+  m_pos = 0;
+  return true;
+}
+
+void mmap_input_stream::_unmap_window()
+{
+  if (m_buf != nullptr) {
+    munmap((void *)m_buf, m_len);
+    m_buf = nullptr;
+  }
+}
+
+bool mmap_input_stream::next_input_buf(const byte **buf, size_t *bytecount)
+{
+  if (m_pos >= m_len) {
+    /* Current window used up (or none yet); map the next one. */
+    uint64_t next = m_off + m_len;
+    if (next >= m_size) {
+      m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "end of file");
+      return false;
+    }
+    if (! _map_window(next)) {
+      return false;
+    }
+  }
+  *buf = m_buf + m_pos;
+  *bytecount = m_len - m_pos;
+  /* Treat input as consumed unless put_back is called. */
+  m_pos = m_len;
+  return true;
+}
+
+void mmap_input_stream::put_back(size_t bytecount)
+{
+  m_pos = m_len - bytecount;
+}
+
+unique_ptr<err> mmap_input_stream::extract_input_error()
+{
+  return std::move(m_err);
+}
+
+
+}  /* namespace ellis */
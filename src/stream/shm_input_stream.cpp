@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/shm_input_stream.hpp>
+
+#include <algorithm>
+#include <ellis/core/err.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis_private/stream/shm_ring.hpp>
+#include <sys/mman.h>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+shm_input_stream::shm_input_stream(const char *name, shm_wait wait) :
+  m_ring(shm_ring::open(name, wait))
+{
+  /* Both sides have it mapped now (or the writer has been and gone); the
+   * name is no longer needed. */
+  shm_unlink(name);
+  m_tail = m_ring->hdr()->tail.load(std::memory_order_acquire);
+  m_notified = m_tail;
+}
+
+shm_input_stream::~shm_input_stream()
+{
+  shm_ring_header *hdr = m_ring->hdr();
+  hdr->reader_closed.store(1, std::memory_order_release);
+  shm_ring::notify(hdr->tail_seq, hdr->writer_waiting);
+}
+
+/** Gives back to the writer what was handed out last time. */
+void shm_input_stream::_release()
+{
+  if (m_taken == 0) {
+    return;
+  }
+  shm_ring_header *hdr = m_ring->hdr();
+  m_tail += m_taken;
+  m_taken = 0;
+  hdr->tail.store(m_tail, std::memory_order_release);
+  /* Wake the writer only once a chunk is free, or when about to wait; woken
+   * for every small message, it would take turns with us one at a time. */
+  if (m_tail - m_notified >= m_ring->chunk()
+      || hdr->head.load(std::memory_order_acquire) == m_tail) {
+    m_notified = m_tail;
+    shm_ring::notify(hdr->tail_seq, hdr->writer_waiting);
+  }
+}
+
+bool shm_input_stream::next_input_buf(const byte **buf, size_t *bytecount)
+{
+  _release();
+  shm_ring_header *hdr = m_ring->hdr();
+  auto avail = [&]()
+  {
+    return hdr->head.load(std::memory_order_acquire) - m_tail;
+  };
+  if (avail() == 0) {
+    m_ring->wait([&]() { return avail() > 0; },
+        hdr->head_seq, hdr->reader_waiting, hdr->writer_closed);
+  }
+  const uint64_t n = std::min(avail(), m_ring->chunk());
+  if (n == 0) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "end of file");
+    return false;
+  }
+  *buf = m_ring->data() + (m_tail & (m_ring->capacity() - 1));
+  *bytecount = n;
+  m_taken = n;
+  return true;
+}
+
+void shm_input_stream::put_back(size_t bytecount)
+{
+  ELLIS_ASSERT_LTE(bytecount, m_taken);
+  m_taken -= bytecount;
+}
+
+unique_ptr<err> shm_input_stream::extract_input_error()
+{
+  return std::move(m_err);
+}
+
+
+}  /* namespace ellis */
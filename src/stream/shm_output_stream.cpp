@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/shm_output_stream.hpp>
+
+#include <algorithm>
+#include <ellis/core/err.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis_private/stream/shm_ring.hpp>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+constexpr size_t shm_output_stream::k_default_capacity;
+
+
+shm_output_stream::shm_output_stream(
+    const char *name,
+    size_t capacity,
+    shm_wait wait) :
+  m_ring(shm_ring::create(name, capacity, wait))
+{
+}
+
+shm_output_stream::~shm_output_stream()
+{
+  shm_ring_header *hdr = m_ring->hdr();
+  hdr->writer_closed.store(1, std::memory_order_release);
+  shm_ring::notify(hdr->head_seq, hdr->reader_waiting);
+}
+
+bool shm_output_stream::next_output_buf(byte **buf, size_t *bytecount)
+{
+  if (m_err) {
+    return false;
+  }
+  shm_ring_header *hdr = m_ring->hdr();
+  const uint64_t cap = m_ring->capacity();
+  auto room = [&]()
+  {
+    return cap - (m_head - hdr->tail.load(std::memory_order_acquire));
+  };
+  if (room() == 0) {
+    m_ring->wait([&]() { return room() > 0; },
+        hdr->tail_seq, hdr->writer_waiting, hdr->reader_closed);
+  }
+  if (hdr->reader_closed.load(std::memory_order_acquire)) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "reader has gone");
+    return false;
+  }
+  *buf = m_ring->data() + (m_head & (cap - 1));
+  *bytecount = std::min(room(), m_ring->chunk());
+  return true;
+}
+
+bool shm_output_stream::emit(size_t bytecount)
+{
+  if (bytecount == 0) {
+    return ! m_err;
+  }
+  shm_ring_header *hdr = m_ring->hdr();
+  ELLIS_ASSERT_LTE(bytecount, m_ring->capacity()
+      - (m_head - hdr->tail.load(std::memory_order_relaxed)));
+  m_head += bytecount;
+  hdr->head.store(m_head, std::memory_order_release);
+  shm_ring::notify(hdr->head_seq, hdr->reader_waiting);
+  return true;
+}
+
+unique_ptr<err> shm_output_stream::extract_output_error()
+{
+  return std::move(m_err);
+}
+
+
+}  /* namespace ellis */
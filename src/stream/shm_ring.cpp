@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis_private/stream/shm_ring.hpp>
+
+#include <ellis/core/err.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+constexpr uint64_t shm_ring::k_magic;
+constexpr unsigned shm_ring::k_spins;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+    "shared memory rings need lock-free atomics");
+
+
+static uint64_t page_size()
+{
+  return sysconf(_SC_PAGESIZE);
+}
+
+
+shm_ring::shm_ring(shm_wait wait) :
+  m_wait(wait),
+  /* With only one core, the other side can not move while we spin. */
+  m_spins(sysconf(_SC_NPROCESSORS_ONLN) > 1 ? k_spins : 1)
+{
+}
+
+shm_ring::~shm_ring()
+{
+  if (m_data != nullptr) {
+    munmap(m_data, 2 * m_capacity);
+  }
+  if (m_hdr != nullptr) {
+    munmap(m_hdr, page_size());
+  }
+}
+
+/** Maps the header page, and the data after it twice over. */
+void shm_ring::_map(int fd, uint64_t capacity)
+{
+  const uint64_t page = page_size();
+  ELLIS_ASSERT_LTE(sizeof(shm_ring_header), page);
+  void *hdr = mmap(nullptr, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (hdr == MAP_FAILED) {
+    THROW_ELLIS_ERR(IO, "can not map ring: " << strerror(errno));
+  }
+  m_hdr = (shm_ring_header *)hdr;
+
+  /* Reserve room for both copies, then map the data over each half. */
+  void *data = mmap(nullptr, 2 * capacity, PROT_NONE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (data == MAP_FAILED) {
+    THROW_ELLIS_ERR(IO, "can not map ring: " << strerror(errno));
+  }
+  m_data = (byte *)data;
+  m_capacity = capacity;
+  for (int i = 0; i < 2; i++) {
+    if (mmap(m_data + i * capacity, capacity, PROT_READ | PROT_WRITE,
+          MAP_SHARED | MAP_FIXED, fd, page) == MAP_FAILED) {
+      THROW_ELLIS_ERR(IO, "can not map ring: " << strerror(errno));
+    }
+  }
+}
+
+unique_ptr<shm_ring> shm_ring::create(
+    const char *name,
+    uint64_t capacity,
+    shm_wait wait)
+{
+  uint64_t cap = page_size();
+  while (cap < capacity) {
+    cap <<= 1;
+  }
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    THROW_ELLIS_ERR(IO, "can not create ring " << name << ": "
+        << strerror(errno));
+  }
+  unique_ptr<shm_ring> ring(new shm_ring(wait));
+  try {
+    if (ftruncate(fd, page_size() + cap) != 0) {
+      THROW_ELLIS_ERR(IO, "can not size ring " << name << ": "
+          << strerror(errno));
+    }
+    ring->_map(fd, cap);
+  } catch (...) {
+    close(fd);
+    shm_unlink(name);
+    throw;
+  }
+  close(fd);
+  /* The new object is all zeroes; only the magic and size need setting,
+   * the magic last so that a reader never sees a half made ring. */
+  ring->m_hdr->capacity = cap;
+  ring->m_hdr->magic.store(k_magic, std::memory_order_release);
+  return ring;
+}
+
+unique_ptr<shm_ring> shm_ring::open(const char *name, shm_wait wait)
+{
+  int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+  if (fd < 0) {
+    THROW_ELLIS_ERR(IO, "can not open ring " << name << ": "
+        << strerror(errno));
+  }
+  unique_ptr<shm_ring> ring(new shm_ring(wait));
+  try {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size <= page_size()) {
+      THROW_ELLIS_ERR(IO, "not a ring: " << name);
+    }
+    const uint64_t cap = st.st_size - page_size();
+    ring->_map(fd, cap);
+    if (ring->m_hdr->magic.load(std::memory_order_acquire) != k_magic
+        || ring->m_hdr->capacity != cap) {
+      THROW_ELLIS_ERR(IO, "not a ring: " << name);
+    }
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  close(fd);
+  return ring;
+}
+
+void shm_ring::notify(
+    std::atomic<uint32_t> &seq,
+    std::atomic<uint32_t> &waiting)
+{
+  seq.fetch_add(1, std::memory_order_seq_cst);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting.load(std::memory_order_relaxed)
+      && waiting.exchange(0, std::memory_order_seq_cst)) {
+    futex_wake(seq);
+  }
+}
+
+void shm_ring::futex_wait(std::atomic<uint32_t> &word, uint32_t val)
+{
+  /* Not FUTEX_PRIVATE_FLAG: the word is shared between processes. */
+  syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAIT, val, nullptr,
+      nullptr, 0);
+}
+
+void shm_ring::futex_wake(std::atomic<uint32_t> &word)
+{
+  syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAKE, 1, nullptr,
+      nullptr, 0);
+}
+
+void shm_ring::relax()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#else
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+
+}  /* namespace ellis */
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/stream_buffer.hpp>
+
+#include <algorithm>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+constexpr size_t stream_buffer::k_default_size;
+constexpr size_t stream_buffer::k_default_max;
+
+
+stream_buffer::stream_buffer(size_t size, size_t max) :
+  m_size(std::max<size_t>(size, 1)),
+  m_max(std::max(max, m_size))
+{
+}
+
+byte * stream_buffer::fresh()
+{
+  if (m_grow) {
+    m_grow = false;
+    m_size = std::min(m_size * 2, m_max);
+    /* Nothing in the old buffer is wanted; no need to copy it. */
+    m_data.reset();
+  }
+  if (! m_data) {
+    m_data.reset(new byte[m_size]);
+  }
+  return m_data.get();
+}
+
+
+}  /* namespace ellis */
@@ -22,24 +22,115 @@
  */
 
 
+
 #include <ellis/stream/tcp_client_stream.hpp>
 
 #include <ellis/core/defs.hpp>
 #include <ellis/core/err.hpp>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
 #include <ellis_private/using.hpp>
 
 namespace ellis {
 
 
-tcp_stream::tcp_stream(UNUSED const char *host, UNUSED const char *port) {
-  // int fd = tcpclientopen(host, port);  // if only that easy
-  // TODO: throw exception on tcpclientopen
-  // m_fdis = make_unique<fd_input_stream>(fd));
-  // m_fdos = make_unique<fd_output_stream>(fd));
+static void set_buffer_sizes(int fd, const tcp_options &opts)
+{
+  if (opts.sndbuf > 0) {
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &opts.sndbuf, sizeof(opts.sndbuf));
+  }
+  if (opts.rcvbuf > 0) {
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &opts.rcvbuf, sizeof(opts.rcvbuf));
+  }
+}
+
+
+tcp_stream::tcp_stream(
+    const char *host,
+    const char *port,
+    const tcp_options &opts)
+{
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *res = nullptr;
+  int rc = getaddrinfo(host, port, &hints, &res);
+  if (rc != 0) {
+    THROW_ELLIS_ERR(IO, "can not resolve " << host << ":" << port
+        << ": " << gai_strerror(rc));
+  }
+  int saved_errno = 0;
+  for (struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next) {
+    m_fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+        ai->ai_protocol);
+    if (m_fd < 0) {
+      saved_errno = errno;
+      continue;
+    }
+    /* Socket buffer sizes must be set before connecting to take full
+     * effect on the window. */
+    set_buffer_sizes(m_fd, opts);
+    while ((rc = connect(m_fd, ai->ai_addr, ai->ai_addrlen)) != 0
+        && errno == EINTR) {
+    }
+    if (rc == 0) {
+      break;
+    }
+    saved_errno = errno;
+    close(m_fd);
+    m_fd = -1;
+  }
+  freeaddrinfo(res);
+  if (m_fd < 0) {
+    THROW_ELLIS_ERR(IO, "can not connect to " << host << ":" << port
+        << ": " << strerror(saved_errno));
+  }
+  _setup(opts);
+}
+
+tcp_stream::tcp_stream(int fd, const tcp_options &opts) :
+  m_fd(fd)
+{
+  ELLIS_ASSERT_GTE(fd, 0);
+  set_buffer_sizes(m_fd, opts);
+  _setup(opts);
 }
 
 tcp_stream::~tcp_stream() {
-  // close(m_fd);
+  m_fdis.reset();
+  m_fdos.reset();
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+}
+
+/** Applies the options that can be set on a connected socket, and makes
+ * the streams over it. */
+void tcp_stream::_setup(const tcp_options &opts) {
+  int one = 1;
+  if (opts.nodelay) {
+    setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  if (opts.keepalive) {
+    setsockopt(m_fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+  }
+  m_fdis.reset(new fd_input_stream(m_fd, opts.bufsize, opts.max_bufsize));
+  m_fdos.reset(new fd_output_stream(m_fd, opts.bufsize, opts.max_bufsize));
+}
+
+int tcp_stream::fd() const {
+  return m_fd;
+}
+
+void tcp_stream::shutdown_output() {
+  shutdown(m_fd, SHUT_WR);
 }
 
 bool tcp_stream::next_input_buf(const byte **buf, size_t *bytecount) {
@@ -62,6 +153,14 @@ bool tcp_stream::emit(size_t bytecount) {
   return m_fdos->emit(bytecount);
 }
 
+size_t tcp_stream::ref_min() const {
+  return m_fdos->ref_min();
+}
+
+bool tcp_stream::emit_ref(size_t bytecount, const byte *data, size_t len) {
+  return m_fdos->emit_ref(bytecount, data, len);
+}
+
 unique_ptr<err> tcp_stream::extract_output_error() {
   return m_fdos->extract_output_error();
 }
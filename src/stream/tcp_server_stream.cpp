@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/tcp_server_stream.hpp>
+
+#include <ellis/core/defs.hpp>
+#include <ellis/core/err.hpp>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <ellis_private/using.hpp>
+
+namespace ellis {
+
+
+constexpr int tcp_server::k_default_backlog;
+
+
+tcp_server::tcp_server(
+    const char *host,
+    const char *port,
+    const tcp_options &opts,
+    int backlog) :
+  m_opts(opts)
+{
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  struct addrinfo *res = nullptr;
+  int rc = getaddrinfo(host, port, &hints, &res);
+  if (rc != 0) {
+    THROW_ELLIS_ERR(IO, "can not resolve " << (host ? host : "*") << ":"
+        << port << ": " << gai_strerror(rc));
+  }
+  int saved_errno = 0;
+  for (struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next) {
+    m_fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+        ai->ai_protocol);
+    if (m_fd < 0) {
+      saved_errno = errno;
+      continue;
+    }
+    int one = 1;
+    setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    /* Accepted sockets inherit the buffer sizes, in time for the
+     * handshake to advertise the window. */
+    if (opts.sndbuf > 0) {
+      setsockopt(m_fd, SOL_SOCKET, SO_SNDBUF, &opts.sndbuf,
+          sizeof(opts.sndbuf));
+    }
+    if (opts.rcvbuf > 0) {
+      setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &opts.rcvbuf,
+          sizeof(opts.rcvbuf));
+    }
+    if (bind(m_fd, ai->ai_addr, ai->ai_addrlen) == 0
+        && listen(m_fd, backlog) == 0) {
+      break;
+    }
+    saved_errno = errno;
+    close(m_fd);
+    m_fd = -1;
+  }
+  freeaddrinfo(res);
+  if (m_fd < 0) {
+    THROW_ELLIS_ERR(IO, "can not listen on " << (host ? host : "*") << ":"
+        << port << ": " << strerror(saved_errno));
+  }
+}
+
+tcp_server::~tcp_server() {
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+}
+
+int tcp_server::fd() const {
+  return m_fd;
+}
+
+int tcp_server::port() const {
+  struct sockaddr_storage addr;
+  socklen_t len = sizeof(addr);
+  if (getsockname(m_fd, (struct sockaddr *)&addr, &len) != 0) {
+    return -1;
+  }
+  if (addr.ss_family == AF_INET6) {
+    return ntohs(((struct sockaddr_in6 *)&addr)->sin6_port);
+  }
+  return ntohs(((struct sockaddr_in *)&addr)->sin_port);
+}
+
+unique_ptr<tcp_stream> tcp_server::accept() {
+  int fd;
+  while ((fd = accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC)) < 0
+      && (errno == EINTR || errno == ECONNABORTED)) {
+  }
+  if (fd < 0) {
+    THROW_ELLIS_ERR(IO, "accept failed: " << strerror(errno));
+  }
+  return unique_ptr<tcp_stream>(new tcp_stream(fd, m_opts));
+}
+
+
+}  /* namespace ellis */
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis_private/stream/uring.hpp>
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ellis_private/using.hpp>
+
+namespace ellis {
+
+
+constexpr uint64_t uring::k_register_min_reuse;
+
+
+/* The kernel and we each own one end of each ring; the other end must be
+ * read with acquire, and our end published with release. */
+static unsigned load_acquire(const unsigned *p)
+{
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void store_release(unsigned *p, unsigned v)
+{
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+
+uring::~uring()
+{
+  if (m_sqes != nullptr) {
+    munmap(m_sqes, m_sqes_len);
+  }
+  if (m_cq_ring != nullptr && m_cq_ring != m_sq_ring) {
+    munmap(m_cq_ring, m_cq_ring_len);
+  }
+  if (m_sq_ring != nullptr) {
+    munmap(m_sq_ring, m_sq_ring_len);
+  }
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+}
+
+bool uring::init(unsigned entries)
+{
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  m_fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+  if (m_fd < 0) {
+    return false;
+  }
+
+  m_sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  m_cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single) {
+    m_sq_ring_len = m_cq_ring_len = std::max(m_sq_ring_len, m_cq_ring_len);
+  }
+  void *sq = mmap(nullptr, m_sq_ring_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    return false;
+  }
+  m_sq_ring = sq;
+  if (single) {
+    m_cq_ring = sq;
+  }
+  else {
+    void *cq = mmap(nullptr, m_cq_ring_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      return false;
+    }
+    m_cq_ring = cq;
+  }
+  m_sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = mmap(nullptr, m_sqes_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return false;
+  }
+  m_sqes = (io_uring_sqe *)sqes;
+
+  byte *sqb = (byte *)m_sq_ring;
+  m_sq_head = (unsigned *)(sqb + p.sq_off.head);
+  m_sq_tail = (unsigned *)(sqb + p.sq_off.tail);
+  m_sq_mask = *(unsigned *)(sqb + p.sq_off.ring_mask);
+  m_sq_entries = p.sq_entries;
+  m_sq_array = (unsigned *)(sqb + p.sq_off.array);
+  byte *cqb = (byte *)m_cq_ring;
+  m_cq_head = (unsigned *)(cqb + p.cq_off.head);
+  m_cq_tail = (unsigned *)(cqb + p.cq_off.tail);
+  m_cq_mask = *(unsigned *)(cqb + p.cq_off.ring_mask);
+  m_cqes = (io_uring_cqe *)(cqb + p.cq_off.cqes);
+  return true;
+}
+
+bool uring::register_buffers(const struct iovec *iov, unsigned count)
+{
+  m_fixed = syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS,
+      iov, count) == 0;
+  return m_fixed;
+}
+
+io_uring_sqe * uring::_get_sqe()
+{
+  const unsigned tail = *m_sq_tail;
+  if (tail - load_acquire(m_sq_head) >= m_sq_entries) {
+    return nullptr;
+  }
+  const unsigned idx = tail & m_sq_mask;
+  io_uring_sqe *sqe = &m_sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  m_sq_array[idx] = idx;
+  return sqe;
+}
+
+bool uring::read(
+    int fd,
+    byte *buf,
+    size_t len,
+    uint64_t off,
+    unsigned buf_index,
+    uint64_t tag)
+{
+  io_uring_sqe *sqe = _get_sqe();
+  if (sqe == nullptr) {
+    return false;
+  }
+  sqe->opcode = m_fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)buf;
+  sqe->len = (uint32_t)len;
+  sqe->off = off;
+  sqe->buf_index = (uint16_t)buf_index;
+  sqe->user_data = tag;
+  store_release(m_sq_tail, *m_sq_tail + 1);
+  m_to_submit++;
+  return true;
+}
+
+bool uring::write(
+    int fd,
+    const byte *buf,
+    size_t len,
+    uint64_t off,
+    unsigned buf_index,
+    uint64_t tag)
+{
+  io_uring_sqe *sqe = _get_sqe();
+  if (sqe == nullptr) {
+    return false;
+  }
+  sqe->opcode = m_fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)buf;
+  sqe->len = (uint32_t)len;
+  sqe->off = off;
+  sqe->buf_index = (uint16_t)buf_index;
+  sqe->user_data = tag;
+  store_release(m_sq_tail, *m_sq_tail + 1);
+  m_to_submit++;
+  return true;
+}
+
+bool uring::_enter(unsigned min_complete)
+{
+  while (true) {
+    int n = (int)syscall(__NR_io_uring_enter, m_fd, m_to_submit, min_complete,
+        min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    if (n >= 0) {
+      m_to_submit -= std::min((unsigned)n, m_to_submit);
+      return true;
+    }
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+}
+
+bool uring::submit()
+{
+  return m_to_submit == 0 || _enter(0);
+}
+
+bool uring::wait(uint64_t *tag, int32_t *res)
+{
+  while (true) {
+    const unsigned head = *m_cq_head;
+    if (head != load_acquire(m_cq_tail)) {
+      const io_uring_cqe &cqe = m_cqes[head & m_cq_mask];
+      *tag = cqe.user_data;
+      *res = cqe.res;
+      store_release(m_cq_head, head + 1);
+      return true;
+    }
+    if (! _enter(1)) {
+      return false;
+    }
+  }
+}
+
+
+}  /* namespace ellis */
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/uring_file_input_stream.hpp>
+
+#include <algorithm>
+#include <ellis/core/err.hpp>
+#include <ellis/stream/fd_input_stream.hpp>
+#include <ellis_private/stream/uring.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+constexpr size_t uring_file_input_stream::k_default_depth;
+constexpr size_t uring_file_input_stream::k_default_bufsize;
+
+
+uring_file_input_stream::uring_file_input_stream(
+    const char *filename,
+    size_t depth,
+    size_t bufsize) :
+  m_mem(nullptr, free),
+  m_bufsize(std::max<size_t>(bufsize, 1))
+{
+  if (strcmp(filename, "-") == 0) {
+    m_fd = 0;
+  } else {
+    m_fd = open(filename, O_RDONLY);
+  }
+  if (m_fd < 0) {
+    THROW_ELLIS_ERR(IO, "bad pathname: " << filename);
+  }
+
+  struct stat st;
+  const bool regular = m_fd != 0
+    && fstat(m_fd, &st) == 0
+    && S_ISREG(st.st_mode);
+  if (regular) {
+    /* No more buffers, nor bigger ones, than the file needs. */
+    m_size = st.st_size;
+    m_bufsize = std::max<uint64_t>(std::min<uint64_t>(m_bufsize, m_size), 1);
+    depth = std::min<uint64_t>(depth, (m_size + m_bufsize - 1) / m_bufsize);
+  }
+  unique_ptr<uring> ring(new uring());
+  void *mem = nullptr;
+  if (regular && depth > 0 && ring->init(depth)
+      && posix_memalign(&mem, 4096, depth * m_bufsize) == 0)
+  {
+    m_mem.reset((byte *)mem);
+    vector<struct iovec> iov(depth);
+    m_slots.resize(depth);
+    for (size_t i = 0; i < depth; i++) {
+      m_slots[i].buf = m_mem.get() + i * m_bufsize;
+      m_slots[i].queued = false;
+      m_slots[i].in_flight = false;
+      iov[i].iov_base = m_slots[i].buf;
+      iov[i].iov_len = m_bufsize;
+    }
+    /* Registered buffers are only a bonus; without them, plain reads are
+     * used. */
+    if (m_size >= uring::k_register_min_reuse * depth * m_bufsize) {
+      ring->register_buffers(iov.data(), (unsigned)depth);
+    }
+    m_ring = std::move(ring);
+    for (size_t i = 0; i < depth && _submit(i); i++) {
+    }
+    if (! m_ring->submit()) {
+      /* Nothing was submitted, so nothing is in flight; just give up. */
+      m_ring.reset();
+    }
+  }
+  if (! m_ring) {
+    m_fallback.reset(new fd_input_stream(m_fd));
+  }
+}
+
+uring_file_input_stream::~uring_file_input_stream()
+{
+  /* The kernel may still be reading into our buffers. */
+  if (m_ring) {
+    for (size_t i = 0; i < m_slots.size(); i++) {
+      if (m_slots[i].in_flight && ! _wait(i)) {
+        break;
+      }
+    }
+  }
+  m_ring.reset();
+  m_fallback.reset();
+  if (m_fd > 0) {
+    close(m_fd);
+    m_fd = -1;
+  }
+}
+
+bool uring_file_input_stream::using_uring() const
+{
+  return (bool)m_ring;
+}
+
+/** Queues a read of the next block into slot idx, unless the file is all
+ * queued already. */
+bool uring_file_input_stream::_submit(size_t idx)
+{
+  if (m_next_off >= m_size) {
+    return false;
+  }
+  slot &s = m_slots[idx];
+  s.off = m_next_off;
+  s.len = (size_t)std::min<uint64_t>(m_bufsize, m_size - m_next_off);
+  m_ring->read(m_fd, s.buf, s.len, s.off, (unsigned)idx, idx);
+  s.queued = true;
+  s.in_flight = true;
+  m_next_off += s.len;
+  return true;
+}
+
+/** Waits for the read into slot idx to complete, finishing it off with
+ * pread() if it came up short. */
+bool uring_file_input_stream::_wait(size_t idx)
+{
+  while (m_slots[idx].in_flight) {
+    uint64_t tag;
+    int32_t res;
+    if (! m_ring->wait(&tag, &res)) {
+      m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "io_uring wait failed: "
+          << strerror(errno));
+      return false;
+    }
+    m_slots[tag].in_flight = false;
+    m_slots[tag].res = res;
+  }
+  slot &s = m_slots[idx];
+  if (s.res < 0) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "I/O error: " << strerror(-s.res));
+    return false;
+  }
+  size_t got = s.res;
+  while (got < s.len) {
+    ssize_t n = pread(m_fd, s.buf + got, s.len - got, s.off + got);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    else if (n < 0) {
+      m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "I/O error: " << strerror(errno));
+      return false;
+    }
+    else if (n == 0) {
+      /* The file got shorter. */
+      break;
+    }
+    got += n;
+  }
+  s.len = got;
+  return true;
+}
+
+bool uring_file_input_stream::next_input_buf(
+    const byte **buf,
+    size_t *bytecount)
+{
+  if (m_fallback) {
+    return m_fallback->next_input_buf(buf, bytecount);
+  }
+
+  if (m_have_cur) {
+    slot &cur = m_slots[m_cur];
+    if (m_pos < cur.len) {
+      /* We have some leftover buffer from earlier.  Return that. */
+      *buf = cur.buf + m_pos;
+      *bytecount = cur.len - m_pos;
+      m_pos = cur.len;
+      return true;
+    }
+    /* Done with this block; read the next one not yet queued into it. */
+    cur.queued = false;
+    m_have_cur = false;
+    if (_submit(m_cur) && ! m_ring->submit()) {
+      m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "io_uring submit failed: "
+          << strerror(errno));
+      return false;
+    }
+    m_cur = (m_cur + 1) % m_slots.size();
+  }
+
+  slot &next = m_slots[m_cur];
+  if (! next.queued) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "end of file");
+    return false;
+  }
+  if (! _wait(m_cur)) {
+    return false;
+  }
+  if (next.len == 0) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "end of file");
+    return false;
+  }
+  m_have_cur = true;
+  *buf = next.buf;
+  *bytecount = next.len;
+  /* Treat input as consumed unless put_back is called. */
+  m_pos = next.len;
+  return true;
+}
+
+void uring_file_input_stream::put_back(size_t bytecount)
+{
+  if (m_fallback) {
+    return m_fallback->put_back(bytecount);
+  }
+  if (! m_have_cur) {
+    ELLIS_ASSERT_EQ(bytecount, 0);
+    return;
+  }
+  m_pos = m_slots[m_cur].len - bytecount;
+}
+
+unique_ptr<err> uring_file_input_stream::extract_input_error()
+{
+  if (m_fallback) {
+    return m_fallback->extract_input_error();
+  }
+  return std::move(m_err);
+}
+
+
+}  /* namespace ellis */
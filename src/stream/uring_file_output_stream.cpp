@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/uring_file_output_stream.hpp>
+
+#include <algorithm>
+#include <ellis/core/err.hpp>
+#include <ellis/stream/fd_output_stream.hpp>
+#include <ellis_private/stream/uring.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <ellis_private/using.hpp>
+
+
+namespace ellis {
+
+
+constexpr size_t uring_file_output_stream::k_default_depth;
+constexpr size_t uring_file_output_stream::k_default_bufsize;
+
+
+uring_file_output_stream::uring_file_output_stream(
+    const char *filename,
+    size_t depth,
+    size_t bufsize) :
+  m_mem(nullptr, free),
+  m_bufsize(std::max<size_t>(bufsize, 1))
+{
+  if (strcmp(filename, "-") == 0) {
+    m_fd = 1;
+  } else {
+    m_fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  }
+  if (m_fd < 0) {
+    THROW_ELLIS_ERR(IO, "bad pathname: " << filename);
+  }
+
+  unique_ptr<uring> ring(new uring());
+  void *mem = nullptr;
+  if (m_fd != 1 && depth > 0 && ring->init(depth)
+      && posix_memalign(&mem, 4096, depth * m_bufsize) == 0)
+  {
+    m_mem.reset((byte *)mem);
+    m_slots.resize(depth);
+    for (size_t i = 0; i < depth; i++) {
+      m_slots[i].buf = m_mem.get() + i * m_bufsize;
+      m_slots[i].len = 0;
+      m_slots[i].in_flight = false;
+    }
+    m_ring = std::move(ring);
+  }
+  if (! m_ring) {
+    m_fallback.reset(new fd_output_stream(m_fd));
+  }
+}
+
+uring_file_output_stream::~uring_file_output_stream()
+{
+  if (m_ring) {
+    finish();
+  }
+  m_ring.reset();
+  m_fallback.reset();
+  if (m_fd > 1) {
+    close(m_fd);
+    m_fd = -1;
+  }
+}
+
+bool uring_file_output_stream::using_uring() const
+{
+  return (bool)m_ring;
+}
+
+/** Registers the buffers, now that the file looks long enough for that to
+ * pay off.  This is only a bonus; if it fails, plain writes carry on. */
+void uring_file_output_stream::_register()
+{
+  vector<struct iovec> iov(m_slots.size());
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    iov[i].iov_base = m_slots[i].buf;
+    iov[i].iov_len = m_bufsize;
+  }
+  m_ring->register_buffers(iov.data(), (unsigned)iov.size());
+  m_registered = true;
+}
+
+/** Waits for the write from slot idx to complete, finishing it off with
+ * pwrite() if it came up short. */
+bool uring_file_output_stream::_wait(size_t idx)
+{
+  while (m_slots[idx].in_flight) {
+    uint64_t tag;
+    int32_t res;
+    if (! m_ring->wait(&tag, &res)) {
+      m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "io_uring wait failed: "
+          << strerror(errno));
+      return false;
+    }
+    m_slots[tag].in_flight = false;
+    m_slots[tag].res = res;
+  }
+  slot &s = m_slots[idx];
+  if (s.res < 0) {
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "I/O error: " << strerror(-s.res));
+    s.res = 0;
+    s.len = 0;
+    return false;
+  }
+  size_t done = s.res;
+  while (done < s.len) {
+    ssize_t n = pwrite(m_fd, s.buf + done, s.len - done, s.off + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    else if (n <= 0) {
+      m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "I/O error: " << strerror(errno));
+      s.len = 0;
+      return false;
+    }
+    done += n;
+  }
+  s.len = 0;
+  return true;
+}
+
+bool uring_file_output_stream::finish()
+{
+  if (m_fallback) {
+    return true;
+  }
+  bool ok = ! m_err;
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    if (m_slots[i].len > 0 && ! _wait(i)) {
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool uring_file_output_stream::next_output_buf(byte **buf, size_t *bytecount)
+{
+  if (m_fallback) {
+    return m_fallback->next_output_buf(buf, bytecount);
+  }
+  /* The buffer may still be on its way out from last time round. */
+  slot &s = m_slots[m_cur];
+  if (s.len > 0 && ! _wait(m_cur)) {
+    return false;
+  }
+  if (m_err) {
+    return false;
+  }
+  *buf = s.buf;
+  *bytecount = m_bufsize;
+  return true;
+}
+
+bool uring_file_output_stream::emit(size_t bytecount)
+{
+  if (m_fallback) {
+    return m_fallback->emit(bytecount);
+  }
+  ELLIS_ASSERT_LTE(bytecount, m_bufsize);
+  if (bytecount == 0) {
+    return ! m_err;
+  }
+  if (! m_registered
+      && m_off >= uring::k_register_min_reuse * m_slots.size() * m_bufsize)
+  {
+    _register();
+  }
+  slot &s = m_slots[m_cur];
+  s.off = m_off;
+  s.len = bytecount;
+  s.in_flight = true;
+  m_ring->write(m_fd, s.buf, s.len, s.off, (unsigned)m_cur, m_cur);
+  if (! m_ring->submit()) {
+    s.in_flight = false;
+    s.len = 0;
+    m_err = MAKE_UNIQUE_ELLIS_ERR(IO, "io_uring submit failed: "
+        << strerror(errno));
+    return false;
+  }
+  m_off += bytecount;
+  m_cur = (m_cur + 1) % m_slots.size();
+  return ! m_err;
+}
+
+unique_ptr<err> uring_file_output_stream::extract_output_error()
+{
+  if (m_fallback) {
+    return m_fallback->extract_output_error();
+  }
+  return std::move(m_err);
+}
+
+
+}  /* namespace ellis */
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <ellis/stream/vector_output_stream.hpp>
+
+#include <algorithm>
+#include <ellis/core/err.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis_private/using.hpp>
+
+namespace ellis {
+
+
+constexpr size_t vector_output_stream::k_default_size;
+
+
+vector_output_stream::vector_output_stream(size_t size)
+{
+  m_vec.resize(std::max<size_t>(size, 1));
+}
+
+vector_output_stream::vector_output_stream(vector<byte> &&vec) :
+  m_vec(std::move(vec))
+{
+  /* Use all the storage it already has. */
+  m_vec.resize(std::max<size_t>(m_vec.capacity(), 1));
+}
+
+const byte *vector_output_stream::data() const {
+  return m_vec.data();
+}
+
+size_t vector_output_stream::size() const {
+  return m_pos;
+}
+
+vector<byte> vector_output_stream::release() {
+  m_vec.resize(m_pos);
+  m_pos = 0;
+  vector<byte> out = std::move(m_vec);
+  m_vec.clear();
+  return out;
+}
+
+bool vector_output_stream::next_output_buf(byte **buf, size_t *bytecount) {
+  if (m_pos == m_vec.size()) {
+    /* Full; double it.  Growing to the new capacity in one go means each
+     * byte is zeroed only once. */
+    m_vec.resize(std::max<size_t>(2 * m_vec.size(), k_default_size));
+    m_vec.resize(m_vec.capacity());
+  }
+  *buf = m_vec.data() + m_pos;
+  *bytecount = m_vec.size() - m_pos;
+  return true;
+}
+
+bool vector_output_stream::emit(size_t bytecount) {
+  ELLIS_ASSERT_LTE(bytecount, m_vec.size() - m_pos);
+  m_pos += bytecount;
+  return true;
+}
+
+unique_ptr<err> vector_output_stream::extract_output_error() {
+  return nullptr;
+}
+
+
+}  /* namespace ellis */
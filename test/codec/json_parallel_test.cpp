@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#undef NDEBUG
+#include <ellis/codec/json.hpp>
+#include <ellis/codec/json_parallel.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/emigration.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis_private/using.hpp>
+#include <sstream>
+
+using namespace ellis;
+
+
+/* Checks that every thread count gives what json_decoder gives. */
+static void check_same(const string &txt, const string &path = "")
+{
+  json_decoder dec;
+  auto expect = load_mem(txt.c_str(), txt.size(), dec);
+  for (unsigned threads : { 1, 2, 3, 8 }) {
+    json_parallel_opts opts;
+    opts.threads = threads;
+    opts.path = path;
+    opts.min_parallel_bytes = 0;
+    auto got = json_parallel_decode(txt.c_str(), txt.size(), opts);
+    ELLIS_ASSERT(*got == *expect);
+  }
+}
+
+
+/* Checks that malformed text fails as it does with json_decoder. */
+static void check_malformed(const string &txt, const string &path = "")
+{
+  json_decoder dec;
+  bool threw = false;
+  try {
+    load_mem(txt.c_str(), txt.size(), dec);
+  } catch (const err &e) {
+    threw = true;
+  }
+  ELLIS_ASSERT(threw);
+  for (unsigned threads : { 2, 8 }) {
+    json_parallel_opts opts;
+    opts.threads = threads;
+    opts.path = path;
+    opts.min_parallel_bytes = 0;
+    threw = false;
+    try {
+      json_parallel_decode(txt.c_str(), txt.size(), opts);
+    } catch (const err &e) {
+      ELLIS_ASSERT(e.code() == err_code::PARSE_FAIL);
+      threw = true;
+    }
+    ELLIS_ASSERT(threw);
+  }
+}
+
+
+int main()
+{
+  check_same("[]");
+  check_same("[ ]");
+  check_same("[1]");
+  check_same("[1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12]");
+  check_same(R"([ "a,b", "c]d", "e\"f", "g\\", [ 1, [ 2, 3 ] ], { "h": [ 4, 5 ] },
+      // comment, with [ brackets ] and "quotes
+      null, true, false, -1.5e3 ] trailing stuff)");
+  check_same("42");
+  check_same(R"({ "not": "an array" })");
+
+  /* Arrays down a path, inside an envelope that is decoded normally. */
+  const string env = R"({ "meta": { "n": 3, "skip": [ 9, 9 ] },
+      "data": { "rows": [ { "a": 1 }, { "a": 2 }, { "a": [ 3 ] } ] },
+      "list": [ [ 0 ], [ 1, 2, 3, 4 ] ], "d\/up": [ 1, 2 ], "tail": "x" })";
+  check_same(env, "{data}{rows}");
+  check_same(env, "{list}[1]");
+  check_same(env, "{d/up}");
+  check_same(env, "{meta}");
+  check_same(env, "{nowhere}");
+  check_same(env, "[0]");
+
+  /* A larger document, with records of varying shapes. */
+  node big(type::ARRAY);
+  for (int i = 0; i < 5000; i++) {
+    node rec(type::MAP);
+    rec.as_mutable_map().insert("id", i);
+    rec.as_mutable_map().insert("name", "rec, [" + std::to_string(i) + "]");
+    if (i % 3 == 0) {
+      node sub(type::ARRAY);
+      sub.as_mutable_array().append(i * 0.5);
+      sub.as_mutable_array().append(node(type::MAP));
+      rec.as_mutable_map().insert("sub", sub);
+    }
+    big.as_mutable_array().append(rec);
+  }
+  std::ostringstream os;
+  dump_stream(&big, os, json_encoder());
+  check_same(os.str());
+
+  check_malformed("[1, 2,]");
+  check_malformed("[1, , 2]");
+  check_malformed("[, 1, 2]");
+  check_malformed("[1, 2 3, 4]");
+  check_malformed("[1, {2}, 4, 5]");
+  check_malformed("[1, [2, 3}, 4, 5]");
+  check_malformed("[1, 2, 3, 4");
+  check_malformed("[1, 2, \"3, 4]");
+  check_malformed(R"({ "a": [ 1, 2, 3, 4 ], "b": })", "{a}");
+
+  /* Path syntax errors are reported as such. */
+  bool threw = false;
+  try {
+    json_parallel_opts opts;
+    opts.path = "{a";
+    json_parallel_decode("[]", 2, opts);
+  } catch (const err &e) {
+    ELLIS_ASSERT(e.code() == err_code::PATH_FAIL);
+    threw = true;
+  }
+  ELLIS_ASSERT(threw);
+
+  return 0;
+}
@@ -30,9 +30,12 @@
 #include <ellis/core/immigration.hpp>
 #include <ellis/core/map_node.hpp>
 #include <ellis/core/system.hpp>
+#include <ellis/core/u8str_node.hpp>
 #include <ellis_private/using.hpp>
 #include <ellis/stream/mem_input_stream.hpp>
 #include <ellis/stream/cpp_output_stream.hpp>
+#include <cmath>
+#include <limits>
 #include <sstream>
 
 void check_give_back()
@@ -67,11 +70,563 @@ void check_give_back()
   ELLIS_ASSERT_EQ(val->as_double(), 15.5);
 }
 
+void check_load_into()
+{
+  using namespace ellis;
+  /* The generic path, through consume_buffer and chop. */
+  json_decoder dec;
+  const char *str = "{ \"a\": [ 1, 2 ] } 15.5";
+  mem_input_stream mis(str, strlen(str));
+  node n("old contents");
+  load(mis, dec, &n);
+  ELLIS_ASSERT_EQ(n.at("{a}[1]").as_int64(), 2);
+  load(mis, dec, &n);
+  ELLIS_ASSERT_EQ(n.as_double(), 15.5);
+  bool threw = false;
+  try {
+    load_mem("[ 1,", 4, dec, &n);
+  } catch (const err &e) {
+    threw = true;
+  }
+  ELLIS_ASSERT(threw);
+  ELLIS_ASSERT_EQ(n.as_double(), 15.5);
+}
+
+void check_reuse()
+{
+  using namespace ellis;
+  json_decoder dec;
+  json_decoder fresh;
+  auto into = [&](const char *text, node *n) {
+    load_mem(text, strlen(text), dec, n);
+    ELLIS_ASSERT(*n == *load_mem(text, strlen(text), fresh));
+  };
+
+  /* The decoder builds each document in the one before last, so every
+   * other one lands in the same storage. */
+  node n(type::NIL);
+  into("{ \"name\": \"first name, too long to be kept inline\", "
+      "\"xs\": [ 1, \"x\", null ] }", &n);
+  const char *name = n.as_map()["name"].as_u8str().c_str();
+  const node *x1 = &n.as_map()["xs"].as_array()[1];
+  into("{ \"name\": \"other name, too long to be kept inline\", "
+      "\"xs\": [ 2, \"y\", null ] }", &n);
+  into("{ \"xs\": [ 3, \"z\", null ], "
+      "\"name\": \"third name, too long to be kept inline\" }", &n);
+  ELLIS_ASSERT(n.as_map()["name"].as_u8str().c_str() == name);
+  ELLIS_ASSERT(&n.as_map()["xs"].as_array()[1] == x1);
+  ELLIS_ASSERT(n.at("{xs}[1]") == "z");
+
+  /* Copies of earlier results are left alone, and other shapes work. */
+  const node keep = n;
+  into("{ \"name\": 5, \"ys\": [ ] }", &n);
+  into("[ { }, [ 1, 2, 3 ], \"s\" ]", &n);
+  into("[ { \"a\": 1 }, [ 4 ], \"t\", \"u\" ]", &n);
+  into("[ ]", &n);
+  into("{ \"name\": \"n\", \"xs\": [ ] }", &n);
+  into("{ \"name\": null, \"xs\": [ 1 ], \"zs\": [ ] }", &n);
+  ELLIS_ASSERT(keep.at("{xs}[1]") == "z");
+  ELLIS_ASSERT_EQ(keep.as_map().length(), 2);
+
+  /* The first of repeated keys wins, as when building from scratch. */
+  into("{ \"xs\": 1, \"xs\": 2, \"name\": \"h\" }", &n);
+  ELLIS_ASSERT_EQ(n.as_map().length(), 2);
+  ELLIS_ASSERT_EQ(n.as_map()["xs"].as_int64(), 1);
+}
+
+void check_number_round_trip()
+{
+  using namespace ellis;
+  json_encoder enc;
+  json_decoder dec;
+  char buf[64];
+
+  auto round_trip = [&](const node &n) {
+    memset(buf, 0, sizeof(buf));
+    dump_mem(&n, buf, sizeof(buf) - 1, enc);
+    auto n2 = load_mem(buf, strlen(buf), dec);
+    ELLIS_ASSERT_EQ(n2->get_type(), n.get_type());
+    return n2;
+  };
+
+  /* Integers, including the extremes and every digit count. */
+  int64_t ival = 1;
+  for (int i = 0; i < 19; i++) {
+    for (int64_t v : { ival - 1, ival, -ival, -ival + 1 }) {
+      ELLIS_ASSERT_EQ(round_trip(node(v))->as_int64(), v);
+    }
+    /* 10^18 is the largest power of ten an int64 holds. */
+    if (i < 18) {
+      ival *= 10;
+    }
+  }
+  ELLIS_ASSERT_EQ(round_trip(node(INT64_MAX))->as_int64(), INT64_MAX);
+  ELLIS_ASSERT_EQ(round_trip(node(INT64_MIN))->as_int64(), INT64_MIN);
+
+  /* Doubles must read back bit for bit; walk random bit patterns across
+   * the whole exponent range, including subnormals. */
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  for (int i = 0; i < 200000; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    double d;
+    memcpy(&d, &state, sizeof(d));
+    if (! std::isfinite(d)) {
+      continue;
+    }
+    double d2 = round_trip(node(d))->as_double();
+    ELLIS_ASSERT_MEM_EQ((const byte *)&d, (const byte *)&d2, sizeof(d));
+  }
+
+  /* Short decimals come back as written. */
+  auto enc_str = [&](double d) {
+    node n(d);
+    dump_mem(&n, buf, sizeof(buf), enc);
+    return string(buf);
+  };
+  ELLIS_ASSERT_EQ(enc_str(0.3), "0.3");
+  ELLIS_ASSERT_EQ(enc_str(1e-9), "1e-9");
+  ELLIS_ASSERT_EQ(enc_str(100.0), "100.0");
+
+  /* Non-finite values have no JSON representation. */
+  bool threw = false;
+  try {
+    enc_str(std::numeric_limits<double>::infinity());
+  } catch (const err &e) {
+    threw = true;
+    ELLIS_ASSERT(e.code() == err_code::TRANSLATE_FAIL);
+  }
+  ELLIS_ASSERT(threw);
+}
+
+void check_string_escapes()
+{
+  using namespace ellis;
+  json_encoder enc;
+  json_decoder dec;
+
+  auto enc_str = [&](const node &n) {
+    std::stringstream ss;
+    dump(&n, cpp_output_stream(ss), enc);
+    return ss.str();
+  };
+
+  /* Every control character, in short and long (vectorized) strings.
+   * NUL is left out since the decoder does not yet keep embedded NULs. */
+  for (int c = 1; c < 0x20; c++) {
+    string plain(40, 'x');
+    for (size_t pos : { 0, 1, 15, 16, 17, 31, 39 }) {
+      string s = plain;
+      s[pos] = (char)c;
+      node n(type::U8STR);
+      n.as_mutable_u8str().assign(s.c_str(), s.size());
+      string txt = enc_str(n);
+      auto n2 = load_mem(txt.c_str(), txt.size(), dec);
+      ELLIS_ASSERT_EQ(n2->as_u8str().length(), s.size());
+      ELLIS_ASSERT(memcmp(n2->as_u8str().c_str(), s.c_str(), s.size()) == 0);
+    }
+  }
+  ELLIS_ASSERT_EQ(enc_str(node("\x01\x1f")), R"("\u0001\u001f")");
+  node nul(type::U8STR);
+  nul.as_mutable_u8str().assign("a\0b", 3);
+  ELLIS_ASSERT_EQ(enc_str(nul), R"("a\u0000b")");
+  ELLIS_ASSERT_EQ(
+      enc_str(node("a long string with a \"quote\" and a back\\slash and /")),
+      R"("a long string with a \"quote\" and a back\\slash and \/")");
+  /* Bytes >= 0x80 (UTF-8) pass through untouched. */
+  ELLIS_ASSERT_EQ(enc_str(node("\xe2\x98\x85\xe2\x98\x85\xe2\x98\x85"
+          "\xe2\x98\x85\xe2\x98\x85\xe2\x98\x85")),
+      "\"\xe2\x98\x85\xe2\x98\x85\xe2\x98\x85"
+      "\xe2\x98\x85\xe2\x98\x85\xe2\x98\x85\"");
+
+  /* Map keys are escaped too. */
+  node m(type::MAP);
+  m.as_mutable_map().insert("k\"e\ny", 1);
+  ELLIS_ASSERT_EQ(enc_str(m), R"({ "k\"e\ny": 1 })");
+}
+
+void check_binary()
+{
+  using namespace ellis;
+  json_encoder enc;
+  json_decoder dec;
+
+  auto enc_str = [&](const node &n) {
+    std::stringstream ss;
+    dump(&n, cpp_output_stream(ss), enc);
+    return ss.str();
+  };
+  auto bin = [](const string &s) {
+    return node((const byte *)s.data(), s.size());
+  };
+
+  /* RFC 4648 test vectors. */
+  ELLIS_ASSERT_EQ(enc_str(bin("")), R"("/ELLIS_BINARY/")");
+  ELLIS_ASSERT_EQ(enc_str(bin("f")), R"("/ELLIS_BINARY/Zg==")");
+  ELLIS_ASSERT_EQ(enc_str(bin("fo")), R"("/ELLIS_BINARY/Zm8=")");
+  ELLIS_ASSERT_EQ(enc_str(bin("foo")), R"("/ELLIS_BINARY/Zm9v")");
+  ELLIS_ASSERT_EQ(enc_str(bin("foobar")), R"("/ELLIS_BINARY/Zm9vYmFy")");
+
+  /* Every length across the vectorized block boundaries, plus a big blob,
+   * fed to the decoder whole and in small pieces. */
+  uint64_t state = 0x2545F4914F6CDD1DULL;
+  auto next_byte = [&state]() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (byte)(state >> 32);
+  };
+  vector<size_t> lens;
+  for (size_t len = 0; len < 100; len++) {
+    lens.push_back(len);
+  }
+  lens.push_back(1 << 20);
+  for (size_t len : lens) {
+    node n(type::BINARY);
+    auto &b = n.as_mutable_binary();
+    b.resize(len);
+    for (size_t i = 0; i < len; i++) {
+      b[i] = next_byte();
+    }
+    string txt = enc_str(n);
+    ELLIS_ASSERT_EQ(txt.size(), 16 + (len + 2) / 3 * 4);
+    auto n2 = load_mem(txt.c_str(), txt.size(), dec);
+    ELLIS_ASSERT(n2->is_type(type::BINARY));
+    ELLIS_ASSERT(*n2 == n);
+
+    dec.reset();
+    node_progress st(stream_state::CONTINUE);
+    for (size_t pos = 0; pos < txt.size(); pos += 7) {
+      size_t count = std::min<size_t>(7, txt.size() - pos);
+      st = dec.consume_buffer((const byte *)txt.data() + pos, &count);
+      ELLIS_ASSERT(st.state() == stream_state::CONTINUE
+          || pos + 7 >= txt.size());
+    }
+    ELLIS_ASSERT(st.state() == stream_state::SUCCESS);
+    ELLIS_ASSERT(*st.extract_value() == n);
+  }
+
+  /* Binary nested among other values. */
+  node m(type::MAP);
+  m.as_mutable_map().insert("blob", bin("\x00\x01\xfe\xff"));
+  node arr(type::ARRAY);
+  arr.as_mutable_array().append(bin("xyz"));
+  arr.as_mutable_array().append("text");
+  m.as_mutable_map().insert("arr", arr);
+  string mtxt = enc_str(m);
+  ELLIS_ASSERT(*load_mem(mtxt.c_str(), mtxt.size(), dec) == m);
+
+  /* Text that merely looks like a blob stays text, since the encoder escapes
+   * its slashes; so do escaped prefixes from elsewhere. */
+  node look(type::U8STR);
+  look.as_mutable_u8str().assign("/ELLIS_BINARY/Zg==", 18);
+  string ltxt = enc_str(look);
+  ELLIS_ASSERT_EQ(ltxt, R"("\/ELLIS_BINARY\/Zg==")");
+  ELLIS_ASSERT(*load_mem(ltxt.c_str(), ltxt.size(), dec) == look);
+  const string esc_txt = "\"/ELLIS_BINARY\\/Zg==\"";
+  ELLIS_ASSERT(load_mem(esc_txt.c_str(), esc_txt.size(), dec)->is_type(
+        type::U8STR));
+
+  /* Malformed base64, in the scalar tail and in a vectorized block, means
+   * the string was not a blob after all; it stays text, as a value or a key. */
+  for (const string &bad : {
+      string("/ELLIS_BINARY/Zg="),
+      string("/ELLIS_BINARY/Z==="),
+      string("/ELLIS_BINARY/Zg==Zg=="),
+      string("/ELLIS_BINARY/not base64!"),
+      "/ELLIS_BINARY/" + string(40, 'A') + "*" + string(23, 'A') })
+  {
+    const string txt = "\"" + bad + "\"";
+    auto n = load_mem(txt.c_str(), txt.size(), dec);
+    ELLIS_ASSERT(n->is_type(type::U8STR));
+    ELLIS_ASSERT_EQ(string(n->as_u8str().c_str()), bad);
+
+    const string ktxt = "{ " + txt + ": " + txt + " }";
+    auto kn = load_mem(ktxt.c_str(), ktxt.size(), dec);
+    ELLIS_ASSERT(kn->as_map().has_key(bad));
+    ELLIS_ASSERT(kn->as_map()[bad].is_type(type::U8STR));
+    ELLIS_ASSERT_EQ(string(kn->as_map()[bad].as_u8str().c_str()), bad);
+  }
+}
+
+void check_projection()
+{
+  using namespace ellis;
+  const string txt = R"({ "id": 7, "name": "x",
+    "big": { "blob": [ 1, 2.5e3, { "deep": "s" }, true, null ], "s": "q\" ]" },
+    // a comment with "quotes" and [ brackets
+    "arr": [ { "a": 1, "b": [ 2 ] }, { "a": 3, "b": -4 }, { "a": 5 } ],
+    "tail": null })";
+
+  auto parse = [](const string &t) {
+    json_decoder dec;
+    return load_mem(t.c_str(), t.size(), dec);
+  };
+  auto check = [&](
+      const string &doc,
+      const vector<string> &paths,
+      const string &expect)
+  {
+    json_decoder dec;
+    dec.set_projection(paths);
+    auto got = load_mem(doc.c_str(), doc.size(), dec);
+    ELLIS_ASSERT(*got == *parse(expect));
+
+    /* Skipping must also work across buffer boundaries. */
+    dec.reset();
+    node_progress st(stream_state::CONTINUE);
+    for (size_t i = 0; i < doc.size() && st.state() == stream_state::CONTINUE;
+        i++)
+    {
+      size_t count = 1;
+      st = dec.consume_buffer((const byte *)doc.data() + i, &count);
+    }
+    if (st.state() == stream_state::CONTINUE) {
+      st = dec.chop();
+    }
+    ELLIS_ASSERT(st.state() == stream_state::SUCCESS);
+    ELLIS_ASSERT(*st.extract_value() == *got);
+  };
+
+  check(txt, { "{id}", "{arr}[1]{a}", "{big}{s}" },
+      R"({ "id": 7, "big": { "s": "q\" ]" }, "arr": [ null, { "a": 3 } ] })");
+  check(txt, { "{arr}" },
+      R"({ "arr": [ { "a": 1, "b": [ 2 ] }, { "a": 3, "b": -4 },
+        { "a": 5 } ] })");
+  check(txt, { "{arr}[5]", "{big}{blob}[2]{deep}" },
+      R"({ "arr": [ null, null, null ],
+        "big": { "blob": [ null, null, { "deep": "s" } ] } })");
+  check(txt, { "{name}", "{tail}" }, R"({ "name": "x", "tail": null })");
+  check(txt, { "" }, txt);
+  check(txt, {}, "{}");
+  check(txt, { "{nope}" }, "{}");
+  check("[ 1, [ 2, 3 ], \"s\", { \"k\": 1 }, 4 ]", { "[1][0]", "[3]" },
+      "[ null, [ 2 ], null, { \"k\": 1 } ]");
+  check("[]", { "[0]" }, "[]");
+  check("[ [], {} ]", { "[9]" }, "[ null, null ]");
+
+  /* Back to decoding everything. */
+  json_decoder dec;
+  dec.set_projection({ "{id}" });
+  dec.clear_projection();
+  ELLIS_ASSERT(*load_mem(txt.c_str(), txt.size(), dec) == *parse(txt));
+
+  /* Skipped text is still checked for nesting and unterminated strings. */
+  for (const string &bad : {
+      string(R"({ "a": [ 1, 2 }, "b": 1 })"),
+      string(R"({ "a": "unterminated, "b": 1 })"),
+      string(R"({ "a": [ 1, 2 ] "b": 1 })") })
+  {
+    dec.set_projection({ "{b}" });
+    bool threw = false;
+    try {
+      load_mem(bad.c_str(), bad.size(), dec);
+    } catch (const err &e) {
+      threw = true;
+      ELLIS_ASSERT(e.code() == err_code::PARSE_FAIL);
+    }
+    ELLIS_ASSERT(threw);
+  }
+}
+
+void check_element_stream()
+{
+  using namespace ellis;
+  auto parse = [](const string &t) {
+    json_decoder dec;
+    return load_mem(t.c_str(), t.size(), dec);
+  };
+  auto check = [&](
+      const string &doc,
+      const string &path,
+      const vector<string> &expect_elems,
+      const string &expect_doc)
+  {
+    json_decoder dec;
+    vector<node> got;
+    dec.set_element_callback(path,
+        [&got](unique_ptr<node> n) { got.push_back(*n); });
+    auto rest = load_mem(doc.c_str(), doc.size(), dec);
+    ELLIS_ASSERT(*rest == *parse(expect_doc));
+    ELLIS_ASSERT_EQ(got.size(), expect_elems.size());
+    for (size_t i = 0; i < got.size(); i++) {
+      ELLIS_ASSERT(got[i] == *parse(expect_elems[i]));
+    }
+
+    /* Again a byte at a time, reusing the decoder. */
+    got.clear();
+    dec.reset();
+    node_progress st(stream_state::CONTINUE);
+    for (size_t i = 0; i < doc.size() && st.state() == stream_state::CONTINUE;
+        i++)
+    {
+      size_t count = 1;
+      st = dec.consume_buffer((const byte *)doc.data() + i, &count);
+    }
+    if (st.state() == stream_state::CONTINUE) {
+      st = dec.chop();
+    }
+    ELLIS_ASSERT(st.state() == stream_state::SUCCESS);
+    ELLIS_ASSERT(*st.extract_value() == *rest);
+    ELLIS_ASSERT_EQ(got.size(), expect_elems.size());
+  };
+
+  check(R"([ { "a": 1 }, [ 2, 3 ], "s", null ])", "",
+      { R"({ "a": 1 })", "[ 2, 3 ]", R"("s")", "null" }, "[]");
+  const string doc = R"({ "meta": { "n": 2 },
+    "data": [ 1, { "x": [ 5 ] } ], "other": [ 7 ] })";
+  check(doc, "{data}", { "1", R"({ "x": [ 5 ] })" },
+      R"({ "meta": { "n": 2 }, "data": [], "other": [ 7 ] })");
+  check(doc, "{meta}", {}, doc);
+  check(doc, "{nope}", {}, doc);
+  check("[ [ 1, 2 ], [ 3, [ 4 ] ] ]", "[1]", { "3", "[ 4 ]" },
+      "[ [ 1, 2 ], [] ]");
+  check("[ [ [ 1 ] ] ]", "[0][0]", { "1" }, "[ [ [] ] ]");
+
+  /* Combined with a projection, which indexes the streamed elements. */
+  json_decoder dec;
+  vector<node> got;
+  dec.set_projection({ "{data}[1]{x}" });
+  dec.set_element_callback("{data}",
+      [&got](unique_ptr<node> n) { got.push_back(*n); });
+  auto rest = load_mem(doc.c_str(), doc.size(), dec);
+  ELLIS_ASSERT(*rest == *parse(R"({ "data": [] })"));
+  ELLIS_ASSERT_EQ(got.size(), 2);
+  ELLIS_ASSERT(got[0].get_type() == type::NIL);
+  ELLIS_ASSERT(got[1] == *parse(R"({ "x": [ 5 ] })"));
+
+  /* Back to building arrays whole. */
+  dec.clear_projection();
+  dec.clear_element_callback();
+  ELLIS_ASSERT(*load_mem(doc.c_str(), doc.size(), dec) == *parse(doc));
+}
+
+void check_encoder_opts()
+{
+  using namespace ellis;
+  json_decoder dec;
+  const string txt = R"({ "b": [ 1, 2.5, { "x": null } ], "a": "s p", "c": {} })";
+  auto n = load_mem(txt.c_str(), txt.size(), dec);
+
+  auto enc_str = [&n](const json_encoder_opts &opts) {
+    json_encoder enc(opts);
+    std::stringstream ss;
+    dump(n.get(), cpp_output_stream(ss), enc);
+    return ss.str();
+  };
+
+  json_encoder_opts opts;
+  opts.sort_keys = true;
+  ELLIS_ASSERT_EQ(enc_str(opts),
+      R"({ "a": "s p", "b": [ 1, 2.5, { "x": null } ], "c": {} })");
+  opts.compact = true;
+  ELLIS_ASSERT_EQ(enc_str(opts), R"({"a":"s p","b":[1,2.5,{"x":null}],"c":{}})");
+
+  /* Unsorted compact output has the same content, in some order. */
+  opts.sort_keys = false;
+  string compact = enc_str(opts);
+  ELLIS_ASSERT_EQ(compact.find(' '), compact.find("s p") + 1);
+  auto n2 = load_mem(compact.c_str(), compact.size(), dec);
+  ELLIS_ASSERT(*n2 == *n);
+
+  /* Options can be changed on an existing encoder. */
+  json_encoder enc;
+  ELLIS_ASSERT_FALSE(enc.opts().compact);
+  enc.set_opts(opts);
+  ELLIS_ASSERT_TRUE(enc.opts().compact);
+  node arr(type::ARRAY);
+  arr.as_mutable_array().append(1);
+  arr.as_mutable_array().append(2);
+  char buf[16];
+  dump_mem(&arr, buf, sizeof(buf), enc);
+  ELLIS_ASSERT_EQ(string(buf), "[1,2]");
+}
+
+void check_encoded_size()
+{
+  using namespace ellis;
+  node all(type::MAP);
+  auto &m = all.as_mutable_map();
+  m.insert("nil", node(type::NIL));
+  m.insert("yes", true);
+  m.insert("no", false);
+  node ints(type::ARRAY);
+  for (int64_t i : { (int64_t)0, (int64_t)9, (int64_t)10, (int64_t)-1,
+        (int64_t)-10, INT64_MAX, INT64_MIN })
+  {
+    ints.as_mutable_array().append(i);
+  }
+  m.insert("ints", ints);
+  node dbls(type::ARRAY);
+  for (double d : { 0.0, 0.3, -1e-9, 100.0, 1.7976931348623157e308 }) {
+    dbls.as_mutable_array().append(d);
+  }
+  m.insert("dbls", dbls);
+  /* Every byte value, so every kind of escape. */
+  string bytes;
+  for (int i = 0; i < 256; i++) {
+    bytes += (char)i;
+  }
+  node str(bytes);
+  m.insert("bytes", str);
+  m.insert("a \"quoted\"/key\n", string(100, 'x') + "\\");
+  for (size_t len : { 0, 1, 2, 3, 4, 100 }) {
+    node blob(type::BINARY);
+    blob.as_mutable_binary().resize(len);
+    m.insert("bin" + std::to_string(len), blob);
+  }
+  m.insert("empty_arr", node(type::ARRAY));
+  m.insert("empty_map", node(type::MAP));
+  node nested(type::ARRAY);
+  nested.as_mutable_array().append(all);
+  nested.as_mutable_array().append(node(type::MAP));
+
+  for (bool compact : { false, true }) {
+    for (bool sort_keys : { false, true }) {
+      json_encoder_opts opts;
+      opts.compact = compact;
+      opts.sort_keys = sort_keys;
+      json_encoder enc(opts);
+      for (const node *n : { &all, &nested, &str, &ints, &dbls }) {
+        std::stringstream ss;
+        dump(n, cpp_output_stream(ss), enc);
+        size_t size = 0;
+        ELLIS_ASSERT_TRUE(enc.encoded_size(*n, &size));
+        ELLIS_ASSERT_EQ(size, ss.str().size());
+      }
+    }
+  }
+
+  /* The same failures as encoding. */
+  json_encoder enc;
+  node bad(type::ARRAY);
+  bad.as_mutable_array().append(std::numeric_limits<double>::quiet_NaN());
+  bool threw = false;
+  try {
+    size_t size;
+    enc.encoded_size(bad, &size);
+  } catch (const err &e) {
+    threw = true;
+    ELLIS_ASSERT(e.code() == err_code::TRANSLATE_FAIL);
+  }
+  ELLIS_ASSERT(threw);
+}
+
 int main() {
   using namespace ellis;
 
   // set_system_log_prefilter(log_severity::DBUG);
   check_give_back();
+  check_load_into();
+  check_reuse();
+  check_number_round_trip();
+  check_string_escapes();
+  check_binary();
+  check_projection();
+  check_element_stream();
+  check_encoder_opts();
+  check_encoded_size();
   json_decoder dec;
   json_encoder enc;
 
@@ -97,19 +652,29 @@ int main() {
   ser_deser("0");
   ser_deser("1");
   ser_deser("9223372036854775807");
-  ser_deser("0.000000");
-  // TODO: enable XeY tests after overhaul double output
-  // ser_deser("2.5e15");
-  ser_deser("2.500000");
-  // ser_deser("2.5e-15");
-  // ser_deser("-0.25e1");
-  ser_deser("-2.500000");
-  // ser_deser("-0.25e-1");
+  ser_deser("0.0");
+  ser_deser("-0.0");
+  ser_deser("2.5e15");
+  ser_deser("2.5");
+  ser_deser("2.5e-15");
+  ser_deser("-2.5");
+  ser_deser("-0.025");
+  ser_deser("-2.5e-5");
+  ser_deser("0.1");
+  ser_deser("1e-9");
+  ser_deser("1e21");
+  ser_deser("123456789012345.0");
+  ser_deser("1.2345678901234568e16");
+  ser_deser("0.30000000000000004");
+  ser_deser("1.7976931348623157e308");
+  ser_deser("5e-324");
   ser_deser(R"("")");
   ser_deser(R"("simple")");
   ser_deser(R"("s\"im\"ple")");
   ser_deser(R"("sim\nple")");
   ser_deser(R"("sim★ple")");
+  ser_deser(R"("a somewhat longer string \/ with \"escapes\" \\ \b\f\n\r\t")");
+  ser_deser(R"({ "\"quoted\" key": "\u0001" })");
   ser_deser(R"({})");
   ser_deser(R"({ "map": {} })");
   ser_deser(R"({ "map": [] })");
@@ -119,7 +684,7 @@ int main() {
   ser_deser(R"({ "map": true })");
   ser_deser(R"({ "map": false })");
   ser_deser(R"({ "map": 42 })");
-  ser_deser(R"({ "map": 42.200000 })");
+  ser_deser(R"({ "map": 42.2 })");
   ser_deser(R"([])");
   ser_deser(R"([ [] ])");
   ser_deser(R"([ 1, 2, { "hello": "world" } ])");
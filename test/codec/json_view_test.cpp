@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#undef NDEBUG
+#include <ellis/codec/json.hpp>
+#include <ellis/codec/json_view.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis_private/using.hpp>
+
+using namespace ellis;
+
+
+/* Checks that the view agrees with the eagerly decoded node throughout. */
+static void compare(const json_view &v, const node &n)
+{
+  ELLIS_ASSERT_EQ(v.get_type(), n.get_type());
+  switch (n.get_type()) {
+    case type::NIL:
+      break;
+    case type::BOOL:
+      ELLIS_ASSERT_EQ(v.as_bool(), n.as_bool());
+      break;
+    case type::INT64:
+      ELLIS_ASSERT_EQ(v.as_int64(), n.as_int64());
+      break;
+    case type::DOUBLE:
+      ELLIS_ASSERT_EQ(v.as_double(), n.as_double());
+      break;
+    case type::U8STR:
+      ELLIS_ASSERT_EQ(v.as_u8str(), string(n.as_u8str().c_str()));
+      break;
+    case type::ARRAY:
+      ELLIS_ASSERT_EQ(v.length(), n.as_array().length());
+      for (size_t i = 0; i < v.length(); i++) {
+        compare(v[i], n.as_array()[i]);
+      }
+      break;
+    case type::MAP:
+      ELLIS_ASSERT_EQ(v.length(), n.as_map().length());
+      for (const auto &k : v.keys()) {
+        ELLIS_ASSERT(n.as_map().has_key(k));
+        compare(v[k], n.as_map()[k]);
+      }
+      break;
+    case type::BINARY:
+      /* Only reachable through to_node(), checked below. */
+      break;
+  }
+  ELLIS_ASSERT(*v.to_node() == n);
+}
+
+
+static void check_same(const string &txt)
+{
+  json_decoder dec;
+  auto n = load_mem(txt.c_str(), txt.size(), dec);
+  json_tape tape(txt.c_str(), txt.size());
+  compare(tape.root(), *n);
+}
+
+
+static void check_malformed(const string &txt)
+{
+  bool threw = false;
+  try {
+    json_tape tape(txt.c_str(), txt.size());
+  } catch (const err &e) {
+    ELLIS_ASSERT(e.code() == err_code::PARSE_FAIL);
+    threw = true;
+  }
+  ELLIS_ASSERT(threw);
+}
+
+
+int main()
+{
+  check_same("null");
+  check_same(" true ");
+  check_same("false");
+  check_same("-12345");
+  check_same("0");
+  check_same("2.5e-3");
+  check_same("-0.25E+1");
+  check_same(R"("plain")");
+  check_same(R"("esc \"aped\" \\ \/ é★ \n\t")");
+  check_same(R"([ "/ELLIS_BINARY/Zm9vYmFy", "\/ELLIS_BINARY\/Zg==" ])");
+  check_same(R"([ "/ELLIS_BINARY/not base64!", "/ELLIS_BINARY/Zg=",
+      "/ELLIS_BINARY/Zg\u003d=", "/ELLIS_BINARY/Zg\u003d" ])");
+  check_same(R"({ "/ELLIS_BINARY/Zg==": "/ELLIS_BINARY/?" })");
+  check_same("[]");
+  check_same("{}");
+  check_same("[[], {}, [[1]], 2]");
+  check_same(R"({ "a": 1, "b": [ true, false, null, { "c": "d" } ],
+      // a comment
+      "e\"k": { "f": { "g": [ 1.5, -2 ] } }, "h": {} })");
+
+  const string doc = R"({
+    "id": 42,
+    "user": { "name": "ann", "tags": [ "x", "y" ] },
+    "items": [ { "v": 1 }, { "v": 2 }, { "v": 3 } ],
+    "ratio": 0.75
+  })";
+  json_tape tape(doc.c_str(), doc.size());
+  auto root = tape.root();
+  ELLIS_ASSERT_EQ(root["id"].as_int64(), 42);
+  ELLIS_ASSERT_EQ(root.at("{user}{name}").as_u8str(), "ann");
+  ELLIS_ASSERT_EQ(root.at("{user}{tags}[1]").as_u8str(), "y");
+  ELLIS_ASSERT_EQ(root.at("{items}[2]{v}").as_int64(), 3);
+  ELLIS_ASSERT_EQ(root["ratio"].as_double(), 0.75);
+  ELLIS_ASSERT(root.has_key("user"));
+  ELLIS_ASSERT(! root.has_key("nope"));
+  ELLIS_ASSERT_EQ(string(root["user"].raw_text(), root["user"].raw_length()),
+      R"({ "name": "ann", "tags": [ "x", "y" ] })");
+  auto items = root["items"].to_node();
+  ELLIS_ASSERT_EQ(items->as_array().length(), 3UL);
+
+  /* Errors. */
+  auto expect_code = [](std::function<void()> fn, err_code code) {
+    bool threw = false;
+    try {
+      fn();
+    } catch (const err &e) {
+      ELLIS_ASSERT(e.code() == code);
+      threw = true;
+    }
+    ELLIS_ASSERT(threw);
+  };
+  expect_code([&]() { root["nope"]; }, err_code::NO_SUCH);
+  expect_code([&]() { root["id"].as_u8str(); }, err_code::TYPE_MISMATCH);
+  expect_code([&]() { root["items"][3]; }, err_code::INVALID_ARGS);
+  expect_code([&]() { root.at("{items}[7]"); }, err_code::PATH_FAIL);
+  expect_code([&]() { root.at("{id}{x}"); }, err_code::PATH_FAIL);
+
+  check_malformed("");
+  check_malformed("   ");
+  check_malformed("[");
+  check_malformed("[1,]");
+  check_malformed("[1 2]");
+  check_malformed("{\"a\" 1}");
+  check_malformed("{\"a\": 1,}");
+  check_malformed("{1: 2}");
+  check_malformed("\"abc");
+  check_malformed("01");
+  check_malformed("-");
+  check_malformed("1.");
+  check_malformed("1e");
+  check_malformed("nil");
+  check_malformed("truex");
+  check_malformed("[] []");
+  check_malformed("]");
+  return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#undef NDEBUG
+#include <ellis/codec/jsonl.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/data_format.hpp>
+#include <ellis/core/emigration.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis/stream/cpp_input_stream.hpp>
+#include <ellis/stream/cpp_output_stream.hpp>
+#include <ellis/stream/mem_input_stream.hpp>
+#include <ellis_private/using.hpp>
+#include <sstream>
+
+using namespace ellis;
+
+static const char *k_sample =
+  "1\n"
+  "{\"a\": 2, \"b\": [true, null]}\n"
+  "\n"
+  "  [3]\r\n"
+  "\"x\"";
+
+void check_codec()
+{
+  jsonl_decoder dec;
+  auto n = load_mem(k_sample, strlen(k_sample), dec);
+  const auto &a = n->as_array();
+  ELLIS_ASSERT_EQ(a.length(), 4UL);
+  ELLIS_ASSERT_EQ(a[0].as_int64(), 1);
+  ELLIS_ASSERT_EQ(a[1].as_map()["a"].as_int64(), 2);
+  ELLIS_ASSERT_EQ(a[2].as_array().length(), 1UL);
+  ELLIS_ASSERT_EQ(string(a[3].as_u8str().c_str()), "x");
+
+  /* Reusing the decoder starts from scratch. */
+  auto n2 = load_mem("5 6", 3, dec);
+  ELLIS_ASSERT_EQ(n2->as_array().length(), 2UL);
+  n2 = load_mem("\n", 1, dec);
+  ELLIS_ASSERT_EQ(n2->as_array().length(), 0UL);
+
+  jsonl_encoder enc;
+  std::ostringstream os;
+  node arr(type::ARRAY);
+  arr.as_mutable_array().append(1);
+  arr.as_mutable_array().append(a[2]);
+  arr.as_mutable_array().append("x y");
+  dump_stream(&arr, os, enc);
+  ELLIS_ASSERT_EQ(os.str(), "1\n[3]\n\"x y\"\n");
+
+  /* Only arrays of records can be written. */
+  bool threw = false;
+  try {
+    node m(type::MAP);
+    dump_stream(&m, os, enc);
+  } catch (const err &e) {
+    threw = true;
+  }
+  ELLIS_ASSERT(threw);
+
+  auto fmt = system_lookup_data_formats_by_extension("jsonl");
+  ELLIS_ASSERT_EQ(fmt.size(), 1UL);
+}
+
+void check_reader()
+{
+  mem_input_stream mis(k_sample, strlen(k_sample));
+  jsonl_reader rdr(mis);
+  auto r = rdr.next();
+  ELLIS_ASSERT_EQ(r->as_int64(), 1);
+  r = rdr.next();
+  ELLIS_ASSERT_EQ(r->get_type(), type::MAP);
+  size_t seen = rdr.for_each([](unique_ptr<node> rec) {
+      ELLIS_ASSERT_EQ(rec->get_type(), type::ARRAY);
+      return false;
+    });
+  ELLIS_ASSERT_EQ(seen, 1UL);
+  /* The last record ends at end of stream, without a newline. */
+  r = rdr.next();
+  ELLIS_ASSERT_EQ(string(r->as_u8str().c_str()), "x");
+  ELLIS_ASSERT(rdr.next() == nullptr);
+  ELLIS_ASSERT(rdr.next() == nullptr);
+  ELLIS_ASSERT_EQ(rdr.count(), 4UL);
+
+  /* Truncated final record. */
+  const char *trunc = "{\"a\": 1}\n{\"b\"";
+  mem_input_stream mis2(trunc, strlen(trunc));
+  jsonl_reader rdr2(mis2);
+  ELLIS_ASSERT(rdr2.next() != nullptr);
+  bool threw = false;
+  try {
+    rdr2.next();
+  } catch (const err &e) {
+    threw = true;
+  }
+  ELLIS_ASSERT(threw);
+}
+
+void check_write_read_many()
+{
+  /* Enough records, some of them big, that both sides cross stream buffer
+   * boundaries many times. */
+  const size_t count = 5000;
+  std::stringstream ss;
+  {
+    cpp_output_stream cos(ss);
+    jsonl_writer wtr(cos);
+    for (size_t i = 0; i < count; i++) {
+      node rec(type::MAP);
+      rec.as_mutable_map().insert("i", (int64_t)i);
+      rec.as_mutable_map().insert("s", string(i % 700 == 0 ? 9000 : 5, 'z'));
+      wtr.write(rec);
+    }
+    wtr.flush();
+    ELLIS_ASSERT_EQ(wtr.count(), count);
+  }
+  string text = ss.str();
+  ELLIS_ASSERT_EQ(text.back(), '\n');
+  ELLIS_ASSERT_EQ(text.substr(0, 2), "{\"");
+  ELLIS_ASSERT_EQ(text.find(' '), string::npos);
+
+  cpp_input_stream cis(ss);
+  jsonl_reader rdr(cis);
+  size_t i = 0;
+  rdr.for_each([&i](unique_ptr<node> rec) {
+      ELLIS_ASSERT_EQ(rec->as_map()["i"].as_int64(), (int64_t)i);
+      ELLIS_ASSERT_EQ(rec->as_map()["s"].as_u8str().length(),
+          i % 700 == 0 ? 9000UL : 5UL);
+      i++;
+      return true;
+    });
+  ELLIS_ASSERT_EQ(i, count);
+}
+
+int main()
+{
+  check_codec();
+  check_reader();
+  check_write_read_many();
+  return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#undef NDEBUG
+#include <algorithm>
+#include <ellis/codec/msgpack_seq.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis/stream/cpp_input_stream.hpp>
+#include <ellis/stream/cpp_output_stream.hpp>
+#include <ellis/stream/mem_input_stream.hpp>
+#include <ellis_private/using.hpp>
+#include <sstream>
+
+using namespace ellis;
+
+/* 1, {"a": 2}, [true, nil], "x" */
+static const byte k_sample[] = {
+  0x01,
+  0x81, 0xa1, 'a', 0x02,
+  0x92, 0xc3, 0xc0,
+  0xa1, 'x',
+};
+
+template <typename F>
+static bool throws(F &&fn)
+{
+  try {
+    fn();
+  } catch (const err &e) {
+    return true;
+  }
+  return false;
+}
+
+void check_reader()
+{
+  mem_input_stream mis(k_sample, sizeof(k_sample));
+  msgpack_seq_reader rdr(mis);
+  auto r = rdr.next();
+  ELLIS_ASSERT_EQ(r->as_int64(), 1);
+  r = rdr.next();
+  ELLIS_ASSERT_EQ(r->as_map()["a"].as_int64(), 2);
+  size_t seen = rdr.for_each([](unique_ptr<node> rec) {
+      ELLIS_ASSERT_EQ(rec->get_type(), type::ARRAY);
+      return false;
+    });
+  ELLIS_ASSERT_EQ(seen, 1UL);
+  r = rdr.next();
+  ELLIS_ASSERT_EQ(string(r->as_u8str().c_str()), "x");
+  ELLIS_ASSERT(rdr.next() == nullptr);
+  ELLIS_ASSERT(rdr.next() == nullptr);
+  ELLIS_ASSERT_EQ(rdr.count(), 4UL);
+
+  /* Batches, the last one short. */
+  mem_input_stream mis2(k_sample, sizeof(k_sample));
+  msgpack_seq_reader rdr2(mis2);
+  vector<node> batch;
+  ELLIS_ASSERT_EQ(rdr2.next_batch(3, &batch), 3UL);
+  ELLIS_ASSERT_EQ(batch.size(), 3UL);
+  ELLIS_ASSERT_EQ(batch[2].as_array().length(), 2UL);
+  ELLIS_ASSERT_EQ(rdr2.next_batch(3, &batch), 1UL);
+  ELLIS_ASSERT_EQ(batch.size(), 4UL);
+  ELLIS_ASSERT_EQ(rdr2.next_batch(3, &batch), 0UL);
+
+  /* Truncated final record. */
+  mem_input_stream mis3(k_sample, sizeof(k_sample) - 1);
+  msgpack_seq_reader rdr3(mis3);
+  batch.clear();
+  ELLIS_ASSERT(throws([&]() { rdr3.next_batch(10, &batch); }));
+  ELLIS_ASSERT_EQ(batch.size(), 3UL);
+
+  /* Malformed record; 0xc1 is never used. */
+  const byte bad[] = { 0x01, 0xc1, 0x02 };
+  mem_input_stream mis4(bad, sizeof(bad));
+  msgpack_seq_reader rdr4(mis4);
+  ELLIS_ASSERT(rdr4.next() != nullptr);
+  ELLIS_ASSERT(throws([&]() { rdr4.next(); }));
+}
+
+void check_chop()
+{
+  /* A plain load of empty or truncated input fails either way, but says
+   * which. */
+  msgpack_decoder dec;
+  auto msg = [&dec](size_t len) {
+    try {
+      load_mem(k_sample + 1, len, dec);
+    } catch (const err &e) {
+      return e.msg();
+    }
+    return string();
+  };
+  ELLIS_ASSERT_NEQ(msg(0).find("no msgpack value"), string::npos);
+  ELLIS_ASSERT_NEQ(msg(2).find("truncated input"), string::npos);
+}
+
+void check_write_read_many()
+{
+  /* Enough records, some of them big, that both sides cross stream buffer
+   * boundaries many times. */
+  const size_t count = 5000;
+  auto make = [](size_t i) {
+    node rec(type::MAP);
+    rec.as_mutable_map().insert("i", (int64_t)i);
+    rec.as_mutable_map().insert("s", string(i % 700 == 0 ? 9000 : 5, 'z'));
+    return rec;
+  };
+  std::stringstream ss;
+  {
+    cpp_output_stream cos(ss);
+    msgpack_seq_writer wtr(cos);
+    vector<node> batch;
+    for (size_t i = 0; i < count; i++) {
+      if (i % 2) {
+        wtr.write(make(i));
+        continue;
+      }
+      batch.push_back(make(i));
+      if (batch.size() == 64) {
+        wtr.write_batch(batch);
+        batch.clear();
+      }
+    }
+    wtr.write_batch(batch);
+    wtr.flush();
+    ELLIS_ASSERT_EQ(wtr.count(), count);
+  }
+
+  cpp_input_stream cis(ss);
+  msgpack_seq_reader rdr(cis);
+  size_t seen = 0;
+  vector<node> recs;
+  while (rdr.next_batch(100, &recs) > 0) {
+    seen = recs.size();
+  }
+  ELLIS_ASSERT_EQ(seen, count);
+  std::sort(recs.begin(), recs.end(), [](const node &a, const node &b) {
+      return a.as_map()["i"].as_int64() < b.as_map()["i"].as_int64();
+    });
+  for (size_t i = 0; i < count; i++) {
+    ELLIS_ASSERT(recs[i] == make(i));
+  }
+}
+
+int main()
+{
+  check_reader();
+  check_chop();
+  check_write_read_many();
+  return 0;
+}
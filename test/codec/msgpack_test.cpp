@@ -26,10 +26,19 @@
 #include <cstring>
 #include <ellis/codec/msgpack.hpp>
 #include <ellis/core/array_node.hpp>
+#include <ellis/core/binary_node.hpp>
 #include <ellis/core/emigration.hpp>
 #include <ellis/core/immigration.hpp>
 #include <ellis/core/map_node.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis/stream/cpp_output_stream.hpp>
+#include <ellis/stream/file_output_stream.hpp>
 #include <ellis_private/using.hpp>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <streambuf>
+#include <unistd.h>
 
 using namespace ellis;
 
@@ -47,11 +56,9 @@ void ser_deser(
   enc.reset(&n);
   enc.fill_buffer(out.get(), &tmp);
   ELLIS_ASSERT_LT(tmp, max_len);
-  size_t diff = max_len - tmp;
 
   /* Now decode. */
   dec.reset();
-  tmp = diff;
   auto status = dec.consume_buffer(out.get(), &tmp);
   ELLIS_ASSERT_EQ(status.state(), stream_state::SUCCESS);
   ELLIS_ASSERT_NULL(status.extract_error().get());
@@ -71,6 +78,589 @@ void onebyte_fail(msgpack_decoder &dec, byte b)
   ELLIS_ASSERT_NOT_NULL(status.extract_error().get());
 }
 
+static vector<byte> encode(msgpack_encoder &enc, const node &n)
+{
+  vector<byte> out(1 << 18);
+  size_t tmp = out.size();
+  enc.reset(&n);
+  enc.fill_buffer(out.data(), &tmp);
+  out.resize(tmp);
+  return out;
+}
+
+void check_projection(msgpack_decoder &dec, msgpack_encoder &enc)
+{
+  /* Something with every kind of length header in it. */
+  node n(type::MAP);
+  auto &m = n.as_mutable_map();
+  m.insert("id", 7);
+  m.insert("neg", -100000);
+  m.insert("dbl", 2.5);
+  m.insert("long", string(300, 'x'));
+  node blob(type::BINARY);
+  blob.as_mutable_binary().resize(70000);
+  m.insert("blob", blob);
+  node wide(type::MAP);
+  for (int i = 0; i < 20; i++) {
+    wide.as_mutable_map().insert("k" + std::to_string(i), i * 1000);
+  }
+  m.insert("wide", wide);
+  node arr(type::ARRAY);
+  for (int i = 0; i < 20; i++) {
+    node rec(type::MAP);
+    rec.as_mutable_map().insert("a", i);
+    rec.as_mutable_map().insert("b", node(type::ARRAY));
+    rec.as_mutable_map().insert("c", "str");
+    arr.as_mutable_array().append(rec);
+  }
+  m.insert("arr", arr);
+  const vector<byte> buf = encode(enc, n);
+
+  auto decode = [&](const vector<string> &paths, size_t chunk) {
+    dec.set_projection(paths);
+    node_progress st(stream_state::CONTINUE);
+    for (size_t i = 0; i < buf.size() && st.state() == stream_state::CONTINUE;
+        i += chunk)
+    {
+      size_t count = std::min(chunk, buf.size() - i);
+      st = dec.consume_buffer(buf.data() + i, &count);
+    }
+    ELLIS_ASSERT(st.state() == stream_state::SUCCESS);
+    return *st.extract_value();
+  };
+
+  node expect(type::MAP);
+  expect.as_mutable_map().insert("id", 7);
+  node ewide(type::MAP);
+  ewide.as_mutable_map().insert("k13", 13000);
+  expect.as_mutable_map().insert("wide", ewide);
+  node earr(type::ARRAY);
+  for (int i = 0; i < 3; i++) {
+    earr.as_mutable_array().append(node(type::NIL));
+  }
+  earr.as_mutable_array().append(arr.as_array()[3]);
+  expect.as_mutable_map().insert("arr", earr);
+  for (size_t chunk : { buf.size(), (size_t)1, (size_t)1000 }) {
+    node got = decode({ "{id}", "{wide}{k13}", "{arr}[3]" }, chunk);
+    ELLIS_ASSERT(got == expect);
+  }
+
+  node expect2(type::MAP);
+  expect2.as_mutable_map().insert("long", string(300, 'x'));
+  node erec(type::MAP);
+  erec.as_mutable_map().insert("c", "str");
+  node earr2(type::ARRAY);
+  earr2.as_mutable_array().append(erec);
+  expect2.as_mutable_map().insert("arr", earr2);
+  ELLIS_ASSERT(decode({ "{long}", "{arr}[0]{c}" }, 7) == expect2);
+
+  ELLIS_ASSERT(decode({}, 7) == node(type::MAP));
+
+  dec.clear_projection();
+}
+
+void check_boundaries(msgpack_decoder &dec, msgpack_encoder &enc)
+{
+  /* Every kind of header, including long and empty keys and payloads. */
+  node n(type::MAP);
+  auto &m = n.as_mutable_map();
+  m.insert("", "empty key");
+  m.insert(string(40, 'k'), "str8 key");
+  m.insert(string(300, 'k'), "str16 key");
+  m.insert("empty", "");
+  m.insert("str8", string(200, 's'));
+  m.insert("str16", string(1000, 's'));
+  m.insert("str32", string(70000, 's'));
+  for (size_t len : { 0, 3, 300, 70000 }) {
+    node blob(type::BINARY);
+    blob.as_mutable_binary().resize(len);
+    for (size_t i = 0; i < len; i++) {
+      blob.as_mutable_binary()[i] = (byte)(i * 7);
+    }
+    m.insert("bin" + std::to_string(len), blob);
+  }
+  node arr(type::ARRAY);
+  for (int i = 0; i < 20; i++) {
+    arr.as_mutable_array().append(i * -1000);
+  }
+  m.insert("array16", arr);
+  node nums(type::ARRAY);
+  for (int64_t i : { 0LL, 127LL, 200LL, 60000LL, 4000000000LL,
+        5000000000LL, -1LL, -100LL, -30000LL, -2000000000LL, -5000000000LL })
+  {
+    nums.as_mutable_array().append(i);
+  }
+  nums.as_mutable_array().append(-2.5e300);
+  m.insert("nums", nums);
+  const vector<byte> buf = encode(enc, n);
+
+  /* The encoder gives the same output whatever the buffer size. */
+  for (size_t chunk : { 1, 2, 5, 9, 10, 4096 }) {
+    vector<byte> out;
+    vector<byte> piece(chunk);
+    enc.reset(&n);
+    while (true) {
+      size_t count = chunk;
+      auto st = enc.fill_buffer(piece.data(), &count);
+      ELLIS_ASSERT(count <= chunk);
+      out.insert(out.end(), piece.begin(), piece.begin() + count);
+      if (st.state() == stream_state::SUCCESS) {
+        break;
+      }
+      ELLIS_ASSERT_EQ(st.state(), stream_state::CONTINUE);
+      ELLIS_ASSERT_EQ(count, chunk);
+    }
+    ELLIS_ASSERT(out == buf);
+  }
+  /* Leaving room for the NUL that mem_output_stream adds. */
+  vector<byte> dumped(buf.size() + 1);
+  dump_mem(&n, dumped.data(), dumped.size(), enc);
+  dumped.pop_back();
+  ELLIS_ASSERT(dumped == buf);
+
+  /* Split in two at every point. */
+  for (size_t i = 0; i <= buf.size(); i += (i < 400 ? 1 : 997)) {
+    dec.reset();
+    size_t count = i;
+    auto st = dec.consume_buffer(buf.data(), &count);
+    if (i < buf.size()) {
+      ELLIS_ASSERT_EQ(st.state(), stream_state::CONTINUE);
+      count = buf.size() - i;
+      st = dec.consume_buffer(buf.data() + i, &count);
+    }
+    ELLIS_ASSERT_EQ(st.state(), stream_state::SUCCESS);
+    ELLIS_ASSERT_EQ(count, 0);
+    ELLIS_ASSERT(*st.extract_value() == n);
+  }
+
+  /* Trailing bytes are handed back. */
+  vector<byte> two = buf;
+  two.insert(two.end(), buf.begin(), buf.end());
+  dec.reset();
+  size_t count = two.size();
+  auto st = dec.consume_buffer(two.data(), &count);
+  ELLIS_ASSERT_EQ(st.state(), stream_state::SUCCESS);
+  ELLIS_ASSERT_EQ(count, buf.size());
+  ELLIS_ASSERT(*st.extract_value() == n);
+
+  /* Forms our encoder does not produce. */
+  {
+    const byte str8_empty[] = { 0xd9, 0x00 };
+    ELLIS_ASSERT(*load_mem(str8_empty, sizeof(str8_empty), dec) == "");
+    const byte float32[] = { 0xca, 0x3f, 0xc0, 0x00, 0x00 };
+    ELLIS_ASSERT(*load_mem(float32, sizeof(float32), dec) == 1.5);
+    const byte array32[] = { 0xdd, 0x00, 0x00, 0x00, 0x01, 0xc3 };
+    node expect(type::ARRAY);
+    expect.as_mutable_array().append(node(true));
+    ELLIS_ASSERT(*load_mem(array32, sizeof(array32), dec) == expect);
+  }
+
+  /* A non-string key is an error, even split across buffers. */
+  {
+    const byte bad[] = { 0x81, 0xcd, 0x01, 0x02, 0xc0 };
+    dec.reset();
+    count = 2;
+    st = dec.consume_buffer(bad, &count);
+    ELLIS_ASSERT_EQ(st.state(), stream_state::CONTINUE);
+    count = sizeof(bad) - 2;
+    st = dec.consume_buffer(bad + 2, &count);
+    ELLIS_ASSERT_EQ(st.state(), stream_state::ERROR);
+  }
+}
+
+void check_element_stream(msgpack_decoder &dec, msgpack_encoder &enc)
+{
+  node n(type::MAP);
+  n.as_mutable_map().insert("id", 7);
+  node recs(type::ARRAY);
+  for (int i = 0; i < 40; i++) {
+    node rec(type::MAP);
+    rec.as_mutable_map().insert("a", i);
+    rec.as_mutable_map().insert("s", string(i, 's'));
+    recs.as_mutable_array().append(rec);
+  }
+  n.as_mutable_map().insert("recs", recs);
+  const vector<byte> buf = encode(enc, n);
+
+  node expect(type::MAP);
+  expect.as_mutable_map().insert("id", 7);
+  expect.as_mutable_map().insert("recs", node(type::ARRAY));
+  for (size_t chunk : { buf.size(), (size_t)1, (size_t)13 }) {
+    vector<node> got;
+    dec.set_element_callback("{recs}",
+        [&got](unique_ptr<node> e) { got.push_back(*e); });
+    node_progress st(stream_state::CONTINUE);
+    for (size_t i = 0; i < buf.size() && st.state() == stream_state::CONTINUE;
+        i += chunk)
+    {
+      size_t count = std::min(chunk, buf.size() - i);
+      st = dec.consume_buffer(buf.data() + i, &count);
+    }
+    ELLIS_ASSERT(st.state() == stream_state::SUCCESS);
+    ELLIS_ASSERT(*st.extract_value() == expect);
+    ELLIS_ASSERT_EQ(got.size(), 40);
+    for (size_t i = 0; i < got.size(); i++) {
+      ELLIS_ASSERT(got[i] == recs.as_array()[i]);
+    }
+  }
+
+  /* The top-level array, combined with a projection. */
+  vector<node> got;
+  dec.set_projection({ "[2]{a}" });
+  dec.set_element_callback("",
+      [&got](unique_ptr<node> e) { got.push_back(*e); });
+  const vector<byte> top = encode(enc, recs);
+  node rest = *load_mem(top.data(), top.size(), dec);
+  ELLIS_ASSERT(rest == node(type::ARRAY));
+  ELLIS_ASSERT_EQ(got.size(), 3);
+  ELLIS_ASSERT(got[0].get_type() == type::NIL);
+  node e2(type::MAP);
+  e2.as_mutable_map().insert("a", 2);
+  ELLIS_ASSERT(got[2] == e2);
+
+  dec.clear_projection();
+  dec.clear_element_callback();
+}
+
+void check_slices(msgpack_decoder &dec, msgpack_encoder &enc)
+{
+  vector<byte> blob(1000);
+  for (size_t i = 0; i < blob.size(); i++) {
+    blob[i] = (byte)(i * 7);
+  }
+  node n(type::MAP);
+  n.as_mutable_map().insert("frame", node(blob.data(), blob.size()));
+  n.as_mutable_map().insert("tiny", node(blob.data(), 3));
+  auto buf = std::make_shared<vector<byte>>(encode(enc, n));
+  const byte *begin = buf->data();
+  const byte *end = begin + buf->size();
+
+  dec.set_slice_source(buf, buf->data(), buf->size());
+  node got = *load_mem(buf->data(), buf->size(), dec);
+  ELLIS_ASSERT(got == n);
+  const binary_node &frame = got.as_map()["frame"].as_binary();
+  ELLIS_ASSERT(frame.is_slice());
+  ELLIS_ASSERT(frame.data() >= begin && frame.data() + frame.length() <= end);
+  ELLIS_ASSERT_FALSE(got.as_map()["tiny"].as_binary().is_slice());
+
+  /* Input from elsewhere is copied as usual. */
+  const vector<byte> copy = *buf;
+  node got2 = *load_mem(copy.data(), copy.size(), dec);
+  ELLIS_ASSERT_FALSE(got2.as_map()["frame"].as_binary().is_slice());
+
+  /* The decoded node keeps the input alive on its own. */
+  dec.clear_slice_source();
+  ELLIS_ASSERT(buf.use_count() > 1);
+  buf.reset();
+  ELLIS_ASSERT(got == n);
+  got.as_mutable_map()["frame"].as_mutable_binary()[0] = 1;
+  ELLIS_ASSERT_FALSE(got.as_map()["frame"].as_binary().is_slice());
+}
+
+/* Empty binaries, on their own, in containers, and in place of earlier
+ * ones; the decoder is handed no bytes to copy. */
+void check_empty_binary(msgpack_decoder &dec, msgpack_encoder &enc)
+{
+  const node empty((const byte *)nullptr, 0);
+  ELLIS_ASSERT_EQ(empty.as_binary().length(), 0);
+  node doc(type::MAP);
+  doc.as_mutable_map().insert("empty", empty);
+  node arr(type::ARRAY);
+  arr.as_mutable_array().append(empty);
+  arr.as_mutable_array().append(node(type::BINARY));
+  doc.as_mutable_map().insert("arr", arr);
+  for (const node *n : { &empty, (const node *)&doc }) {
+    const vector<byte> buf = encode(enc, *n);
+    ELLIS_ASSERT_TRUE(*load_mem(buf.data(), buf.size(), dec) == *n);
+  }
+
+  /* Into a node that held a non-empty binary. */
+  const vector<byte> buf = encode(enc, empty);
+  node into(type::BINARY);
+  into.as_mutable_binary().resize(5);
+  load_mem(buf.data(), buf.size(), dec, &into);
+  ELLIS_ASSERT_TRUE(into == empty);
+}
+
+void check_load_into(msgpack_decoder &dec, msgpack_encoder &enc)
+{
+  node doc(type::MAP);
+  doc.as_mutable_map().insert("id", 7);
+  doc.as_mutable_map().insert("xs", node({ node(1), node(2), node(3) }));
+  const vector<byte> buf = encode(enc, doc);
+
+  node n("old contents");
+  load_mem(buf.data(), buf.size(), dec, &n);
+  ELLIS_ASSERT(n == doc);
+
+  /* Chunked, with the result only delivered at the end. */
+  node m(type::NIL);
+  dec.reset();
+  for (size_t i = 0; i < buf.size(); i++) {
+    size_t count = 1;
+    progress st = dec.consume_buffer_into(buf.data() + i, &count, &m);
+    ELLIS_ASSERT_EQ(count, 0);
+    const bool last = (i == buf.size() - 1);
+    ELLIS_ASSERT(st.state() ==
+        (last ? stream_state::SUCCESS : stream_state::CONTINUE));
+    ELLIS_ASSERT(last ? m == doc : m.get_type() == type::NIL);
+  }
+
+  /* Failures leave the node alone. */
+  bool threw = false;
+  try {
+    load_mem(buf.data(), buf.size() - 1, dec, &m);
+  } catch (const err &e) {
+    ELLIS_ASSERT_NEQ(e.msg().find("truncated"), string::npos);
+    threw = true;
+  }
+  ELLIS_ASSERT(threw);
+  ELLIS_ASSERT(m == doc);
+}
+
+void check_reuse(msgpack_decoder &dec, msgpack_encoder &enc)
+{
+  auto make = [](int64_t id, const string &name, size_t count) {
+    node xs(type::ARRAY);
+    for (size_t i = 0; i < count; i++) {
+      xs.as_mutable_array().append(name + " element");
+    }
+    node doc(type::MAP);
+    doc.as_mutable_map().insert("id", id);
+    doc.as_mutable_map().insert("name", name);
+    doc.as_mutable_map().insert("xs", xs);
+    doc.as_mutable_map().insert("none", node(type::NIL));
+    return doc;
+  };
+  auto into = [&](const node &doc, node *n) {
+    const vector<byte> buf = encode(enc, doc);
+    load_mem(buf.data(), buf.size(), dec, n);
+    ELLIS_ASSERT(*n == doc);
+  };
+
+  /* The decoder builds each document in the one before last, so every
+   * other one lands in the same storage. */
+  node n(type::NIL);
+  into(make(1, "first name, too long to be kept inline", 3), &n);
+  const char *name = n.as_map()["name"].as_u8str().c_str();
+  const node *x0 = &n.as_map()["xs"].as_array()[0];
+  into(make(2, "other name, too long to be kept inline", 3), &n);
+  into(make(3, "third name, too long to be kept inline", 3), &n);
+  ELLIS_ASSERT(n.as_map()["name"].as_u8str().c_str() == name);
+  ELLIS_ASSERT(&n.as_map()["xs"].as_array()[0] == x0);
+
+  /* Copies of earlier results are left alone. */
+  const node keep = n;
+  const node keep_copy = make(3, "third name, too long to be kept inline", 3);
+  into(make(4, "b", 5), &n);
+  into(make(5, "c", 1), &n);
+  into(make(6, "d", 0), &n);
+  ELLIS_ASSERT(keep == keep_copy);
+
+  /* Other shapes: keys come and go, and types change. */
+  node other(type::MAP);
+  other.as_mutable_map().insert("id", "seven");
+  other.as_mutable_map().insert("extra", node({ node(1), node(2) }));
+  into(other, &n);
+  into(other, &n);
+  into(make(7, "e", 2), &n);
+  into(node({ node(1), node("two") }), &n);
+  into(make(8, "f", 2), &n);
+  into(make(9, "g", 2), &n);
+
+  /* The first of repeated keys wins, as when building from scratch. */
+  const byte dup[] = { 0x84,
+    0xa2, 'i', 'd', 0x01,
+    0xa2, 'i', 'd', 0x02,
+    0xa4, 'n', 'a', 'm', 'e', 0xa1, 'h',
+    0xa2, 'x', 's', 0x90 };
+  node expect(type::MAP);
+  expect.as_mutable_map().insert("id", 1);
+  expect.as_mutable_map().insert("name", "h");
+  expect.as_mutable_map().insert("xs", node(type::ARRAY));
+  load_mem(dup, sizeof(dup), dec, &n);
+  ELLIS_ASSERT(n == expect);
+  ELLIS_ASSERT(*load_mem(dup, sizeof(dup), dec) == expect);
+}
+
+/** A streambuf that takes only the first limit bytes written to it. */
+class short_buf : public std::streambuf {
+  size_t m_left;
+
+protected:
+  std::streamsize xsputn(const char *s, std::streamsize n) override
+  {
+    (void)s;
+    const std::streamsize took = std::min<std::streamsize>(n, m_left);
+    m_left -= took;
+    return took;
+  }
+
+  int_type overflow(int_type c) override
+  {
+    if (m_left == 0 || traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::eof();
+    }
+    m_left--;
+    return c;
+  }
+
+public:
+  explicit short_buf(size_t limit) : m_left(limit) {}
+};
+
+/* Large bodies are handed to the stream by reference; the output must be
+ * the same as when they are copied. */
+void check_dump_refs(msgpack_decoder &dec, msgpack_encoder &enc)
+{
+  node n(type::ARRAY);
+  auto &a = n.as_mutable_array();
+  for (size_t len : { 10, 40000, 100, 50000, 33000 }) {
+    node blob(type::BINARY);
+    blob.as_mutable_binary().resize(len);
+    memset(blob.as_mutable_binary().data(), (int)(len & 0xff), len);
+    a.append(blob);
+    a.append(string(len, 'a' + len % 26));
+  }
+  const vector<byte> want = encode(enc, n);
+
+  /* Through writev. */
+  char tempfile[] = "/tmp/mytestXXXXXX";
+  int tmpfd = mkstemp(tempfile);
+  ELLIS_ASSERT_GTE(tmpfd, 0);
+  close(tmpfd);
+  dump(&n, file_output_stream(tempfile), enc);
+  std::ifstream ifs(tempfile);
+  std::string got((std::istreambuf_iterator<char>(ifs)),
+      std::istreambuf_iterator<char>());
+  unlink(tempfile);
+  ELLIS_ASSERT_EQ(got.size(), want.size());
+  ELLIS_ASSERT_MEM_EQ((const byte *)got.data(), want.data(), want.size());
+
+  /* Straight to an ostream. */
+  std::ostringstream ss;
+  dump(&n, cpp_output_stream(ss), enc);
+  ELLIS_ASSERT_TRUE(ss.str() == got);
+
+  /* A failing ostream is an error, whether it fails on the buffer or on a
+   * body written in place. */
+  for (size_t limit : { (size_t)0, (size_t)10, want.size() / 2,
+        want.size() - 1 })
+  {
+    short_buf sb(limit);
+    std::ostream os(&sb);
+    bool threw = false;
+    try {
+      dump(&n, cpp_output_stream(os), enc);
+    } catch (const err &e) {
+      threw = true;
+      ELLIS_ASSERT(e.code() == err_code::IO);
+    }
+    ELLIS_ASSERT_TRUE(threw);
+  }
+
+  /* An offer that is not taken is copied by the next fill_buffer. */
+  enc.reset(&n);
+  enc.set_ref_min(1000);
+  vector<byte> copied;
+  byte piece[5000];
+  while (true) {
+    size_t count = sizeof(piece);
+    auto st = enc.fill_buffer(piece, &count);
+    copied.insert(copied.end(), piece, piece + count);
+    if (st.state() != stream_state::CONTINUE) {
+      break;
+    }
+  }
+  ELLIS_ASSERT_TRUE(copied == want);
+
+  /* And the result still decodes. */
+  auto back = load_mem(got.data(), got.size(), dec);
+  ELLIS_ASSERT_TRUE(*back == n);
+}
+
+/* encoded_size must match the output exactly, for every kind of header. */
+void check_encoded_size(msgpack_encoder &enc)
+{
+  auto check = [&enc](const node &n) {
+    size_t size = 0;
+    ELLIS_ASSERT_TRUE(enc.encoded_size(n, &size));
+    std::ostringstream ss;
+    dump(&n, cpp_output_stream(ss), enc);
+    ELLIS_ASSERT_EQ(size, ss.str().size());
+  };
+
+  node all(type::ARRAY);
+  auto &a = all.as_mutable_array();
+  a.append(node(type::NIL));
+  a.append(true);
+  a.append(0.5);
+  for (int64_t edge : { 0LL, 127LL, 255LL, 65535LL, 4294967295LL,
+        -32LL, -128LL, -32768LL, -2147483648LL })
+  {
+    for (int64_t i : { edge - 1, edge, edge + 1 }) {
+      a.append(i);
+    }
+  }
+  a.append(INT64_MAX);
+  a.append(INT64_MIN);
+  for (size_t len : { 0, 15, 16, 31, 32, 255, 256, 65535, 65536 }) {
+    a.append(string(len, 'x'));
+    node blob(type::BINARY);
+    blob.as_mutable_binary().resize(len);
+    a.append(blob);
+    node arr(type::ARRAY);
+    node map(type::MAP);
+    for (size_t i = 0; i < len && i < 70; i++) {
+      arr.as_mutable_array().append((int64_t)i);
+      map.as_mutable_map().insert(string(i, 'k'), (int64_t)i);
+    }
+    a.append(arr);
+    a.append(map);
+  }
+  node big(type::ARRAY);
+  for (int i = 0; i < 70000; i++) {
+    big.as_mutable_array().append(node(type::NIL));
+  }
+  a.append(big);
+  for (size_t i = 0; i < a.length(); i++) {
+    check(a[i]);
+  }
+  check(all);
+
+  /* Asking does not disturb an encoding in progress. */
+  std::ostringstream ss;
+  dump(&all, cpp_output_stream(ss), enc);
+  const string dumped = ss.str();
+  const vector<byte> want(dumped.begin(), dumped.end());
+  vector<byte> got(want.size());
+  enc.reset(&all);
+  size_t count = 10;
+  enc.fill_buffer(got.data(), &count);
+  size_t size = 0;
+  enc.encoded_size(a[3], &size);
+  count = got.size() - 10;
+  auto st = enc.fill_buffer(got.data() + 10, &count);
+  ELLIS_ASSERT_EQ(st.state(), stream_state::SUCCESS);
+  ELLIS_ASSERT_TRUE(got == want);
+
+  /* Sizing a buffer for dump_mem, which adds a NUL. */
+  ELLIS_ASSERT_TRUE(enc.encoded_size(all, &size));
+  vector<byte> buf(size + 1);
+  dump_mem(&all, buf.data(), buf.size(), enc);
+  ELLIS_ASSERT_EQ(buf.back(), 0);
+  buf.pop_back();
+  ELLIS_ASSERT_TRUE(buf == want);
+  bool threw = false;
+  try {
+    dump_mem(&all, buf.data(), buf.size(), enc);
+  } catch (const err &e) {
+    threw = true;
+    ELLIS_ASSERT(e.code() == err_code::IO);
+  }
+  ELLIS_ASSERT_TRUE(threw);
+}
+
 int main() {
   msgpack_decoder dec;
   msgpack_encoder enc;
@@ -290,5 +880,15 @@ int main() {
     ser_deser(dec, enc, n);
   }
 
+  check_boundaries(dec, enc);
+  check_projection(dec, enc);
+  check_element_stream(dec, enc);
+  check_slices(dec, enc);
+  check_empty_binary(dec, enc);
+  check_load_into(dec, enc);
+  check_reuse(dec, enc);
+  check_dump_refs(dec, enc);
+  check_encoded_size(enc);
+
   return 0;
 }
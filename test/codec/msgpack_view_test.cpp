@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#undef NDEBUG
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/codec/msgpack_view.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/binary_node.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/core/u8str_node.hpp>
+#include <ellis_private/using.hpp>
+#include <cstring>
+#include <functional>
+
+using namespace ellis;
+
+
+static vector<byte> encode(const node &n)
+{
+  msgpack_encoder enc;
+  vector<byte> out(1 << 16);
+  size_t count = out.size();
+  enc.reset(&n);
+  enc.fill_buffer(out.data(), &count);
+  out.resize(count);
+  return out;
+}
+
+
+/* Checks that the view agrees with the eagerly decoded node throughout. */
+static void compare(const msgpack_view &v, const node &n)
+{
+  ELLIS_ASSERT_EQ(v.get_type(), n.get_type());
+  switch (n.get_type()) {
+    case type::NIL:
+      break;
+    case type::BOOL:
+      ELLIS_ASSERT_EQ(v.as_bool(), n.as_bool());
+      break;
+    case type::INT64:
+      ELLIS_ASSERT_EQ(v.as_int64(), n.as_int64());
+      break;
+    case type::DOUBLE:
+      ELLIS_ASSERT_EQ(v.as_double(), n.as_double());
+      break;
+    case type::U8STR:
+      ELLIS_ASSERT_EQ(v.as_u8str(), string(n.as_u8str().c_str()));
+      break;
+    case type::ARRAY:
+      ELLIS_ASSERT_EQ(v.length(), n.as_array().length());
+      for (size_t i = 0; i < v.length(); i++) {
+        compare(v[i], n.as_array()[i]);
+      }
+      break;
+    case type::MAP:
+      ELLIS_ASSERT_EQ(v.length(), n.as_map().length());
+      for (const auto &k : v.keys()) {
+        ELLIS_ASSERT(n.as_map().has_key(k));
+        compare(v[k], n.as_map()[k]);
+      }
+      break;
+    case type::BINARY:
+      ELLIS_ASSERT_EQ(v.data_length(), n.as_binary().length());
+      ELLIS_ASSERT_EQ(memcmp(v.data(), n.as_binary().data(), v.data_length()),
+          0);
+      break;
+  }
+  ELLIS_ASSERT(*v.to_node() == n);
+}
+
+
+static void check_same(const node &n)
+{
+  const vector<byte> buf = encode(n);
+  msgpack_view v(buf.data(), buf.size());
+  compare(v, n);
+  ELLIS_ASSERT_EQ(v.raw_length(), buf.size());
+}
+
+
+static void expect_code(std::function<void()> fn, err_code code)
+{
+  bool threw = false;
+  try {
+    fn();
+  } catch (const err &e) {
+    ELLIS_ASSERT(e.code() == code);
+    threw = true;
+  }
+  ELLIS_ASSERT(threw);
+}
+
+
+int main()
+{
+  check_same(node(type::NIL));
+  check_same(node(true));
+  check_same(node(false));
+  for (int64_t i : { 0L, 5L, 127L, 128L, 255L, 256L, 65535L, 65536L,
+      4294967295L, 4294967296L, -1L, -32L, -33L, -128L, -129L, -32768L,
+      -32769L, -2147483648L, -2147483649L }) {
+    check_same(node(i));
+  }
+  check_same(node(2.5));
+  check_same(node("plain"));
+  check_same(node(string(300, 's')));
+  const byte blob[] = { 0, 1, 2, 0xff };
+  check_same(node(blob, sizeof(blob)));
+  check_same(node(type::ARRAY));
+  check_same(node(type::MAP));
+
+  /* Containers big enough for the 16 bit length forms. */
+  node big(type::ARRAY);
+  node wide(type::MAP);
+  for (int i = 0; i < 40; i++) {
+    big.as_mutable_array().append(i * 1000);
+    wide.as_mutable_map().insert("k" + std::to_string(i), i);
+  }
+  check_same(big);
+  check_same(wide);
+
+  node user(type::MAP);
+  user.as_mutable_map().insert("name", "ann");
+  node tags(type::ARRAY);
+  tags.as_mutable_array().append("x");
+  tags.as_mutable_array().append("y");
+  user.as_mutable_map().insert("tags", tags);
+  node items(type::ARRAY);
+  for (int i = 1; i <= 3; i++) {
+    node it(type::MAP);
+    it.as_mutable_map().insert("v", i);
+    items.as_mutable_array().append(it);
+  }
+  node doc(type::MAP);
+  doc.as_mutable_map().insert("id", 42);
+  doc.as_mutable_map().insert("user", user);
+  doc.as_mutable_map().insert("items", items);
+  doc.as_mutable_map().insert("ratio", 0.75);
+  check_same(doc);
+
+  const vector<byte> buf = encode(doc);
+  msgpack_view root(buf.data(), buf.size());
+  ELLIS_ASSERT_EQ(root["id"].as_int64(), 42);
+  ELLIS_ASSERT_EQ(root.at("{user}{name}").as_u8str(), "ann");
+  ELLIS_ASSERT_EQ(root.at("{user}{tags}[1]").as_u8str(), "y");
+  ELLIS_ASSERT_EQ(root.at("{items}[2]{v}").as_int64(), 3);
+  ELLIS_ASSERT_EQ(root["ratio"].as_double(), 0.75);
+  ELLIS_ASSERT(root.at("").raw_bytes() == buf.data());
+  ELLIS_ASSERT(root.has_key("user"));
+  ELLIS_ASSERT(! root.has_key("nope"));
+
+  /* A subtree's bytes are its encoding, ready to forward. */
+  const auto u = root["user"];
+  const vector<byte> ubuf = encode(user);
+  ELLIS_ASSERT_EQ(u.raw_length(), ubuf.size());
+  ELLIS_ASSERT_EQ(memcmp(u.raw_bytes(), ubuf.data(), ubuf.size()), 0);
+  ELLIS_ASSERT(u.raw_bytes() > buf.data());
+  ELLIS_ASSERT(u.raw_bytes() + u.raw_length() <= buf.data() + buf.size());
+
+  /* Errors. */
+  expect_code([&]() { root["nope"]; }, err_code::NO_SUCH);
+  expect_code([&]() { root["id"].as_u8str(); }, err_code::TYPE_MISMATCH);
+  expect_code([&]() { root["id"].data(); }, err_code::TYPE_MISMATCH);
+  expect_code([&]() { root["items"][3]; }, err_code::INVALID_ARGS);
+  expect_code([&]() { root.at("{items}[7]"); }, err_code::PATH_FAIL);
+  expect_code([&]() { root.at("{id}{x}"); }, err_code::PATH_FAIL);
+  expect_code([&]() { msgpack_view(buf.data(), 0); },
+      err_code::PARSE_FAIL);
+
+  /* Truncation is noticed only by accesses that reach it. */
+  msgpack_view cut(buf.data(), buf.size() - 1);
+  ELLIS_ASSERT_EQ(cut.length(), 4UL);
+  expect_code([&]() { cut.raw_length(); }, err_code::PARSE_FAIL);
+  expect_code([&]() { cut.keys(); }, err_code::PARSE_FAIL);
+  const byte str_cut[] = { 0xa5, 'a', 'b' };
+  expect_code([&]() { msgpack_view(str_cut, sizeof(str_cut)).as_u8str(); },
+      err_code::PARSE_FAIL);
+  const byte arr_cut[] = { 0x93, 0x01 };
+  expect_code([&]() { msgpack_view(arr_cut, sizeof(arr_cut))[2]; },
+      err_code::PARSE_FAIL);
+
+  /* As with the decoder, non-string keys and ext types are not handled. */
+  const byte int_key[] = { 0x81, 0x01, 0x02 };
+  expect_code([&]() { msgpack_view(int_key, sizeof(int_key))["a"]; },
+      err_code::TRANSLATE_FAIL);
+  const byte ext[] = { 0xd4, 0x01, 0x02 };
+  expect_code([&]() { msgpack_view(ext, sizeof(ext)).get_type(); },
+      err_code::TRANSLATE_FAIL);
+  return 0;
+}
@@ -28,6 +28,7 @@
 #include <ellis/core/array_node.hpp>
 #include <ellis/core/binary_node.hpp>
 #include <ellis/core/defs.hpp>
+#include <ellis/core/disposition.hpp>
 #include <ellis/core/err.hpp>
 #include <ellis/core/map_node.hpp>
 #include <ellis/core/node.hpp>
@@ -507,6 +508,50 @@ static void binarytest()
   zchk(b4, big - 1);
 }
 
+static void slicetest()
+{
+  using namespace ellis;
+  const size_t sdlen = sizeof(k_somedata);
+  auto owner = std::make_shared<std::vector<byte>>(
+      k_somedata, k_somedata + sdlen);
+  const byte *mem = owner->data();
+
+  /* The node refers to the owner's bytes in place, and keeps them alive. */
+  node s1(owner, mem, sdlen);
+  ELLIS_ASSERT_EQ(owner.use_count(), 2);
+  ELLIS_ASSERT(s1.as_binary().is_slice());
+  ELLIS_ASSERT_EQ(s1.as_binary().data(), mem);
+  ELLIS_ASSERT_EQ(s1.as_binary().length(), sdlen);
+  ELLIS_ASSERT_EQ(s1.as_binary()[1], 0x81);
+  ELLIS_ASSERT_EQ(s1, node(k_somedata, sdlen));
+
+  /* Copies share the slice; a deep copy holds its own bytes. */
+  node s2(s1);
+  ELLIS_ASSERT_EQ(s2.as_binary().data(), mem);
+  node s3(type::NIL);
+  s3.deep_copy(s1);
+  ELLIS_ASSERT_FALSE(s3.as_binary().is_slice());
+  ELLIS_ASSERT_EQ(s3, s1);
+
+  /* Writing to a shared slice copies it, leaving the owner's bytes alone. */
+  s2.as_mutable_binary()[0] = 0x55;
+  ELLIS_ASSERT_FALSE(s2.as_binary().is_slice());
+  ELLIS_ASSERT_EQ((*owner)[0], k_somedata[0]);
+  ELLIS_ASSERT_EQ(s1.as_binary().data(), mem);
+
+  /* As does writing to an unshared one, which then lets go of the owner. */
+  s1.as_mutable_binary().append(k_somedata, 1);
+  ELLIS_ASSERT_FALSE(s1.as_binary().is_slice());
+  ELLIS_ASSERT_EQ(s1.as_binary().length(), sdlen + 1);
+  ELLIS_ASSERT_EQ(owner.use_count(), 1);
+
+  {
+    node s4(owner, mem + 1, 2);
+    ELLIS_ASSERT_EQ(owner.use_count(), 2);
+  }
+  ELLIS_ASSERT_EQ(owner.use_count(), 1);
+}
+
 static void maptest()
 {
   using namespace ellis;
@@ -518,6 +563,9 @@ static void maptest()
   en.as_mutable_map().insert("foo", 72);  // no effect here
   ELLIS_ASSERT_EQ(en.as_map()["foo"], 4);
   ELLIS_ASSERT_EQ(en.as_map().length(), 1);
+  ELLIS_ASSERT_EQ(*en.as_map().find("foo"), 4);
+  ELLIS_ASSERT(en.as_map().find("nope") == nullptr);
+  ELLIS_ASSERT_FALSE(en.as_map().has_key("nope"));
 
   node bar(type::MAP);
   en.as_mutable_map().set("bar", bar);
@@ -682,6 +730,33 @@ static void pathtest()
   ELLIS_ASSERT_EQ(r.at("{w}{x}{y}{z}[10]{hey}"), 32.0);
 }
 
+/* Reassigning a disposition must release what it held before. */
+static void dispositiontest()
+{
+  using namespace ellis;
+  using ptr_progress =
+    disposition<stream_state, std::shared_ptr<int>, std::unique_ptr<err>>;
+  auto first = std::make_shared<int>(1);
+  auto second = std::make_shared<int>(2);
+  ptr_progress st{std::shared_ptr<int>(first)};
+  ELLIS_ASSERT_EQ(first.use_count(), 2);
+  st = ptr_progress(std::shared_ptr<int>(second));
+  ELLIS_ASSERT_EQ(first.use_count(), 1);
+  ELLIS_ASSERT_EQ(second.use_count(), 2);
+
+  /* The same, replacing a value with an error, and moving out. */
+  st = ptr_progress(MAKE_UNIQUE_ELLIS_ERR(IO, "oops"));
+  ELLIS_ASSERT_EQ(second.use_count(), 1);
+  ptr_progress st2(std::move(st));
+  ELLIS_ASSERT(st.state() == stream_state::CONTINUE);
+  ELLIS_ASSERT(st2.state() == stream_state::ERROR);
+  ELLIS_ASSERT(st2.extract_error()->code() == err_code::IO);
+  st = ptr_progress(std::shared_ptr<int>(first));
+  st2 = std::move(st);
+  ELLIS_ASSERT_EQ(first.use_count(), 2);
+  ELLIS_ASSERT(*st2.extract_value() == 1);
+}
+
 int main()
 {
   logtest();
@@ -691,9 +766,11 @@ int main()
   strtest();
   arraytest();
   binarytest();
+  slicetest();
   maptest();
   pathtest();
   u8strdeepcopytest();
+  dispositiontest();
   printf("all tests completed.\n");
   return 0;
 }
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#undef NDEBUG
+#include <ellis/codec/json.hpp>
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/binary_node.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/stream/async_fd_stream.hpp>
+#include <ellis/stream/epoll_reactor.hpp>
+#include <ellis_private/using.hpp>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace ellis;
+
+
+/** One transfer of a node across a socketpair, with everything it needs. */
+struct transfer {
+  int fds[2];
+  node sent{type::NIL};
+  unique_ptr<async_fd_stream> writer;
+  unique_ptr<async_fd_stream> reader;
+  unique_ptr<encoder> enc;
+  unique_ptr<decoder> dec;
+  bool dumped = false;
+  unique_ptr<node> received;
+};
+
+
+/** Something different for each i, and now and then too big for the socket
+ * buffers, so that writes have to wait for the reader. */
+static node make_doc(size_t i)
+{
+  node n(type::MAP);
+  auto &m = n.as_mutable_map();
+  m.insert("id", (int64_t)i);
+  m.insert("name", "session " + std::to_string(i));
+  node items(type::ARRAY);
+  for (size_t j = 0; j < i % 50; j++) {
+    items.as_mutable_array().append((int64_t)(i * j));
+  }
+  m.insert("items", items);
+  node blob(type::BINARY);
+  blob.as_mutable_binary().resize((i % 100 == 0) ? 1000000 : i % 3000);
+  m.insert("blob", blob);
+  return n;
+}
+
+
+/** How many socketpairs we can have open at once, up to want. */
+static size_t fd_budget(size_t want)
+{
+  struct rlimit rl;
+  ELLIS_ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &rl), 0);
+  if (rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    getrlimit(RLIMIT_NOFILE, &rl);
+  }
+  return std::min(want, (size_t)(rl.rlim_cur - 64) / 2);
+}
+
+
+/* Many loads and dumps at once, over socketpairs, all in one thread. */
+void check_many(bool json)
+{
+  const size_t count = fd_budget(2000);
+  ELLIS_ASSERT_GT(count, 100);
+  vector<transfer> xfers(count);
+  epoll_reactor reactor;
+  for (size_t i = 0; i < count; i++) {
+    transfer &x = xfers[i];
+    ELLIS_ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, x.fds), 0);
+    x.sent = make_doc(i);
+    /* Small buffers, since there are so many of them. */
+    x.writer.reset(new async_fd_stream(x.fds[0]));
+    x.reader.reset(new async_fd_stream(x.fds[1]));
+    if (json) {
+      x.enc.reset(new json_encoder());
+      x.dec.reset(new json_decoder());
+    }
+    else {
+      x.enc.reset(new msgpack_encoder());
+      x.dec.reset(new msgpack_decoder());
+    }
+    reactor.load(x.reader.get(), x.dec.get(), [&x](node_progress res) {
+        ELLIS_ASSERT_EQ(res.state(), stream_state::SUCCESS);
+        x.received = res.extract_value();
+      });
+    reactor.dump(&x.sent, x.writer.get(), x.enc.get(), [&x](progress res) {
+        ELLIS_ASSERT_EQ(res.state(), stream_state::SUCCESS);
+        x.dumped = true;
+        /* JSON documents are only known to be done at end of file. */
+        shutdown(x.fds[0], SHUT_WR);
+      });
+  }
+  ELLIS_ASSERT_EQ(reactor.pending(), 2 * count);
+  reactor.run();
+  ELLIS_ASSERT_EQ(reactor.pending(), 0u);
+
+  for (auto &x : xfers) {
+    ELLIS_ASSERT_TRUE(x.dumped);
+    ELLIS_ASSERT_NOT_NULL(x.received.get());
+    ELLIS_ASSERT_TRUE(*x.received == x.sent);
+    close(x.fds[0]);
+    close(x.fds[1]);
+  }
+}
+
+
+/* Requests and replies back and forth over the same sockets, with new
+ * sessions started from the done functions. */
+void check_ping_pong()
+{
+  const size_t count = 100;
+  const int rounds = 10;
+  struct peer {
+    int fds[2];
+    unique_ptr<async_fd_stream> client;
+    unique_ptr<async_fd_stream> server;
+    msgpack_encoder client_enc;
+    msgpack_encoder server_enc;
+    msgpack_decoder client_dec;
+    msgpack_decoder server_dec;
+    node request{type::NIL};
+    node reply{type::NIL};
+    int round = 0;
+  };
+  vector<peer> peers(count);
+  epoll_reactor reactor;
+  std::function<void(peer &)> start_round;
+  start_round = [&](peer &p) {
+    p.request = (int64_t)p.round;
+    reactor.dump(&p.request, p.client.get(), &p.client_enc,
+        [](progress res) {
+          ELLIS_ASSERT_EQ(res.state(), stream_state::SUCCESS);
+        });
+    reactor.load(p.server.get(), &p.server_dec, [&](node_progress req) {
+        ELLIS_ASSERT_EQ(req.state(), stream_state::SUCCESS);
+        p.reply = req.extract_value()->as_int64() * 2;
+        reactor.dump(&p.reply, p.server.get(), &p.server_enc,
+            [](progress res) {
+              ELLIS_ASSERT_EQ(res.state(), stream_state::SUCCESS);
+            });
+        reactor.load(p.client.get(), &p.client_dec, [&](node_progress rep) {
+            ELLIS_ASSERT_EQ(rep.state(), stream_state::SUCCESS);
+            ELLIS_ASSERT_EQ(rep.extract_value()->as_int64(), p.round * 2);
+            if (++p.round < rounds) {
+              start_round(p);
+            }
+          });
+      });
+  };
+  for (auto &p : peers) {
+    ELLIS_ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, p.fds), 0);
+    p.client.reset(new async_fd_stream(p.fds[0], 4096, 4096));
+    p.server.reset(new async_fd_stream(p.fds[1], 4096, 4096));
+    start_round(p);
+  }
+  reactor.run();
+  for (auto &p : peers) {
+    ELLIS_ASSERT_EQ(p.round, rounds);
+    close(p.fds[0]);
+    close(p.fds[1]);
+  }
+}
+
+
+/* Errors reach the done functions. */
+void check_errors()
+{
+  epoll_reactor reactor;
+  int fds[2];
+  ELLIS_ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  async_fd_stream reader(fds[1]);
+  async_fd_stream writer(fds[0]);
+  msgpack_decoder dec;
+
+  /* The writer goes away part way through a value. */
+  const byte partial[] = { 0x92, 0x01 };
+  ELLIS_ASSERT_EQ(write(fds[0], partial, sizeof(partial)), 2);
+  shutdown(fds[0], SHUT_WR);
+  bool failed = false;
+  reactor.load(&reader, &dec, [&](node_progress res) {
+      failed = (res.state() == stream_state::ERROR);
+    });
+  bool threw = false;
+  try {
+    reactor.load(&reader, &dec, [](node_progress) {});
+  } catch (const err &e) {
+    threw = (e.code() == err_code::INVALID_ARGS);
+  }
+  ELLIS_ASSERT_TRUE(threw);
+  reactor.run();
+  ELLIS_ASSERT_TRUE(failed);
+
+  /* The reader goes away. */
+  close(fds[1]);
+  node big(type::BINARY);
+  big.as_mutable_binary().resize(10000000);
+  msgpack_encoder enc;
+  failed = false;
+  reactor.dump(&big, &writer, &enc, [&](progress res) {
+      failed = (res.state() == stream_state::ERROR);
+    });
+  reactor.run();
+  ELLIS_ASSERT_TRUE(failed);
+  close(fds[0]);
+}
+
+
+int main()
+{
+  check_many(false);
+  check_many(true);
+  check_ping_pong();
+  check_errors();
+  return 0;
+}
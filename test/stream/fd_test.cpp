@@ -30,14 +30,18 @@
 #include <sstream>
 #include <unistd.h>
 
-void round_trip_test(const char *mem, size_t len)
+void round_trip_test(
+    const char *mem,
+    size_t len,
+    size_t bufsize = ellis::stream_buffer::k_default_size,
+    size_t max_bufsize = ellis::stream_buffer::k_default_max)
 {
   using namespace ellis;
   int fd[2];
   ELLIS_ASSERT_EQ(pipe(fd), 0);
 
   /* Write to pipe. */
-  fd_output_stream fdos(fd[1]);
+  fd_output_stream fdos(fd[1], bufsize, max_bufsize);
   const char *mem_end = mem + len;
   for (const char *p = mem; p < mem_end; ) {
     byte *buf;
@@ -52,7 +56,7 @@ void round_trip_test(const char *mem, size_t len)
   close(fd[1]);
 
   /* Read from pipe. */
-  fd_input_stream fdis(fd[0]);
+  fd_input_stream fdis(fd[0], bufsize, max_bufsize);
   std::ostringstream got;
   while (1) {
     byte *buf;
@@ -76,6 +80,38 @@ void round_trip_test(const char *mem)
   round_trip_test(mem, strlen(mem));
 }
 
+void check_growth()
+{
+  using namespace ellis;
+  int fd[2];
+  ELLIS_ASSERT_EQ(pipe(fd), 0);
+  char mem[1000];
+  memset(mem, 'x', sizeof(mem));
+  ELLIS_ASSERT_EQ(write(fd[1], mem, sizeof(mem)), (ssize_t)sizeof(mem));
+  close(fd[1]);
+
+  /* Each read fills the buffer, so it doubles until it reaches the max. */
+  fd_input_stream fdis(fd[0], 16, 64);
+  const size_t expect[] = { 16, 32, 64, 64 };
+  for (size_t want : expect) {
+    const byte *buf;
+    size_t avail;
+    ELLIS_ASSERT_TRUE(fdis.next_input_buf(&buf, &avail));
+    ELLIS_ASSERT_EQ(avail, want);
+  }
+  close(fd[0]);
+
+  /* Likewise for writes; a short one stops the growth. */
+  stream_buffer sb(16, 64);
+  ELLIS_ASSERT_EQ(sb.size(), 16u);
+  sb.filled(16);
+  sb.fresh();
+  ELLIS_ASSERT_EQ(sb.size(), 32u);
+  sb.filled(10);
+  sb.fresh();
+  ELLIS_ASSERT_EQ(sb.size(), 32u);
+}
+
 int main() {
   using namespace ellis;
   round_trip_test("");
@@ -91,5 +127,8 @@ int main() {
   round_trip_test(buf, 4096);
   round_trip_test(buf, 4097);
   round_trip_test(buf, 20000);
+  round_trip_test(buf, 20000, 16, 16);
+  round_trip_test(buf, 20000, 16, 1024);
+  check_growth();
   return 0;
 }
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#undef NDEBUG
+#include <ellis/codec/json.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/stream/file_input_stream.hpp>
+#include <ellis/stream/file_output_stream.hpp>
+#include <ellis/stream/mmap_input_stream.hpp>
+#include <ellis_private/using.hpp>
+#include <functional>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static string write_temp(const char *mem, size_t len)
+{
+  using namespace ellis;
+  char tempfile[] = "/tmp/mytestXXXXXX";
+  int tmpfd = mkstemp(tempfile);
+  ELLIS_ASSERT_GTE(tmpfd, 0);
+  close(tmpfd);
+
+  file_output_stream fos(tempfile);
+  const char *mem_end = mem + len;
+  for (const char *p = mem; p < mem_end; ) {
+    byte *buf;
+    size_t avail;
+    ELLIS_ASSERT_TRUE(fos.next_output_buf(&buf, &avail));
+    ELLIS_ASSERT_GT(avail, 0);
+    size_t how_much = std::min((size_t)(mem_end - p), avail);
+    memcpy(buf, p, how_much);
+    fos.emit(how_much);
+    p += how_much;
+  }
+  return tempfile;
+}
+
+/* Reads the file back through a mapping of the given window size; with a
+ * small window, files larger than a page span several windows. */
+void round_trip_test(const char *mem, size_t len, size_t window)
+{
+  using namespace ellis;
+  string tempfile = write_temp(mem, len);
+
+  mmap_input_stream mis(tempfile.c_str(), window);
+  std::ostringstream got;
+  while (1) {
+    const byte *buf;
+    size_t avail;
+    if (! mis.next_input_buf(&buf, &avail)) {
+      break;
+    }
+    ELLIS_ASSERT_GT(avail, 0);
+    got.write((const char *)buf, avail);
+  }
+  auto e = mis.extract_input_error();
+  ELLIS_ASSERT_NOT_NULL(e.get());
+  ELLIS_ASSERT_NEQ(e->msg().find("end of file"), string::npos);
+
+  string s = got.str();
+  ELLIS_ASSERT_EQ(s.size(), len);
+  ELLIS_ASSERT_MEM_EQ((const byte *)(s.data()), (const byte *)mem, len);
+
+  unlink(tempfile.c_str());
+}
+
+void round_trip_test(const char *mem, size_t len)
+{
+  round_trip_test(mem, len, 1);
+  round_trip_test(mem, len, ellis::mmap_input_stream::k_default_window);
+}
+
+void round_trip_test(const char *mem)
+{
+  round_trip_test(mem, strlen(mem));
+}
+
+void check_put_back(const char *mem, size_t len)
+{
+  using namespace ellis;
+  string tempfile = write_temp(mem, len);
+
+  /* Take a byte at a time, putting the rest back each time. */
+  mmap_input_stream mis(tempfile.c_str(), 1);
+  string got;
+  const byte *buf;
+  size_t avail;
+  while (mis.next_input_buf(&buf, &avail)) {
+    got.push_back((char)buf[0]);
+    mis.put_back(avail - 1);
+  }
+  ELLIS_ASSERT_EQ(got.size(), len);
+  ELLIS_ASSERT_MEM_EQ((const byte *)(got.data()), (const byte *)mem, len);
+
+  unlink(tempfile.c_str());
+}
+
+void check_load_file()
+{
+  using namespace ellis;
+  /* A document long enough to span windows, with strings across the
+   * boundaries. */
+  string doc = "[";
+  for (int i = 0; i < 1000; i++) {
+    doc += (i ? ", " : "");
+    doc += "\"element number " + std::to_string(i) + "\"";
+  }
+  doc += "]";
+  string tempfile = write_temp(doc.data(), doc.size());
+
+  auto n = load(mmap_input_stream(tempfile.c_str(), 1), json_decoder());
+  ELLIS_ASSERT_EQ(n->as_array().length(), 1000u);
+  ELLIS_ASSERT_TRUE(n->as_array()[999] == "element number 999");
+
+  auto n2 = load_file(tempfile.c_str(), json_decoder());
+  ELLIS_ASSERT_TRUE(*n2 == *n);
+
+  unlink(tempfile.c_str());
+}
+
+/* Pseudo-files look regular but can not be mapped; load_file must read
+ * them instead. */
+void check_load_proc_file()
+{
+  using namespace ellis;
+  const char *path = "/proc/sys/kernel/pid_max";
+  if (access(path, R_OK) != 0) {
+    return;
+  }
+  auto want = load(file_input_stream(path), json_decoder());
+  ELLIS_ASSERT_TRUE(want->is_type(type::INT64));
+  ELLIS_ASSERT_GT(want->as_int64(), 0);
+  auto got = load_file(path, json_decoder());
+  ELLIS_ASSERT_TRUE(*got == *want);
+}
+
+void check_errors()
+{
+  using namespace ellis;
+  auto throws = [](std::function<void()> fn, err_code code)
+  {
+    bool threw = false;
+    try {
+      fn();
+    } catch (const err &e) {
+      threw = e.code() == code;
+    }
+    ELLIS_ASSERT_TRUE(threw);
+  };
+  throws([]() { mmap_input_stream("/nonexistent/file"); }, err_code::IO);
+  throws([]() { mmap_input_stream("/dev/null"); }, err_code::INVALID_ARGS);
+}
+
+int main() {
+  using namespace ellis;
+  round_trip_test("");
+  round_trip_test("'");
+  round_trip_test("0");
+  round_trip_test("something\nhere\n");
+  char buf[20000];
+  for (size_t i = 0; i < sizeof(buf); ++i) {
+    buf[i] = 'A' + (i % 13);
+  }
+  round_trip_test(buf, 1000);
+  round_trip_test(buf, 4095);
+  round_trip_test(buf, 4096);
+  round_trip_test(buf, 4097);
+  round_trip_test(buf, 8192);
+  round_trip_test(buf, 20000);
+  check_put_back(buf, 9000);
+  check_load_file();
+  check_load_proc_file();
+  check_errors();
+  return 0;
+}
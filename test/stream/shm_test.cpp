@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#undef NDEBUG
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/emigration.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/stream/shm_input_stream.hpp>
+#include <ellis/stream/shm_output_stream.hpp>
+#include <ellis_private/using.hpp>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace ellis;
+
+
+static string ring_name(const char *what)
+{
+  return "/ellis_shm_test_" + std::to_string(getpid()) + "_" + what;
+}
+
+static vector<char> pattern(size_t len)
+{
+  vector<char> v(len);
+  for (size_t i = 0; i < len; i++) {
+    v[i] = (char)(i * 7 + i / 1000);
+  }
+  return v;
+}
+
+/* Streams len bytes through a ring, the writer emitting at most chunk bytes
+ * at a time, and checks they all arrive in order. */
+void round_trip_test(size_t capacity, shm_wait wait, size_t len,
+    size_t chunk)
+{
+  const string name = ring_name("round_trip");
+  const vector<char> data = pattern(len);
+  unique_ptr<shm_output_stream> out(
+      new shm_output_stream(name.c_str(), capacity, wait));
+  shm_input_stream in(name.c_str(), wait);
+
+  std::thread writer([&]() {
+      for (size_t pos = 0; pos < len; ) {
+        byte *buf;
+        size_t avail;
+        ELLIS_ASSERT_TRUE(out->next_output_buf(&buf, &avail));
+        ELLIS_ASSERT_GT(avail, 0);
+        size_t n = std::min({ avail, chunk, len - pos });
+        memcpy(buf, data.data() + pos, n);
+        ELLIS_ASSERT_TRUE(out->emit(n));
+        pos += n;
+      }
+      out.reset();
+    });
+
+  vector<char> got;
+  const byte *buf;
+  size_t avail;
+  while (in.next_input_buf(&buf, &avail)) {
+    ELLIS_ASSERT_GT(avail, 0);
+    got.insert(got.end(), (const char *)buf, (const char *)buf + avail);
+  }
+  writer.join();
+  auto e = in.extract_input_error();
+  ELLIS_ASSERT_NOT_NULL(e.get());
+  ELLIS_ASSERT_NEQ(e->msg().find("end of file"), string::npos);
+  ELLIS_ASSERT_EQ(got.size(), len);
+  ELLIS_ASSERT_TRUE(got == data);
+}
+
+void check_put_back()
+{
+  const string name = ring_name("put_back");
+  const vector<char> data = pattern(10000);
+  shm_input_stream *in = nullptr;
+  {
+    shm_output_stream out(name.c_str(), 16384);
+    in = new shm_input_stream(name.c_str());
+    byte *buf;
+    size_t avail;
+    for (size_t pos = 0; pos < data.size(); pos += avail) {
+      ELLIS_ASSERT_TRUE(out.next_output_buf(&buf, &avail));
+      avail = std::min(avail, data.size() - pos);
+      memcpy(buf, data.data() + pos, avail);
+      out.emit(avail);
+    }
+  }
+
+  /* Take a byte at a time, putting the rest back each time. */
+  string got;
+  const byte *buf;
+  size_t avail;
+  while (in->next_input_buf(&buf, &avail)) {
+    got.push_back((char)buf[0]);
+    in->put_back(avail - 1);
+  }
+  ELLIS_ASSERT_EQ(got.size(), data.size());
+  ELLIS_ASSERT_MEM_EQ((const byte *)got.data(), (const byte *)data.data(),
+      data.size());
+  delete in;
+}
+
+/* Documents from a child process, decoded one after another from the same
+ * stream. */
+void check_across_processes()
+{
+  const string name = ring_name("processes");
+  const int count = 1000;
+  pid_t pid = fork();
+  ELLIS_ASSERT_GTE(pid, 0);
+  if (pid == 0) {
+    {
+      shm_output_stream out(name.c_str(), 4096);
+      for (int i = 0; i < count; i++) {
+        node doc(type::MAP);
+        doc.as_mutable_map().insert("seq", i);
+        doc.as_mutable_map().insert("text", string(i % 300, 'x'));
+        dump(&doc, out, msgpack_encoder());
+      }
+    }
+    _exit(0);
+  }
+
+  /* The writer creates the ring; wait for it. */
+  unique_ptr<shm_input_stream> in;
+  for (int tries = 0; ! in; tries++) {
+    try {
+      in.reset(new shm_input_stream(name.c_str()));
+    } catch (const err &) {
+      ELLIS_ASSERT_LT(tries, 10000);
+      usleep(1000);
+    }
+  }
+  msgpack_decoder deco;
+  for (int i = 0; i < count; i++) {
+    auto doc = load(*in, deco);
+    ELLIS_ASSERT_TRUE(doc->as_map()["seq"] == i);
+    ELLIS_ASSERT_TRUE(doc->as_map()["text"] == string(i % 300, 'x'));
+  }
+  const byte *buf;
+  size_t avail;
+  ELLIS_ASSERT_FALSE(in->next_input_buf(&buf, &avail));
+
+  int status = 0;
+  ELLIS_ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ELLIS_ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+void check_errors()
+{
+  bool threw = false;
+  try {
+    shm_input_stream in(ring_name("missing").c_str());
+  } catch (const err &e) {
+    threw = e.code() == err_code::IO;
+  }
+  ELLIS_ASSERT_TRUE(threw);
+
+  /* Once the reader has gone, writing fails rather than waiting. */
+  const string name = ring_name("reader_gone");
+  shm_output_stream out(name.c_str(), 4096);
+  {
+    shm_input_stream in(name.c_str());
+  }
+  bool failed = false;
+  for (int i = 0; i < 100 && ! failed; i++) {
+    byte *buf;
+    size_t avail;
+    failed = ! out.next_output_buf(&buf, &avail) || ! out.emit(avail);
+  }
+  ELLIS_ASSERT_TRUE(failed);
+  ELLIS_ASSERT_NOT_NULL(out.extract_output_error().get());
+}
+
+int main() {
+  for (shm_wait wait : { shm_wait::SPIN, shm_wait::FUTEX }) {
+    round_trip_test(4096, wait, 0, 1);
+    round_trip_test(4096, wait, 1, 1);
+    round_trip_test(4096, wait, 100000, 1);
+    round_trip_test(4096, wait, 1000000, 777);
+    round_trip_test(1 << 20, wait, 10000000, 1 << 20);
+  }
+  check_put_back();
+  check_across_processes();
+  check_errors();
+  return 0;
+}
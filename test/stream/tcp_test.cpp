@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#undef NDEBUG
+#include <ellis/codec/json.hpp>
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/binary_node.hpp>
+#include <ellis/core/emigration.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/stream/frame_input_stream.hpp>
+#include <ellis/stream/frame_output_stream.hpp>
+#include <ellis/stream/tcp_client_stream.hpp>
+#include <ellis/stream/tcp_server_stream.hpp>
+#include <ellis_private/using.hpp>
+#include <functional>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace ellis;
+
+
+/** A few documents of different sizes, including blobs large enough to be
+ * written by reference. */
+static vector<node> make_docs()
+{
+  vector<node> docs;
+  docs.push_back(node(7));
+  docs.push_back(node("hello"));
+  for (size_t len : { 10, 5000, 100000, 1500000 }) {
+    node doc(type::MAP);
+    node blob(type::BINARY);
+    blob.as_mutable_binary().resize(len);
+    for (size_t i = 0; i < len; i++) {
+      blob.as_mutable_binary()[i] = (byte)(i * 13);
+    }
+    doc.as_mutable_map().insert("blob", std::move(blob));
+    doc.as_mutable_map().insert("len", (int64_t)len);
+    docs.push_back(std::move(doc));
+  }
+  return docs;
+}
+
+/** Sends back each framed msgpack document received on conn. */
+static void echo(tcp_stream *conn)
+{
+  frame_input_stream in(*conn);
+  frame_output_stream out(*conn);
+  while (in.next_frame()) {
+    auto doc = load(in, msgpack_decoder());
+    dump(doc.get(), out, msgpack_encoder());
+    ELLIS_ASSERT_TRUE(out.end_frame());
+  }
+  auto e = in.extract_input_error();
+  ELLIS_ASSERT_NOT_NULL(e.get());
+  ELLIS_ASSERT_NEQ(e->msg().find("end of file"), string::npos);
+  conn->shutdown_output();
+}
+
+void check_echo(const tcp_options &opts)
+{
+  tcp_server server("127.0.0.1", "0", opts);
+  ELLIS_ASSERT_GT(server.port(), 0);
+  std::thread peer([&]() { echo(server.accept().get()); });
+
+  tcp_stream conn("127.0.0.1", std::to_string(server.port()).c_str(), opts);
+  const vector<node> docs = make_docs();
+  /* Send everything first, so that frames queue up back to back. */
+  {
+    frame_output_stream out(conn);
+    for (const node &doc : docs) {
+      dump(&doc, out, msgpack_encoder());
+      ELLIS_ASSERT_TRUE(out.end_frame());
+    }
+  }
+  conn.shutdown_output();
+
+  frame_input_stream in(conn);
+  size_t got = 0;
+  while (in.next_frame()) {
+    ELLIS_ASSERT_LT(got, docs.size());
+    auto doc = load(in, msgpack_decoder());
+    ELLIS_ASSERT_TRUE(*doc == docs[got]);
+    got++;
+  }
+  ELLIS_ASSERT_EQ(got, docs.size());
+  peer.join();
+}
+
+void check_json_frames()
+{
+  /* A number at top level only ends at the end of input, which the frame
+   * provides; without framing the decoder would wait for more. */
+  tcp_server server("127.0.0.1", "0");
+  std::thread peer([&]() {
+      auto conn = server.accept();
+      frame_output_stream out(*conn);
+      for (int i = 0; i < 3; i++) {
+        node n(i * 100);
+        dump(&n, out, json_encoder());
+        ELLIS_ASSERT_TRUE(out.end_frame());
+      }
+      conn->shutdown_output();
+    });
+
+  tcp_stream conn("localhost", std::to_string(server.port()).c_str());
+  frame_input_stream in(conn);
+  for (int i = 0; i < 3; i++) {
+    ELLIS_ASSERT_TRUE(in.next_frame());
+    auto n = load(in, json_decoder());
+    ELLIS_ASSERT_TRUE(*n == i * 100);
+  }
+  ELLIS_ASSERT_FALSE(in.next_frame());
+  peer.join();
+}
+
+void check_skip_frames()
+{
+  tcp_server server("127.0.0.1", "0");
+  std::thread peer([&]() {
+      auto conn = server.accept();
+      frame_output_stream out(*conn);
+      for (const node &doc : make_docs()) {
+        dump(&doc, out, msgpack_encoder());
+        ELLIS_ASSERT_TRUE(out.end_frame());
+      }
+      conn->shutdown_output();
+    });
+
+  /* Read only a little of each frame but the last, with small buffers so
+   * that chunk headers straddle them. */
+  tcp_options opts;
+  opts.bufsize = 7;
+  opts.max_bufsize = 7;
+  tcp_stream conn("127.0.0.1", std::to_string(server.port()).c_str(), opts);
+  frame_input_stream in(conn);
+  const vector<node> docs = make_docs();
+  for (size_t i = 0; i + 1 < docs.size(); i++) {
+    ELLIS_ASSERT_TRUE(in.next_frame());
+    const byte *buf;
+    size_t avail;
+    ELLIS_ASSERT_TRUE(in.next_input_buf(&buf, &avail));
+    ELLIS_ASSERT_GT(avail, 0);
+  }
+  ELLIS_ASSERT_TRUE(in.next_frame());
+  auto doc = load(in, msgpack_decoder());
+  ELLIS_ASSERT_TRUE(*doc == docs.back());
+  ELLIS_ASSERT_FALSE(in.next_frame());
+  peer.join();
+}
+
+void check_options()
+{
+  tcp_options opts;
+  opts.keepalive = true;
+  opts.sndbuf = 1 << 20;
+  tcp_server server("127.0.0.1", "0", opts);
+  std::thread peer([&]() { server.accept(); });
+  tcp_stream conn("127.0.0.1", std::to_string(server.port()).c_str(), opts);
+  peer.join();
+
+  auto get = [&](int level, int name)
+  {
+    int v = 0;
+    socklen_t len = sizeof(v);
+    ELLIS_ASSERT_EQ(getsockopt(conn.fd(), level, name, &v, &len), 0);
+    return v;
+  };
+  ELLIS_ASSERT_NEQ(get(IPPROTO_TCP, TCP_NODELAY), 0);
+  ELLIS_ASSERT_NEQ(get(SOL_SOCKET, SO_KEEPALIVE), 0);
+  /* The kernel doubles what it is asked for, up to a limit. */
+  ELLIS_ASSERT_GT(get(SOL_SOCKET, SO_SNDBUF), 64 * 1024);
+}
+
+void check_errors()
+{
+  auto throws = [](std::function<void()> fn)
+  {
+    bool threw = false;
+    try {
+      fn();
+    } catch (const err &e) {
+      threw = e.code() == err_code::IO;
+    }
+    ELLIS_ASSERT_TRUE(threw);
+  };
+  string port;
+  {
+    tcp_server server("127.0.0.1", "0");
+    port = std::to_string(server.port());
+  }
+  throws([&]() { tcp_stream("127.0.0.1", port.c_str()); });
+  throws([]() { tcp_stream("no.such.host.invalid", "80"); });
+  throws([]() { tcp_server("127.0.0.1", "no-such-service"); });
+
+  /* Writing to a peer that has gone is an error, not a SIGPIPE. */
+  tcp_server server("127.0.0.1", "0");
+  std::thread peer([&]() { server.accept(); });
+  tcp_stream conn("127.0.0.1", std::to_string(server.port()).c_str());
+  peer.join();
+  bool failed = false;
+  for (int i = 0; i < 10000 && ! failed; i++) {
+    byte *buf;
+    size_t avail;
+    ELLIS_ASSERT_TRUE(conn.next_output_buf(&buf, &avail));
+    memset(buf, 0, avail);
+    failed = ! conn.emit(avail);
+  }
+  ELLIS_ASSERT_TRUE(failed);
+  ELLIS_ASSERT_NOT_NULL(conn.extract_output_error().get());
+}
+
+int main() {
+  check_echo(tcp_options());
+  tcp_options small;
+  small.bufsize = 16;
+  small.max_bufsize = 64;
+  small.nodelay = false;
+  check_echo(small);
+  check_json_frames();
+  check_skip_frames();
+  check_options();
+  check_errors();
+  return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#undef NDEBUG
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/binary_node.hpp>
+#include <ellis/core/emigration.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/stream/uring_file_input_stream.hpp>
+#include <ellis/stream/uring_file_output_stream.hpp>
+#include <ellis_private/stream/uring.hpp>
+#include <ellis_private/using.hpp>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Whether io_uring works here.  Where it does not (an old kernel, or a
+ * kernel or container that forbids it), the streams must fall back to
+ * plain reads and writes, and everything else must still pass. */
+static bool g_have_uring;
+
+static string temp_name()
+{
+  char tempfile[] = "/tmp/mytestXXXXXX";
+  int tmpfd = mkstemp(tempfile);
+  ELLIS_ASSERT_GTE(tmpfd, 0);
+  close(tmpfd);
+  return tempfile;
+}
+
+/* Writes mem to a file, a chunk at a time, through a uring output stream
+ * with the given depth and buffer size. */
+static void write_file(const string &fname, const char *mem, size_t len,
+    size_t depth, size_t bufsize, size_t chunk)
+{
+  using namespace ellis;
+  uring_file_output_stream fos(fname.c_str(), depth, bufsize);
+  ELLIS_ASSERT_EQ(fos.using_uring(), g_have_uring && depth > 0);
+  const char *mem_end = mem + len;
+  for (const char *p = mem; p < mem_end; ) {
+    byte *buf;
+    size_t avail;
+    ELLIS_ASSERT_TRUE(fos.next_output_buf(&buf, &avail));
+    ELLIS_ASSERT_GT(avail, 0);
+    size_t how_much = std::min({(size_t)(mem_end - p), avail, chunk});
+    memcpy(buf, p, how_much);
+    ELLIS_ASSERT_TRUE(fos.emit(how_much));
+    p += how_much;
+  }
+  ELLIS_ASSERT_TRUE(fos.finish());
+  ELLIS_ASSERT_NULL(fos.extract_output_error().get());
+}
+
+void round_trip_test(const char *mem, size_t len, size_t depth,
+    size_t bufsize)
+{
+  using namespace ellis;
+  string tempfile = temp_name();
+  /* Emit short chunks too, so that writes are smaller than buffers. */
+  write_file(tempfile, mem, len, depth, bufsize, bufsize / 2 + 1);
+
+  uring_file_input_stream fis(tempfile.c_str(), depth, bufsize);
+  ELLIS_ASSERT_EQ(fis.using_uring(), g_have_uring && depth > 0 && len > 0);
+  std::ostringstream got;
+  while (1) {
+    const byte *buf;
+    size_t avail;
+    if (! fis.next_input_buf(&buf, &avail)) {
+      break;
+    }
+    ELLIS_ASSERT_GT(avail, 0);
+    got.write((const char *)buf, avail);
+  }
+  auto e = fis.extract_input_error();
+  ELLIS_ASSERT_NOT_NULL(e.get());
+  ELLIS_ASSERT_NEQ(e->msg().find("end of file"), string::npos);
+
+  string s = got.str();
+  ELLIS_ASSERT_EQ(s.size(), len);
+  ELLIS_ASSERT_MEM_EQ((const byte *)(s.data()), (const byte *)mem, len);
+
+  unlink(tempfile.c_str());
+}
+
+void round_trip_test(const char *mem, size_t len)
+{
+  using namespace ellis;
+  round_trip_test(mem, len, 1, 1);
+  round_trip_test(mem, len, 2, 1000);
+  round_trip_test(mem, len, 4, 4096);
+  round_trip_test(mem, len,
+      uring_file_input_stream::k_default_depth,
+      uring_file_input_stream::k_default_bufsize);
+  /* Without io_uring. */
+  round_trip_test(mem, len, 0, 4096);
+}
+
+void check_put_back(const char *mem, size_t len)
+{
+  using namespace ellis;
+  string tempfile = temp_name();
+  write_file(tempfile, mem, len, 3, 1000, 1000);
+
+  /* Take a byte at a time, putting the rest back each time. */
+  uring_file_input_stream fis(tempfile.c_str(), 3, 1000);
+  string got;
+  const byte *buf;
+  size_t avail;
+  while (fis.next_input_buf(&buf, &avail)) {
+    got.push_back((char)buf[0]);
+    fis.put_back(avail - 1);
+  }
+  ELLIS_ASSERT_EQ(got.size(), len);
+  ELLIS_ASSERT_MEM_EQ((const byte *)(got.data()), (const byte *)mem, len);
+
+  unlink(tempfile.c_str());
+}
+
+void check_load_dump()
+{
+  using namespace ellis;
+  node doc(type::ARRAY);
+  for (int i = 0; i < 1000; i++) {
+    node blob(type::BINARY);
+    blob.as_mutable_binary().resize(1000 + i);
+    doc.as_mutable_array().append(std::move(blob));
+    doc.as_mutable_array().append("element number " + std::to_string(i));
+  }
+  string tempfile = temp_name();
+
+  dump(&doc, uring_file_output_stream(tempfile.c_str(), 4, 4096),
+      msgpack_encoder());
+  auto n = load(uring_file_input_stream(tempfile.c_str(), 4, 4096),
+      msgpack_decoder());
+  ELLIS_ASSERT_TRUE(*n == doc);
+
+  unlink(tempfile.c_str());
+}
+
+void check_errors()
+{
+  using namespace ellis;
+  bool threw = false;
+  try {
+    uring_file_input_stream("/nonexistent/file");
+  } catch (const err &e) {
+    threw = e.code() == err_code::IO;
+  }
+  ELLIS_ASSERT_TRUE(threw);
+
+  threw = false;
+  try {
+    uring_file_output_stream("/nonexistent/dir/file");
+  } catch (const err &e) {
+    threw = e.code() == err_code::IO;
+  }
+  ELLIS_ASSERT_TRUE(threw);
+
+  /* Not a regular file, so read as a plain descriptor. */
+  uring_file_input_stream dn("/dev/null");
+  ELLIS_ASSERT_FALSE(dn.using_uring());
+  const byte *buf;
+  size_t avail;
+  ELLIS_ASSERT_FALSE(dn.next_input_buf(&buf, &avail));
+}
+
+int main() {
+  using namespace ellis;
+  g_have_uring = uring().init(1);
+  if (! g_have_uring) {
+    printf("io_uring not available; testing the fallback\n");
+  }
+  round_trip_test("", 0);
+  round_trip_test("0", 1);
+  string buf(600000, 0);
+  for (size_t i = 0; i < buf.size(); ++i) {
+    buf[i] = 'A' + (i % 13);
+  }
+  round_trip_test(buf.data(), 999);
+  round_trip_test(buf.data(), 4096);
+  round_trip_test(buf.data(), 20001);
+  round_trip_test(buf.data(), buf.size());
+  check_put_back(buf.data(), 9000);
+  check_load_dump();
+  check_errors();
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2016 Surround.IO Corporation. All Rights Reserved.
+ * Copyright (c) 2017 Xevo Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#undef NDEBUG
+#include <ellis/codec/json.hpp>
+#include <ellis/codec/msgpack.hpp>
+#include <ellis/core/array_node.hpp>
+#include <ellis/core/binary_node.hpp>
+#include <ellis/core/emigration.hpp>
+#include <ellis/core/immigration.hpp>
+#include <ellis/core/map_node.hpp>
+#include <ellis/core/system.hpp>
+#include <ellis/stream/vector_output_stream.hpp>
+#include <ellis_private/using.hpp>
+#include <sstream>
+
+using namespace ellis;
+
+
+static node make_doc(size_t records, size_t blob_len)
+{
+  node doc(type::MAP);
+  node arr(type::ARRAY);
+  for (size_t i = 0; i < records; i++) {
+    node rec(type::MAP);
+    rec.as_mutable_map().insert("id", (int64_t)i);
+    rec.as_mutable_map().insert("name", "record " + std::to_string(i));
+    arr.as_mutable_array().append(std::move(rec));
+  }
+  doc.as_mutable_map().insert("records", std::move(arr));
+  node blob(type::BINARY);
+  blob.as_mutable_binary().resize(blob_len);
+  for (size_t i = 0; i < blob_len; i++) {
+    blob.as_mutable_binary()[i] = (byte)(i * 31);
+  }
+  doc.as_mutable_map().insert("blob", std::move(blob));
+  return doc;
+}
+
+template <typename TENCODER>
+static string via_stream(const node &doc, TENCODER &&enco)
+{
+  std::ostringstream os;
+  dump_stream(&doc, os, enco);
+  return os.str();
+}
+
+void check_growth()
+{
+  /* A byte at a time, from the smallest start. */
+  vector_output_stream out(1);
+  for (size_t i = 0; i < 100000; i++) {
+    byte *buf;
+    size_t avail;
+    ELLIS_ASSERT_TRUE(out.next_output_buf(&buf, &avail));
+    ELLIS_ASSERT_GT(avail, 0);
+    buf[0] = (byte)i;
+    ELLIS_ASSERT_TRUE(out.emit(1));
+    ELLIS_ASSERT_EQ(out.size(), i + 1);
+  }
+  ELLIS_ASSERT_NULL(out.extract_output_error().get());
+  vector<byte> got = out.release();
+  ELLIS_ASSERT_EQ(got.size(), 100000u);
+  for (size_t i = 0; i < got.size(); i++) {
+    ELLIS_ASSERT_EQ(got[i], (byte)i);
+  }
+  /* Released, so empty again, but still usable. */
+  ELLIS_ASSERT_EQ(out.size(), 0u);
+  ELLIS_ASSERT_EQ(out.release().size(), 0u);
+  byte *buf;
+  size_t avail;
+  ELLIS_ASSERT_TRUE(out.next_output_buf(&buf, &avail));
+  buf[0] = 'x';
+  out.emit(1);
+  ELLIS_ASSERT_EQ(out.size(), 1u);
+  ELLIS_ASSERT_EQ(out.data()[0], 'x');
+}
+
+void check_dump_vector()
+{
+  for (size_t records : { 0, 1, 100, 10000 }) {
+    for (size_t blob_len : { 0, 100, 70000, 3000000 }) {
+      const node doc = make_doc(records, blob_len);
+
+      const string want = via_stream(doc, msgpack_encoder());
+      vector<byte> got = dump_vector(&doc, msgpack_encoder());
+      ELLIS_ASSERT_EQ(got.size(), want.size());
+      ELLIS_ASSERT_MEM_EQ(got.data(), (const byte *)want.data(), want.size());
+      auto back = load_mem(got.data(), got.size(), msgpack_decoder());
+      ELLIS_ASSERT_TRUE(*back == doc);
+
+      const string json = via_stream(doc, json_encoder());
+      got = dump_vector(&doc, json_encoder());
+      ELLIS_ASSERT_TRUE(string(got.begin(), got.end()) == json);
+    }
+  }
+}
+
+void check_reuse()
+{
+  const node big = make_doc(1000, 100000);
+  const node small = make_doc(10, 10);
+  vector<byte> buf;
+  dump_vector(&big, &buf, msgpack_encoder());
+  const size_t big_size = buf.size();
+  const byte *storage = buf.data();
+  const size_t cap = buf.capacity();
+
+  /* Smaller and same-sized documents go in the same storage. */
+  for (int i = 0; i < 3; i++) {
+    dump_vector(&small, &buf, msgpack_encoder());
+    ELLIS_ASSERT_TRUE(*load_mem(buf.data(), buf.size(), msgpack_decoder())
+        == small);
+    dump_vector(&big, &buf, msgpack_encoder());
+    ELLIS_ASSERT_EQ(buf.size(), big_size);
+    ELLIS_ASSERT_TRUE(*load_mem(buf.data(), buf.size(), msgpack_decoder())
+        == big);
+    ELLIS_ASSERT_TRUE(buf.data() == storage);
+    ELLIS_ASSERT_EQ(buf.capacity(), cap);
+  }
+}
+
+int main() {
+  check_growth();
+  check_dump_vector();
+  check_reuse();
+  return 0;
+}
@@ -23,10 +23,20 @@
 
 
 #undef NDEBUG
+#include <ellis/codec/json.hpp>
 #include <ellis/core/emigration.hpp>
 #include <ellis/core/immigration.hpp>
 #include <iostream>
 #include <stdlib.h>
+#include <string.h>
+
+
+static bool ends_with(const char *s, const char *suffix)
+{
+  size_t slen = strlen(s);
+  size_t suflen = strlen(suffix);
+  return slen >= suflen && strcmp(s + slen - suflen, suffix) == 0;
+}
 
 
 int main(int argc, char *argv[]) {
@@ -34,17 +44,48 @@ int main(int argc, char *argv[]) {
   using std::cerr;
   using std::endl;
 
-  if (argc != 3) {
-    cerr << "Syntax: " << argv[0] << " in_filename out_filename" << endl;
+  ellis::json_encoder_opts json_opts;
+  bool json_opts_given = false;
+  int argi = 1;
+  for (; argi < argc && strncmp(argv[argi], "--", 2) == 0; argi++) {
+    if (strcmp(argv[argi], "--compact") == 0) {
+      json_opts.compact = true;
+      json_opts_given = true;
+    }
+    else if (strcmp(argv[argi], "--sort-keys") == 0) {
+      json_opts.sort_keys = true;
+      json_opts_given = true;
+    }
+    else {
+      cerr << "Unknown option: " << argv[argi] << endl;
+      exit(1);
+    }
+  }
+
+  if (argc - argi != 2) {
+    cerr << "Syntax: " << argv[0]
+      << " [--compact] [--sort-keys] in_filename out_filename" << endl
+      << "  --compact    JSON output without insignificant whitespace" << endl
+      << "  --sort-keys  JSON output with map keys in sorted order" << endl;
     exit(1);
   }
 
-  const char *in_filename = argv[1];
-  const char *out_filename = argv[2];
+  const char *in_filename = argv[argi];
+  const char *out_filename = argv[argi + 1];
+
+  if (json_opts_given && ! ends_with(out_filename, ".json")) {
+    cerr << "JSON output options require a .json out_filename" << endl;
+    exit(1);
+  }
 
   try {
     auto n = ellis::load_file_autodecode(in_filename);
-    ellis::dump_file_autoencode(n.get(), out_filename);
+    if (json_opts_given) {
+      ellis::dump_file(n.get(), out_filename, ellis::json_encoder(json_opts));
+    }
+    else {
+      ellis::dump_file_autoencode(n.get(), out_filename);
+    }
   }
   catch (const ellis::err &e) {
     cerr << "ERROR: " << e.msg() << endl << "Details\n" << e.summary() << endl;